@@ -0,0 +1,276 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "v3async.h"
+#include "v3batch.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Jobs larger than this are split into independent items so several workers
+// can share them.
+#define V3_ASYNC_CHUNK 16384
+
+// A worker keeps dequeuing items until it holds at least this many vectors,
+// so a burst of tiny jobs costs one lock round-trip and one task dispatch.
+#define V3_ASYNC_BATCH 16384
+
+typedef struct v3_item {
+    v3_job job;
+    v3_stream_mode stream;     // decided from the whole submitted job
+    v3_future *future;
+    struct v3_item *next;
+} v3_item;
+
+struct v3_future {
+    v3_queue *queue;
+    atomic_size_t remaining;   // items not yet completed
+    atomic_uint refs;          // caller handle + queue
+    struct v3_future *done_next;
+    v3_item items[];           // one allocation per submitted job
+};
+
+struct v3_queue {
+    v3_pool *pool;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    v3_item *head;
+    v3_item *tail;
+    size_t pending_items;      // queued or running
+    size_t queued_vectors;     // queued, not yet claimed by a worker
+    unsigned drainers;         // drain tasks submitted or running
+};
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+static bool op_needs_b(v3_op op) {
+    return op != V3_OP_SCALE && op != V3_OP_LENGTH && op != V3_OP_NORMALIZE;
+}
+
+static bool op_scalar_output(v3_op op) {
+    return op == V3_OP_DOT || op == V3_OP_LENGTH;
+}
+
+static bool v3_job_valid(const v3_job *job) {
+    if (job == NULL) return false;
+    if ((unsigned)job->op > (unsigned)V3_OP_REFLECT) return false;
+    if (job->dst == NULL || job->a == NULL) return false;
+    if (op_needs_b(job->op) && job->b == NULL) return false;
+    return true;
+}
+
+static void future_release(v3_future *f) {
+    if (atomic_fetch_sub(&f->refs, 1) == 1) free(f);
+}
+
+void v3_job_run(const v3_job *job) {
+    if (!v3_job_valid(job)) {
+        v3_error("v3_job_run received invalid job");
+        return;
+    }
+    switch (job->op) {
+    case V3_OP_ADD:       v3_add_n(job->dst, job->a, job->b, job->count); break;
+    case V3_OP_SUBTRACT:  v3_subtract_n(job->dst, job->a, job->b, job->count); break;
+    case V3_OP_SCALE:     v3_scale_n(job->dst, job->a, job->s, job->count); break;
+    case V3_OP_DOT:       v3_dot_product_n(job->dst, job->a, job->b, job->count); break;
+    case V3_OP_CROSS:     v3_cross_product_n(job->dst, job->a, job->b, job->count); break;
+    case V3_OP_LENGTH:    v3_length_n(job->dst, job->a, job->count); break;
+    case V3_OP_NORMALIZE: v3_normalize_n(job->dst, job->a, job->count); break;
+    case V3_OP_REFLECT:   v3_reflect_n(job->dst, job->a, job->b, job->count); break;
+    }
+}
+
+v3_job v3_job_slice(const v3_job *job, size_t begin, size_t end) {
+    v3_job part = *job;
+    size_t out_stride = op_scalar_output(job->op) ? 1 : 3;
+    part.count = end - begin;
+    part.dst = job->dst + begin * out_stride;
+    part.a = job->a + begin * 3;
+    part.b = op_needs_b(job->op) ? job->b + begin * 3 : NULL;
+    return part;
+}
+
+v3_stream_mode v3_job_stream_mode(const v3_job *job) {
+    if (job == NULL || op_scalar_output(job->op)) return V3_STREAM_OFF;
+    return job->count * 3 * sizeof(float) >= v3_batch_stream_threshold() ? V3_STREAM_ON : V3_STREAM_OFF;
+}
+
+static void run_with_mode(const v3_job *job, v3_stream_mode mode) {
+    v3_stream_mode old = v3_batch_set_thread_stream_mode(mode);
+    v3_job_run(job);
+    v3_batch_set_thread_stream_mode(old);
+}
+
+void v3_job_run_range(const v3_job *job, size_t begin, size_t end) {
+    if (!v3_job_valid(job) || begin > end || end > job->count) {
+        v3_error("v3_job_run_range received invalid job");
+        return;
+    }
+    v3_job part = v3_job_slice(job, begin, end);
+    run_with_mode(&part, v3_job_stream_mode(job));
+}
+
+// ---------- worker side ----------
+static void drain(void *arg) {
+    v3_queue *q = arg;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->head != NULL) {
+        // claim a batch of items totalling at least V3_ASYNC_BATCH vectors
+        v3_item *batch = q->head;
+        v3_item *last = NULL;
+        size_t vectors = 0, nitems = 0;
+        while (q->head != NULL && vectors < V3_ASYNC_BATCH) {
+            last = q->head;
+            vectors += last->job.count;
+            nitems++;
+            q->head = last->next;
+        }
+        if (q->head == NULL) q->tail = NULL;
+        last->next = NULL;
+        q->queued_vectors -= vectors;
+        pthread_mutex_unlock(&q->lock);
+
+        v3_future *finished = NULL;
+        for (v3_item *it = batch; it != NULL;) {
+            v3_item *next = it->next;
+            v3_future *f = it->future;
+            run_with_mode(&it->job, it->stream);
+            if (atomic_fetch_sub(&f->remaining, 1) == 1) {
+                f->done_next = finished;
+                finished = f;
+            }
+            it = next;
+        }
+
+        pthread_mutex_lock(&q->lock);
+        q->pending_items -= nitems;
+        if (finished != NULL) pthread_cond_broadcast(&q->done);
+        // the queue's references are dropped only after waiters were woken
+        pthread_mutex_unlock(&q->lock);
+        while (finished != NULL) {
+            v3_future *next = finished->done_next;
+            future_release(finished);
+            finished = next;
+        }
+        pthread_mutex_lock(&q->lock);
+    }
+    q->drainers--;
+    pthread_cond_broadcast(&q->done);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// ---------- queue API ----------
+v3_queue *v3_queue_create(v3_pool *pool) {
+    if (pool == NULL) pool = v3_pool_default();
+    if (pool == NULL) {
+        v3_error("v3_queue_create has no worker pool");
+        return NULL;
+    }
+    v3_queue *q = calloc(1, sizeof(*q));
+    if (q == NULL) {
+        v3_error("v3_queue_create out of memory");
+        return NULL;
+    }
+    q->pool = pool;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->done, NULL);
+    return q;
+}
+
+void v3_queue_destroy(v3_queue *q) {
+    if (q == NULL) return;
+    pthread_mutex_lock(&q->lock);
+    while (q->pending_items > 0 || q->drainers > 0) {
+        pthread_cond_wait(&q->done, &q->lock);
+    }
+    pthread_mutex_unlock(&q->lock);
+    pthread_cond_destroy(&q->done);
+    pthread_mutex_destroy(&q->lock);
+    free(q);
+}
+
+v3_future *v3_queue_submit(v3_queue *q, const v3_job *job) {
+    if (q == NULL || !v3_job_valid(job)) {
+        v3_error("v3_queue_submit received invalid job");
+        return NULL;
+    }
+
+    size_t nitems = (job->count + V3_ASYNC_CHUNK - 1) / V3_ASYNC_CHUNK;
+    v3_future *f = malloc(sizeof(*f) + nitems * sizeof(v3_item));
+    if (f == NULL) {
+        v3_error("v3_queue_submit out of memory");
+        return NULL;
+    }
+    f->queue = q;
+    f->done_next = NULL;
+    atomic_init(&f->remaining, nitems);
+    atomic_init(&f->refs, nitems > 0 ? 2u : 1u);
+    if (nitems == 0) return f;  // empty job is complete immediately
+
+    v3_stream_mode stream = v3_job_stream_mode(job);
+    for (size_t i = 0; i < nitems; i++) {
+        size_t begin = i * V3_ASYNC_CHUNK;
+        size_t end = job->count - begin < V3_ASYNC_CHUNK ? job->count : begin + V3_ASYNC_CHUNK;
+        v3_item *it = &f->items[i];
+        it->job = v3_job_slice(job, begin, end);
+        it->stream = stream;
+        it->future = f;
+        it->next = i + 1 < nitems ? &f->items[i + 1] : NULL;
+    }
+
+    unsigned threads = v3_pool_size(q->pool);
+    bool run_inline = false;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->tail != NULL) q->tail->next = &f->items[0];
+    else q->head = &f->items[0];
+    q->tail = &f->items[nitems - 1];
+    q->pending_items += nitems;
+    q->queued_vectors += job->count;
+
+    // wake only as many workers as there are full batches of queued work
+    size_t want = (q->queued_vectors + V3_ASYNC_BATCH - 1) / V3_ASYNC_BATCH;
+    if (want > threads) want = threads;
+    if (want == 0) want = 1;
+    while (q->drainers < want) {
+        q->drainers++;
+        if (!v3_pool_submit(q->pool, drain, q)) {
+            run_inline = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    if (run_inline) drain(q);
+    return f;
+}
+
+bool v3_future_ready(v3_future *f) {
+    if (f == NULL) return false;
+    return atomic_load(&f->remaining) == 0;
+}
+
+void v3_future_wait(v3_future *f) {
+    if (f == NULL) {
+        v3_error("v3_future_wait received NULL pointer");
+        return;
+    }
+    if (atomic_load(&f->remaining) == 0) return;
+
+    v3_queue *q = f->queue;
+    pthread_mutex_lock(&q->lock);
+    while (atomic_load(&f->remaining) != 0) {
+        pthread_cond_wait(&q->done, &q->lock);
+    }
+    pthread_mutex_unlock(&q->lock);
+}
+
+void v3_future_release(v3_future *f) {
+    if (f == NULL) return;
+    future_release(f);
+}
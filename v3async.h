@@ -0,0 +1,76 @@
+#ifndef V3ASYNC_H
+#define V3ASYNC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "v3batch.h"
+#include "v3pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Asynchronous submission of batched v3 operations. Jobs are queued and run
+// on a worker pool; large jobs are split into chunks and small jobs from any
+// number of submitting threads are coalesced into one batch per worker pass.
+
+typedef enum {
+    V3_OP_ADD,        // dst = a + b
+    V3_OP_SUBTRACT,   // dst = a - b
+    V3_OP_SCALE,      // dst = a * s
+    V3_OP_DOT,        // dst[i] = dot(a[i], b[i]) (scalar output)
+    V3_OP_CROSS,      // dst = a x b
+    V3_OP_LENGTH,     // dst[i] = |a[i]| (scalar output)
+    V3_OP_NORMALIZE,  // dst = a / |a|
+    V3_OP_REFLECT     // dst = reflect a about b
+} v3_op;
+
+typedef struct {
+    v3_op op;
+    float *dst;
+    float *a;
+    float *b;      // unused by SCALE, LENGTH and NORMALIZE
+    float s;       // only used by SCALE
+    size_t count;  // number of vectors
+} v3_job;
+
+typedef struct v3_queue v3_queue;
+typedef struct v3_future v3_future;
+
+// pool == NULL uses v3_pool_default()
+v3_queue *v3_queue_create(v3_pool *pool);
+
+// blocks until every submitted job has completed
+void v3_queue_destroy(v3_queue *queue);
+
+// The buffers named by the job must stay valid until the future is ready.
+// Returns NULL (after reporting an error) if the job is invalid.
+v3_future *v3_queue_submit(v3_queue *queue, const v3_job *job);
+
+bool v3_future_ready(v3_future *future);  // non-blocking poll
+void v3_future_wait(v3_future *future);
+
+// drop the caller's handle; the job still runs to completion if pending
+void v3_future_release(v3_future *future);
+
+// run a job synchronously on the calling thread
+void v3_job_run(const v3_job *job);
+
+// the part of job covering vectors [begin, end)
+v3_job v3_job_slice(const v3_job *job, size_t begin, size_t end);
+
+// Whether the vector output of the whole job streams: ON when it reaches
+// v3_batch_stream_threshold(), OFF otherwise and for scalar outputs.
+v3_stream_mode v3_job_stream_mode(const v3_job *job);
+
+// Run the slice [begin, end) of job on the calling thread with the store
+// mode of the whole job, so the chunks of a large job stream even though
+// each one alone is below the threshold.
+void v3_job_run_range(const v3_job *job, size_t begin, size_t end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
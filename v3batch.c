@@ -0,0 +1,661 @@
+#include "v3batch.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+// AVX2 kernels are compiled with a target attribute and picked at run time,
+// so the default -O2 build still uses them on CPUs that have AVX2
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define V3_AVX2_DISPATCH 1
+#endif
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+static bool v3_valid_arrays(float *a, float *b, float *c) {
+    return a != NULL && b != NULL && c != NULL;
+}
+
+// ---------- vector-output kernels ----------
+// Each loop loads the inputs of element i before storing element i, so
+// dst == a (or dst == b) behaves like the overlap-safe scalar functions.
+// The shared signature lets run_vec_kernel pick cached or streaming stores;
+// the return value is the number of elements that hit an error fallback.
+typedef size_t (*vec_kernel)(float *dst, float *a, float *b, float s, size_t count);
+
+static size_t add_kernel(float *dst, float *a, float *b, float s, size_t count) {
+    (void)s;
+    for (size_t i = 0; i < 3 * count; i++) {
+        dst[i] = a[i] + b[i];
+    }
+    return 0;
+}
+
+static size_t subtract_kernel(float *dst, float *a, float *b, float s, size_t count) {
+    (void)s;
+    for (size_t i = 0; i < 3 * count; i++) {
+        dst[i] = a[i] - b[i];
+    }
+    return 0;
+}
+
+static size_t scale_kernel(float *dst, float *a, float *b, float s, size_t count) {
+    (void)b;
+    for (size_t i = 0; i < 3 * count; i++) {
+        dst[i] = a[i] * s;
+    }
+    return 0;
+}
+
+static size_t cross_kernel(float *dst, float *a, float *b, float s, size_t count) {
+    (void)s;
+    for (size_t i = 0; i < count; i++) {
+        float *pa = a + 3 * i, *pb = b + 3 * i, *pd = dst + 3 * i;
+        float ax = pa[0], ay = pa[1], az = pa[2];
+        float bx = pb[0], by = pb[1], bz = pb[2];
+        pd[0] = ay*bz - az*by;
+        pd[1] = az*bx - ax*bz;
+        pd[2] = ax*by - ay*bx;
+    }
+    return 0;
+}
+
+static size_t normalize_kernel(float *dst, float *a, float *b, float s, size_t count) {
+    (void)b;
+    (void)s;
+    size_t bad = 0;
+    for (size_t i = 0; i < count; i++) {
+        float *pa = a + 3 * i, *pd = dst + 3 * i;
+        float x = pa[0], y = pa[1], z = pa[2];
+        float len = sqrtf(x*x + y*y + z*z);
+        // branch-free select keeps the loop vectorizable
+        bool ok = len != 0.0f && isfinite(len);
+        float inv = ok ? 1.0f / len : 0.0f;
+        bad += !ok;
+        pd[0] = x * inv;
+        pd[1] = y * inv;
+        pd[2] = z * inv;
+    }
+    return bad;
+}
+
+static size_t reflect_kernel(float *dst, float *v, float *n, float s, size_t count) {
+    (void)s;
+    size_t bad = 0;
+    for (size_t i = 0; i < count; i++) {
+        float *pv = v + 3 * i, *pn = n + 3 * i, *pd = dst + 3 * i;
+        float vx = pv[0], vy = pv[1], vz = pv[2];
+        float nx = pn[0], ny = pn[1], nz = pn[2];
+        float nn = nx*nx + ny*ny + nz*nz;
+        bool ok = nn != 0.0f && isfinite(nn);
+        // r = v - 2*dot(v,n)/dot(n,n)*n avoids normalizing n explicitly;
+        // a zero normal falls back to copying v, like v3_reflect
+        float k = ok ? 2.0f * (vx*nx + vy*ny + vz*nz) / nn : 0.0f;
+        bad += !ok;
+        pd[0] = vx - k * nx;
+        pd[1] = vy - k * ny;
+        pd[2] = vz - k * nz;
+    }
+    return bad;
+}
+
+// ---------- change detection ----------
+// Four vectors are twelve floats, i.e. three SSE registers per array. The
+// compare masks give one bit per component; vector k owns bits 3k..3k+2 and
+// has changed if any of them is clear.
+#define V3_CHANGE_CHUNK 64   // vectors tested between early-out checks
+
+#ifdef __SSE__
+static inline unsigned changed4(const float *a, const float *b, __m128 tol) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    unsigned ok = 0;
+    for (int j = 0; j < 3; j++) {
+        __m128 d = _mm_andnot_ps(sign, _mm_sub_ps(_mm_loadu_ps(a + 4 * j), _mm_loadu_ps(b + 4 * j)));
+        ok |= (unsigned)_mm_movemask_ps(_mm_cmple_ps(d, tol)) << (4 * j);
+    }
+    unsigned bad = ~ok & 0xfffu;
+    bad |= bad >> 1 | bad >> 2;
+    return (bad & 1u) | (bad >> 2 & 2u) | (bad >> 4 & 4u) | (bad >> 6 & 8u);
+}
+#endif
+
+static inline unsigned changed1(const float *a, const float *b, float tol) {
+    return !((fabsf(a[0] - b[0]) <= tol) & (fabsf(a[1] - b[1]) <= tol) & (fabsf(a[2] - b[2]) <= tol));
+}
+
+static float abs_tol(float tol) {
+    return tol < 0.0f ? -tol : tol;
+}
+
+bool v3_any_changed_n(float *a, float *b, float tol, size_t count) {
+    if (!v3_valid_arrays(a, b, b)) {
+        v3_error("v3_any_changed_n received NULL pointer");
+        return false;
+    }
+    tol = abs_tol(tol);
+    size_t i = 0;
+#ifdef __SSE__
+    __m128 vtol = _mm_set1_ps(tol);
+    for (; i + V3_CHANGE_CHUNK <= count; i += V3_CHANGE_CHUNK) {
+        unsigned m = 0;
+        for (size_t k = i; k < i + V3_CHANGE_CHUNK; k += 4) m |= changed4(a + 3 * k, b + 3 * k, vtol);
+        if (m != 0) return true;
+    }
+#endif
+    for (; i < count; i++) {
+        if (changed1(a + 3 * i, b + 3 * i, tol)) return true;
+    }
+    return false;
+}
+
+bool v3_all_changed_n(float *a, float *b, float tol, size_t count) {
+    if (!v3_valid_arrays(a, b, b)) {
+        v3_error("v3_all_changed_n received NULL pointer");
+        return false;
+    }
+    tol = abs_tol(tol);
+    size_t i = 0;
+#ifdef __SSE__
+    __m128 vtol = _mm_set1_ps(tol);
+    for (; i + V3_CHANGE_CHUNK <= count; i += V3_CHANGE_CHUNK) {
+        unsigned m = 0xfu;
+        for (size_t k = i; k < i + V3_CHANGE_CHUNK; k += 4) m &= changed4(a + 3 * k, b + 3 * k, vtol);
+        if (m != 0xfu) return false;
+    }
+#endif
+    for (; i < count; i++) {
+        if (!changed1(a + 3 * i, b + 3 * i, tol)) return false;
+    }
+    return true;
+}
+
+size_t v3_count_changed_n(float *a, float *b, float tol, size_t count) {
+    if (!v3_valid_arrays(a, b, b)) {
+        v3_error("v3_count_changed_n received NULL pointer");
+        return 0;
+    }
+    tol = abs_tol(tol);
+    size_t n = 0, i = 0;
+#ifdef __SSE__
+    static const unsigned char bits4[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+    __m128 vtol = _mm_set1_ps(tol);
+    for (; i + 4 <= count; i += 4) n += bits4[changed4(a + 3 * i, b + 3 * i, vtol)];
+#endif
+    for (; i < count; i++) n += changed1(a + 3 * i, b + 3 * i, tol);
+    return n;
+}
+
+size_t v3_changed_indices_n(uint32_t *idx, float *a, float *b, float tol, size_t count) {
+    if (!v3_valid_arrays(a, b, b) || idx == NULL) {
+        v3_error("v3_changed_indices_n received NULL pointer");
+        return 0;
+    }
+    if (count > (size_t)UINT32_MAX + 1) {
+        v3_error("v3_changed_indices_n count exceeds 32-bit indices");
+        return 0;
+    }
+    tol = abs_tol(tol);
+    // Branch-free compaction: every candidate index is stored and the
+    // write position only advances past changed ones. Position n never
+    // exceeds the element being tested, so idx[count] is never touched.
+    size_t n = 0, i = 0;
+#ifdef __SSE__
+    __m128 vtol = _mm_set1_ps(tol);
+    for (; i + 4 <= count; i += 4) {
+        unsigned m = changed4(a + 3 * i, b + 3 * i, vtol);
+        if (m == 0) continue;   // the common case when few elements change
+        for (unsigned k = 0; k < 4; k++) {
+            idx[n] = (uint32_t)(i + k);
+            n += m >> k & 1u;
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        idx[n] = (uint32_t)i;
+        n += changed1(a + 3 * i, b + 3 * i, tol);
+    }
+    return n;
+}
+
+// ---------- streaming stores ----------
+// Outputs at least this large bypass the cache: results are computed into a
+// small L1-resident block and copied out with non-temporal stores (movntps),
+// which skips the read-for-ownership of dst and leaves the cache to the inputs.
+#define V3_STREAM_THRESHOLD_DEFAULT ((size_t)8 << 20)
+#define V3_STREAM_BLOCK 256  // vectors per block; 3 * 256 floats is a multiple of 4
+
+static atomic_size_t g_stream_threshold = V3_STREAM_THRESHOLD_DEFAULT;
+static _Thread_local v3_stream_mode tl_stream_mode = V3_STREAM_AUTO;
+
+void v3_batch_set_stream_threshold(size_t bytes) {
+    atomic_store_explicit(&g_stream_threshold, bytes, memory_order_relaxed);
+}
+
+size_t v3_batch_stream_threshold(void) {
+    return atomic_load_explicit(&g_stream_threshold, memory_order_relaxed);
+}
+
+v3_stream_mode v3_batch_set_thread_stream_mode(v3_stream_mode mode) {
+    v3_stream_mode old = tl_stream_mode;
+    tl_stream_mode = mode;
+    return old;
+}
+
+#ifdef __SSE__
+// nfloats must be a multiple of 4 and dst 16-byte aligned
+static void stream_copy(float *dst, const float *src, size_t nfloats) {
+    for (size_t i = 0; i < nfloats; i += 4) {
+        _mm_stream_ps(dst + i, _mm_load_ps(src + i));
+    }
+}
+
+static size_t run_streaming(vec_kernel fn, float *dst, float *a, float *b, float s, size_t count) {
+    // a dst that is not even float aligned can never reach a 16-byte boundary
+    if (((uintptr_t)dst & 3) != 0) return fn(dst, a, b, s, count);
+
+    size_t bad = 0;
+    size_t i = 0;
+    // 12-byte vectors reach a 16-byte boundary within 3 vectors
+    while (i < count && ((uintptr_t)(dst + 3 * i) & 15) != 0) {
+        bad += fn(dst + 3 * i, a + 3 * i, b != NULL ? b + 3 * i : NULL, s, 1);
+        i++;
+    }
+
+    _Alignas(16) float block[3 * V3_STREAM_BLOCK];
+    while (i < count) {
+        size_t n = count - i < V3_STREAM_BLOCK ? count - i : V3_STREAM_BLOCK;
+        bad += fn(block, a + 3 * i, b != NULL ? b + 3 * i : NULL, s, n);
+        size_t whole = (3 * n) & ~(size_t)3;
+        stream_copy(dst + 3 * i, block, whole);
+        for (size_t k = whole; k < 3 * n; k++) dst[3 * i + k] = block[k];
+        i += n;
+    }
+    // order the weakly-ordered stores before anything that follows
+    _mm_sfence();
+    return bad;
+}
+#endif
+
+static size_t run_vec_kernel(vec_kernel fn, float *dst, float *a, float *b, float s, size_t count) {
+#ifdef __SSE__
+    bool stream = tl_stream_mode == V3_STREAM_AUTO ? count * 3 * sizeof(float) >= v3_batch_stream_threshold()
+                                                   : tl_stream_mode == V3_STREAM_ON;
+    if (stream) return run_streaming(fn, dst, a, b, s, count);
+#endif
+    return fn(dst, a, b, s, count);
+}
+
+// ---------- batched kernels ----------
+
+void v3_add_n(float *dst, float *a, float *b, size_t count) {
+    if (!v3_valid_arrays(dst, a, b)) {
+        v3_error("v3_add_n received NULL pointer");
+        return;
+    }
+    run_vec_kernel(add_kernel, dst, a, b, 0.0f, count);
+}
+
+void v3_subtract_n(float *dst, float *a, float *b, size_t count) {
+    if (!v3_valid_arrays(dst, a, b)) {
+        v3_error("v3_subtract_n received NULL pointer");
+        return;
+    }
+    run_vec_kernel(subtract_kernel, dst, a, b, 0.0f, count);
+}
+
+void v3_scale_n(float *dst, float *a, float s, size_t count) {
+    if (!v3_valid_arrays(dst, a, a)) {
+        v3_error("v3_scale_n received NULL pointer");
+        return;
+    }
+    run_vec_kernel(scale_kernel, dst, a, NULL, s, count);
+}
+
+void v3_dot_product_n(float *dst, float *a, float *b, size_t count) {
+    if (!v3_valid_arrays(dst, a, b)) {
+        v3_error("v3_dot_product_n received NULL pointer");
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        float *pa = a + 3 * i, *pb = b + 3 * i;
+        dst[i] = pa[0]*pb[0] + pa[1]*pb[1] + pa[2]*pb[2];
+    }
+}
+
+void v3_cross_product_n(float *dst, float *a, float *b, size_t count) {
+    if (!v3_valid_arrays(dst, a, b)) {
+        v3_error("v3_cross_product_n received NULL pointer");
+        return;
+    }
+    run_vec_kernel(cross_kernel, dst, a, b, 0.0f, count);
+}
+
+void v3_length_n(float *dst, float *a, size_t count) {
+    if (!v3_valid_arrays(dst, a, a)) {
+        v3_error("v3_length_n received NULL pointer");
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        float *pa = a + 3 * i;
+        dst[i] = sqrtf(pa[0]*pa[0] + pa[1]*pa[1] + pa[2]*pa[2]);
+    }
+}
+
+void v3_normalize_n(float *dst, float *a, size_t count) {
+    if (!v3_valid_arrays(dst, a, a)) {
+        v3_error("v3_normalize_n received NULL pointer");
+        return;
+    }
+    size_t bad = run_vec_kernel(normalize_kernel, dst, a, NULL, 0.0f, count);
+    if (bad != 0) {
+        fprintf(stderr, "Error: v3_normalize_n could not normalize %zu zero-length or non-finite vector(s)\n", bad);
+    }
+}
+
+void v3_reflect_n(float *dst, float *v, float *n, size_t count) {
+    if (!v3_valid_arrays(dst, v, n)) {
+        v3_error("v3_reflect_n received NULL pointer");
+        return;
+    }
+    size_t bad = run_vec_kernel(reflect_kernel, dst, v, n, 0.0f, count);
+    if (bad != 0) {
+        fprintf(stderr, "Error: v3_reflect_n undefined for %zu zero-length normal(s)\n", bad);
+    }
+}
+
+// ---------- structure-of-arrays transforms ----------
+// translate is 1 for points and 0 for vectors; the scalar remainder matches
+// the SSE body bit for bit
+static void transform_soa(v3_soa3 dst, const float *m, v3_soa3 src, float translate, size_t count) {
+    size_t i = 0;
+#ifdef __SSE__
+    __m128 r[12];
+    for (int k = 0; k < 12; k++) r[k] = _mm_set1_ps(m[k] * (k % 4 == 3 ? translate : 1.0f));
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(src.x + i), y = _mm_loadu_ps(src.y + i), z = _mm_loadu_ps(src.z + i);
+        for (int row = 0; row < 3; row++) {
+            const __m128 *mr = r + 4 * row;
+            __m128 v = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(mr[0], x), _mm_mul_ps(mr[1], y)),
+                                             _mm_mul_ps(mr[2], z)), mr[3]);
+            _mm_storeu_ps((row == 0 ? dst.x : row == 1 ? dst.y : dst.z) + i, v);
+        }
+    }
+#endif
+    float tx = m[3] * translate, ty = m[7] * translate, tz = m[11] * translate;
+    for (; i < count; i++) {
+        float x = src.x[i], y = src.y[i], z = src.z[i];
+        dst.x[i] = m[0]*x + m[1]*y + m[2]*z + tx;
+        dst.y[i] = m[4]*x + m[5]*y + m[6]*z + ty;
+        dst.z[i] = m[8]*x + m[9]*y + m[10]*z + tz;
+    }
+}
+
+void v3_transform_points_soa(v3_soa3 dst, float *m, v3_soa3 src, size_t count) {
+    if (!v3_valid_arrays(dst.x, dst.y, dst.z) || !v3_valid_arrays(src.x, src.y, src.z) || m == NULL) {
+        v3_error("v3_transform_points_soa received NULL pointer");
+        return;
+    }
+    transform_soa(dst, m, src, 1.0f, count);
+}
+
+void v3_transform_vectors_soa(v3_soa3 dst, float *m, v3_soa3 src, size_t count) {
+    if (!v3_valid_arrays(dst.x, dst.y, dst.z) || !v3_valid_arrays(src.x, src.y, src.z) || m == NULL) {
+        v3_error("v3_transform_vectors_soa received NULL pointer");
+        return;
+    }
+    transform_soa(dst, m, src, 0.0f, count);
+}
+
+// ---------- structure-of-arrays refraction ----------
+// refract1 and the SSE loop perform the same operations in the same order,
+// so the remainder elements match the vector body bit for bit.
+static inline bool refract1(v3_soa3 refl, v3_soa3 refr, float *fresnel, v3_fresnel_mode mode,
+                            v3_soa3 d, v3_soa3 n, float eta, size_t i) {
+    float dx = d.x[i], dy = d.y[i], dz = d.z[i];
+    float nx = n.x[i], ny = n.y[i], nz = n.z[i];
+    float cosi = -(dx*nx + dy*ny + dz*nz);
+    float r = 2.0f * cosi;
+    float rx = dx + r * nx, ry = dy + r * ny, rz = dz + r * nz;
+    float k = 1.0f - eta * eta * (1.0f - cosi * cosi);
+    bool tir = k < 0.0f;
+    float cost = sqrtf(tir ? 0.0f : k);
+    float s = eta * cosi - cost;
+    refl.x[i] = rx;
+    refl.y[i] = ry;
+    refl.z[i] = rz;
+    refr.x[i] = tir ? rx : eta * dx + s * nx;
+    refr.y[i] = tir ? ry : eta * dy + s * ny;
+    refr.z[i] = tir ? rz : eta * dz + s * nz;
+    if (fresnel != NULL) {
+        float c = cosi < 0.0f ? 0.0f : cosi > 1.0f ? 1.0f : cosi;
+        float f;
+        if (mode == V3_FRESNEL_SCHLICK) {
+            float r0 = (1.0f - eta) / (1.0f + eta);
+            r0 *= r0;
+            float x = 1.0f - (eta > 1.0f ? cost : c), x2 = x * x;
+            f = r0 + (1.0f - r0) * (x2 * x2 * x);
+        } else {
+            float ds = eta * c + cost, dp = c + eta * cost;
+            float rs = (eta * c - cost) / ds, rp = (c - eta * cost) / dp;
+            f = (ds == 0.0f || dp == 0.0f) ? 1.0f : 0.5f * (rs * rs + rp * rp);
+        }
+        fresnel[i] = tir ? 1.0f : f;
+    }
+    return tir;
+}
+
+#ifdef __SSE__
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+#endif
+
+size_t v3_reflect_refract_soa(v3_soa3 refl, v3_soa3 refr, uint8_t *tir, float *fresnel,
+                              v3_fresnel_mode mode, v3_soa3 d, v3_soa3 n, float *eta, size_t count) {
+    if (!v3_valid_arrays(refl.x, refl.y, refl.z) || !v3_valid_arrays(refr.x, refr.y, refr.z) ||
+        !v3_valid_arrays(d.x, d.y, d.z) || !v3_valid_arrays(n.x, n.y, n.z) || eta == NULL) {
+        v3_error("v3_reflect_refract_soa received NULL pointer");
+        return 0;
+    }
+    size_t total = 0, i = 0;
+#ifdef __SSE__
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f), half = _mm_set1_ps(0.5f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 dx = _mm_loadu_ps(d.x + i), dy = _mm_loadu_ps(d.y + i), dz = _mm_loadu_ps(d.z + i);
+        __m128 nx = _mm_loadu_ps(n.x + i), ny = _mm_loadu_ps(n.y + i), nz = _mm_loadu_ps(n.z + i);
+        __m128 e = _mm_loadu_ps(eta + i);
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, nx), _mm_mul_ps(dy, ny)), _mm_mul_ps(dz, nz));
+        __m128 cosi = _mm_xor_ps(dot, sign);
+        __m128 r = _mm_mul_ps(two, cosi);
+        __m128 rx = _mm_add_ps(dx, _mm_mul_ps(r, nx));
+        __m128 ry = _mm_add_ps(dy, _mm_mul_ps(r, ny));
+        __m128 rz = _mm_add_ps(dz, _mm_mul_ps(r, nz));
+        __m128 k = _mm_sub_ps(one, _mm_mul_ps(_mm_mul_ps(e, e), _mm_sub_ps(one, _mm_mul_ps(cosi, cosi))));
+        __m128 m = _mm_cmplt_ps(k, zero);
+        __m128 cost = _mm_sqrt_ps(_mm_andnot_ps(m, k));
+        __m128 s = _mm_sub_ps(_mm_mul_ps(e, cosi), cost);
+        _mm_storeu_ps(refl.x + i, rx);
+        _mm_storeu_ps(refl.y + i, ry);
+        _mm_storeu_ps(refl.z + i, rz);
+        _mm_storeu_ps(refr.x + i, select_ps(m, rx, _mm_add_ps(_mm_mul_ps(e, dx), _mm_mul_ps(s, nx))));
+        _mm_storeu_ps(refr.y + i, select_ps(m, ry, _mm_add_ps(_mm_mul_ps(e, dy), _mm_mul_ps(s, ny))));
+        _mm_storeu_ps(refr.z + i, select_ps(m, rz, _mm_add_ps(_mm_mul_ps(e, dz), _mm_mul_ps(s, nz))));
+        if (fresnel != NULL) {
+            __m128 c = _mm_min_ps(_mm_max_ps(cosi, zero), one);
+            __m128 f, full = m;
+            if (mode == V3_FRESNEL_SCHLICK) {
+                __m128 r0 = _mm_div_ps(_mm_sub_ps(one, e), _mm_add_ps(one, e));
+                r0 = _mm_mul_ps(r0, r0);
+                __m128 x = _mm_sub_ps(one, select_ps(_mm_cmpgt_ps(e, one), cost, c));
+                __m128 x2 = _mm_mul_ps(x, x);
+                f = _mm_add_ps(r0, _mm_mul_ps(_mm_sub_ps(one, r0), _mm_mul_ps(_mm_mul_ps(x2, x2), x)));
+            } else {
+                __m128 ds = _mm_add_ps(_mm_mul_ps(e, c), cost);
+                __m128 dp = _mm_add_ps(c, _mm_mul_ps(e, cost));
+                __m128 rs = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(e, c), cost), ds);
+                __m128 rp = _mm_div_ps(_mm_sub_ps(c, _mm_mul_ps(e, cost)), dp);
+                f = _mm_mul_ps(half, _mm_add_ps(_mm_mul_ps(rs, rs), _mm_mul_ps(rp, rp)));
+                // a zero denominator (grazing ray, eta == 1) reflects fully
+                full = _mm_or_ps(full, _mm_or_ps(_mm_cmpeq_ps(ds, zero), _mm_cmpeq_ps(dp, zero)));
+            }
+            _mm_storeu_ps(fresnel + i, select_ps(full, one, f));
+        }
+        unsigned bits = (unsigned)_mm_movemask_ps(m);
+        for (int j = 0; j < 4; j++) {
+            uint8_t t = (uint8_t)(bits >> j & 1u);
+            if (tir != NULL) tir[i + j] = t;
+            total += t;
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        bool t = refract1(refl, refr, fresnel, mode, d, n, eta[i], i);
+        if (tir != NULL) tir[i] = t;
+        total += t;
+    }
+    return total;
+}
+
+// ---------- indexed (gather) kernels ----------
+// Random gathers are latency bound. Indices are read V3_PREFETCH_DISTANCE
+// elements ahead so the vectors they name are already in flight, and each
+// block of V3_GATHER_BLOCK elements is gathered into contiguous scratch first
+// so the arithmetic runs as a dense loop. In ./v3bench indexed, distances
+// of 16 to 64 performed alike; without prefetching the dot was ~15% slower.
+#define V3_PREFETCH_DISTANCE 32
+#define V3_GATHER_BLOCK 256
+
+#if defined(__GNUC__)
+#define V3_PREFETCH(p) __builtin_prefetch((p), 0, 1)
+#else
+#define V3_PREFETCH(p) ((void)(p))
+#endif
+
+static void gather_block(float *out, float *src, uint32_t *idx,
+                         size_t begin, size_t n, size_t count) {
+    for (size_t k = 0; k < n; k++) {
+        size_t i = begin + k;
+        if (i + V3_PREFETCH_DISTANCE < count) {
+            V3_PREFETCH(src + 3 * (size_t)idx[i + V3_PREFETCH_DISTANCE]);
+        }
+        float *p = src + 3 * (size_t)idx[i];
+        out[3 * k + 0] = p[0];
+        out[3 * k + 1] = p[1];
+        out[3 * k + 2] = p[2];
+    }
+}
+
+static void dot_indexed_blocked(float *dst, float *a, uint32_t *idx_a,
+                                float *b, uint32_t *idx_b, size_t begin, size_t count) {
+    float ga[3 * V3_GATHER_BLOCK], gb[3 * V3_GATHER_BLOCK];
+    for (size_t i = begin; i < count; i += V3_GATHER_BLOCK) {
+        size_t n = count - i < V3_GATHER_BLOCK ? count - i : V3_GATHER_BLOCK;
+        gather_block(ga, a, idx_a, i, n, count);
+        gather_block(gb, b, idx_b, i, n, count);
+        for (size_t k = 0; k < n; k++) {
+            float *pa = ga + 3 * k, *pb = gb + 3 * k;
+            dst[i + k] = pa[0]*pb[0] + pa[1]*pb[1] + pa[2]*pb[2];
+        }
+    }
+}
+
+#ifdef V3_AVX2_DISPATCH
+// 8 dot products per step straight from the gathered lanes (x, y and z are
+// gathered separately, which also transposes AoS into registers). Lanes whose
+// index would overflow the 32-bit gather offset take the scalar path.
+__attribute__((target("avx2")))
+static void dot_indexed_avx2(float *dst, float *a, uint32_t *idx_a,
+                             float *b, uint32_t *idx_b, size_t count) {
+    // idx <= 0x2AAAAAAA keeps the signed offset 3 * idx <= INT32_MAX - 1,
+    // i.e. 3 * idx + 2 <= INT32_MAX + 1 = 2^31 counting the y/z base shift
+    const __m256i limit = _mm256_set1_epi32(0x2AAAAAAA);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        if (i + 8 + V3_PREFETCH_DISTANCE <= count) {
+            for (size_t k = 0; k < 8; k++) {
+                V3_PREFETCH(a + 3 * (size_t)idx_a[i + V3_PREFETCH_DISTANCE + k]);
+                V3_PREFETCH(b + 3 * (size_t)idx_b[i + V3_PREFETCH_DISTANCE + k]);
+            }
+        }
+        __m256i ia = _mm256_loadu_si256((const __m256i *)(idx_a + i));
+        __m256i ib = _mm256_loadu_si256((const __m256i *)(idx_b + i));
+        __m256i in_range = _mm256_and_si256(
+            _mm256_cmpeq_epi32(_mm256_max_epu32(ia, limit), limit),
+            _mm256_cmpeq_epi32(_mm256_max_epu32(ib, limit), limit));
+        if (_mm256_movemask_epi8(in_range) != -1) {
+            dot_indexed_blocked(dst, a, idx_a, b, idx_b, i, i + 8);
+            continue;
+        }
+        __m256i oa = _mm256_add_epi32(ia, _mm256_add_epi32(ia, ia));
+        __m256i ob = _mm256_add_epi32(ib, _mm256_add_epi32(ib, ib));
+        __m256 ax = _mm256_i32gather_ps(a + 0, oa, 4);
+        __m256 ay = _mm256_i32gather_ps(a + 1, oa, 4);
+        __m256 az = _mm256_i32gather_ps(a + 2, oa, 4);
+        __m256 bx = _mm256_i32gather_ps(b + 0, ob, 4);
+        __m256 by = _mm256_i32gather_ps(b + 1, ob, 4);
+        __m256 bz = _mm256_i32gather_ps(b + 2, ob, 4);
+        // separate mul/add (no FMA) to match the scalar results bit for bit
+        __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)),
+                                 _mm256_mul_ps(az, bz));
+        _mm256_storeu_ps(dst + i, d);
+    }
+    if (i < count) dot_indexed_blocked(dst, a, idx_a, b, idx_b, i, count);
+}
+
+// pool workers may all ask on first use: the cache is atomic, and racing
+// writers store the same answer
+static bool cpu_has_avx2(void) {
+    static atomic_int cached = -1;
+    int has = atomic_load_explicit(&cached, memory_order_relaxed);
+    if (has < 0) {
+        has = __builtin_cpu_supports("avx2") ? 1 : 0;
+        atomic_store_explicit(&cached, has, memory_order_relaxed);
+    }
+    return has == 1;
+}
+#endif
+
+void v3_dot_indexed_n(float *dst, float *a, uint32_t *idx_a,
+                      float *b, uint32_t *idx_b, size_t count) {
+    if (!v3_valid_arrays(dst, a, b) || idx_a == NULL || idx_b == NULL) {
+        v3_error("v3_dot_indexed_n received NULL pointer");
+        return;
+    }
+#ifdef V3_AVX2_DISPATCH
+    if (cpu_has_avx2()) {
+        dot_indexed_avx2(dst, a, idx_a, b, idx_b, count);
+        return;
+    }
+#endif
+    dot_indexed_blocked(dst, a, idx_a, b, idx_b, 0, count);
+}
+
+void v3_sub_indexed_n(float *dst, float *a, uint32_t *idx_a,
+                      float *b, uint32_t *idx_b, size_t count) {
+    if (!v3_valid_arrays(dst, a, b) || idx_a == NULL || idx_b == NULL) {
+        v3_error("v3_sub_indexed_n received NULL pointer");
+        return;
+    }
+    // dst is contiguous, so a's block is gathered straight into it
+    float gb[3 * V3_GATHER_BLOCK];
+    for (size_t i = 0; i < count; i += V3_GATHER_BLOCK) {
+        size_t n = count - i < V3_GATHER_BLOCK ? count - i : V3_GATHER_BLOCK;
+        gather_block(dst + 3 * i, a, idx_a, i, n, count);
+        gather_block(gb, b, idx_b, i, n, count);
+        for (size_t k = 0; k < 3 * n; k++) {
+            dst[3 * i + k] -= gb[k];
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef V3BATCH_H
+#define V3BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Batched versions of the v3math functions. Every array holds `count`
+// packed vectors (x0 y0 z0 x1 y1 z1 ...); scalar outputs hold `count` floats.
+// dst may be the same array as an input (in-place) but must not partially
+// overlap it.
+
+void v3_add_n(float *dst, float *a, float *b, size_t count);
+void v3_subtract_n(float *dst, float *a, float *b, size_t count);
+
+// dst[i] = a[i] * s (unlike v3_scale this takes a separate source array;
+// pass dst == a for the in-place form)
+void v3_scale_n(float *dst, float *a, float s, size_t count);
+
+void v3_dot_product_n(float *dst, float *a, float *b, size_t count);
+void v3_cross_product_n(float *dst, float *a, float *b, size_t count);
+void v3_length_n(float *dst, float *a, size_t count);
+
+// zero-length or non-finite inputs produce a zero vector; the error is
+// reported once per call rather than once per element
+void v3_normalize_n(float *dst, float *a, size_t count);
+
+// reflect v[i] about n[i] (normals need not be normalized)
+void v3_reflect_n(float *dst, float *v, float *n, size_t count);
+
+// ---------- structure-of-arrays kernels ----------
+// Component arrays of `count` floats each, e.g. the direction fields of a
+// v3_ray_soa, so four elements fill one SSE register.
+typedef struct {
+    float *x, *y, *z;
+} v3_soa3;
+
+typedef enum {
+    V3_FRESNEL_EXACT,     // v3_fresnel_exact
+    V3_FRESNEL_SCHLICK,   // v3_fresnel_schlick
+} v3_fresnel_mode;
+
+// v3_transform_point / v3_transform_vector for every element: m is the
+// row-major 3x4 affine matrix [R | t]. dst may be src.
+void v3_transform_points_soa(v3_soa3 dst, float *m, v3_soa3 src, size_t count);
+void v3_transform_vectors_soa(v3_soa3 dst, float *m, v3_soa3 src, size_t count);
+
+// v3_reflect_refract for every element: unit d[i] hits unit n[i] (facing
+// against d[i]) with eta[i] = n_from / n_to. Under total internal reflection
+// tir[i] is 1, refr[i] is the reflected direction and fresnel[i] is 1;
+// otherwise tir[i] is 0. tir and fresnel may be NULL. Outputs may be the same
+// arrays as inputs (every element is read before it is written). Returns the
+// number of totally internally reflected elements.
+size_t v3_reflect_refract_soa(v3_soa3 refl, v3_soa3 refr, uint8_t *tir, float *fresnel,
+                              v3_fresnel_mode mode, v3_soa3 d, v3_soa3 n, float *eta, size_t count);
+
+// Indexed (gather) forms: element i uses a[idx_a[i]] and b[idx_b[i]], e.g.
+// the two endpoints of mesh edge i with a == b == positions. Indices are
+// vector indices, not float offsets. Gathers are prefetched ahead and done in
+// cache-sized blocks; the dot product uses AVX2 gathers when the CPU has them.
+void v3_dot_indexed_n(float *dst, float *a, uint32_t *idx_a,
+                      float *b, uint32_t *idx_b, size_t count);
+
+// dst[i] = a[idx_a[i]] - b[idx_b[i]] (dst must not overlap a or b)
+void v3_sub_indexed_n(float *dst, float *a, uint32_t *idx_a,
+                      float *b, uint32_t *idx_b, size_t count);
+
+// Change detection: element i has changed when some component of a[i] and
+// b[i] differs by more than |tol| (NaN counts as changed), i.e. exactly when
+// v3_equals(a[i], b[i], tol) is false. any/all stop at the first element
+// that decides the answer.
+bool v3_any_changed_n(float *a, float *b, float tol, size_t count);
+bool v3_all_changed_n(float *a, float *b, float tol, size_t count);
+size_t v3_count_changed_n(float *a, float *b, float tol, size_t count);
+
+// Write the indices of changed elements to idx in increasing order and return
+// how many there are. idx must have room for count entries; count must fit
+// in 32 bits.
+size_t v3_changed_indices_n(uint32_t *idx, float *a, float *b, float tol, size_t count);
+
+// Vector outputs of at least this many bytes (default 8 MiB) are written with
+// non-temporal stores that bypass the cache; write-once results then do not
+// evict the inputs or pay a read-for-ownership. 0 streams every call,
+// SIZE_MAX never streams. Scalar outputs (dot, length) are always cached.
+void v3_batch_set_stream_threshold(size_t bytes);
+size_t v3_batch_stream_threshold(void);
+
+// Store mode of the batched calls made by the calling thread. AUTO (the
+// default) compares each call's output with the threshold; ON and OFF fix
+// the choice, so the chunks of a split job can all follow the decision
+// taken for the whole job (see v3_job_run_range). Returns the old mode.
+typedef enum {
+    V3_STREAM_AUTO,
+    V3_STREAM_OFF,
+    V3_STREAM_ON
+} v3_stream_mode;
+
+v3_stream_mode v3_batch_set_thread_stream_mode(v3_stream_mode mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,763 @@
+#include "v3math.h"
+#include "v3batch.h"
+#include "v3pool.h"
+#include "v3async.h"
+#include "v3numa.h"
+#include "v3expr.h"
+#include "v3hist.h"
+#include "v3perf.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int g_failures = 0;
+static const float EPS = 1e-5f;
+
+static void print_v3(const float *v) {
+    printf("[%.6f, %.6f, %.6f]", v[0], v[1], v[2]);
+}
+
+static void expect_true(const char *testname, bool cond) {
+    if (cond) {
+        printf("PASS: %s\n", testname);
+    } else {
+        printf("FAIL: %s\n", testname);
+        g_failures++;
+    }
+}
+
+// compare every vector of a batched result against the expected array
+static void expect_v3_n(const char *testname, float *actual, float *expected,
+                        size_t count, float tol) {
+    for (size_t i = 0; i < count; i++) {
+        if (!v3_equals(actual + 3 * i, expected + 3 * i, tol)) {
+            printf("FAIL: %s (element %zu)\n  expected=", testname, i);
+            print_v3(expected + 3 * i);
+            printf("\n  actual  =");
+            print_v3(actual + 3 * i);
+            printf("\n  tol=%.6g\n", tol);
+            g_failures++;
+            return;
+        }
+    }
+    printf("PASS: %s\n", testname);
+}
+
+static void expect_float_n(const char *testname, float *actual, float *expected,
+                           size_t count, float tol) {
+    for (size_t i = 0; i < count; i++) {
+        if (fabsf(actual[i] - expected[i]) > tol) {
+            printf("FAIL: %s (element %zu)\n  expected=%.8f actual=%.8f tol=%.6g\n",
+                   testname, i, expected[i], actual[i], tol);
+            g_failures++;
+            return;
+        }
+    }
+    printf("PASS: %s\n", testname);
+}
+
+// deterministic pseudo-random vectors in [-1, 1)
+static void fill_random(float *v, size_t nfloats, unsigned seed) {
+    unsigned state = seed * 2654435761u + 1u;
+    for (size_t i = 0; i < nfloats; i++) {
+        state = state * 1664525u + 1013904223u;
+        v[i] = (float)(state >> 8) / (float)(1u << 23) - 1.0f;
+    }
+}
+
+// ---- Tests ----
+
+static void test_batch_matches_scalar(void) {
+    enum { N = 37 };
+    float a[3 * N], b[3 * N], dst[3 * N], exp[3 * N];
+    float s[N], exps[N];
+    fill_random(a, 3 * N, 1);
+    fill_random(b, 3 * N, 2);
+
+    v3_add_n(dst, a, b, N);
+    for (int i = 0; i < N; i++) v3_add(exp + 3 * i, a + 3 * i, b + 3 * i);
+    expect_v3_n("v3_add_n matches v3_add", dst, exp, N, EPS);
+
+    v3_subtract_n(dst, a, b, N);
+    for (int i = 0; i < N; i++) v3_subtract(exp + 3 * i, a + 3 * i, b + 3 * i);
+    expect_v3_n("v3_subtract_n matches v3_subtract", dst, exp, N, EPS);
+
+    v3_scale_n(dst, a, -2.5f, N);
+    memcpy(exp, a, sizeof(a));
+    for (int i = 0; i < N; i++) v3_scale(exp + 3 * i, -2.5f);
+    expect_v3_n("v3_scale_n matches v3_scale", dst, exp, N, EPS);
+
+    v3_cross_product_n(dst, a, b, N);
+    for (int i = 0; i < N; i++) v3_cross_product(exp + 3 * i, a + 3 * i, b + 3 * i);
+    expect_v3_n("v3_cross_product_n matches v3_cross_product", dst, exp, N, EPS);
+
+    v3_dot_product_n(s, a, b, N);
+    for (int i = 0; i < N; i++) exps[i] = v3_dot_product(a + 3 * i, b + 3 * i);
+    expect_float_n("v3_dot_product_n matches v3_dot_product", s, exps, N, EPS);
+
+    v3_length_n(s, a, N);
+    for (int i = 0; i < N; i++) exps[i] = v3_length(a + 3 * i);
+    expect_float_n("v3_length_n matches v3_length", s, exps, N, EPS);
+
+    v3_normalize_n(dst, a, N);
+    for (int i = 0; i < N; i++) v3_normalize(exp + 3 * i, a + 3 * i);
+    expect_v3_n("v3_normalize_n matches v3_normalize", dst, exp, N, 1e-4f);
+
+    v3_reflect_n(dst, a, b, N);
+    for (int i = 0; i < N; i++) v3_reflect(exp + 3 * i, a + 3 * i, b + 3 * i);
+    expect_v3_n("v3_reflect_n matches v3_reflect", dst, exp, N, 1e-4f);
+}
+
+static void test_batch_in_place_and_edge_cases(void) {
+    float a[6] = {1, 2, 3, -4, 5, 0};
+    float b[6] = {0, 1, 0, 1, 0, 0};
+    float exp[6];
+
+    // in-place cross: dst == a
+    v3_cross_product(exp, a, b);
+    v3_cross_product(exp + 3, a + 3, b + 3);
+    v3_cross_product_n(a, a, b, 2);
+    expect_v3_n("v3_cross_product_n overlap dst==a", a, exp, 2, EPS);
+
+    // zero vectors normalize to zero (error reported once)
+    float z[6] = {0, 0, 0, 3, 0, 4};
+    float zexp[6] = {0, 0, 0, 0.6f, 0, 0.8f};
+    v3_normalize_n(z, z, 2);
+    expect_v3_n("v3_normalize_n zero vector and in-place", z, zexp, 2, 1e-4f);
+
+    // zero normal copies v, like v3_reflect
+    float v[3] = {1, -1, 0};
+    float n0[3] = {0, 0, 0};
+    float r[3];
+    v3_reflect_n(r, v, n0, 1);
+    expect_v3_n("v3_reflect_n zero normal copies v", r, v, 1, EPS);
+
+    // count == 0 touches nothing
+    float untouched[3] = {7, 8, 9};
+    float keep[3] = {7, 8, 9};
+    v3_add_n(untouched, a, b, 0);
+    expect_v3_n("v3_add_n count 0", untouched, keep, 1, 0.0f);
+}
+
+static void test_batch_refract_soa(void) {
+    enum { N = 103 };   // not a multiple of 4: exercises the scalar remainder
+    float buf[16][N];
+    float eta[N], fres[N], rv[3], tv[3];
+    uint8_t tir[N];
+    v3_soa3 d = {buf[0], buf[1], buf[2]}, n = {buf[3], buf[4], buf[5]};
+    v3_soa3 refl = {buf[6], buf[7], buf[8]}, refr = {buf[9], buf[10], buf[11]};
+    float tmp[6 * N];
+    fill_random(tmp, 6 * N, 41);
+    for (int i = 0; i < N; i++) {
+        float *pd = tmp + 3 * i, *pn = tmp + 3 * (N + i);
+        v3_normalize(pd, pd);
+        v3_normalize(pn, pn);
+        // normals face against the ray, as v3_trace_intersect leaves them
+        if (v3_dot_product(pd, pn) > 0.0f) v3_scale(pn, -1.0f);
+        d.x[i] = pd[0]; d.y[i] = pd[1]; d.z[i] = pd[2];
+        n.x[i] = pn[0]; n.y[i] = pn[1]; n.z[i] = pn[2];
+        eta[i] = i % 2 ? 1.5f : 1.0f / 1.5f;   // leaving and entering glass
+    }
+
+    for (int mode = 0; mode < 2; mode++) {
+        size_t count = v3_reflect_refract_soa(refl, refr, tir, fres, (v3_fresnel_mode)mode, d, n, eta, N);
+        size_t expect_count = 0;
+        bool same = true;
+        for (int i = 0; i < N; i++) {
+            float pd[3] = {d.x[i], d.y[i], d.z[i]}, pn[3] = {n.x[i], n.y[i], n.z[i]};
+            bool ok = v3_reflect_refract(rv, tv, pd, pn, eta[i]);
+            if (!ok) memcpy(tv, rv, sizeof(tv));
+            float cosi = -v3_dot_product(pd, pn);
+            float f = mode == V3_FRESNEL_SCHLICK ? v3_fresnel_schlick(cosi, eta[i]) : v3_fresnel_exact(cosi, eta[i]);
+            float got_r[3] = {refl.x[i], refl.y[i], refl.z[i]}, got_t[3] = {refr.x[i], refr.y[i], refr.z[i]};
+            expect_count += !ok;
+            same &= v3_equals(got_r, rv, 1e-6f) && v3_equals(got_t, tv, 1e-6f) &&
+                    tir[i] == !ok && fabsf(fres[i] - f) <= 1e-6f;
+        }
+        expect_true(mode == V3_FRESNEL_SCHLICK ? "v3_reflect_refract_soa schlick matches scalar"
+                                               : "v3_reflect_refract_soa exact matches scalar", same);
+        expect_true("v3_reflect_refract_soa counts total internal reflection",
+                    count == expect_count && count > 0 && count < N / 2);
+    }
+
+    // in place over the directions, without the optional outputs
+    memcpy(buf[12], refr.x, sizeof(buf[12]));
+    v3_soa3 same_d = {buf[13], buf[14], buf[15]};
+    memcpy(buf[13], d.x, sizeof(buf[13]));
+    memcpy(buf[14], d.y, sizeof(buf[14]));
+    memcpy(buf[15], d.z, sizeof(buf[15]));
+    v3_reflect_refract_soa(refl, same_d, NULL, NULL, V3_FRESNEL_EXACT, same_d, n, eta, N);
+    expect_true("v3_reflect_refract_soa in place",
+                memcmp(buf[13], buf[12], sizeof(buf[12])) == 0);
+}
+
+static void test_batch_transform_soa(void) {
+    enum { N = 103 };
+    float buf[9][N], m[12];
+    v3_soa3 src = {buf[0], buf[1], buf[2]}, pts = {buf[3], buf[4], buf[5]}, vecs = {buf[6], buf[7], buf[8]};
+    fill_random(buf[0], 3 * N, 43);
+    fill_random(m, 12, 44);
+    v3_transform_points_soa(pts, m, src, N);
+    v3_transform_vectors_soa(vecs, m, src, N);
+    bool same = true;
+    for (int i = 0; i < N; i++) {
+        float p[3] = {src.x[i], src.y[i], src.z[i]}, ep[3], ev[3];
+        v3_transform_point(ep, m, p);
+        v3_transform_vector(ev, m, p);
+        float gp[3] = {pts.x[i], pts.y[i], pts.z[i]}, gv[3] = {vecs.x[i], vecs.y[i], vecs.z[i]};
+        same &= v3_equals(gp, ep, 1e-6f) && v3_equals(gv, ev, 1e-6f);
+    }
+    expect_true("v3_transform_points_soa / vectors_soa match scalar", same);
+
+    // in place
+    v3_transform_points_soa(src, m, src, N);
+    expect_true("v3_transform_points_soa in place", memcmp(buf[0], buf[3], 3 * sizeof(buf[0])) == 0);
+}
+
+static void test_batch_streaming_stores(void) {
+    enum { N = 1000 };
+    // extra room so dst can start at every float offset mod 16 bytes
+    float *a = malloc((3 * N + 4) * sizeof(float));
+    float *b = malloc((3 * N + 4) * sizeof(float));
+    float *cached = malloc((3 * N + 4) * sizeof(float));
+    float *streamed = malloc((3 * N + 4) * sizeof(float));
+    fill_random(a, 3 * N, 5);
+    fill_random(b, 3 * N, 6);
+    size_t saved = v3_batch_stream_threshold();
+
+    bool ok = true;
+    for (int off = 0; off < 4; off++) {
+        float *dst = streamed + off;
+        v3_batch_set_stream_threshold(SIZE_MAX);
+        v3_cross_product_n(cached, a, b, N);
+        v3_batch_set_stream_threshold(0);
+        v3_cross_product_n(dst, a, b, N);
+        ok = ok && memcmp(cached, dst, 3 * N * sizeof(float)) == 0;
+
+        v3_batch_set_stream_threshold(SIZE_MAX);
+        v3_normalize_n(cached, a, N);
+        v3_batch_set_stream_threshold(0);
+        v3_normalize_n(dst, a, N);
+        ok = ok && memcmp(cached, dst, 3 * N * sizeof(float)) == 0;
+    }
+    expect_true("streaming stores match cached stores at every alignment", ok);
+
+    // in-place streaming
+    memcpy(cached, a, 3 * N * sizeof(float));
+    v3_batch_set_stream_threshold(SIZE_MAX);
+    v3_scale_n(cached, cached, 3.0f, N);
+    v3_batch_set_stream_threshold(0);
+    v3_scale_n(a, a, 3.0f, N);
+    expect_true("streaming in-place scale", memcmp(cached, a, 3 * N * sizeof(float)) == 0);
+
+    // a split job streams or not as a whole: chunks of 100 vectors follow
+    // the decision taken for all N
+    v3_batch_set_stream_threshold(3 * N * sizeof(float));
+    v3_job job = {V3_OP_CROSS, streamed, a, b, 0.0f, N};
+    v3_job part = v3_job_slice(&job, 0, 100), len = {V3_OP_LENGTH, streamed, a, NULL, 0.0f, N};
+    expect_true("v3_job_stream_mode decides from the whole job",
+                v3_job_stream_mode(&job) == V3_STREAM_ON && v3_job_stream_mode(&part) == V3_STREAM_OFF &&
+                v3_job_stream_mode(&len) == V3_STREAM_OFF);
+    v3_cross_product_n(cached, a, b, N);
+    memset(streamed, 0, 3 * N * sizeof(float));
+    for (size_t i = 0; i < N; i += 100) v3_job_run_range(&job, i, i + 100);
+    v3_job_run_range(&job, 0, N + 1);
+    expect_true("v3_job_run_range matches a single call and restores the thread mode",
+                memcmp(cached, streamed, 3 * N * sizeof(float)) == 0 &&
+                v3_batch_set_thread_stream_mode(V3_STREAM_AUTO) == V3_STREAM_AUTO);
+
+    v3_batch_set_stream_threshold(saved);
+    free(a);
+    free(b);
+    free(cached);
+    free(streamed);
+}
+
+static void test_batch_indexed(void) {
+    enum { V = 500, N = 1237 };
+    float *pos = malloc(3 * V * sizeof(float));
+    uint32_t *ia = malloc(N * sizeof(uint32_t));
+    uint32_t *ib = malloc(N * sizeof(uint32_t));
+    float *dots = malloc(N * sizeof(float));
+    float *exps = malloc(N * sizeof(float));
+    float *diff = malloc(3 * N * sizeof(float));
+    float *expd = malloc(3 * N * sizeof(float));
+    fill_random(pos, 3 * V, 7);
+    unsigned state = 12345u;
+    for (size_t i = 0; i < N; i++) {
+        state = state * 1664525u + 1013904223u;
+        ia[i] = (state >> 8) % V;
+        state = state * 1664525u + 1013904223u;
+        ib[i] = (state >> 8) % V;
+        exps[i] = v3_dot_product(pos + 3 * ia[i], pos + 3 * ib[i]);
+        v3_subtract(expd + 3 * i, pos + 3 * ia[i], pos + 3 * ib[i]);
+    }
+
+    v3_dot_indexed_n(dots, pos, ia, pos, ib, N);
+    expect_float_n("v3_dot_indexed_n matches v3_dot_product", dots, exps, N, 0.0f);
+
+    v3_sub_indexed_n(diff, pos, ia, pos, ib, N);
+    expect_v3_n("v3_sub_indexed_n matches v3_subtract", diff, expd, N, 0.0f);
+
+    // counts below one AVX2 step and below the prefetch distance
+    v3_dot_indexed_n(dots, pos, ia, pos, ib, 5);
+    expect_float_n("v3_dot_indexed_n short tail", dots, exps, 5, 0.0f);
+
+    free(pos);
+    free(ia);
+    free(ib);
+    free(dots);
+    free(exps);
+    free(diff);
+    free(expd);
+}
+
+static void test_batch_change_detection(void) {
+    enum { N = 1003 };   // whole chunks, whole groups of four and a tail
+    float *a = malloc(3 * N * sizeof(float));
+    float *b = malloc(3 * N * sizeof(float));
+    uint32_t *idx = malloc(N * sizeof(uint32_t));
+    fill_random(a, 3 * N, 31);
+    memcpy(b, a, 3 * N * sizeof(float));
+    const float tol = 1e-4f;
+
+    expect_true("v3_any_changed_n identical arrays", !v3_any_changed_n(a, b, tol, N));
+    expect_true("v3_all_changed_n identical arrays", !v3_all_changed_n(a, b, tol, N));
+    expect_true("v3_count_changed_n identical arrays", v3_count_changed_n(a, b, tol, N) == 0);
+    expect_true("v3_changed_indices_n identical arrays", v3_changed_indices_n(idx, a, b, tol, N) == 0);
+
+    // changes in every component position, below and above the tolerance,
+    // in the vector tail and a NaN
+    for (size_t i = 0; i < N; i += 13) b[3 * i + i % 3] += (i % 2) ? 2e-4f : 5e-5f;
+    b[3 * (N - 1) + 2] += 1.0f;
+    b[3 * 500 + 1] = NAN;
+    size_t expected = 0;
+    bool any = false, all = true;
+    for (size_t i = 0; i < N; i++) {
+        bool changed = !v3_equals(a + 3 * i, b + 3 * i, tol);
+        expected += changed;
+        any = any || changed;
+        all = all && changed;
+    }
+    expect_true("v3_any_changed_n matches v3_equals", v3_any_changed_n(a, b, tol, N) == any);
+    expect_true("v3_all_changed_n matches v3_equals", v3_all_changed_n(a, b, tol, N) == all);
+    expect_true("v3_count_changed_n matches v3_equals", v3_count_changed_n(a, b, tol, N) == expected);
+    expect_true("negative tolerance is taken as its magnitude",
+                v3_count_changed_n(a, b, -tol, N) == expected);
+
+    size_t n = v3_changed_indices_n(idx, a, b, tol, N);
+    bool ok = n == expected;
+    size_t k = 0;
+    for (size_t i = 0; ok && i < N; i++) {
+        if (!v3_equals(a + 3 * i, b + 3 * i, tol)) ok = idx[k++] == i;
+    }
+    expect_true("v3_changed_indices_n lists changed elements in order", ok && k == n);
+
+    // all changed, and one unchanged element only in the scalar tail
+    for (size_t i = 0; i < 3 * N; i++) b[i] = a[i] + 1.0f;
+    expect_true("v3_all_changed_n every element", v3_all_changed_n(a, b, tol, N));
+    memcpy(b + 3 * (N - 1), a + 3 * (N - 1), 3 * sizeof(float));
+    expect_true("v3_all_changed_n unchanged tail", !v3_all_changed_n(a, b, tol, N));
+    expect_true("v3_any_changed_n short count", !v3_any_changed_n(a + 3 * (N - 1), b + 3 * (N - 1), tol, 1));
+
+    free(a);
+    free(b);
+    free(idx);
+}
+
+static void test_expr(void) {
+    enum { N = 5003 };   // several blocks and a partial one
+    float *a = malloc(3 * N * sizeof(float));
+    float *b = malloc(3 * N * sizeof(float));
+    float *c = malloc(3 * N * sizeof(float));
+    float *s = malloc(N * sizeof(float));
+    float *out = malloc(3 * N * sizeof(float));
+    float *exp = malloc(3 * N * sizeof(float));
+    float *tmp = malloc(3 * N * sizeof(float));
+    float *dots = malloc(N * sizeof(float));
+    float *expd = malloc(N * sizeof(float));
+    uint32_t *idx = malloc(N * sizeof(uint32_t));
+    fill_random(a, 3 * N, 21);
+    fill_random(b, 3 * N, 22);
+    fill_random(c, 3 * N, 23);
+    fill_random(s, N, 24);
+    for (size_t i = 0; i < N; i++) idx[i] = (uint32_t)((i * 7919u) % N);
+
+    // normalize(cross(a, b)) * 0.5 + c, fused vs one call per stage
+    v3_expr *e = v3_expr_create();
+    v3_expr_id n = v3_expr_normalize(e, v3_expr_cross_product(e, v3_expr_vectors(e, a),
+                                                             v3_expr_vectors(e, b)));
+    v3_expr_output(e, v3_expr_add(e, v3_expr_scale(e, n, 0.5f), v3_expr_vectors(e, c)), out);
+    expect_true("v3_expr_run fused chain", v3_expr_run(e, N, NULL));
+    v3_cross_product_n(exp, a, b, N);
+    v3_normalize_n(exp, exp, N);
+    v3_scale_n(exp, exp, 0.5f, N);
+    v3_add_n(exp, exp, c, N);
+    expect_v3_n("v3_expr fused chain matches v3batch bit for bit", out, exp, N, 0.0f);
+    expect_true("v3_expr reuses temporaries",
+                v3_expr_temporaries(e) > 0 && v3_expr_temporaries(e) < 7);
+
+    // serial and pooled runs agree
+    v3_pool *pool = v3_pool_create(4);
+    memset(out, 0, 3 * N * sizeof(float));
+    v3_expr_run(e, N, pool);
+    expect_v3_n("v3_expr pooled run matches", out, exp, N, 0.0f);
+    v3_pool_destroy(pool);
+
+    // scalars, broadcasting, dot, length and reflect, with two outputs
+    v3_expr_clear(e);
+    v3_expr_id va = v3_expr_vectors(e, a), vb = v3_expr_vectors(e, b);
+    v3_expr_id r = v3_expr_reflect(e, va, vb);
+    v3_expr_output(e, v3_expr_multiply(e, r, v3_expr_scalars(e, s)), out);
+    v3_expr_output(e, v3_expr_add(e, v3_expr_dot_product(e, va, vb), v3_expr_length(e, va)), dots);
+    expect_true("v3_expr_run two outputs", v3_expr_run(e, N, NULL));
+    v3_reflect_n(exp, a, b, N);
+    for (size_t i = 0; i < N; i++) {
+        for (int k = 0; k < 3; k++) exp[3 * i + k] *= s[i];
+    }
+    v3_dot_product_n(expd, a, b, N);
+    v3_length_n(tmp, a, N);
+    for (size_t i = 0; i < N; i++) expd[i] += tmp[i];
+    expect_v3_n("v3_expr reflect times scalar", out, exp, N, 0.0f);
+    expect_float_n("v3_expr dot plus length", dots, expd, N, 0.0f);
+
+    // gather
+    v3_expr_clear(e);
+    v3_expr_output(e, v3_expr_subtract(e, v3_expr_gather(e, a, idx), v3_expr_vectors(e, b)), out);
+    v3_expr_run(e, N, NULL);
+    for (size_t i = 0; i < N; i++) v3_subtract(exp + 3 * i, a + 3 * (size_t)idx[i], b + 3 * i);
+    expect_v3_n("v3_expr gather", out, exp, N, 0.0f);
+
+    // in place: c = c * 2 - a
+    memcpy(exp, c, 3 * N * sizeof(float));
+    v3_expr_clear(e);
+    v3_expr_output(e, v3_expr_subtract(e, v3_expr_scale(e, v3_expr_vectors(e, c), 2.0f),
+                                       v3_expr_vectors(e, a)), c);
+    v3_expr_run(e, N, NULL);
+    for (size_t i = 0; i < 3 * N; i++) exp[i] = exp[i] * 2.0f - a[i];
+    expect_v3_n("v3_expr in place", c, exp, N, 0.0f);
+
+    // zero-length vectors normalize to zero, as in v3_normalize_n
+    float zeros[9] = {0, 0, 0, 3, 0, 4, 0, 0, 0}, unit[9];
+    v3_expr_clear(e);
+    v3_expr_output(e, v3_expr_normalize(e, v3_expr_vectors(e, zeros)), unit);
+    v3_expr_run(e, 3, NULL);
+    expect_true("v3_expr normalize zero vector",
+                unit[0] == 0.0f && unit[2] == 0.0f && unit[3] == 0.6f && unit[5] == 0.8f &&
+                unit[6] == 0.0f);
+
+    // bad operands poison the graph until it is cleared
+    v3_expr_clear(e);
+    v3_expr_id sc = v3_expr_scalars(e, s);
+    expect_true("v3_expr rejects scalar cross product",
+                v3_expr_cross_product(e, sc, sc) == V3_EXPR_INVALID);
+    expect_true("v3_expr rejects unknown node", v3_expr_length(e, 1000) == V3_EXPR_INVALID);
+    expect_true("v3_expr_run fails after invalid node", !v3_expr_run(e, N, NULL));
+    v3_expr_clear(e);
+    v3_expr_output(e, v3_expr_scale(e, v3_expr_scalars(e, s), 2.0f), dots);
+    expect_true("v3_expr_run succeeds after clear", v3_expr_run(e, N, NULL) && dots[7] == 2.0f * s[7]);
+
+    v3_expr_destroy(e);
+    free(a);
+    free(b);
+    free(c);
+    free(s);
+    free(out);
+    free(exp);
+    free(tmp);
+    free(dots);
+    free(expd);
+    free(idx);
+}
+
+typedef struct {
+    float *data;
+} square_ctx;
+
+static void square_range(void *arg, size_t begin, size_t end) {
+    square_ctx *ctx = arg;
+    for (size_t i = begin; i < end; i++) ctx->data[i] = (float)(i * i);
+}
+
+static void test_pool_parallel_for(void) {
+    v3_pool *pool = v3_pool_create(4);
+    expect_true("v3_pool_create 4 threads", pool != NULL && v3_pool_size(pool) == 4);
+
+    enum { N = 10007 };
+    float *data = calloc(N, sizeof(float));
+    square_ctx ctx = {data};
+    v3_pool_parallel_for(pool, N, 64, square_range, &ctx);
+    bool ok = true;
+    for (size_t i = 0; i < N; i++) ok = ok && data[i] == (float)(i * i);
+    expect_true("v3_pool_parallel_for covers every index once", ok);
+
+    free(data);
+    v3_pool_destroy(pool);
+}
+
+typedef struct {
+    v3_pool *pool;
+    int *owner;
+} owner_ctx;
+
+static void record_owner(void *arg, size_t begin, size_t end) {
+    owner_ctx *ctx = arg;
+    for (size_t i = begin; i < end; i++) ctx->owner[i] = v3_pool_current_worker(ctx->pool);
+}
+
+static void test_pool_static_and_numa(void) {
+    v3_pool *pool = v3_pool_create_ex(3, V3_POOL_PIN_THREADS);
+    expect_true("v3_pool_create_ex pinned", pool != NULL && v3_pool_size(pool) == 3);
+    expect_true("v3_pool_current_worker outside pool", v3_pool_current_worker(pool) == -1);
+    expect_true("v3_numa_node_count >= 1", v3_numa_node_count() >= 1);
+
+    // two nodes of four CPUs: a 3-worker pool must reach both
+    int cpus[8] = {0, 1, 2, 3, 4, 5, 6, 7}, picked[10];
+    unsigned nodes[8] = {0, 0, 0, 0, 1, 1, 1, 1}, picked_nodes[10];
+    size_t n = v3_numa_spread(cpus, nodes, 8, picked, picked_nodes, 3);
+    expect_true("v3_numa_spread round-robin over nodes",
+                n == 3 && picked[0] == 0 && picked[1] == 1 && picked[2] == 4 && picked_nodes[2] == 1);
+    n = v3_numa_spread(cpus, nodes, 8, picked, picked_nodes, 10);
+    expect_true("v3_numa_spread wraps past the CPU count",
+                n == 10 && picked[3] == 3 && picked[4] == 4 && picked[8] == 0 && picked[9] == 1);
+
+    // static chunks: contiguous, one per worker, same mapping every call
+    enum { N = 5000 };
+    int *first = malloc(N * sizeof(int));
+    int *second = malloc(N * sizeof(int));
+    owner_ctx c1 = {pool, first}, c2 = {pool, second};
+    v3_pool_parallel_for_static(pool, N, record_owner, &c1);
+    v3_pool_parallel_for_static(pool, N, record_owner, &c2);
+    bool ok = first[0] == 0;
+    for (size_t i = 1; i < N; i++) ok = ok && first[i] >= first[i - 1] && first[i] >= 0;
+    expect_true("v3_pool_parallel_for_static contiguous chunks in worker order", ok);
+    expect_true("v3_pool_parallel_for_static repeatable mapping",
+                memcmp(first, second, N * sizeof(int)) == 0);
+    free(first);
+    free(second);
+
+    size_t count = 10000;
+    float *src = v3_numa_alloc(pool, count);
+    float *dst = v3_numa_alloc(pool, count);
+    ok = src != NULL && dst != NULL;
+    for (size_t i = 0; ok && i < 3 * count; i++) ok = src[i] == 0.0f;
+    expect_true("v3_numa_alloc zeroed", ok);
+
+    float *exp = malloc(3 * count * sizeof(float));
+    fill_random(src, 3 * count, 4);
+    v3_normalize_n(exp, src, count);
+    v3_job job = {V3_OP_NORMALIZE, dst, src, NULL, 0.0f, count};
+    v3_numa_run(pool, &job);
+    expect_v3_n("v3_numa_run normalize", dst, exp, count, 1e-6f);
+
+    free(exp);
+    v3_numa_free(src);
+    v3_numa_free(dst);
+    v3_pool_destroy(pool);
+}
+
+static void test_async_queue(void) {
+    v3_pool *pool = v3_pool_create(3);
+    v3_queue *q = v3_queue_create(pool);
+    expect_true("v3_queue_create", q != NULL);
+
+    // one large job that is split into several chunks
+    size_t big = 50000;
+    float *a = malloc(3 * big * sizeof(float));
+    float *dst = malloc(3 * big * sizeof(float));
+    float *exp = malloc(3 * big * sizeof(float));
+    fill_random(a, 3 * big, 3);
+    v3_normalize_n(exp, a, big);
+
+    v3_job job = {V3_OP_NORMALIZE, dst, a, NULL, 0.0f, big};
+    v3_future *f = v3_queue_submit(q, &job);
+    v3_future_wait(f);
+    expect_true("v3_future_ready after wait", v3_future_ready(f));
+    expect_v3_n("async normalize large job", dst, exp, big, 1e-5f);
+    v3_future_release(f);
+
+    // many tiny jobs that get coalesced
+    enum { JOBS = 200 };
+    float small_a[JOBS][3], small_dst[JOBS];
+    v3_future *fs[JOBS];
+    for (int i = 0; i < JOBS; i++) {
+        small_a[i][0] = (float)i; small_a[i][1] = 0; small_a[i][2] = 0;
+        v3_job sj = {V3_OP_LENGTH, &small_dst[i], small_a[i], NULL, 0.0f, 1};
+        fs[i] = v3_queue_submit(q, &sj);
+    }
+    bool ok = true;
+    for (int i = 0; i < JOBS; i++) {
+        v3_future_wait(fs[i]);
+        ok = ok && small_dst[i] == (float)i;
+        v3_future_release(fs[i]);
+    }
+    expect_true("async coalesced small jobs", ok);
+
+    // fire-and-forget: release before completion, destroy waits
+    float sa[3] = {1, 2, 3};
+    float sd[3] = {0, 0, 0};
+    v3_job scale = {V3_OP_SCALE, sd, sa, NULL, 2.0f, 1};
+    v3_future_release(v3_queue_submit(q, &scale));
+    v3_queue_destroy(q);
+    float sexp[3] = {2, 4, 6};
+    expect_v3_n("async released job completes before queue destroy", sd, sexp, 1, EPS);
+
+    // invalid job is rejected
+    v3_queue *q2 = v3_queue_create(pool);
+    v3_job bad = {V3_OP_ADD, sd, sa, NULL, 0.0f, 1};
+    expect_true("v3_queue_submit rejects missing operand", v3_queue_submit(q2, &bad) == NULL);
+
+    // empty job is immediately ready
+    v3_job empty = {V3_OP_ADD, sd, sa, sa, 0.0f, 0};
+    v3_future *fe = v3_queue_submit(q2, &empty);
+    expect_true("v3_queue_submit empty job ready", v3_future_ready(fe));
+    v3_future_release(fe);
+    v3_queue_destroy(q2);
+
+    free(a);
+    free(dst);
+    free(exp);
+    v3_pool_destroy(pool);
+}
+
+typedef struct {
+    v3_hist_group *group;
+} hist_ctx;
+
+static void hist_record_range(void *arg, size_t begin, size_t end) {
+    hist_ctx *c = arg;
+    v3_hist *h = v3_hist_group_local(c->group);
+    for (size_t i = begin; i < end; i++) v3_hist_record(h, i + 1);
+}
+
+static void test_hist(void) {
+    v3_hist h;
+    if (!v3_hist_init(&h)) {
+        expect_true("v3_hist_init", false);
+        return;
+    }
+    expect_true("v3_hist empty", v3_hist_percentile(&h, 50.0) == 0 && v3_hist_mean(&h) == 0.0);
+
+    // values below 2 * V3_HIST_SUB are exact
+    for (uint64_t v = 1; v <= 200; v++) v3_hist_record(&h, v);
+    expect_true("v3_hist exact small values",
+                v3_hist_percentile(&h, 50.0) == 100 && v3_hist_percentile(&h, 99.0) == 198 &&
+                v3_hist_percentile(&h, 0.0) == 1 && v3_hist_percentile(&h, 100.0) == 200 &&
+                fabs(v3_hist_mean(&h) - 100.5) < 1e-9);
+
+    // 1 .. 1e6: every percentile within one bucket of the exact value
+    v3_hist_reset(&h);
+    for (uint64_t v = 1; v <= 1000000; v++) v3_hist_record(&h, v);
+    static const double ps[] = {1.0, 25.0, 50.0, 90.0, 99.0, 99.9, 99.99};
+    bool close = true;
+    for (size_t i = 0; i < sizeof(ps) / sizeof(ps[0]); i++) {
+        double exact = ps[i] * 1e4;
+        double got = (double)v3_hist_percentile(&h, ps[i]);
+        close &= got >= exact && got <= exact * (1.0 + 1.0 / V3_HIST_SUB);
+    }
+    expect_true("v3_hist percentiles within 1/V3_HIST_SUB", close);
+    expect_true("v3_hist min and max exact", h.min == 1 && h.max == 1000000);
+
+    // large values keep their relative precision
+    v3_hist_reset(&h);
+    uint64_t big = (uint64_t)3 << 40;
+    v3_hist_record(&h, big);
+    v3_hist_record(&h, UINT64_MAX);
+    uint64_t p50 = v3_hist_percentile(&h, 50.0);
+    expect_true("v3_hist large values", p50 >= big && p50 - big <= big / V3_HIST_SUB &&
+                                            v3_hist_percentile(&h, 100.0) == UINT64_MAX);
+
+    // per-thread recording: every worker and the caller use their own shard
+    v3_pool *pool = v3_pool_create(3);
+    v3_hist_group g;
+    if (v3_hist_group_init(&g, pool)) {
+        hist_ctx c = {&g};
+        v3_pool_parallel_for(pool, 100000, 100, hist_record_range, &c);
+        v3_hist_reset(&h);
+        v3_hist_group_merge(&h, &g);
+        expect_true("v3_hist_group merges every thread",
+                    g.count == 4 && h.total == 100000 && h.min == 1 && h.max == 100000 &&
+                    fabs(h.sum - 5000050000.0) < 1.0);
+        v3_hist_group_free(&g);
+    }
+    v3_pool_destroy(pool);
+
+    // export rows
+    v3_hist_reset(&h);
+    for (uint64_t v = 1; v <= 100; v++) v3_hist_record(&h, v);
+    char buf[512] = {0};
+    FILE *f = tmpfile();
+    if (f != NULL) {
+        v3_hist_write_csv(f, "k", &h);
+        v3_hist_write_json(f, "k", &h);
+        rewind(f);
+        size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+        buf[n] = '\0';
+        fclose(f);
+    }
+    expect_true("v3_hist_write_csv", strncmp(buf, "k,100,1,50.5,50,90,99,100,100\n", 30) == 0);
+    expect_true("v3_hist_write_json", strstr(buf, "{\"name\": \"k\", \"count\": 100, \"min_ns\": 1, ") != NULL &&
+                                          strstr(buf, "\"p99_ns\": 99, \"p999_ns\": 100, \"max_ns\": 100}") != NULL);
+    v3_hist_free(&h);
+}
+
+static void test_perf_counters(void) {
+    v3_perf *perf = v3_perf_open();
+    expect_true("v3_perf_open", perf != NULL);
+    if (perf == NULL) return;
+    const char *reason = NULL;
+    bool available = v3_perf_available(perf, &reason);
+    float a[3 * 256], dst[3 * 256];
+    for (int i = 0; i < 3 * 256; i++) a[i] = (float)i;
+    v3_perf_counts c;
+    bool started = v3_perf_start(perf);
+    v3_normalize_n(dst, a + 3, 255);
+    bool stopped = v3_perf_stop(perf, &c);
+    if (available) {
+        printf("  (perf counters: %llu instructions, %llu cycles)\n", (unsigned long long)c.instructions,
+               (unsigned long long)c.cycles);
+        expect_true("v3_perf counts a kernel",
+                    started && stopped && c.hw && c.instructions > 255 && c.cycles > 0 &&
+                    c.branch_misses <= c.branches);
+    } else {
+        printf("  (perf counters unavailable: %s)\n", reason);
+        expect_true("v3_perf unavailable reports why and counts nothing",
+                    reason != NULL && reason[0] != '\0' && !started && !stopped && !c.hw && !c.fp &&
+                    c.instructions == 0);
+    }
+    v3_perf_counts fp = {.fp = true, .fp_scalar = 1, .fp_128 = 2, .fp_256 = 3, .fp_512 = 4};
+    expect_true("v3_perf_flops weighs vector widths", v3_perf_flops(&fp) == 1 + 8 + 24 + 64);
+    fp.fp = false;
+    expect_true("v3_perf_flops without FP counters", v3_perf_flops(&fp) == 0.0);
+    v3_perf_close(perf);
+}
+
+int main(void) {
+    printf("=== v3batchtest: Batched and Async Kernel Tests ===\n\n");
+
+    test_batch_matches_scalar();
+    test_batch_in_place_and_edge_cases();
+    test_batch_refract_soa();
+    test_batch_transform_soa();
+    test_batch_streaming_stores();
+    test_batch_indexed();
+    test_batch_change_detection();
+    test_expr();
+    test_hist();
+    test_perf_counters();
+    test_pool_parallel_for();
+    test_pool_static_and_numa();
+    test_async_queue();
+
+    printf("\n=== Summary ===\n");
+    if (g_failures == 0) {
+        printf("ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("FAILURES: %d\n", g_failures);
+        return 1;
+    }
+}
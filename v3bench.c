@@ -0,0 +1,2489 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "v3math.h"
+#include "v3batch.h"
+#include "v3pool.h"
+#include "v3async.h"
+#include "v3numa.h"
+#include "v3tri.h"
+#include "v3bvh.h"
+#include "v3camera.h"
+#include "v3image.h"
+#include "v3scene.h"
+#include "v3trace.h"
+#include "v3progressive.h"
+#include "v3expr.h"
+#include "v3dirty.h"
+#include "v3rcu.h"
+#include "v3serve.h"
+#include "v3hist.h"
+#include "v3perf.h"
+#include "v3sdf.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+// Benchmarks for the batched paths. Usage:
+//   v3bench [--json FILE] [--csv FILE] [--perf] [name] [vectors]
+//   v3bench --compare BASE NEW [percent]
+// Without a name every benchmark runs at its default size. Latency
+// histograms (report_latency) are also written to the --json / --csv files;
+// --compare reads two such files and flags every entry whose p50 or p99 grew
+// by more than percent (default 10), exiting with status 1 if any did.
+// --perf adds hardware counters (v3perf.h) to the roofline benchmark.
+
+#define REPS 5
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void fill_random(float *v, size_t nfloats, unsigned seed) {
+    unsigned state = seed * 2654435761u + 1u;
+    for (size_t i = 0; i < nfloats; i++) {
+        state = state * 1664525u + 1013904223u;
+        v[i] = (float)(state >> 8) / (float)(1u << 23) - 1.0f;
+    }
+}
+
+static void report(const char *name, size_t count, size_t bytes_per_vec, double sec) {
+    printf("%-32s %10zu vec  %9.3f ms  %8.2f GB/s\n", name, count, sec * 1e3,
+           (double)(count * bytes_per_vec) / sec * 1e-9);
+}
+
+static void report_rate(const char *name, size_t ops, double sec) {
+    printf("%-32s %10zu ops  %9.3f ms  %8.2f Mops/s\n", name, ops, sec * 1e3,
+           (double)ops / sec * 1e-6);
+}
+
+static FILE *g_json, *g_csv;
+static size_t g_json_rows;
+static v3_perf *g_perf;
+
+// print the tail of a latency histogram (ns values) and export it
+static void report_latency(const char *name, const v3_hist *h) {
+    printf("%-32s %10llu ops  p50 %9.2f us  p99 %9.2f us  p99.9 %9.2f us  max %9.2f us\n", name,
+           (unsigned long long)h->total, v3_hist_percentile(h, 50.0) * 1e-3, v3_hist_percentile(h, 99.0) * 1e-3,
+           v3_hist_percentile(h, 99.9) * 1e-3, h->max * 1e-3);
+    if (g_csv) v3_hist_write_csv(g_csv, name, h);
+    if (g_json) {
+        fprintf(g_json, g_json_rows++ ? ",\n  " : "  ");
+        v3_hist_write_json(g_json, name, h);
+    }
+}
+
+// ---------- numa ----------
+typedef struct {
+    float *data;
+} fill_ctx;
+
+static void fill_range(void *arg, size_t begin, size_t end) {
+    fill_ctx *ctx = arg;
+    fill_random(ctx->data + 3 * begin, 3 * (end - begin), (unsigned)begin);
+}
+
+static void normalize_range(void *arg, size_t begin, size_t end) {
+    v3_job_run_range(arg, begin, end);
+}
+
+// Normalize with every page on the allocating thread's node versus buffers
+// placed by parallel first touch and processed with the same chunk-to-worker
+// mapping on a pinned pool. On a single-node machine both should match.
+static void bench_numa(size_t count) {
+    printf("numa: %u node(s)\n", v3_numa_node_count());
+
+    // baseline: serial initialization, unpinned dynamic scheduling
+    v3_pool *pool = v3_pool_create(0);
+    float *src = malloc(count * 3 * sizeof(float));
+    float *dst = malloc(count * 3 * sizeof(float));
+    if (pool == NULL || src == NULL || dst == NULL) {
+        fprintf(stderr, "Error: v3bench numa allocation failed\n");
+        free(src);
+        free(dst);
+        v3_pool_destroy(pool);
+        return;
+    }
+    fill_random(src, 3 * count, 1);
+    memset(dst, 0, count * 3 * sizeof(float));
+    v3_job job = {V3_OP_NORMALIZE, dst, src, NULL, 0.0f, count};
+    double best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        v3_pool_parallel_for(pool, count, 1 << 14, normalize_range, &job);
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report("normalize serial-init unpinned", count, 24, best);
+    free(src);
+    free(dst);
+    v3_pool_destroy(pool);
+
+    // first-touch placement on a pinned pool
+    pool = v3_pool_create_ex(0, V3_POOL_PIN_THREADS);
+    src = v3_numa_alloc(pool, count);
+    dst = v3_numa_alloc(pool, count);
+    if (pool == NULL || src == NULL || dst == NULL) {
+        fprintf(stderr, "Error: v3bench numa allocation failed\n");
+        v3_numa_free(src);
+        v3_numa_free(dst);
+        v3_pool_destroy(pool);
+        return;
+    }
+    fill_ctx ctx = {src};
+    v3_pool_parallel_for_static(pool, count, fill_range, &ctx);
+    job.dst = dst;
+    job.a = src;
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        v3_numa_run(pool, &job);
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report("normalize first-touch pinned", count, 24, best);
+    v3_numa_free(src);
+    v3_numa_free(dst);
+    v3_pool_destroy(pool);
+}
+
+// ---------- stream ----------
+// Write-once normalize into a fresh output with cached and non-temporal
+// stores. Bytes per vector count the read of src and the write of dst.
+static void bench_stream(size_t count) {
+    float *src = malloc(count * 3 * sizeof(float));
+    float *dst = malloc(count * 3 * sizeof(float));
+    if (src == NULL || dst == NULL) {
+        fprintf(stderr, "Error: v3bench stream allocation failed\n");
+        free(src);
+        free(dst);
+        return;
+    }
+    fill_random(src, 3 * count, 2);
+    memset(dst, 0, count * 3 * sizeof(float));
+    size_t saved = v3_batch_stream_threshold();
+
+    const struct { const char *name; size_t threshold; } modes[] = {
+        {"normalize cached stores", SIZE_MAX},
+        {"normalize streaming stores", 0},
+    };
+    for (size_t m = 0; m < 2; m++) {
+        v3_batch_set_stream_threshold(modes[m].threshold);
+        double best = 1e30;
+        for (int r = 0; r < REPS; r++) {
+            double t0 = now_sec();
+            v3_normalize_n(dst, src, count);
+            double t = now_sec() - t0;
+            if (t < best) best = t;
+        }
+        report(modes[m].name, count, 24, best);
+    }
+    v3_batch_set_stream_threshold(saved);
+    free(src);
+    free(dst);
+}
+
+// ---------- indexed ----------
+// Mesh-edge style gathers: random endpoint pairs over a positions array much
+// larger than the cache, compared with a per-pair v3_dot_product loop.
+static void bench_indexed(size_t count) {
+    size_t nverts = count;
+    float *pos = malloc(nverts * 3 * sizeof(float));
+    uint32_t *ia = malloc(count * sizeof(uint32_t));
+    uint32_t *ib = malloc(count * sizeof(uint32_t));
+    float *out = malloc(count * sizeof(float));
+    float *diff = malloc(count * 3 * sizeof(float));
+    if (pos == NULL || ia == NULL || ib == NULL || out == NULL || diff == NULL) {
+        fprintf(stderr, "Error: v3bench indexed allocation failed\n");
+        free(pos);
+        free(ia);
+        free(ib);
+        free(out);
+        free(diff);
+        return;
+    }
+    fill_random(pos, 3 * nverts, 3);
+    unsigned state = 99u;
+    for (size_t i = 0; i < count; i++) {
+        state = state * 1664525u + 1013904223u;
+        ia[i] = (uint32_t)((state >> 4) % nverts);
+        state = state * 1664525u + 1013904223u;
+        ib[i] = (uint32_t)((state >> 4) % nverts);
+    }
+
+    double best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        for (size_t i = 0; i < count; i++) {
+            out[i] = v3_dot_product(pos + 3 * (size_t)ia[i], pos + 3 * (size_t)ib[i]);
+        }
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report("dot per-pair v3_dot_product", count, 36, best);
+
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        v3_dot_indexed_n(out, pos, ia, pos, ib, count);
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report("dot v3_dot_indexed_n", count, 36, best);
+
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        v3_sub_indexed_n(diff, pos, ia, pos, ib, count);
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report("sub v3_sub_indexed_n", count, 44, best);
+
+    free(pos);
+    free(ia);
+    free(ib);
+    free(out);
+    free(diff);
+}
+
+// ---------- tri ----------
+// Classic Moller-Trumbore straight from the vertices, as a caller without
+// precomputed records would write it.
+static bool mt_from_vertices(float *v0, float *v1, float *v2, float *orig, float *dir,
+                             float t_max, float *hit) {
+    float e1[3], e2[3], p[3], s[3], q[3];
+    v3_subtract(e1, v1, v0);
+    v3_subtract(e2, v2, v0);
+    v3_cross_product(p, dir, e2);
+    float det = v3_dot_product(e1, p);
+    if (det == 0.0f) return false;
+    float inv = 1.0f / det;
+    v3_subtract(s, orig, v0);
+    float u = v3_dot_product(s, p) * inv;
+    if (u < 0.0f || u > 1.0f) return false;
+    v3_cross_product(q, s, e1);
+    float v = v3_dot_product(dir, q) * inv;
+    if (v < 0.0f || u + v > 1.0f) return false;
+    float t = v3_dot_product(e2, q) * inv;
+    if (!(t > 0.0f && t < t_max)) return false;
+    hit[0] = t;
+    hit[1] = u;
+    hit[2] = v;
+    return true;
+}
+
+// count rays x count/16 triangles: every ray is tested against every triangle
+static void bench_tri(size_t count) {
+    size_t ntris = count / 16 > 0 ? count / 16 : 1;
+    size_t nrays = count;
+    float *verts = malloc(ntris * 9 * sizeof(float));
+    float *rays = malloc(nrays * 6 * sizeof(float));
+    v3_tri *tris = malloc(ntris * sizeof(v3_tri));
+    v3_tri_wt *wts = malloc(ntris * sizeof(v3_tri_wt));
+    v3_ray_wt *rwt = malloc(nrays * sizeof(v3_ray_wt));
+    if (verts == NULL || rays == NULL || tris == NULL || wts == NULL || rwt == NULL) {
+        fprintf(stderr, "Error: v3bench tri allocation failed\n");
+        free(verts);
+        free(rays);
+        free(tris);
+        free(wts);
+        free(rwt);
+        return;
+    }
+    fill_random(verts, ntris * 9, 11);
+    fill_random(rays, nrays * 6, 12);
+    for (size_t i = 0; i < ntris; i++) {
+        float *v = verts + 9 * i;
+        v3_tri_precompute(&tris[i], v, v + 3, v + 6);
+        v3_tri_wt_precompute(&wts[i], v, v + 3, v + 6);
+    }
+    size_t tests = ntris * nrays;
+    size_t hits;
+    float hit[3];
+
+    double best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        hits = 0;
+        double t0 = now_sec();
+        for (size_t j = 0; j < nrays; j++) {
+            float *o = rays + 6 * j, *d = o + 3;
+            for (size_t i = 0; i < ntris; i++) {
+                float *v = verts + 9 * i;
+                hits += mt_from_vertices(v, v + 3, v + 6, o, d, INFINITY, hit);
+            }
+        }
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report_rate("ray-tri MT from vertices", tests, best);
+    printf("  hits: %zu\n", hits);
+
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        hits = 0;
+        double t0 = now_sec();
+        for (size_t j = 0; j < nrays; j++) {
+            float *o = rays + 6 * j, *d = o + 3;
+            for (size_t i = 0; i < ntris; i++) {
+                hits += v3_ray_tri_intersect(&tris[i], o, d, INFINITY, hit);
+            }
+        }
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report_rate("ray-tri MT precomputed v3_tri", tests, best);
+    printf("  hits: %zu\n", hits);
+
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        hits = 0;
+        double t0 = now_sec();
+        for (size_t j = 0; j < nrays; j++) {
+            v3_ray_wt_precompute(&rwt[j], rays + 6 * j, rays + 6 * j + 3);
+            for (size_t i = 0; i < ntris; i++) {
+                hits += v3_ray_tri_intersect_watertight(&wts[i], &rwt[j], INFINITY, hit);
+            }
+        }
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report_rate("ray-tri watertight v3_tri_wt", tests, best);
+    printf("  hits: %zu\n", hits);
+
+    free(verts);
+    free(rays);
+    free(tris);
+    free(wts);
+    free(rwt);
+}
+
+// ---------- bvh ----------
+// Per-frame BVH update for count moving boxes: full rebuild, full parallel
+// refit, and incremental refits of 1% and 0.1% of the primitives followed
+// by the degradation check.
+static void bench_bvh(size_t count) {
+    float *rnd = malloc(count * 4 * sizeof(float));
+    v3_aabb *boxes = malloc(count * sizeof(v3_aabb));
+    uint32_t *changed = malloc(count * sizeof(uint32_t));
+    v3_bvh bvh;
+    v3_bvh_refitter r;
+    if (rnd == NULL || boxes == NULL || changed == NULL) {
+        fprintf(stderr, "Error: v3bench bvh allocation failed\n");
+        free(rnd);
+        free(boxes);
+        free(changed);
+        return;
+    }
+    fill_random(rnd, count * 4, 31);
+    for (size_t i = 0; i < count; i++) {
+        float radius = 0.01f + 0.02f * fabsf(rnd[4 * i + 3]);
+        for (int k = 0; k < 3; k++) {
+            boxes[i].min[k] = rnd[4 * i + k] * 100.0f - radius;
+            boxes[i].max[k] = rnd[4 * i + k] * 100.0f + radius;
+        }
+    }
+    double t0 = now_sec();
+    bool ok = v3_bvh_build(&bvh, boxes, count);
+    double t_build = now_sec() - t0;
+    if (!ok || !v3_bvh_refitter_init(&r, &bvh)) {
+        fprintf(stderr, "Error: v3bench bvh build failed\n");
+        if (ok) v3_bvh_free(&bvh);
+        free(rnd);
+        free(boxes);
+        free(changed);
+        return;
+    }
+    report_rate("bvh full rebuild", count, t_build);
+
+    double best = 1e30;
+    for (int rep = 0; rep < REPS; rep++) {
+        t0 = now_sec();
+        v3_bvh_refit(&bvh, &r, boxes, NULL);
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report_rate("bvh v3_bvh_refit (all nodes)", count, best);
+    v3_bvh_rebuild_degraded(&bvh, &r, boxes, 1.5f);
+
+    static const size_t fractions[2] = {100, 1000};
+    for (int f = 0; f < 2; f++) {
+        size_t n = count / fractions[f];
+        double best_refit = 1e30, best_check = 1e30;
+        for (int rep = 0; rep < REPS; rep++) {
+            // a small jitter of a scattered subset, as in an animation frame
+            for (size_t i = 0; i < n; i++) {
+                changed[i] = (uint32_t)((i * 2654435761u + (size_t)rep) % count);
+                v3_aabb *b = &boxes[changed[i]];
+                float d = (rep & 1) ? 0.05f : -0.05f;
+                for (int k = 0; k < 3; k++) {
+                    b->min[k] += d;
+                    b->max[k] += d;
+                }
+            }
+            t0 = now_sec();
+            v3_bvh_refit_prims(&bvh, &r, boxes, changed, n);
+            double t1 = now_sec();
+            v3_bvh_rebuild_degraded(&bvh, &r, boxes, 1.5f);
+            double t2 = now_sec();
+            if (t1 - t0 < best_refit) best_refit = t1 - t0;
+            if (t2 - t1 < best_check) best_check = t2 - t1;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "bvh refit_prims 1/%zu", fractions[f]);
+        report_rate(name, n, best_refit);
+        snprintf(name, sizeof(name), "bvh rebuild_degraded 1/%zu", fractions[f]);
+        report_rate(name, n, best_check);
+    }
+    printf("bvh SAH cost %.2f\n", v3_bvh_sah_cost(&bvh));
+    v3_bvh_refitter_free(&r);
+    v3_bvh_free(&bvh);
+    free(rnd);
+    free(boxes);
+    free(changed);
+}
+
+// ---------- camera ----------
+// Primary rays for a square frame of count pixels: the per-pixel
+// v3_scale/v3_add/v3_normalize loop against v3_raygen_tile on 16x16 tiles.
+static void bench_camera(size_t count) {
+    int side = (int)sqrt((double)count);
+    if (side < 16) side = 16;
+    size_t pixels = (size_t)side * side;
+    float *aos = malloc(pixels * 3 * sizeof(float));
+    v3_ray_soa rays;
+    if (aos == NULL || !v3_ray_soa_alloc(&rays, pixels)) {
+        fprintf(stderr, "Error: v3bench camera allocation failed\n");
+        free(aos);
+        return;
+    }
+    v3_camera cam = {.pos = {0, 1, 5}, .look = {0, 0, 0}, .up = {0, 1, 0}, .fov = 45};
+    v3_raygen rg;
+    v3_raygen_init(&rg, &cam, side, side);
+
+    float forward[3], right[3], up[3];
+    v3_from_points(forward, cam.pos, cam.look);
+    v3_normalize(forward, forward);
+    v3_cross_product(right, forward, cam.up);
+    v3_normalize(right, right);
+    v3_cross_product(up, right, forward);
+    float half = tanf(22.5f * 3.14159265f / 180.0f);
+
+    double best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        for (int y = 0; y < side; y++) {
+            for (int x = 0; x < side; x++) {
+                float rx[3] = {right[0], right[1], right[2]}, uy[3] = {up[0], up[1], up[2]};
+                float *d = aos + 3 * ((size_t)y * side + x);
+                v3_scale(rx, (2.0f * (x + 0.5f) / side - 1.0f) * half);
+                v3_scale(uy, (1.0f - 2.0f * (y + 0.5f) / side) * half);
+                v3_add(d, forward, rx);
+                v3_add(d, d, uy);
+                v3_normalize(d, d);
+            }
+        }
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report_rate("camera per-pixel v3 calls", pixels, best);
+
+    const char *names[3] = {"camera v3_raygen_tile pinhole", "camera v3_raygen_tile jitter",
+                            "camera v3_raygen_tile thin lens"};
+    for (int mode = 0; mode < 3; mode++) {
+        if (mode == 2) {
+            cam.aperture = 0.1f;
+            v3_raygen_init(&rg, &cam, side, side);
+        }
+        rg.jitter = mode >= 1;
+        best = 1e30;
+        for (int r = 0; r < REPS; r++) {
+            double t0 = now_sec();
+            for (int y0 = 0; y0 < side; y0 += 16) {
+                for (int x0 = 0; x0 < side; x0 += 16) {
+                    int w = side - x0 < 16 ? side - x0 : 16, h = side - y0 < 16 ? side - y0 : 16;
+                    size_t off = (size_t)y0 * side + (size_t)x0 * (size_t)h;
+                    v3_ray_soa tile = {rays.ox + off, rays.oy + off, rays.oz + off,
+                                       rays.dx + off, rays.dy + off, rays.dz + off};
+                    v3_raygen_tile(&rg, x0, y0, w, h, (uint32_t)r, &tile);
+                }
+            }
+            double t = now_sec() - t0;
+            if (t < best) best = t;
+        }
+        report_rate(names[mode], pixels, best);
+    }
+    free(aos);
+    v3_ray_soa_free(&rays);
+}
+
+// ---------- refraction ----------
+// Glass shading for count hits (random unit directions, normals facing
+// against them, half entering and half leaving glass): reflect, refract and
+// Schlick's Fresnel term. Per-ray v3 calls as the shading code used to write
+// them, the fused scalar v3_reflect_refract, and the SoA batch.
+static void bench_refract(size_t count) {
+    float *aos = malloc(count * 6 * sizeof(float));
+    float *soa = malloc(count * 14 * sizeof(float));   // d, n, eta, refl, refr, fresnel
+    uint8_t *tir = malloc(count);
+    if (aos == NULL || soa == NULL || tir == NULL) {
+        fprintf(stderr, "Error: v3bench refract allocation failed\n");
+        free(aos);
+        free(soa);
+        free(tir);
+        return;
+    }
+    float *ad = aos, *an = aos + 3 * count;
+    fill_random(aos, 6 * count, 71);
+    v3_soa3 d = {soa, soa + count, soa + 2 * count};
+    v3_soa3 n = {soa + 3 * count, soa + 4 * count, soa + 5 * count};
+    float *eta = soa + 6 * count;
+    v3_soa3 refl = {soa + 7 * count, soa + 8 * count, soa + 9 * count};
+    v3_soa3 refr = {soa + 10 * count, soa + 11 * count, soa + 12 * count};
+    float *fres = soa + 13 * count;
+    for (size_t i = 0; i < count; i++) {
+        float *pd = ad + 3 * i, *pn = an + 3 * i;
+        v3_normalize(pd, pd);
+        v3_normalize(pn, pn);
+        if (v3_dot_product(pd, pn) > 0.0f) v3_scale(pn, -1.0f);
+        d.x[i] = pd[0]; d.y[i] = pd[1]; d.z[i] = pd[2];
+        n.x[i] = pn[0]; n.y[i] = pn[1]; n.z[i] = pn[2];
+        eta[i] = i % 2 ? 1.5f : 1.0f / 1.5f;
+    }
+
+    double best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        for (size_t i = 0; i < count; i++) {
+            float *pd = ad + 3 * i, *pn = an + 3 * i;
+            float m[3], t[3] = {pd[0], pd[1], pd[2]}, s[3] = {pn[0], pn[1], pn[2]};
+            v3_reflect(m, pd, pn);
+            float cosi = -v3_dot_product(pd, pn);
+            float k = 1.0f - eta[i] * eta[i] * (1.0f - cosi * cosi);
+            float f = 1.0f;
+            if (k >= 0.0f) {
+                float ct = sqrtf(k);
+                v3_scale(t, eta[i]);
+                v3_scale(s, eta[i] * cosi - ct);
+                v3_add(t, t, s);
+                f = v3_fresnel_schlick(cosi, eta[i]);
+            } else {
+                memcpy(t, m, sizeof(t));
+            }
+            refl.x[i] = m[0]; refl.y[i] = m[1]; refl.z[i] = m[2];
+            refr.x[i] = t[0]; refr.y[i] = t[1]; refr.z[i] = t[2];
+            fres[i] = f;
+        }
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report_rate("refract per-ray v3 calls", count, best);
+
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        for (size_t i = 0; i < count; i++) {
+            float *pd = ad + 3 * i, *pn = an + 3 * i;
+            float m[3], t[3];
+            if (!v3_reflect_refract(m, t, pd, pn, eta[i])) memcpy(t, m, sizeof(t));
+            refl.x[i] = m[0]; refl.y[i] = m[1]; refl.z[i] = m[2];
+            refr.x[i] = t[0]; refr.y[i] = t[1]; refr.z[i] = t[2];
+            fres[i] = v3_fresnel_schlick(-v3_dot_product(pd, pn), eta[i]);
+        }
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report_rate("refract v3_reflect_refract", count, best);
+
+    const char *names[2] = {"refract soa exact", "refract soa schlick"};
+    for (int mode = 0; mode < 2; mode++) {
+        best = 1e30;
+        for (int r = 0; r < REPS; r++) {
+            double t0 = now_sec();
+            v3_reflect_refract_soa(refl, refr, tir, fres, (v3_fresnel_mode)mode, d, n, eta, count);
+            double t = now_sec() - t0;
+            if (t < best) best = t;
+        }
+        report_rate(names[mode], count, best);
+    }
+    free(aos);
+    free(soa);
+    free(tir);
+}
+
+// ---------- sdf ----------
+// Sphere tracing count camera rays into a blend of spheres, boxes and tori:
+// a per-ray march built from v3 calls (the normal by central differences)
+// against v3_sdf_march, which keeps four rays per register for the march.
+#define SDF_BENCH_PRIMS 8
+
+static float sdf_bench_dist(const v3_sdf *sdf, float *p) {
+    float d = INFINITY;
+    for (size_t i = 0; i < sdf->count; i++) {
+        const v3_sdf_prim *s = &sdf->prims[i];
+        float q[3], e;
+        v3_subtract(q, p, (float *)s->center);
+        if (s->kind == V3_SDF_SPHERE) {
+            e = v3_length(q) - s->size[0];
+        } else if (s->kind == V3_SDF_BOX) {
+            float o[3];
+            for (int k = 0; k < 3; k++) {
+                q[k] = fabsf(q[k]) - s->size[k];
+                o[k] = fmaxf(q[k], 0.0f);
+            }
+            e = v3_length(o) + fminf(fmaxf(q[0], fmaxf(q[1], q[2])), 0.0f);
+        } else {
+            float xz[3] = {q[0], 0.0f, q[2]};
+            float ring[3] = {v3_length(xz) - s->size[0], q[1], 0.0f};
+            e = v3_length(ring) - s->size[1];
+        }
+        if (i == 0 || s->blend == 0.0f) {
+            d = fminf(d, e);
+        } else {
+            float h = fminf(fmaxf(0.5f + 0.5f * (e - d) / s->blend, 0.0f), 1.0f);
+            d = e + (d - e) * h - s->blend * h * (1.0f - h);
+        }
+    }
+    return d;
+}
+
+static void bench_sdf(size_t count) {
+    v3_sdf sdf;
+    v3_ray_soa rays;
+    float *buf = malloc(count * 5 * sizeof(float));
+    uint8_t *hit = malloc(count);
+    if (!v3_sdf_init(&sdf) || buf == NULL || hit == NULL || !v3_ray_soa_alloc(&rays, count)) {
+        fprintf(stderr, "Error: v3bench sdf allocation failed\n");
+        free(buf);
+        free(hit);
+        return;
+    }
+    float *t = buf, *t_max = buf + count;
+    v3_soa3 n = {buf + 2 * count, buf + 3 * count, buf + 4 * count};
+    for (int i = 0; i < SDF_BENCH_PRIMS; i++) {
+        float c[3] = {(float)(i % 4) * 2.5f - 3.75f, (float)(i / 4) * 2.5f - 1.25f, 0.0f};
+        float half[3] = {0.6f, 0.8f, 0.6f};
+        if (i % 3 == 0) v3_sdf_add_sphere(&sdf, c, 1.0f, 0.3f);
+        else if (i % 3 == 1) v3_sdf_add_box(&sdf, c, half, 0.3f);
+        else v3_sdf_add_torus(&sdf, c, 0.9f, 0.3f, 0.0f);
+    }
+    // a pinhole fan over the field from z = -8
+    size_t side = (size_t)sqrt((double)count) + 1;
+    for (size_t i = 0; i < count; i++) {
+        float d[3] = {((float)(i % side) / side - 0.5f) * 1.2f, ((float)(i / side) / side - 0.5f) * 0.8f, 1.0f};
+        v3_normalize(d, d);
+        rays.ox[i] = 0.0f;
+        rays.oy[i] = 0.0f;
+        rays.oz[i] = -8.0f;
+        rays.dx[i] = d[0];
+        rays.dy[i] = d[1];
+        rays.dz[i] = d[2];
+        t_max[i] = 30.0f;
+    }
+
+    size_t hits[2] = {0, 0};
+    double best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        hits[0] = 0;
+        for (size_t i = 0; i < count; i++) {
+            float o[3] = {rays.ox[i], rays.oy[i], rays.oz[i]}, d[3] = {rays.dx[i], rays.dy[i], rays.dz[i]};
+            float tt = 0.0f, g[3] = {0.0f, 0.0f, 0.0f};
+            bool h = false;
+            for (int step = 0; step < sdf.max_steps && tt < t_max[i]; step++) {
+                float p[3] = {d[0], d[1], d[2]};
+                v3_scale(p, tt);
+                v3_add(p, o, p);
+                float dist = sdf_bench_dist(&sdf, p);
+                if (dist < sdf.eps * fmaxf(tt, 1.0f)) {
+                    h = true;
+                    for (int k = 0; k < 3; k++) {
+                        float a[3] = {p[0], p[1], p[2]}, b[3] = {p[0], p[1], p[2]};
+                        a[k] += 1e-3f;
+                        b[k] -= 1e-3f;
+                        g[k] = sdf_bench_dist(&sdf, a) - sdf_bench_dist(&sdf, b);
+                    }
+                    v3_normalize(g, g);
+                    break;
+                }
+                tt += dist;
+            }
+            t[i] = h ? tt : t_max[i];
+            n.x[i] = g[0];
+            n.y[i] = g[1];
+            n.z[i] = g[2];
+            hits[0] += h;
+        }
+        double dt = now_sec() - t0;
+        if (dt < best) best = dt;
+    }
+    report_rate("sdf march per-ray v3 calls", count, best);
+
+    const char *names[2] = {"sdf march soa", "sdf march soa, no normals"};
+    for (int k = 0; k < 2; k++) {
+        best = 1e30;
+        v3_soa3 nk = k ? (v3_soa3){NULL, NULL, NULL} : n;
+        for (int r = 0; r < REPS; r++) {
+            double t0 = now_sec();
+            hits[1] = v3_sdf_march(&sdf, NULL, &rays, t_max, count, t, nk, hit);
+            double dt = now_sec() - t0;
+            if (dt < best) best = dt;
+        }
+        report_rate(names[k], count, best);
+    }
+    printf("%-32s %10zu hits %10zu hits\n", "sdf hits, per-ray / soa", hits[0], hits[1]);
+    v3_ray_soa_free(&rays);
+    v3_sdf_free(&sdf);
+    free(buf);
+    free(hit);
+}
+
+// ---------- scene ----------
+// Load time of a random scene with count spheres and count triangles:
+// text parse plus BVH build against mapping the converted binary file.
+static void bench_scene(size_t count) {
+    char txt[] = "/tmp/v3benchXXXXXX", bin[] = "/tmp/v3benchXXXXXX";
+    int fd_txt = mkstemp(txt), fd_bin = mkstemp(bin);
+    FILE *f = fd_txt >= 0 ? fdopen(fd_txt, "w") : NULL;
+    float *rnd = malloc(count * 9 * sizeof(float));
+    if (f == NULL || fd_bin < 0 || rnd == NULL) {
+        fprintf(stderr, "Error: v3bench scene setup failed\n");
+        if (f) fclose(f);
+        if (fd_bin >= 0) close(fd_bin);
+        free(rnd);
+        return;
+    }
+    close(fd_bin);
+    fill_random(rnd, count * 9, 21);
+    fprintf(f, "image 640 480\nmaterial a diffuse 0.8 0.3 0.2\nmaterial b reflect 0.5\n");
+    fprintf(f, "light pos 0 50 50 color 1 1 1\n");
+    for (size_t i = 0; i < count; i++) {
+        float *r = rnd + 9 * i;
+        fprintf(f, "sphere center %.6f %.6f %.6f radius %.6f material a\n",
+                r[0] * 100.0f, r[1] * 100.0f, r[2] * 100.0f, 0.1f + 0.2f * fabsf(r[3]));
+        fprintf(f, "triangle %.6f %.6f %.6f %.6f %.6f %.6f %.6f %.6f %.6f material b\n",
+                r[3] * 100.0f, r[4] * 100.0f, r[5] * 100.0f, r[3] * 100.0f + r[6], r[4] * 100.0f,
+                r[5] * 100.0f, r[3] * 100.0f, r[4] * 100.0f + r[7], r[5] * 100.0f + r[8]);
+    }
+    fclose(f);
+    free(rnd);
+
+    v3_scene scene;
+    double t0 = now_sec();
+    bool ok = v3_scene_load(&scene, txt);
+    double t_text = now_sec() - t0;
+    if (ok) {
+        ok = v3_scene_save_binary(&scene, bin);
+        v3_scene_free(&scene);
+    }
+    double best = 1e30;
+    for (int r = 0; ok && r < REPS; r++) {
+        t0 = now_sec();
+        ok = v3_scene_load(&scene, bin);
+        double t = now_sec() - t0;
+        if (ok) v3_scene_free(&scene);
+        if (t < best) best = t;
+    }
+    if (ok) {
+        report_rate("scene load text + BVH build", 2 * count, t_text);
+        report_rate("scene load binary (mmap)", 2 * count, best);
+    } else {
+        fprintf(stderr, "Error: v3bench scene load failed\n");
+    }
+    unlink(txt);
+    unlink(bin);
+}
+
+// ---------- image ----------
+// Output of a count-pixel HDR frame: per-pixel clamp and powf with an ASCII
+// P3 writer against the batched v3_image_to_srgb8 and the buffered writers.
+static void bench_image(size_t count) {
+    int side = (int)sqrt((double)count);
+    if (side < 16) side = 16;
+    size_t pixels = (size_t)side * side;
+    char path[] = "/tmp/v3benchXXXXXX";
+    int fd = mkstemp(path);
+    float *rgb = malloc(pixels * 3 * sizeof(float));
+    uint8_t *rgb8 = malloc(pixels * 3);
+    if (fd < 0 || rgb == NULL || rgb8 == NULL) {
+        fprintf(stderr, "Error: v3bench image setup failed\n");
+        if (fd >= 0) {
+            close(fd);
+            unlink(path);
+        }
+        free(rgb);
+        free(rgb8);
+        return;
+    }
+    close(fd);
+    fill_random(rgb, pixels * 3, 11);
+    for (size_t i = 0; i < pixels * 3; i++) rgb[i] = fabsf(rgb[i]) * 1.5f;
+
+    double best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        for (size_t i = 0; i < pixels * 3; i++) {
+            float v = rgb[i] < 0.0f ? 0.0f : rgb[i] > 1.0f ? 1.0f : rgb[i];
+            v = v <= 0.0031308f ? 12.92f * v : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+            rgb8[i] = (uint8_t)(v * 255.0f + 0.5f);
+        }
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report_rate("image per-value powf sRGB", pixels, best);
+
+    for (int mode = 0; mode < 2; mode++) {
+        v3_tonemap op = mode == 0 ? V3_TONEMAP_CLAMP : V3_TONEMAP_FILMIC;
+        best = 1e30;
+        for (int r = 0; r < REPS; r++) {
+            double t0 = now_sec();
+            v3_image_to_srgb8(rgb8, rgb, pixels, 1.0f, op, NULL);
+            double t = now_sec() - t0;
+            if (t < best) best = t;
+        }
+        report_rate(mode == 0 ? "image v3_image_to_srgb8 clamp" : "image v3_image_to_srgb8 filmic",
+                    pixels, best);
+    }
+
+    double t0 = now_sec();
+    FILE *f = fopen(path, "w");
+    if (f != NULL) {
+        fprintf(f, "P3\n%d %d\n255\n", side, side);
+        for (size_t i = 0; i < pixels; i++) {
+            fprintf(f, "%d %d %d\n", rgb8[3 * i], rgb8[3 * i + 1], rgb8[3 * i + 2]);
+        }
+        fclose(f);
+    }
+    report_rate("image fprintf P3 writer", pixels, now_sec() - t0);
+    t0 = now_sec();
+    v3_image_write_ppm(path, rgb8, side, side);
+    report_rate("image v3_image_write_ppm", pixels, now_sec() - t0);
+    t0 = now_sec();
+    v3_image_write_pfm(path, rgb, side, side);
+    report_rate("image v3_image_write_pfm", pixels, now_sec() - t0);
+    unlink(path);
+    free(rgb);
+    free(rgb8);
+}
+
+// ---------- progressive ----------
+// Time to an image of given quality for a count-pixel frame of a defocused
+// scene: uniform sampling at increasing rates against adaptive progressive
+// passes, each with its rms error against a 256 spp reference.
+static const char *k_progressive_scene =
+    "background 0.55 0.7 0.9\n"
+    "camera pos 0 1.6 7 look 0 0.8 0 up 0 1 0 fov 45 aperture 0.08 focus 6\n"
+    "material floor diffuse 0.75 0.72 0.65 reflect 0.15\n"
+    "material mirror diffuse 0.9 0.9 0.9 specular 1 1 1 shininess 200 reflect 0.85\n"
+    "material glass diffuse 1 1 1 specular 1 1 1 shininess 300 reflect 0.05 transmit 0.9 ior 1.5\n"
+    "material red diffuse 0.85 0.15 0.1 specular 0.6 0.6 0.6 shininess 60\n"
+    "light pos -4 6 5 color 0.9 0.9 0.85\n"
+    "plane point 0 0 0 normal 0 1 0 material floor\n"
+    "sphere center -1.6 1 0 radius 1 material mirror\n"
+    "sphere center 0.6 0.7 1.4 radius 0.7 material glass\n"
+    "sphere center 2.0 0.5 -0.6 radius 0.5 material red\n";
+
+static double rms_error(const float *a, const float *b, size_t n) {
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) sum += (double)(a[i] - b[i]) * (a[i] - b[i]);
+    return sqrt(sum / (double)n);
+}
+
+static void bench_progressive(size_t count) {
+    int side = (int)sqrt((double)count);
+    if (side < 16) side = 16;
+    size_t pixels = (size_t)side * side;
+    FILE *f = tmpfile();
+    v3_scene scene;
+    bool ok = f != NULL;
+    if (ok) {
+        fprintf(f, "image %d %d\ndepth 4\n%s", side, side, k_progressive_scene);
+        rewind(f);
+        ok = v3_scene_parse(&scene, f, "progressive");
+        fclose(f);
+    }
+    float *ref = malloc(pixels * 3 * sizeof(float));
+    float *rgb = malloc(pixels * 3 * sizeof(float));
+    v3_progressive p;
+    if (!ok || ref == NULL || rgb == NULL || !v3_progressive_init(&p, &scene)) {
+        fprintf(stderr, "Error: v3bench progressive setup failed\n");
+        if (ok) v3_scene_free(&scene);
+        free(ref);
+        free(rgb);
+        return;
+    }
+    v3_pool *pool = v3_pool_default();
+    scene.samples = 256;
+    v3_trace_render(&scene, pool, ref, NULL);
+
+    for (int spp = 4; spp <= 64; spp *= 4) {
+        scene.samples = spp;
+        double t0 = now_sec();
+        v3_trace_render(&scene, pool, rgb, NULL);
+        double t = now_sec() - t0;
+        printf("progressive uniform %3d spp       %9.3f ms  rms %.4f\n", spp, t * 1e3,
+               rms_error(rgb, ref, pixels * 3));
+    }
+
+    static const float tolerances[3] = {0.1f, 0.05f, 0.02f};
+    for (int k = 0; k < 3; k++) {
+        v3_progressive_reset(&p);
+        p.tolerance = tolerances[k];
+        double t0 = now_sec();
+        v3_progressive_pass(&p, pool);
+        double t_first = now_sec() - t0;
+        if (k == 0) {
+            v3_progressive_resolve(&p, rgb);
+            printf("progressive first pass  1 spp     %9.3f ms  rms %.4f\n", t_first * 1e3,
+                   rms_error(rgb, ref, pixels * 3));
+        }
+        while (v3_progressive_pass(&p, pool) > 0) {
+        }
+        double t = now_sec() - t0;
+        uint64_t samples = 0;
+        for (size_t i = 0; i < pixels; i++) samples += p.count[i];
+        v3_progressive_resolve(&p, rgb);
+        printf("progressive tol %.2f %5.1f spp     %9.3f ms  rms %.4f  (%u passes)\n", p.tolerance,
+               (double)samples / (double)pixels, t * 1e3, rms_error(rgb, ref, pixels * 3), p.pass);
+    }
+
+    v3_progressive_free(&p);
+    v3_scene_free(&scene);
+    free(ref);
+    free(rgb);
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(size_t count);
+    size_t default_count;
+} bench_entry;
+
+// ---------- compare ----------
+// Change detection over count vectors: the v3_equals loop the callers used
+// against the batched kernels, with no changes (full scan, the common frame)
+// and with 1% of the elements moved.
+static void bench_compare(size_t count) {
+    float *a = malloc(count * 3 * sizeof(float));
+    float *b = malloc(count * 3 * sizeof(float));
+    uint32_t *idx = malloc(count * sizeof(uint32_t));
+    if (a == NULL || b == NULL || idx == NULL) {
+        fprintf(stderr, "Error: v3bench compare allocation failed\n");
+        free(a);
+        free(b);
+        free(idx);
+        return;
+    }
+    fill_random(a, 3 * count, 8);
+    memcpy(b, a, count * 3 * sizeof(float));
+    const float tol = 1e-5f;
+    volatile size_t sink = 0;
+
+    double best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        bool changed = false;
+        for (size_t i = 0; i < count && !changed; i++) changed = !v3_equals(a + 3 * i, b + 3 * i, tol);
+        sink = changed;
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report("unchanged v3_equals loop", count, 24, best);
+
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        sink = v3_any_changed_n(a, b, tol, count);
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report("unchanged v3_any_changed_n", count, 24, best);
+
+    for (size_t i = 0; i < count; i += 100) b[3 * i + 1] += 1.0f;
+
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (!v3_equals(a + 3 * i, b + 3 * i, tol)) idx[n++] = (uint32_t)i;
+        }
+        sink = n;
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report("1% changed v3_equals loop", count, 24, best);
+
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        sink = v3_count_changed_n(a, b, tol, count);
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report("1% changed v3_count_changed_n", count, 24, best);
+
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        sink = v3_changed_indices_n(idx, a, b, tol, count);
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report("1% changed v3_changed_indices_n", count, 24, best);
+    (void)sink;
+
+    free(a);
+    free(b);
+    free(idx);
+}
+
+// ---------- dirty ----------
+// Vertex normals and bounds of a count-vertex grid mesh after editing a
+// square patch of about 1% and 0.1% of the vertices: full recomputation
+// against dirty-block updates (marking included).
+static void bench_dirty(size_t count) {
+    size_t g = 2;
+    while ((g + 1) * (g + 1) <= count) g++;
+    size_t nv = g * g, nt = 2 * (g - 1) * (g - 1);
+    float *verts = malloc(nv * 3 * sizeof(float));
+    float *normals = malloc(nv * 3 * sizeof(float));
+    uint32_t *tris = malloc(nt * 3 * sizeof(uint32_t));
+    v3_dirty *d = v3_dirty_create(nv, 0);
+    v3_normals nm;
+    v3_bounds bounds;
+    if (verts == NULL || normals == NULL || tris == NULL || d == NULL) {
+        fprintf(stderr, "Error: v3bench dirty allocation failed\n");
+        free(verts);
+        free(normals);
+        free(tris);
+        v3_dirty_destroy(d);
+        return;
+    }
+    for (size_t y = 0; y < g; y++) {
+        for (size_t x = 0; x < g; x++) {
+            float *p = verts + 3 * (y * g + x);
+            p[0] = (float)x;
+            p[1] = (float)y;
+            p[2] = sinf(0.05f * (float)x) * cosf(0.07f * (float)y);
+        }
+    }
+    size_t t = 0;
+    for (size_t y = 0; y + 1 < g; y++) {
+        for (size_t x = 0; x + 1 < g; x++) {
+            uint32_t v = (uint32_t)(y * g + x), w = (uint32_t)g;
+            uint32_t quad[6] = {v, v + 1, v + w, v + 1, v + w + 1, v + w};
+            memcpy(tris + 3 * t, quad, sizeof(quad));
+            t += 2;
+        }
+    }
+    if (!v3_normals_init(&nm, tris, nt, nv) || !v3_bounds_init(&bounds, d, verts)) {
+        fprintf(stderr, "Error: v3bench dirty setup failed\n");
+        free(verts);
+        free(normals);
+        free(tris);
+        v3_dirty_destroy(d);
+        return;
+    }
+
+    double best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        v3_normals_compute(&nm, verts, normals);
+        double dt = now_sec() - t0;
+        if (dt < best) best = dt;
+    }
+    report_rate("normals full", nv, best);
+
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        v3_dirty_mark_all(d);
+        double t0 = now_sec();
+        v3_bounds_update(&bounds, d, verts);
+        double dt = now_sec() - t0;
+        if (dt < best) best = dt;
+        v3_dirty_clear(d);
+    }
+    report_rate("bounds full", nv, best);
+
+    const double fractions[2] = {0.01, 0.001};
+    for (int f = 0; f < 2; f++) {
+        size_t side = (size_t)(sqrt(fractions[f]) * (double)g);
+        if (side < 1) side = 1;
+        double best_n = 1e30, best_b = 1e30;
+        for (int r = 0; r < REPS; r++) {
+            // move the patch and mark each of its rows as written
+            double t0 = now_sec();
+            for (size_t y = g / 3; y < g / 3 + side; y++) {
+                for (size_t x = g / 3; x < g / 3 + side; x++) verts[3 * (y * g + x) + 2] += 0.01f;
+                v3_dirty_mark(d, y * g + g / 3, side);
+            }
+            double t_mark = now_sec() - t0;
+            t0 = now_sec();
+            v3_normals_update(&nm, d, verts, normals);
+            double t_n = now_sec() - t0;
+            t0 = now_sec();
+            v3_bounds_update(&bounds, d, verts);
+            double t_b = now_sec() - t0;
+            v3_dirty_clear(d);
+            if (t_mark + t_n < best_n) best_n = t_mark + t_n;
+            if (t_mark + t_b < best_b) best_b = t_mark + t_b;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "normals dirty %.1f%%", 100.0 * fractions[f]);
+        report_rate(name, side * side, best_n);
+        snprintf(name, sizeof(name), "bounds dirty %.1f%%", 100.0 * fractions[f]);
+        report_rate(name, side * side, best_b);
+    }
+
+    v3_normals_free(&nm);
+    v3_bounds_free(&bounds);
+    v3_dirty_destroy(d);
+    free(verts);
+    free(normals);
+    free(tris);
+}
+
+// ---------- rcu ----------
+// Query latency while an editor moves 1% of count spheres and rebuilds the
+// BVH every 10 ms. Readers cast 64 rays per query against either an RCU
+// snapshot (the editor builds a copy and publishes it) or the one shared
+// scene under a rwlock (the editor edits in place under the write lock).
+#define RCU_BENCH_READERS 2
+#define RCU_BENCH_SECONDS 1.0
+
+typedef struct {
+    v3_rcu *rcu;                 // NULL: use lock and shared
+    pthread_rwlock_t *lock;
+    v3_scene *shared;
+    atomic_bool *stop;
+    v3_hist lat;                 // this reader's query times
+    unsigned seed;
+} rcu_bench_reader;
+
+static void rcu_bench_scene_destroy(void *scene) {
+    v3_scene_free(scene);
+    free(scene);
+}
+
+static void *rcu_bench_read(void *arg) {
+    rcu_bench_reader *c = arg;
+    int me = c->rcu ? v3_rcu_register(c->rcu) : -1;
+    unsigned state = c->seed;
+    while (!atomic_load_explicit(c->stop, memory_order_relaxed)) {
+        uint64_t t0 = v3_hist_now_ns();
+        v3_scene *scene;
+        if (c->rcu) {
+            scene = v3_rcu_read_lock(c->rcu, me);
+        } else {
+            pthread_rwlock_rdlock(c->lock);
+            scene = c->shared;
+        }
+        for (int i = 0; i < 64; i++) {
+            state = state * 1664525u + 1013904223u;
+            float orig[3] = {(float)(state >> 8) / (float)(1u << 24) * 200.0f - 100.0f, -100.0f, 0.0f};
+            float dir[3] = {0.0f, 1.0f, 0.0f};
+            v3_hit hit;
+            v3_trace_intersect(scene, orig, dir, INFINITY, &hit);
+        }
+        if (c->rcu) {
+            v3_rcu_read_unlock(c->rcu, me);
+        } else {
+            pthread_rwlock_unlock(c->lock);
+        }
+        v3_hist_record(&c->lat, v3_hist_now_ns() - t0);
+    }
+    if (c->rcu) v3_rcu_unregister(c->rcu, me);
+    return NULL;
+}
+
+static void rcu_bench_move(v3_scene *scene, unsigned pass) {
+    for (size_t i = pass % 100; i < scene->sphere_count; i += 100) scene->spheres[i].center[2] += 0.01f;
+}
+
+static void rcu_bench_run(const char *name, v3_scene *base, bool use_rcu) {
+    v3_scene *scene = malloc(sizeof(v3_scene));
+    if (scene == NULL || !v3_scene_copy(scene, base)) {
+        fprintf(stderr, "Error: v3bench rcu setup failed\n");
+        free(scene);
+        return;
+    }
+    pthread_rwlock_t lock;
+    pthread_rwlock_init(&lock, NULL);
+    v3_rcu *rcu = use_rcu ? v3_rcu_create(scene, rcu_bench_scene_destroy, 0) : NULL;
+    atomic_bool stop;
+    atomic_init(&stop, false);
+    rcu_bench_reader readers[RCU_BENCH_READERS];
+    pthread_t threads[RCU_BENCH_READERS];
+    for (int i = 0; i < RCU_BENCH_READERS; i++) {
+        readers[i] = (rcu_bench_reader){rcu, &lock, scene, &stop, {0}, (unsigned)i * 7919u + 1u};
+        v3_hist_init(&readers[i].lat);
+        pthread_create(&threads[i], NULL, rcu_bench_read, &readers[i]);
+    }
+
+    unsigned edits = 0;
+    v3_scene *latest = scene;
+    double start = now_sec();
+    while (now_sec() - start < RCU_BENCH_SECONDS) {
+        struct timespec pause = {0, 10 * 1000 * 1000};
+        nanosleep(&pause, NULL);
+        if (use_rcu) {
+            v3_scene *next = malloc(sizeof(v3_scene));
+            if (next == NULL || !v3_scene_copy(next, latest)) {
+                free(next);
+                break;
+            }
+            rcu_bench_move(next, edits);
+            v3_scene_build_bvh(next);
+            v3_rcu_publish(rcu, next);
+            latest = next;
+        } else {
+            pthread_rwlock_wrlock(&lock);
+            rcu_bench_move(scene, edits);
+            v3_scene_build_bvh(scene);
+            pthread_rwlock_unlock(&lock);
+        }
+        edits++;
+    }
+    atomic_store(&stop, true);
+
+    v3_hist all;
+    bool merged = v3_hist_init(&all);
+    for (int i = 0; i < RCU_BENCH_READERS; i++) {
+        pthread_join(threads[i], NULL);
+        if (merged) v3_hist_merge(&all, &readers[i].lat);
+        v3_hist_free(&readers[i].lat);
+    }
+    if (merged) report_latency(name, &all);
+    printf("%-32s %10u edits\n", "", edits);
+    v3_hist_free(&all);
+    if (use_rcu) {
+        v3_rcu_destroy(rcu);
+    } else {
+        rcu_bench_scene_destroy(scene);
+    }
+    pthread_rwlock_destroy(&lock);
+}
+
+// count random spheres in a 200^3 box with one material, BVH built
+static bool sphere_scene(v3_scene *scene, size_t count, unsigned seed) {
+    memset(scene, 0, sizeof(*scene));
+    float *rnd = malloc(count * 4 * sizeof(float));
+    scene->materials = calloc(1, sizeof(v3_material));
+    scene->spheres = malloc(count * sizeof(v3_sphere));
+    if (rnd == NULL || scene->materials == NULL || scene->spheres == NULL) {
+        fprintf(stderr, "Error: v3bench sphere scene allocation failed\n");
+        free(rnd);
+        v3_scene_free(scene);
+        return false;
+    }
+    scene->material_count = 1;
+    scene->sphere_count = count;
+    fill_random(rnd, count * 4, seed);
+    for (size_t i = 0; i < count; i++) {
+        for (int k = 0; k < 3; k++) scene->spheres[i].center[k] = rnd[4 * i + k] * 100.0f;
+        scene->spheres[i].radius = 0.2f + 0.3f * fabsf(rnd[4 * i + 3]);
+        scene->spheres[i].material = 0;
+    }
+    free(rnd);
+    if (!v3_scene_build_bvh(scene)) {
+        v3_scene_free(scene);
+        return false;
+    }
+    return true;
+}
+
+static void bench_rcu(size_t count) {
+    v3_scene base;
+    if (!sphere_scene(&base, count, 51)) return;
+    rcu_bench_run("rcu query, rwlock + in-place edit", &base, false);
+    rcu_bench_run("rcu query, snapshots", &base, true);
+    v3_scene_free(&base);
+}
+
+// ---------- serve ----------
+// Short ray-cast queries (t_max 5) against a 65536-sphere scene from client
+// threads through the v3serve socket and shared-memory ring, against tracing
+// in process. count is the number of rays each client casts per configuration.
+#define SERVE_BENCH_SPHERES 65536
+
+typedef struct {
+    const char *path;
+    const v3_query_ray *rays;
+    size_t count;
+    unsigned batch;
+    bool pipelined;     // keep 4 batches in flight instead of one
+    v3_hist lat;        // per-batch round trip, unless pipelined
+} serve_bench_client;
+
+static void *serve_bench_run_client(void *arg) {
+    serve_bench_client *b = arg;
+    v3_client *c = v3_client_connect(b->path, 4, b->batch);
+    if (c == NULL) return NULL;
+    if (b->pipelined) {
+        v3_query_hit *hits = malloc(b->count * sizeof(v3_query_hit));
+        if (hits != NULL) v3_client_cast(c, b->rays, b->count, hits);
+        free(hits);
+    } else {
+        for (size_t first = 0; first < b->count; first += b->batch) {
+            unsigned n = (unsigned)(b->count - first < b->batch ? b->count - first : b->batch);
+            uint64_t t0 = v3_hist_now_ns();
+            memcpy(v3_client_rays(c, 0), b->rays + first, n * sizeof(v3_query_ray));
+            if (!v3_client_submit(c, 0, n) || v3_client_wait(c, NULL) < 0) break;
+            v3_hist_record(&b->lat, v3_hist_now_ns() - t0);
+        }
+    }
+    v3_client_close(c);
+    return NULL;
+}
+
+static void serve_bench_config(const char *path, const v3_query_ray *rays, size_t count, int clients,
+                               unsigned batch, bool pipelined) {
+    serve_bench_client b[4];
+    pthread_t threads[4];
+    v3_hist all;
+    if (!v3_hist_init(&all)) return;
+    double t0 = now_sec();
+    for (int i = 0; i < clients; i++) {
+        b[i] = (serve_bench_client){path, rays, count, batch, pipelined, {0}};
+        v3_hist_init(&b[i].lat);
+        pthread_create(&threads[i], NULL, serve_bench_run_client, &b[i]);
+    }
+    for (int i = 0; i < clients; i++) {
+        pthread_join(threads[i], NULL);
+        v3_hist_merge(&all, &b[i].lat);
+        v3_hist_free(&b[i].lat);
+    }
+    double sec = now_sec() - t0;
+    char name[64];
+    snprintf(name, sizeof(name), "serve %d client%s x %u%s", clients, clients > 1 ? "s" : "", batch,
+             pipelined ? " pipelined" : "");
+    printf("%-32s %10zu rays  %9.3f ms  %8.2f Mrays/s\n", name, (size_t)clients * count, sec * 1e3,
+           (double)clients * (double)count / sec * 1e-6);
+    if (!pipelined) {
+        snprintf(name, sizeof(name), "serve %d client%s x %u batch", clients, clients > 1 ? "s" : "", batch);
+        report_latency(name, &all);
+    }
+    v3_hist_free(&all);
+}
+
+typedef struct {
+    v3_scene *scene;
+    const v3_query_ray *rays;
+} serve_local_ctx;
+
+static void serve_local_range(void *arg, size_t begin, size_t end) {
+    serve_local_ctx *c = arg;
+    for (size_t i = begin; i < end; i++) {
+        v3_query_ray r = c->rays[i];
+        v3_hit h;
+        v3_trace_intersect(c->scene, r.orig, r.dir, r.t_max, &h);
+    }
+}
+
+static void bench_serve(size_t count) {
+    v3_scene scene;
+    if (!sphere_scene(&scene, SERVE_BENCH_SPHERES, 68)) return;
+    v3_query_ray *rays = malloc(count * sizeof(v3_query_ray));
+    float *rnd = malloc(count * 6 * sizeof(float));
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/v3bench-%ld.sock", (long)getpid());
+    v3_server *server = rays && rnd ? v3_server_start(&scene, path, NULL) : NULL;
+    if (server == NULL) {
+        fprintf(stderr, "Error: v3bench serve setup failed\n");
+        free(rays);
+        free(rnd);
+        v3_scene_free(&scene);
+        return;
+    }
+    fill_random(rnd, count * 6, 68);
+    for (size_t i = 0; i < count; i++) {
+        for (int k = 0; k < 3; k++) {
+            rays[i].orig[k] = rnd[6 * i + k] * 100.0f;
+            rays[i].dir[k] = rnd[6 * i + 3 + k];
+        }
+        rays[i].t_max = 5.0f;
+    }
+    free(rnd);
+
+    serve_local_ctx local = {&scene, rays};
+    double t0 = now_sec();
+    serve_local_range(&local, 0, count);
+    double t1 = now_sec();
+    v3_pool_parallel_for(NULL, count, V3_TRACE_TILE * V3_TRACE_TILE, serve_local_range, &local);
+    double t2 = now_sec();
+    printf("%-32s %10zu rays  %9.3f ms  %8.2f Mrays/s\n", "in process, 1 thread", count, (t1 - t0) * 1e3,
+           (double)count / (t1 - t0) * 1e-6);
+    printf("%-32s %10zu rays  %9.3f ms  %8.2f Mrays/s\n", "in process, pool", count, (t2 - t1) * 1e3,
+           (double)count / (t2 - t1) * 1e-6);
+
+    static const unsigned batches[] = {64, 4096};
+    for (int clients = 1; clients <= 4; clients *= 4) {
+        for (int k = 0; k < 2; k++) serve_bench_config(path, rays, count, clients, batches[k], false);
+        serve_bench_config(path, rays, count, clients, 4096, true);
+    }
+    v3_server_stop(server);
+    free(rays);
+    v3_scene_free(&scene);
+}
+
+// ---------- shadow ----------
+// count shadow rays from points on the spheres of a 65536-sphere scene to a
+// point light. Each run of 64 rays starts on one sphere, like the shading
+// points of a tile that sees one object, so packets are coherent. Closest
+// hit against any-hit, and any-hit one ray at a time, in packets of 64 (in
+// order and shuffled) and as one stream on a one-thread pool.
+#define SHADOW_BENCH_SPHERES 65536
+
+static void bench_shadow(size_t count) {
+    v3_scene scene;
+    if (!sphere_scene(&scene, SHADOW_BENCH_SPHERES, 72)) return;
+    v3_ray_soa rays, shuffled;
+    float *t_max = malloc(count * sizeof(float)), *t_shuf = malloc(count * sizeof(float));
+    float *rnd = malloc(count * 3 * sizeof(float));
+    uint8_t *occluded = malloc(count);
+    v3_pool *pool = v3_pool_create(1);
+    bool ok = v3_ray_soa_alloc(&rays, count);
+    ok = v3_ray_soa_alloc(&shuffled, count) && ok;
+    if (!ok || t_max == NULL || t_shuf == NULL || rnd == NULL || occluded == NULL || pool == NULL) {
+        fprintf(stderr, "Error: v3bench shadow allocation failed\n");
+        goto done;
+    }
+    fill_random(rnd, count * 3, 72);
+    const float light[3] = {30.0f, 150.0f, -20.0f};
+    for (size_t i = 0; i < count; i++) {
+        const v3_sphere *sp = &scene.spheres[(i / V3_BVH_PACKET * 7919) % scene.sphere_count];
+        float n[3] = {rnd[3 * i], fabsf(rnd[3 * i + 1]) + 0.1f, rnd[3 * i + 2]};
+        v3_normalize(n, n);
+        float o[3], d[3];
+        for (int k = 0; k < 3; k++) o[k] = sp->center[k] + (sp->radius + 1e-3f) * n[k];
+        v3_from_points(d, o, (float *)light);
+        t_max[i] = v3_length(d);
+        v3_scale(d, 1.0f / t_max[i]);
+        rays.ox[i] = o[0]; rays.oy[i] = o[1]; rays.oz[i] = o[2];
+        rays.dx[i] = d[0]; rays.dy[i] = d[1]; rays.dz[i] = d[2];
+    }
+    for (size_t i = 0; i < count; i++) {
+        size_t j = (i * 2654435761u) % count;   // a permutation when count is a power of two
+        shuffled.ox[i] = rays.ox[j]; shuffled.oy[i] = rays.oy[j]; shuffled.oz[i] = rays.oz[j];
+        shuffled.dx[i] = rays.dx[j]; shuffled.dy[i] = rays.dy[j]; shuffled.dz[i] = rays.dz[j];
+        t_shuf[i] = t_max[j];
+    }
+
+    double best = 1e30;
+    size_t blocked = 0;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        blocked = 0;
+        for (size_t i = 0; i < count; i++) {
+            float o[3] = {rays.ox[i], rays.oy[i], rays.oz[i]}, d[3] = {rays.dx[i], rays.dy[i], rays.dz[i]};
+            v3_hit h;
+            blocked += v3_trace_intersect(&scene, o, d, t_max[i], &h);
+        }
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report_rate("shadow closest hit", count, best);
+    printf("%-32s %10zu of %zu rays blocked\n", "", blocked, count);
+
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        for (size_t i = 0; i < count; i++) {
+            float o[3] = {rays.ox[i], rays.oy[i], rays.oz[i]}, d[3] = {rays.dx[i], rays.dy[i], rays.dz[i]};
+            occluded[i] = v3_trace_occluded(&scene, o, d, t_max[i]);
+        }
+        double t = now_sec() - t0;
+        if (t < best) best = t;
+    }
+    report_rate("shadow any hit", count, best);
+
+    const char *names[2] = {"shadow packets", "shadow packets, shuffled"};
+    for (int k = 0; k < 2; k++) {
+        v3_ray_soa *src = k ? &shuffled : &rays;
+        float *tm = k ? t_shuf : t_max;
+        best = 1e30;
+        for (int r = 0; r < REPS; r++) {
+            double t0 = now_sec();
+            for (size_t first = 0; first < count; first += V3_BVH_PACKET) {
+                size_t n = count - first < V3_BVH_PACKET ? count - first : V3_BVH_PACKET;
+                v3_ray_soa sub = {src->ox + first, src->oy + first, src->oz + first,
+                                  src->dx + first, src->dy + first, src->dz + first};
+                v3_trace_occluded_packet(&scene, &sub, tm + first, n, occluded + first);
+            }
+            double t = now_sec() - t0;
+            if (t < best) best = t;
+        }
+        report_rate(names[k], count, best);
+    }
+
+    const char *stream_names[2] = {"shadow stream", "shadow stream, shuffled"};
+    for (int k = 0; k < 2; k++) {
+        best = 1e30;
+        for (int r = 0; r < REPS; r++) {
+            double t0 = now_sec();
+            v3_trace_occluded_n(&scene, pool, k ? &shuffled : &rays, k ? t_shuf : t_max, count, occluded);
+            double t = now_sec() - t0;
+            if (t < best) best = t;
+        }
+        report_rate(stream_names[k], count, best);
+    }
+
+done:
+    v3_pool_destroy(pool);
+    v3_ray_soa_free(&rays);
+    v3_ray_soa_free(&shuffled);
+    free(t_max);
+    free(t_shuf);
+    free(rnd);
+    free(occluded);
+    v3_scene_free(&scene);
+}
+
+// ---------- wbvh ----------
+// Binary BVH against its compressed 8-wide conversion over count spheres of
+// sphere_scene: node memory, conversion time, and closest-hit and any-hit
+// rates for rays from inside the cloud, the same primitive callback on both.
+#define WBVH_BENCH_RAYS (1u << 16)
+
+typedef struct {
+    const v3_sphere *spheres;
+    const float *orig, *dir;
+} wbvh_bench_ray;
+
+static bool wbvh_bench_t(const v3_sphere *sp, const float *orig, const float *dir, float t_max, float *t) {
+    float oc[3] = {orig[0] - sp->center[0], orig[1] - sp->center[1], orig[2] - sp->center[2]};
+    float b = oc[0] * dir[0] + oc[1] * dir[1] + oc[2] * dir[2];
+    float c = oc[0] * oc[0] + oc[1] * oc[1] + oc[2] * oc[2] - sp->radius * sp->radius;
+    float disc = b * b - c;
+    if (disc < 0.0f) return false;
+    float tt = -b - sqrtf(disc);
+    if (!(tt > 0.0f && tt < t_max)) return false;
+    *t = tt;
+    return true;
+}
+
+static bool wbvh_bench_hit(void *ctx, uint32_t prim, float *t_max) {
+    wbvh_bench_ray *r = ctx;
+    return wbvh_bench_t(&r->spheres[prim], r->orig, r->dir, *t_max, t_max);
+}
+
+static bool wbvh_bench_any(void *ctx, uint32_t ray, uint32_t prim, float t_max) {
+    (void)ray;
+    wbvh_bench_ray *r = ctx;
+    float t;
+    return wbvh_bench_t(&r->spheres[prim], r->orig, r->dir, t_max, &t);
+}
+
+static void bench_wbvh(size_t count) {
+    v3_scene scene;
+    if (!sphere_scene(&scene, count, 61)) return;
+    float *rays = malloc(WBVH_BENCH_RAYS * 6 * sizeof(float));
+    v3_wbvh w;
+    double t0 = now_sec();
+    bool ok = rays != NULL && v3_wbvh_convert(&w, &scene.bvh);
+    double t_convert = now_sec() - t0;
+    if (!ok) {
+        fprintf(stderr, "Error: v3bench wbvh setup failed\n");
+        free(rays);
+        v3_scene_free(&scene);
+        return;
+    }
+    report_rate("wbvh convert", scene.bvh.node_count, t_convert);
+    printf("%-32s %10zu nodes  %8.2f MB\n", "wbvh binary nodes", scene.bvh.node_count,
+           scene.bvh.node_count * sizeof(v3_bvh_node) / 1e6);
+    printf("%-32s %10zu nodes  %8.2f MB\n", "wbvh wide nodes", w.node_count,
+           w.node_count * sizeof(v3_wbvh_node) / 1e6);
+
+    fill_random(rays, WBVH_BENCH_RAYS * 6, 62);
+    for (size_t i = 0; i < WBVH_BENCH_RAYS; i++) {
+        float *r = rays + 6 * i;
+        for (int k = 0; k < 3; k++) r[k] *= 100.0f;
+        v3_normalize(r + 3, r + 3);
+    }
+    const char *hit_names[2] = {"wbvh closest hit, binary", "wbvh closest hit, wide"};
+    const char *any_names[2] = {"wbvh any hit, binary", "wbvh any hit, wide"};
+    size_t hits[2] = {0, 0};
+    for (int k = 0; k < 2; k++) {
+        double best = 1e30;
+        for (int rep = 0; rep < REPS; rep++) {
+            t0 = now_sec();
+            hits[k] = 0;
+            for (size_t i = 0; i < WBVH_BENCH_RAYS; i++) {
+                float *r = rays + 6 * i, t = INFINITY;
+                wbvh_bench_ray ctx = {scene.spheres, r, r + 3};
+                hits[k] += k ? v3_wbvh_intersect(&w, r, r + 3, &t, wbvh_bench_hit, &ctx)
+                             : v3_bvh_intersect(&scene.bvh, r, r + 3, &t, wbvh_bench_hit, &ctx);
+            }
+            double t = now_sec() - t0;
+            if (t < best) best = t;
+        }
+        report_rate(hit_names[k], WBVH_BENCH_RAYS, best);
+    }
+    if (hits[0] != hits[1]) fprintf(stderr, "Error: v3bench wbvh hit counts differ\n");
+    for (int k = 0; k < 2; k++) {
+        double best = 1e30;
+        for (int rep = 0; rep < REPS; rep++) {
+            t0 = now_sec();
+            for (size_t i = 0; i < WBVH_BENCH_RAYS; i++) {
+                float *r = rays + 6 * i;
+                wbvh_bench_ray ctx = {scene.spheres, r, r + 3};
+                hits[k] += k ? v3_wbvh_occluded(&w, r, r + 3, 20.0f, wbvh_bench_any, &ctx)
+                             : v3_bvh_occluded(&scene.bvh, r, r + 3, 20.0f, wbvh_bench_any, &ctx);
+            }
+            double t = now_sec() - t0;
+            if (t < best) best = t;
+        }
+        report_rate(any_names[k], WBVH_BENCH_RAYS, best);
+    }
+    v3_wbvh_free(&w);
+    free(rays);
+    v3_scene_free(&scene);
+}
+
+// ---------- instance ----------
+// A 2048-triangle height-field patch placed 256 times with random rotations
+// about y, as one shared mesh under a top-level BVH of instances and as the
+// same triangles flattened into one BVH: memory, build time, and closest
+// hit and packet any-hit rates of rays cast down onto the field.
+#define INSTANCE_BENCH_GRID 32      // quads per side of the mesh
+#define INSTANCE_BENCH_COPIES 16    // instances per side of the field
+
+static size_t scene_bytes(const v3_scene *s) {
+    return s->tri_count * (sizeof(v3_tri_wt) + sizeof(uint32_t)) +
+           s->mesh_tri_count * (sizeof(v3_tri_wt) + 2 * sizeof(uint32_t)) +
+           s->mesh_node_count * sizeof(v3_bvh_node) + s->instance_count * sizeof(v3_instance) +
+           s->bvh.node_count * sizeof(v3_bvh_node) + s->bvh.prim_count * sizeof(uint32_t);
+}
+
+static void bench_instance(size_t count) {
+    enum { G = INSTANCE_BENCH_GRID, C = INSTANCE_BENCH_COPIES, TRIS = 2 * G * G, COPIES = C * C };
+    v3_scene inst, flat;
+    memset(&inst, 0, sizeof(inst));
+    memset(&flat, 0, sizeof(flat));
+    float *verts = malloc(TRIS * 9 * sizeof(float)), *m = malloc(COPIES * 12 * sizeof(float));
+    uint32_t *mats = calloc(TRIS, sizeof(uint32_t));
+    v3_material *mat = calloc(1, sizeof(v3_material)), *mat2 = calloc(1, sizeof(v3_material));
+    v3_ray_soa rays;
+    bool have_rays = v3_ray_soa_alloc(&rays, count);
+    float *t_max = malloc(count * sizeof(float)), *rnd = malloc(count * 4 * sizeof(float));
+    uint8_t *occluded = malloc(count);
+    flat.tris = malloc((size_t)COPIES * TRIS * sizeof(v3_tri_wt));
+    flat.tri_materials = calloc((size_t)COPIES * TRIS, sizeof(uint32_t));
+    if (verts == NULL || m == NULL || mats == NULL || mat == NULL || mat2 == NULL || !have_rays ||
+        t_max == NULL || rnd == NULL || occluded == NULL || flat.tris == NULL || flat.tri_materials == NULL) {
+        fprintf(stderr, "Error: v3bench instance allocation failed\n");
+        free(mat);
+        free(mat2);
+        goto done;
+    }
+    inst.materials = mat;
+    flat.materials = mat2;
+    inst.material_count = flat.material_count = 1;
+
+    // unit patch in x and z with gentle bumps in y, two triangles per quad
+    float *v = verts;
+    for (int i = 0; i < G; i++) {
+        for (int j = 0; j < G; j++) {
+            float x0 = (float)i / G, x1 = (float)(i + 1) / G, z0 = (float)j / G, z1 = (float)(j + 1) / G;
+            float y00 = 0.05f * sinf(20 * x0) * cosf(17 * z0), y10 = 0.05f * sinf(20 * x1) * cosf(17 * z0);
+            float y01 = 0.05f * sinf(20 * x0) * cosf(17 * z1), y11 = 0.05f * sinf(20 * x1) * cosf(17 * z1);
+            float q[18] = {x0, y00, z0, x1, y10, z0, x1, y11, z1, x0, y00, z0, x1, y11, z1, x0, y01, z1};
+            memcpy(v, q, sizeof(q));
+            v += 18;
+        }
+    }
+    fill_random(rnd, COPIES, 91);
+    for (int c = 0; c < COPIES; c++) {
+        float a = 3.14159265f * rnd[c], cs = cosf(a), sn = sinf(a);
+        float row[12] = {cs, 0, sn, 1.5f * (c % C), 0, 1, 0, 0, -sn, 0, cs, 1.5f * (c / C)};
+        memcpy(m + 12 * c, row, sizeof(row));
+    }
+
+    double t0 = now_sec();
+    bool ok = v3_scene_add_mesh(&inst, "patch", verts, mats, TRIS);
+    for (int c = 0; ok && c < COPIES; c++) ok = v3_scene_add_instance(&inst, 0, m + 12 * c);
+    ok = ok && v3_scene_build_bvh(&inst);
+    double t_inst = now_sec() - t0;
+    for (int c = 0; c < COPIES; c++) {
+        for (int i = 0; i < TRIS; i++) {
+            float p[9];
+            for (int k = 0; k < 3; k++) v3_transform_point(p + 3 * k, m + 12 * c, verts + 9 * i + 3 * k);
+            v3_tri_wt_precompute(&flat.tris[(size_t)c * TRIS + i], p, p + 3, p + 6);
+        }
+    }
+    flat.tri_count = (size_t)COPIES * TRIS;
+    t0 = now_sec();
+    ok = ok && v3_scene_build_bvh(&flat);
+    double t_flat = now_sec() - t0;
+    if (!ok) {
+        fprintf(stderr, "Error: v3bench instance scene setup failed\n");
+        goto done;
+    }
+    printf("%-32s %10zu triangles  %9.3f ms  %8.2f MB\n", "instance build, flattened", flat.tri_count,
+           t_flat * 1e3, scene_bytes(&flat) / 1e6);
+    printf("%-32s %10zu triangles  %9.3f ms  %8.2f MB\n", "instance build, instanced",
+           inst.mesh_tri_count * inst.instance_count, t_inst * 1e3, scene_bytes(&inst) / 1e6);
+
+    // rays from above onto the field, packets of 64 over one small region
+    fill_random(rnd, count * 4, 92);
+    const float span = 1.5f * C;
+    for (size_t i = 0; i < count; i++) {
+        size_t tile = i / V3_BVH_PACKET * 7919;
+        float cx = span * (float)(tile % 97) / 97.0f, cz = span * (float)(tile / 97 % 89) / 89.0f;
+        float o[3] = {cx + 0.5f * rnd[4 * i], 5.0f, cz + 0.5f * rnd[4 * i + 1]};
+        float d[3] = {0.2f * rnd[4 * i + 2], -1.0f, 0.2f * rnd[4 * i + 3]};
+        v3_normalize(d, d);
+        rays.ox[i] = o[0]; rays.oy[i] = o[1]; rays.oz[i] = o[2];
+        rays.dx[i] = d[0]; rays.dy[i] = d[1]; rays.dz[i] = d[2];
+        t_max[i] = INFINITY;
+    }
+    v3_scene *scenes[2] = {&flat, &inst};
+    const char *hit_names[2] = {"instance closest hit, flattened", "instance closest hit, instanced"};
+    const char *any_names[2] = {"instance packets, flattened", "instance packets, instanced"};
+    for (int k = 0; k < 2; k++) {
+        double best = 1e30;
+        size_t hits = 0;
+        for (int r = 0; r < REPS; r++) {
+            double t1 = now_sec();
+            hits = 0;
+            for (size_t i = 0; i < count; i++) {
+                float o[3] = {rays.ox[i], rays.oy[i], rays.oz[i]}, d[3] = {rays.dx[i], rays.dy[i], rays.dz[i]};
+                v3_hit h;
+                hits += v3_trace_intersect(scenes[k], o, d, t_max[i], &h);
+            }
+            double t = now_sec() - t1;
+            if (t < best) best = t;
+        }
+        report_rate(hit_names[k], count, best);
+        printf("%-32s %10zu of %zu rays hit\n", "", hits, count);
+    }
+    for (int k = 0; k < 2; k++) {
+        double best = 1e30;
+        for (int r = 0; r < REPS; r++) {
+            double t1 = now_sec();
+            for (size_t first = 0; first < count; first += V3_BVH_PACKET) {
+                size_t n = count - first < V3_BVH_PACKET ? count - first : V3_BVH_PACKET;
+                v3_ray_soa sub = {rays.ox + first, rays.oy + first, rays.oz + first,
+                                  rays.dx + first, rays.dy + first, rays.dz + first};
+                v3_trace_occluded_packet(scenes[k], &sub, t_max + first, n, occluded + first);
+            }
+            double t = now_sec() - t1;
+            if (t < best) best = t;
+        }
+        report_rate(any_names[k], count, best);
+    }
+
+done:
+    if (have_rays) v3_ray_soa_free(&rays);
+    free(verts);
+    free(m);
+    free(mats);
+    free(t_max);
+    free(rnd);
+    free(occluded);
+    v3_scene_free(&inst);
+    v3_scene_free(&flat);
+}
+
+// ---------- expr ----------
+// Two chains as one v3batch call per stage (every stage streams a full
+// temporary through memory) and as one fused v3_expr pass. Bandwidth is
+// what the unfused calls move, so the fused rate shows the traffic saved.
+//   short: normalize(cross(a, b)) * 0.5 + c                       4 stages
+//   long:  normalize(reflect(c, normalize(cross(a, b))) * 0.5 + a - b)  7 stages
+static void bench_expr(size_t count) {
+    float *a = malloc(count * 3 * sizeof(float));
+    float *b = malloc(count * 3 * sizeof(float));
+    float *c = malloc(count * 3 * sizeof(float));
+    float *t = malloc(count * 3 * sizeof(float));
+    float *out = malloc(count * 3 * sizeof(float));
+    v3_expr *e = v3_expr_create();
+    if (a == NULL || b == NULL || c == NULL || t == NULL || out == NULL || e == NULL) {
+        fprintf(stderr, "Error: v3bench expr allocation failed\n");
+        free(a);
+        free(b);
+        free(c);
+        free(t);
+        free(out);
+        v3_expr_destroy(e);
+        return;
+    }
+    fill_random(a, 3 * count, 5);
+    fill_random(b, 3 * count, 6);
+    fill_random(c, 3 * count, 7);
+    v3_pool *pool = v3_pool_default();
+
+    double best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        v3_cross_product_n(t, a, b, count);
+        v3_normalize_n(t, t, count);
+        v3_scale_n(t, t, 0.5f, count);
+        v3_add_n(out, t, c, count);
+        double dt = now_sec() - t0;
+        if (dt < best) best = dt;
+    }
+    report("short chain v3batch calls", count, 120, best);
+
+    v3_expr_id n = v3_expr_normalize(e, v3_expr_cross_product(e, v3_expr_vectors(e, a),
+                                                             v3_expr_vectors(e, b)));
+    v3_expr_output(e, v3_expr_add(e, v3_expr_scale(e, n, 0.5f), v3_expr_vectors(e, c)), out);
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        v3_expr_run(e, count, pool);
+        double dt = now_sec() - t0;
+        if (dt < best) best = dt;
+    }
+    report("short chain v3_expr fused", count, 120, best);
+
+    best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        v3_cross_product_n(t, a, b, count);
+        v3_normalize_n(t, t, count);
+        v3_reflect_n(t, c, t, count);
+        v3_scale_n(t, t, 0.5f, count);
+        v3_add_n(t, t, a, count);
+        v3_subtract_n(t, t, b, count);
+        v3_normalize_n(out, t, count);
+        double dt = now_sec() - t0;
+        if (dt < best) best = dt;
+    }
+    report("long chain v3batch calls", count, 216, best);
+
+    v3_expr_clear(e);
+    v3_expr_id va = v3_expr_vectors(e, a), vb = v3_expr_vectors(e, b);
+    n = v3_expr_normalize(e, v3_expr_cross_product(e, va, vb));
+    v3_expr_id r = v3_expr_reflect(e, v3_expr_vectors(e, c), n);
+    v3_expr_id sum = v3_expr_subtract(e, v3_expr_add(e, v3_expr_scale(e, r, 0.5f), va), vb);
+    v3_expr_output(e, v3_expr_normalize(e, sum), out);
+    best = 1e30;
+    for (int k = 0; k < REPS; k++) {
+        double t0 = now_sec();
+        v3_expr_run(e, count, pool);
+        double dt = now_sec() - t0;
+        if (dt < best) best = dt;
+    }
+    report("long chain v3_expr fused", count, 216, best);
+    printf("%-32s %10zu buffers for %zu nodes\n", "long chain temporaries",
+           v3_expr_temporaries(e), (size_t)11);
+
+    v3_expr_destroy(e);
+    free(a);
+    free(b);
+    free(c);
+    free(t);
+    free(out);
+}
+
+// ---------- latency ----------
+// Per-call latency of every batched kernel on count vectors, and of the ray
+// tracing paths, while all pool threads call the kernel at once on their own
+// buffers. Every thread records into its own histogram of a v3_hist_group.
+#define LATENCY_CALLS 512
+
+typedef enum {
+    LAT_ADD,
+    LAT_SUBTRACT,
+    LAT_SCALE,
+    LAT_DOT,
+    LAT_CROSS,
+    LAT_LENGTH,
+    LAT_NORMALIZE,
+    LAT_REFLECT,
+    LAT_DOT_INDEXED,
+    LAT_SUB_INDEXED,
+    LAT_ANY_CHANGED,
+    LAT_COUNT_CHANGED,
+    LAT_CHANGED_INDICES,
+    LAT_EXPR,
+    LAT_ASYNC,
+    LAT_RAYGEN,
+    LAT_INTERSECT,
+    LAT_KERNELS
+} lat_kernel;
+
+static const char *const k_lat_names[LAT_KERNELS] = {
+    "v3_add_n",          "v3_subtract_n",        "v3_scale_n",          "v3_dot_product_n",
+    "v3_cross_product_n", "v3_length_n",         "v3_normalize_n",      "v3_reflect_n",
+    "v3_dot_indexed_n",  "v3_sub_indexed_n",     "v3_any_changed_n",    "v3_count_changed_n",
+    "v3_changed_indices_n", "v3_expr_run",       "v3_queue add",        "v3_raygen_tile 16x16",
+    "v3_trace_intersect x64",
+};
+
+// one thread's buffers
+typedef struct {
+    float *a, *b, *prev, *dst, *scalars;   // 3 * count floats, scalars count
+    uint32_t *idx_a, *idx_b, *changed;
+    v3_expr *expr;
+    v3_ray_soa rays;                       // one tile
+} lat_buffers;
+
+typedef struct {
+    lat_kernel kernel;
+    size_t count;
+    lat_buffers *bufs;        // [1 + worker]
+    v3_hist_group *hist;
+    v3_pool *pool;
+    v3_queue *queue;
+    v3_raygen *rg;
+    v3_scene *scene;
+    const v3_query_ray *rays; // LATENCY_CALLS * 64
+} lat_ctx;
+
+static void lat_call(lat_ctx *c, lat_buffers *b, size_t call) {
+    size_t n = c->count;
+    switch (c->kernel) {
+    case LAT_ADD: v3_add_n(b->dst, b->a, b->b, n); break;
+    case LAT_SUBTRACT: v3_subtract_n(b->dst, b->a, b->b, n); break;
+    case LAT_SCALE: v3_scale_n(b->dst, b->a, 0.5f, n); break;
+    case LAT_DOT: v3_dot_product_n(b->scalars, b->a, b->b, n); break;
+    case LAT_CROSS: v3_cross_product_n(b->dst, b->a, b->b, n); break;
+    case LAT_LENGTH: v3_length_n(b->scalars, b->a, n); break;
+    case LAT_NORMALIZE: v3_normalize_n(b->dst, b->a, n); break;
+    case LAT_REFLECT: v3_reflect_n(b->dst, b->a, b->b, n); break;
+    case LAT_DOT_INDEXED: v3_dot_indexed_n(b->scalars, b->a, b->idx_a, b->b, b->idx_b, n); break;
+    case LAT_SUB_INDEXED: v3_sub_indexed_n(b->dst, b->a, b->idx_a, b->b, b->idx_b, n); break;
+    case LAT_ANY_CHANGED: v3_any_changed_n(b->a, b->a, 1e-6f, n); break;   // unchanged: full scan
+    case LAT_COUNT_CHANGED: v3_count_changed_n(b->a, b->prev, 1e-6f, n); break;
+    case LAT_CHANGED_INDICES: v3_changed_indices_n(b->changed, b->a, b->prev, 1e-6f, n); break;
+    case LAT_EXPR: v3_expr_run(b->expr, n, c->pool); break;
+    case LAT_ASYNC: {
+        v3_job job = {V3_OP_ADD, b->dst, b->a, b->b, 0.0f, n};
+        v3_future *f = v3_queue_submit(c->queue, &job);
+        if (f != NULL) {
+            v3_future_wait(f);
+            v3_future_release(f);
+        }
+        break;
+    }
+    case LAT_RAYGEN:
+        v3_raygen_tile(c->rg, (int)(call % 16) * V3_TRACE_TILE, (int)(call / 16 % 16) * V3_TRACE_TILE,
+                       V3_TRACE_TILE, V3_TRACE_TILE, 0, &b->rays);
+        break;
+    case LAT_INTERSECT:
+        for (size_t i = 64 * call; i < 64 * call + 64; i++) {
+            v3_query_ray r = c->rays[i];
+            v3_hit h;
+            v3_trace_intersect(c->scene, r.orig, r.dir, r.t_max, &h);
+        }
+        break;
+    default: break;
+    }
+}
+
+static void lat_range(void *arg, size_t begin, size_t end) {
+    lat_ctx *c = arg;
+    lat_buffers *b = &c->bufs[v3_pool_current_worker(c->pool) + 1];
+    v3_hist *h = v3_hist_group_local(c->hist);
+    for (size_t i = begin; i < end; i++) {
+        uint64_t t0 = v3_hist_now_ns();
+        lat_call(c, b, i);
+        v3_hist_record(h, v3_hist_now_ns() - t0);
+    }
+}
+
+static bool lat_buffers_init(lat_buffers *b, size_t count, unsigned seed) {
+    memset(b, 0, sizeof(*b));
+    b->a = malloc(count * 3 * sizeof(float));
+    b->b = malloc(count * 3 * sizeof(float));
+    b->prev = malloc(count * 3 * sizeof(float));
+    b->dst = malloc(count * 3 * sizeof(float));
+    b->scalars = malloc(count * sizeof(float));
+    b->idx_a = malloc(count * sizeof(uint32_t));
+    b->idx_b = malloc(count * sizeof(uint32_t));
+    b->changed = malloc(count * sizeof(uint32_t));
+    b->expr = v3_expr_create();
+    if (b->a == NULL || b->b == NULL || b->prev == NULL || b->dst == NULL || b->scalars == NULL ||
+        b->idx_a == NULL || b->idx_b == NULL || b->changed == NULL || b->expr == NULL ||
+        !v3_ray_soa_alloc(&b->rays, V3_TRACE_TILE * V3_TRACE_TILE)) {
+        return false;
+    }
+    fill_random(b->a, 3 * count, seed);
+    fill_random(b->b, 3 * count, seed + 1);
+    // 1% of the vectors changed since prev
+    memcpy(b->prev, b->a, count * 3 * sizeof(float));
+    for (size_t i = 0; i < count; i += 100) b->prev[3 * i] += 1.0f;
+    unsigned state = seed;
+    for (size_t i = 0; i < count; i++) {
+        state = state * 1664525u + 1013904223u;
+        b->idx_a[i] = (uint32_t)((state >> 8) % count);
+        b->idx_b[i] = (uint32_t)(count - 1 - i);
+    }
+    v3_expr_id n = v3_expr_normalize(b->expr, v3_expr_cross_product(b->expr, v3_expr_vectors(b->expr, b->a),
+                                                                   v3_expr_vectors(b->expr, b->b)));
+    v3_expr_output(b->expr, v3_expr_add(b->expr, v3_expr_scale(b->expr, n, 0.5f), v3_expr_vectors(b->expr, b->a)),
+                   b->dst);
+    return true;
+}
+
+static void lat_buffers_free(lat_buffers *b) {
+    free(b->a);
+    free(b->b);
+    free(b->prev);
+    free(b->dst);
+    free(b->scalars);
+    free(b->idx_a);
+    free(b->idx_b);
+    free(b->changed);
+    v3_expr_destroy(b->expr);
+    v3_ray_soa_free(&b->rays);
+}
+
+static void bench_latency(size_t count) {
+    v3_pool *pool = v3_pool_default();
+    unsigned slots = v3_pool_size(pool) + 1;
+    lat_buffers *bufs = calloc(slots, sizeof(lat_buffers));
+    v3_query_ray *rays = malloc(64 * LATENCY_CALLS * sizeof(v3_query_ray));
+    float *rnd = malloc(64 * LATENCY_CALLS * 6 * sizeof(float));
+    v3_queue *queue = v3_queue_create(pool);
+    v3_hist_group group;
+    v3_hist total;
+    v3_scene spheres, scene;
+    bool have_spheres = false, have_scene = false, ok = bufs && rays && rnd && queue;
+    for (unsigned i = 0; ok && i < slots; i++) ok = lat_buffers_init(&bufs[i], count, 70 + 2 * i);
+    if (ok) ok = v3_hist_group_init(&group, pool);
+    if (ok && !v3_hist_init(&total)) {
+        v3_hist_group_free(&group);
+        ok = false;
+    }
+    if (ok) ok = have_spheres = sphere_scene(&spheres, 16384, 69);
+    FILE *f = ok ? tmpfile() : NULL;
+    if (f != NULL) {
+        fprintf(f, "image 256 256\ndepth 4\nsamples 4\n%s", k_progressive_scene);
+        rewind(f);
+        have_scene = v3_scene_parse(&scene, f, "latency");
+        fclose(f);
+    }
+    v3_raygen rg;
+    if (!ok || !have_scene || !v3_raygen_init(&rg, &scene.camera, scene.width, scene.height)) {
+        fprintf(stderr, "Error: v3bench latency setup failed\n");
+        if (ok) {
+            v3_hist_free(&total);
+            v3_hist_group_free(&group);
+        }
+        ok = false;
+    }
+
+    if (ok) {
+        fill_random(rnd, 64 * LATENCY_CALLS * 6, 69);
+        for (size_t i = 0; i < 64 * LATENCY_CALLS; i++) {
+            for (int k = 0; k < 3; k++) {
+                rays[i].orig[k] = rnd[6 * i + k] * 100.0f;
+                rays[i].dir[k] = rnd[6 * i + 3 + k];
+            }
+            rays[i].t_max = 5.0f;
+        }
+        lat_ctx c = {.count = count, .bufs = bufs, .hist = &group, .pool = pool, .queue = queue,
+                     .rg = &rg, .scene = &spheres, .rays = rays};
+        for (int k = 0; k < LAT_KERNELS; k++) {
+            c.kernel = (lat_kernel)k;
+            v3_hist_group_reset(&group);
+            v3_hist_reset(&total);
+            // the async queue is driven from this thread only: its jobs run on the pool
+            if (c.kernel == LAT_ASYNC) {
+                lat_range(&c, 0, LATENCY_CALLS);
+            } else {
+                v3_pool_parallel_for(pool, LATENCY_CALLS, 1, lat_range, &c);
+            }
+            v3_hist_group_merge(&total, &group);
+            report_latency(k_lat_names[k], &total);
+        }
+
+        // rendered tiles: 256 of them per frame, four samples per pixel
+        float *rgb = malloc((size_t)scene.width * scene.height * 3 * sizeof(float));
+        v3_hist_group_reset(&group);
+        v3_hist_reset(&total);
+        for (int frame = 0; rgb != NULL && frame < 4; frame++) {
+            v3_trace_render_timed(&scene, pool, rgb, NULL, &group);
+        }
+        v3_hist_group_merge(&total, &group);
+        report_latency("v3_trace_render tile", &total);
+        free(rgb);
+        v3_hist_free(&total);
+        v3_hist_group_free(&group);
+    }
+    if (have_scene) v3_scene_free(&scene);
+    if (have_spheres) v3_scene_free(&spheres);
+    for (unsigned i = 0; bufs != NULL && i < slots; i++) lat_buffers_free(&bufs[i]);
+    free(bufs);
+    free(rays);
+    free(rnd);
+    v3_queue_destroy(queue);
+}
+
+// ---------- roofline ----------
+// Where the batched kernels sit against this machine's measured peaks: copy
+// bandwidth over count vectors (memcpy, read plus write) and single-core SSE
+// multiply-add throughput from registers. Each kernel's arithmetic intensity
+// uses nominal flops per vector (a sqrt or division counts as one) and the
+// bytes read and written once, as in report(). Rows give the attainable
+// roof min(peak flops, intensity * bandwidth), the achieved fraction of it
+// at count vectors and in cache (4096 vectors), and the bound. With --perf,
+// counters per vector follow each row, from the memory-resident runs.
+#define ROOF_CACHED 4096
+
+typedef enum {
+    ROOF_ADD,
+    ROOF_SUBTRACT,
+    ROOF_SCALE,
+    ROOF_DOT,
+    ROOF_CROSS,
+    ROOF_LENGTH,
+    ROOF_NORMALIZE,
+    ROOF_REFLECT,
+    ROOF_DOT_INDEXED,
+    ROOF_COUNT_CHANGED,
+    ROOF_KERNELS
+} roof_kernel;
+
+static const struct {
+    const char *name;
+    double flops, bytes;   // per vector
+} k_roof[ROOF_KERNELS] = {
+    {"v3_add_n", 3, 36},
+    {"v3_subtract_n", 3, 36},
+    {"v3_scale_n", 3, 24},
+    {"v3_dot_product_n", 5, 28},
+    {"v3_cross_product_n", 9, 36},
+    {"v3_length_n", 6, 16},
+    {"v3_normalize_n", 9, 24},
+    {"v3_reflect_n", 18, 36},
+    {"v3_dot_indexed_n", 5, 36},         // two gathers, two indices, one result
+    {"v3_count_changed_n", 9, 24},      // subtract, abs and compare per component
+};
+
+static void roof_run(roof_kernel k, float *dst, float *a, float *b, uint32_t *ia, uint32_t *ib, size_t n) {
+    switch (k) {
+    case ROOF_ADD: v3_add_n(dst, a, b, n); break;
+    case ROOF_SUBTRACT: v3_subtract_n(dst, a, b, n); break;
+    case ROOF_SCALE: v3_scale_n(dst, a, 0.5f, n); break;
+    case ROOF_DOT: v3_dot_product_n(dst, a, b, n); break;
+    case ROOF_CROSS: v3_cross_product_n(dst, a, b, n); break;
+    case ROOF_LENGTH: v3_length_n(dst, a, n); break;
+    case ROOF_NORMALIZE: v3_normalize_n(dst, a, n); break;
+    case ROOF_REFLECT: v3_reflect_n(dst, a, b, n); break;
+    case ROOF_DOT_INDEXED: v3_dot_indexed_n(dst, a, ia, b, ib, n); break;
+    case ROOF_COUNT_CHANGED: v3_count_changed_n(a, b, 1e-6f, n); break;
+    default: break;
+    }
+}
+
+// best time of one call on n vectors; reps calls per timing so that small
+// cached runs are long enough to time
+static double roof_time(roof_kernel k, float *dst, float *a, float *b, uint32_t *ia, uint32_t *ib, size_t n,
+                        int reps) {
+    double best = 1e30;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        for (int i = 0; i < reps; i++) roof_run(k, dst, a, b, ia, ib, n);
+        double t = (now_sec() - t0) / reps;
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+// Peak multiply-add rate of one core: 8 independent accumulators hide the
+// latency of the adds.
+static double peak_flops(void) {
+    const long iters = 1L << 24;
+    double best = 0.0;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+#ifdef __SSE__
+        __m128 acc[8], m = _mm_set1_ps(0.999999f), c = _mm_set1_ps(1e-7f);
+        for (int i = 0; i < 8; i++) acc[i] = _mm_set1_ps((float)i);
+        for (long i = 0; i < iters; i++) {
+            for (int j = 0; j < 8; j++) acc[j] = _mm_add_ps(_mm_mul_ps(acc[j], m), c);
+        }
+        for (int j = 1; j < 8; j++) acc[0] = _mm_add_ps(acc[0], acc[j]);
+        float sink[4];
+        _mm_storeu_ps(sink, acc[0]);
+        const double flops = (double)iters * 8 * 4 * 2;
+#else
+        float acc[8], sink[1];
+        for (int i = 0; i < 8; i++) acc[i] = (float)i;
+        for (long i = 0; i < iters; i++) {
+            for (int j = 0; j < 8; j++) acc[j] = acc[j] * 0.999999f + 1e-7f;
+        }
+        sink[0] = acc[0] + acc[1] + acc[2] + acc[3] + acc[4] + acc[5] + acc[6] + acc[7];
+        const double flops = (double)iters * 8 * 2;
+#endif
+        double t = now_sec() - t0;
+        if (sink[0] == 12345.0f) printf(" ");   // keep the loop
+        if (flops / t > best) best = flops / t;
+    }
+    return best;
+}
+
+static void bench_roofline(size_t count) {
+    size_t big = count, small = count < ROOF_CACHED ? count : ROOF_CACHED;
+    float *a = malloc(big * 3 * sizeof(float));
+    float *b = malloc(big * 3 * sizeof(float));
+    float *dst = malloc(big * 3 * sizeof(float));
+    uint32_t *ia = malloc(big * sizeof(uint32_t));
+    uint32_t *ib = malloc(big * sizeof(uint32_t));
+    uint32_t *ia_small = malloc(small * sizeof(uint32_t));
+    if (a == NULL || b == NULL || dst == NULL || ia == NULL || ib == NULL || ia_small == NULL) {
+        fprintf(stderr, "Error: v3bench roofline allocation failed\n");
+        free(a);
+        free(b);
+        free(dst);
+        free(ia);
+        free(ib);
+        free(ia_small);
+        return;
+    }
+    fill_random(a, 3 * big, 71);
+    fill_random(b, 3 * big, 72);
+    memset(dst, 0, big * 3 * sizeof(float));
+    unsigned state = 71;
+    for (size_t i = 0; i < big; i++) {
+        state = state * 1664525u + 1013904223u;
+        ia[i] = (uint32_t)((state >> 8) % big);
+        ib[i] = (uint32_t)i;
+    }
+    // cached runs gather from the first small vectors only
+    for (size_t i = 0; i < small; i++) ia_small[i] = ia[i] % (uint32_t)small;
+
+    double bw = 0.0;
+    for (int r = 0; r < REPS; r++) {
+        double t0 = now_sec();
+        memcpy(dst, a, big * 3 * sizeof(float));
+        double t = now_sec() - t0;
+        if (2.0 * (double)big * 12 / t > bw) bw = 2.0 * (double)big * 12 / t;
+    }
+    double peak = peak_flops();
+    double ridge = peak / bw;
+    printf("roofline peaks: copy %.2f GB/s, SSE mul+add %.2f GFLOP/s (1 core), ridge %.2f flop/byte\n", bw * 1e-9,
+           peak * 1e-9, ridge);
+
+    const char *reason = NULL;
+    bool counting = g_perf != NULL && v3_perf_available(g_perf, &reason);
+    if (g_perf != NULL && !counting) printf("perf counters unavailable: %s\n", reason);
+
+    printf("%-20s %6s %9s %9s %7s %9s %7s  %s\n", "kernel", "flop/B", "roof", "memory", "of roof", "cached",
+           "of peak", "bound");
+    for (int k = 0; k < ROOF_KERNELS; k++) {
+        double intensity = k_roof[k].flops / k_roof[k].bytes;
+        double roof = intensity * bw < peak ? intensity * bw : peak;
+        double t_big = roof_time((roof_kernel)k, dst, a, b, ia, ib, big, 1);
+        int reps = (int)(big / small < 1000 ? big / small : 1000);
+        if (reps < 1) reps = 1;
+        double t_small = roof_time((roof_kernel)k, dst, a, b, ia_small, ib, small, reps);
+        double gf_big = k_roof[k].flops * (double)big / t_big, gf_small = k_roof[k].flops * (double)small / t_small;
+        printf("%-20s %6.3f %6.2f GF %6.2f GF %6.1f%% %6.2f GF %6.1f%%  %s\n", k_roof[k].name, intensity,
+               roof * 1e-9, gf_big * 1e-9, gf_big / roof * 100.0, gf_small * 1e-9, gf_small / peak * 100.0,
+               intensity < ridge ? "memory" : "compute");
+        if (!counting) continue;
+        v3_perf_counts c;
+        v3_perf_start(g_perf);
+        roof_run((roof_kernel)k, dst, a, b, ia, ib, big);
+        v3_perf_stop(g_perf, &c);
+        double per = 1.0 / (double)big;
+        printf("%-20s ipc %.2f  insn/vec %.2f  llc miss/vec %.3f  branch miss %.2f%%", "",
+               c.cycles ? (double)c.instructions / (double)c.cycles : 0.0, (double)c.instructions * per,
+               (double)c.cache_misses * per, c.branches ? (double)c.branch_misses / (double)c.branches * 100.0 : 0.0);
+        if (c.fp) {
+            printf("  vector/vec %.2f  scalar/vec %.2f  flop/vec %.2f",
+                   (double)(c.fp_128 + c.fp_256 + c.fp_512) * per, (double)c.fp_scalar * per,
+                   v3_perf_flops(&c) * per);
+        }
+        printf("\n");
+    }
+    free(a);
+    free(b);
+    free(dst);
+    free(ia);
+    free(ib);
+    free(ia_small);
+}
+
+// ---------- run comparison ----------
+// Reading back --json / --csv output for --compare.
+typedef struct {
+    char name[64];
+    double p50, p99;
+} lat_entry;
+
+// value of "key": in a JSON object line, or NAN
+static double json_number(const char *line, const char *key) {
+    const char *p = strstr(line, key);
+    return p ? strtod(p + strlen(key), NULL) : NAN;
+}
+
+static lat_entry *load_latencies(const char *path, size_t *count) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Error: cannot open %s\n", path);
+        return NULL;
+    }
+    lat_entry *list = NULL;
+    size_t n = 0, cap = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lat_entry e;
+        memset(&e, 0, sizeof(e));
+        const char *name = strstr(line, "{\"name\": \"");
+        if (name != NULL) {
+            name += strlen("{\"name\": \"");
+            const char *end = strchr(name, '"');
+            if (end == NULL || (size_t)(end - name) >= sizeof(e.name)) continue;
+            memcpy(e.name, name, (size_t)(end - name));
+            e.p50 = json_number(end, "\"p50_ns\": ");
+            e.p99 = json_number(end, "\"p99_ns\": ");
+        } else {
+            // CSV: name,count,min_ns,mean_ns,p50_ns,p90_ns,p99_ns,...
+            unsigned long long cnt, min;
+            double mean, p90;
+            if (sscanf(line, "%63[^,],%llu,%llu,%lf,%lf,%lf,%lf", e.name, &cnt, &min, &mean, &e.p50, &p90,
+                       &e.p99) != 7) {
+                continue;
+            }
+        }
+        if (isnan(e.p50) || isnan(e.p99)) continue;
+        if (n == cap) {
+            cap = cap ? 2 * cap : 32;
+            lat_entry *grown = realloc(list, cap * sizeof(lat_entry));
+            if (grown == NULL) break;
+            list = grown;
+        }
+        list[n++] = e;
+    }
+    fclose(f);
+    *count = n;
+    if (n == 0) fprintf(stderr, "Error: no latency entries in %s\n", path);
+    return list;
+}
+
+static double change_pct(double base, double now) {
+    return base > 0.0 ? (now - base) / base * 100.0 : 0.0;
+}
+
+static int compare_runs(const char *base_path, const char *new_path, double threshold) {
+    size_t nb = 0, nn = 0;
+    lat_entry *base = load_latencies(base_path, &nb);
+    lat_entry *now = load_latencies(new_path, &nn);
+    if (nb == 0 || nn == 0) {
+        free(base);
+        free(now);
+        return 2;
+    }
+    int regressions = 0;
+    printf("%-32s %11s %11s %8s %11s %11s %8s\n", "name", "base p50", "new p50", "change", "base p99",
+           "new p99", "change");
+    for (size_t i = 0; i < nn; i++) {
+        const lat_entry *b = NULL;
+        for (size_t j = 0; j < nb && b == NULL; j++) {
+            if (strcmp(base[j].name, now[i].name) == 0) b = &base[j];
+        }
+        if (b == NULL) {
+            printf("%-32s only in %s\n", now[i].name, new_path);
+            continue;
+        }
+        double d50 = change_pct(b->p50, now[i].p50), d99 = change_pct(b->p99, now[i].p99);
+        bool worse = d50 > threshold || d99 > threshold;
+        regressions += worse;
+        printf("%-32s %8.2f us %8.2f us %+7.1f%% %8.2f us %8.2f us %+7.1f%%%s\n", now[i].name, b->p50 * 1e-3,
+               now[i].p50 * 1e-3, d50, b->p99 * 1e-3, now[i].p99 * 1e-3, d99, worse ? "  REGRESSION" : "");
+    }
+    for (size_t j = 0; j < nb; j++) {
+        bool found = false;
+        for (size_t i = 0; i < nn && !found; i++) found = strcmp(base[j].name, now[i].name) == 0;
+        if (!found) printf("%-32s only in %s\n", base[j].name, base_path);
+    }
+    printf("%d regression%s over %.1f%%\n", regressions, regressions == 1 ? "" : "s", threshold);
+    free(base);
+    free(now);
+    return regressions ? 1 : 0;
+}
+
+static const bench_entry g_benches[] = {
+    {"numa", bench_numa, 1u << 23},
+    {"stream", bench_stream, 1u << 24},
+    {"indexed", bench_indexed, 1u << 23},
+    {"tri", bench_tri, 1u << 12},
+    {"bvh", bench_bvh, 1u << 20},
+    {"wbvh", bench_wbvh, 1u << 20},
+    {"camera", bench_camera, 1u << 22},
+    {"refract", bench_refract, 1u << 22},
+    {"sdf", bench_sdf, 1u << 16},
+    {"scene", bench_scene, 1u << 18},
+    {"image", bench_image, 1u << 22},
+    {"progressive", bench_progressive, 1u << 14},
+    {"expr", bench_expr, 1u << 22},
+    {"compare", bench_compare, 10000000},
+    {"dirty", bench_dirty, 1u << 20},
+    {"rcu", bench_rcu, 1u << 16},
+    {"serve", bench_serve, 1u << 18},
+    {"shadow", bench_shadow, 1u << 18},
+    {"instance", bench_instance, 1u << 16},
+    {"latency", bench_latency, 4096},
+    {"roofline", bench_roofline, 1u << 22},
+};
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--compare") == 0) {
+        if (argc < 4 || argc > 5) {
+            fprintf(stderr, "usage: %s --compare BASE NEW [percent]\n", argv[0]);
+            return 2;
+        }
+        return compare_runs(argv[2], argv[3], argc > 4 ? strtod(argv[4], NULL) : 10.0);
+    }
+    int arg = 1;
+    while (arg < argc && strncmp(argv[arg], "--", 2) == 0) {
+        if (strcmp(argv[arg], "--perf") == 0) {
+            if (g_perf == NULL) g_perf = v3_perf_open();
+            arg++;
+            continue;
+        }
+        if (arg + 1 >= argc || (strcmp(argv[arg], "--json") != 0 && strcmp(argv[arg], "--csv") != 0)) {
+            fprintf(stderr, "Error: unknown option '%s'\n", argv[arg]);
+            return 2;
+        }
+        FILE **out = argv[arg][2] == 'j' ? &g_json : &g_csv;
+        if (*out != NULL) fclose(*out);
+        *out = fopen(argv[arg + 1], "w");
+        if (*out == NULL) {
+            fprintf(stderr, "Error: cannot write %s\n", argv[arg + 1]);
+            return 1;
+        }
+        arg += 2;
+    }
+    const char *only = argc > arg ? argv[arg] : NULL;
+    size_t count = argc > arg + 1 ? (size_t)strtoull(argv[arg + 1], NULL, 10) : 0;
+    bool found = false;
+    if (g_json) fprintf(g_json, "{\"unit\": \"ns\", \"benchmarks\": [\n");
+    if (g_csv) v3_hist_write_csv_header(g_csv);
+
+    for (size_t i = 0; i < sizeof(g_benches) / sizeof(g_benches[0]); i++) {
+        if (only != NULL && strcmp(only, g_benches[i].name) != 0) continue;
+        found = true;
+        g_benches[i].run(count > 0 ? count : g_benches[i].default_count);
+    }
+    if (g_json) {
+        fprintf(g_json, "\n]}\n");
+        fclose(g_json);
+    }
+    if (g_csv) fclose(g_csv);
+    v3_perf_close(g_perf);
+    if (!found) {
+        fprintf(stderr, "Error: unknown benchmark '%s'\n", only);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,1202 @@
+#include "v3bvh.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define V3_BVH_BINS 12
+#define V3_BVH_LEAF_MIN 2    // never split nodes at or below this size
+#define V3_BVH_LEAF_MAX 16   // force a split above this size even if SAH prefers a leaf
+// A depth-first walk holds at most one pending sibling per level plus the
+// two children just pushed; a wide walk at most seven per level plus eight.
+#define V3_BVH_STACK (V3_BVH_MAX_DEPTH + 1)
+#define V3_WBVH_STACK (7 * V3_BVH_MAX_DEPTH + 1)
+#define V3_BVH_NONE UINT32_MAX
+#define V3_BVH_HOLE (UINT32_MAX - 1)   // refitter parent of a slot a rebuild freed
+
+// v3_bvh_refit splits the top of larger trees into about this many subtrees
+#define V3_BVH_REFIT_TASKS 64
+#define V3_BVH_REFIT_SERIAL 4096   // node count below which refits stay serial
+
+// SAH cost of visiting a node relative to one primitive test
+#define V3_BVH_TRAVERSAL_COST 1.0f
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+void v3_aabb_empty(v3_aabb *box) {
+    for (int k = 0; k < 3; k++) {
+        box->min[k] = INFINITY;
+        box->max[k] = -INFINITY;
+    }
+}
+
+void v3_aabb_grow_point(v3_aabb *box, float *p) {
+    for (int k = 0; k < 3; k++) {
+        box->min[k] = fminf(box->min[k], p[k]);
+        box->max[k] = fmaxf(box->max[k], p[k]);
+    }
+}
+
+void v3_aabb_grow_box(v3_aabb *box, v3_aabb *other) {
+    for (int k = 0; k < 3; k++) {
+        box->min[k] = fminf(box->min[k], other->min[k]);
+        box->max[k] = fmaxf(box->max[k], other->max[k]);
+    }
+}
+
+static float aabb_area(const v3_aabb *box) {
+    float dx = box->max[0] - box->min[0];
+    float dy = box->max[1] - box->min[1];
+    float dz = box->max[2] - box->min[2];
+    if (dx < 0.0f || dy < 0.0f || dz < 0.0f) return 0.0f;  // empty
+    return 2.0f * (dx*dy + dy*dz + dz*dx);
+}
+
+// ---------- build ----------
+typedef struct {
+    v3_aabb *boxes;
+    uint32_t *prims;
+    v3_bvh_node *nodes;
+    size_t node_count;
+    size_t node_limit;  // nodes[node_count .. node_limit) are free
+} build_ctx;
+
+typedef struct {
+    v3_aabb box;
+    uint32_t count;
+} bin;
+
+static void set_node_bounds(v3_bvh_node *node, const v3_aabb *box) {
+    memcpy(node->bmin, box->min, sizeof(node->bmin));
+    memcpy(node->bmax, box->max, sizeof(node->bmax));
+}
+
+static float centroid(const v3_aabb *box, int axis) {
+    return 0.5f * (box->min[axis] + box->max[axis]);
+}
+
+static void make_leaf(build_ctx *ctx, uint32_t node, uint32_t first, uint32_t count) {
+    ctx->nodes[node].first = first;
+    ctx->nodes[node].count = count;
+}
+
+static void build_rec(build_ctx *ctx, uint32_t node, uint32_t first, uint32_t count, int depth) {
+    v3_aabb bounds, cbounds;
+    v3_aabb_empty(&bounds);
+    v3_aabb_empty(&cbounds);
+    for (uint32_t i = first; i < first + count; i++) {
+        uint32_t p = ctx->prims[i];
+        v3_aabb *box = &ctx->boxes[p];
+        float c[3] = {centroid(box, 0), centroid(box, 1), centroid(box, 2)};
+        v3_aabb_grow_box(&bounds, box);
+        v3_aabb_grow_point(&cbounds, c);
+    }
+    set_node_bounds(&ctx->nodes[node], &bounds);
+
+    // a subtree rebuilt in place may run out of node slots
+    if (count <= V3_BVH_LEAF_MIN || ctx->node_count + 2 > ctx->node_limit || depth >= V3_BVH_MAX_DEPTH) {
+        make_leaf(ctx, node, first, count);
+        return;
+    }
+
+    // evaluate binned SAH on every axis
+    float best_cost = INFINITY;
+    int best_axis = -1, best_split = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = cbounds.min[axis], extent = cbounds.max[axis] - lo;
+        if (!(extent > 0.0f)) continue;
+        float scale = V3_BVH_BINS / extent;
+
+        bin bins[V3_BVH_BINS];
+        for (int b = 0; b < V3_BVH_BINS; b++) {
+            v3_aabb_empty(&bins[b].box);
+            bins[b].count = 0;
+        }
+        for (uint32_t i = first; i < first + count; i++) {
+            uint32_t p = ctx->prims[i];
+            int b = (int)((centroid(&ctx->boxes[p], axis) - lo) * scale);
+            if (b >= V3_BVH_BINS) b = V3_BVH_BINS - 1;
+            bins[b].count++;
+            v3_aabb_grow_box(&bins[b].box, &ctx->boxes[p]);
+        }
+
+        // sweep from the right, then from the left
+        float right_area[V3_BVH_BINS];
+        uint32_t right_count[V3_BVH_BINS];
+        v3_aabb acc;
+        v3_aabb_empty(&acc);
+        uint32_t n = 0;
+        for (int b = V3_BVH_BINS - 1; b > 0; b--) {
+            v3_aabb_grow_box(&acc, &bins[b].box);
+            n += bins[b].count;
+            right_area[b] = aabb_area(&acc);
+            right_count[b] = n;
+        }
+        v3_aabb_empty(&acc);
+        n = 0;
+        for (int b = 0; b < V3_BVH_BINS - 1; b++) {
+            v3_aabb_grow_box(&acc, &bins[b].box);
+            n += bins[b].count;
+            if (n == 0 || right_count[b + 1] == 0) continue;
+            float cost = aabb_area(&acc) * (float)n + right_area[b + 1] * (float)right_count[b + 1];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = b;
+            }
+        }
+    }
+
+    float leaf_cost = aabb_area(&bounds) * (float)count;
+    float split_cost = V3_BVH_TRAVERSAL_COST * aabb_area(&bounds) + best_cost;
+    if (best_axis < 0 || (split_cost >= leaf_cost && count <= V3_BVH_LEAF_MAX)) {
+        make_leaf(ctx, node, first, count);
+        return;
+    }
+
+    // partition in place by bin
+    float lo = cbounds.min[best_axis];
+    float scale = V3_BVH_BINS / (cbounds.max[best_axis] - lo);
+    uint32_t i = first, j = first + count;
+    while (i < j) {
+        uint32_t p = ctx->prims[i];
+        int b = (int)((centroid(&ctx->boxes[p], best_axis) - lo) * scale);
+        if (b >= V3_BVH_BINS) b = V3_BVH_BINS - 1;
+        if (b <= best_split) {
+            i++;
+        } else {
+            j--;
+            ctx->prims[i] = ctx->prims[j];
+            ctx->prims[j] = p;
+        }
+    }
+    uint32_t left_count = i - first;
+    if (left_count == 0 || left_count == count) {
+        // all centroids in one bin (can happen with equal centroids): split in half
+        left_count = count / 2;
+    }
+
+    uint32_t left = (uint32_t)ctx->node_count;
+    ctx->node_count += 2;
+    ctx->nodes[node].first = left;
+    ctx->nodes[node].count = 0;
+    build_rec(ctx, left, first, left_count, depth + 1);
+    build_rec(ctx, left + 1, first + left_count, count - left_count, depth + 1);
+}
+
+bool v3_bvh_build(v3_bvh *bvh, v3_aabb *boxes, size_t count) {
+    if (bvh == NULL || (boxes == NULL && count > 0)) {
+        v3_error("v3_bvh_build received NULL pointer");
+        return false;
+    }
+    memset(bvh, 0, sizeof(*bvh));
+    if (count == 0) return true;
+    if (count > UINT32_MAX / 2) {
+        v3_error("v3_bvh_build too many primitives");
+        return false;
+    }
+
+    build_ctx ctx;
+    ctx.boxes = boxes;
+    ctx.prims = malloc(count * sizeof(uint32_t));
+    ctx.nodes = malloc((2 * count - 1) * sizeof(v3_bvh_node));
+    ctx.node_count = 1;
+    ctx.node_limit = 2 * count - 1;
+    if (ctx.prims == NULL || ctx.nodes == NULL) {
+        v3_error("v3_bvh_build out of memory");
+        free(ctx.prims);
+        free(ctx.nodes);
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) ctx.prims[i] = (uint32_t)i;
+
+    build_rec(&ctx, 0, 0, (uint32_t)count, 0);
+
+    bvh->nodes = ctx.nodes;
+    bvh->node_count = ctx.node_count;
+    bvh->prims = ctx.prims;
+    bvh->prim_count = count;
+    return true;
+}
+
+void v3_bvh_free(v3_bvh *bvh) {
+    if (bvh == NULL) return;
+    free(bvh->nodes);
+    free(bvh->prims);
+    memset(bvh, 0, sizeof(*bvh));
+}
+
+// ---------- refitting ----------
+static float node_area(const v3_bvh_node *n) {
+    v3_aabb box;
+    memcpy(box.min, n->bmin, sizeof(box.min));
+    memcpy(box.max, n->bmax, sizeof(box.max));
+    return aabb_area(&box);
+}
+
+static float cost_per_area(float cost, float area) {
+    return area > 0.0f ? cost / area : 0.0f;
+}
+
+// Recompute one node's box from its primitives or (already refitted)
+// children, and its subtree cost if cost is not NULL.
+static void refit_node(v3_bvh *bvh, v3_aabb *boxes, float *cost, uint32_t node) {
+    v3_bvh_node *n = &bvh->nodes[node];
+    if (n->count > 0) {
+        v3_aabb box;
+        v3_aabb_empty(&box);
+        for (uint32_t i = 0; i < n->count; i++) v3_aabb_grow_box(&box, &boxes[bvh->prims[n->first + i]]);
+        set_node_bounds(n, &box);
+        if (cost) cost[node] = aabb_area(&box) * (float)n->count;
+    } else {
+        const v3_bvh_node *a = &bvh->nodes[n->first], *b = a + 1;
+        for (int k = 0; k < 3; k++) {
+            n->bmin[k] = fminf(a->bmin[k], b->bmin[k]);
+            n->bmax[k] = fmaxf(a->bmax[k], b->bmax[k]);
+        }
+        if (cost) {
+            cost[node] = V3_BVH_TRAVERSAL_COST * node_area(n) + cost[n->first] + cost[n->first + 1];
+        }
+    }
+}
+
+static void refit_rec(v3_bvh *bvh, v3_aabb *boxes, float *cost, uint32_t node) {
+    const v3_bvh_node *n = &bvh->nodes[node];
+    if (n->count == 0) {
+        refit_rec(bvh, boxes, cost, n->first);
+        refit_rec(bvh, boxes, cost, n->first + 1);
+    }
+    refit_node(bvh, boxes, cost, node);
+}
+
+typedef struct {
+    v3_bvh *bvh;
+    v3_aabb *boxes;
+    float *cost;
+    const uint32_t *roots;
+} refit_ctx;
+
+static void refit_subtrees(void *arg, size_t begin, size_t end) {
+    refit_ctx *rc = arg;
+    for (size_t i = begin; i < end; i++) refit_rec(rc->bvh, rc->boxes, rc->cost, rc->roots[i]);
+}
+
+void v3_bvh_refit(v3_bvh *bvh, v3_bvh_refitter *r, v3_aabb *boxes, v3_pool *pool) {
+    if (bvh == NULL || (boxes == NULL && bvh->node_count > 0)) {
+        v3_error("v3_bvh_refit received NULL pointer");
+        return;
+    }
+    if (bvh->node_count == 0) return;
+    float *cost = r ? r->cost : NULL;
+    if (r) r->check_all = true;
+    if (bvh->node_count < V3_BVH_REFIT_SERIAL) {
+        refit_rec(bvh, boxes, cost, 0);
+        return;
+    }
+
+    // split the top of the tree breadth-first into independent subtrees;
+    // the split nodes are recorded level by level and refitted last
+    uint32_t roots[2 * V3_BVH_REFIT_TASKS], next[2 * V3_BVH_REFIT_TASKS], top[2 * V3_BVH_REFIT_TASKS];
+    size_t root_count = 1, top_count = 0;
+    roots[0] = 0;
+    bool split = true;
+    while (split && root_count < V3_BVH_REFIT_TASKS) {
+        split = false;
+        size_t next_count = 0;
+        for (size_t i = 0; i < root_count; i++) {
+            const v3_bvh_node *n = &bvh->nodes[roots[i]];
+            if (n->count > 0) {
+                next[next_count++] = roots[i];
+            } else {
+                top[top_count++] = roots[i];
+                next[next_count++] = n->first;
+                next[next_count++] = n->first + 1;
+                split = true;
+            }
+        }
+        memcpy(roots, next, next_count * sizeof(uint32_t));
+        root_count = next_count;
+    }
+
+    refit_ctx rc = {.bvh = bvh, .boxes = boxes, .cost = cost, .roots = roots};
+    v3_pool_parallel_for(pool ? pool : v3_pool_default(), root_count, 1, refit_subtrees, &rc);
+    for (size_t i = top_count; i-- > 0;) refit_node(bvh, boxes, cost, top[i]);
+}
+
+static float sah_rec(const v3_bvh *bvh, uint32_t node) {
+    const v3_bvh_node *n = &bvh->nodes[node];
+    if (n->count > 0) return node_area(n) * (float)n->count;
+    return V3_BVH_TRAVERSAL_COST * node_area(n) + sah_rec(bvh, n->first) + sah_rec(bvh, n->first + 1);
+}
+
+float v3_bvh_sah_cost(v3_bvh *bvh) {
+    if (bvh == NULL) {
+        v3_error("v3_bvh_sah_cost received NULL pointer");
+        return 0.0f;
+    }
+    if (bvh->node_count == 0) return 0.0f;
+    return cost_per_area(sah_rec(bvh, 0), node_area(&bvh->nodes[0]));
+}
+
+// parent links, leaf map and costs of a freshly built subtree
+static float link_rec(const v3_bvh *bvh, v3_bvh_refitter *r, uint32_t node) {
+    const v3_bvh_node *n = &bvh->nodes[node];
+    float area = node_area(n), cost;
+    if (n->count > 0) {
+        for (uint32_t i = 0; i < n->count; i++) r->leaf[bvh->prims[n->first + i]] = node;
+        cost = area * (float)n->count;
+    } else {
+        r->parent[n->first] = node;
+        r->parent[n->first + 1] = node;
+        cost = V3_BVH_TRAVERSAL_COST * area + link_rec(bvh, r, n->first) + link_rec(bvh, r, n->first + 1);
+    }
+    r->cost[node] = cost;
+    r->built[node] = cost_per_area(cost, area);
+    return cost;
+}
+
+bool v3_bvh_refitter_init(v3_bvh_refitter *r, v3_bvh *bvh) {
+    if (r == NULL || bvh == NULL) {
+        v3_error("v3_bvh_refitter_init received NULL pointer");
+        return false;
+    }
+    memset(r, 0, sizeof(*r));
+    size_t nodes = bvh->node_count ? bvh->node_count : 1;
+    size_t prims = bvh->prim_count ? bvh->prim_count : 1;
+    r->parent = malloc(nodes * sizeof(uint32_t));
+    r->leaf = malloc(prims * sizeof(uint32_t));
+    r->mark = calloc(nodes, sizeof(uint32_t));
+    r->cost = malloc(nodes * sizeof(float));
+    r->built = malloc(nodes * sizeof(float));
+    if (r->parent == NULL || r->leaf == NULL || r->mark == NULL || r->cost == NULL || r->built == NULL) {
+        v3_error("v3_bvh_refitter_init out of memory");
+        v3_bvh_refitter_free(r);
+        return false;
+    }
+    if (bvh->node_count > 0) {
+        r->parent[0] = V3_BVH_NONE;
+        link_rec(bvh, r, 0);
+    }
+    return true;
+}
+
+void v3_bvh_refitter_free(v3_bvh_refitter *r) {
+    if (r == NULL) return;
+    free(r->parent);
+    free(r->leaf);
+    free(r->mark);
+    free(r->cost);
+    free(r->built);
+    free(r->touched);
+    free(r->pending);
+    memset(r, 0, sizeof(*r));
+}
+
+static int cmp_desc(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x < y) - (x > y);
+}
+
+static int cmp_asc(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// make room for count + extra entries in a growable index list
+static bool reserve_list(uint32_t **list, size_t *cap, size_t count, size_t extra) {
+    if (count + extra <= *cap) return true;
+    size_t ncap = *cap ? *cap : 256;
+    while (ncap < count + extra) ncap *= 2;
+    uint32_t *p = realloc(*list, ncap * sizeof(uint32_t));
+    if (p == NULL) return false;
+    *list = p;
+    *cap = ncap;
+    return true;
+}
+
+bool v3_bvh_refit_prims(v3_bvh *bvh, v3_bvh_refitter *r, v3_aabb *boxes,
+                        const uint32_t *changed, size_t n) {
+    if (bvh == NULL || r == NULL || boxes == NULL || (changed == NULL && n > 0)) {
+        v3_error("v3_bvh_refit_prims received NULL pointer");
+        return false;
+    }
+    if (++r->generation == 0) {
+        memset(r->mark, 0, bvh->node_count * sizeof(uint32_t));
+        r->generation = 1;
+    }
+    // collect each changed leaf and its ancestors once; a walk stops at the
+    // first node an earlier walk already reached
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (changed[i] >= bvh->prim_count) {
+            v3_error("v3_bvh_refit_prims primitive out of range");
+            return false;
+        }
+        for (uint32_t node = r->leaf[changed[i]]; node != V3_BVH_NONE && r->mark[node] != r->generation;
+             node = r->parent[node]) {
+            if (!reserve_list(&r->touched, &r->touched_cap, count, 1)) {
+                v3_error("v3_bvh_refit_prims out of memory");
+                return false;
+            }
+            r->mark[node] = r->generation;
+            r->touched[count++] = node;
+        }
+    }
+    // children come after their parents, so descending order is bottom-up
+    qsort(r->touched, count, sizeof(uint32_t), cmp_desc);
+    for (size_t i = 0; i < count; i++) refit_node(bvh, boxes, r->cost, r->touched[i]);
+
+    // remember them for v3_bvh_rebuild_degraded (duplicates are removed there)
+    if (!r->check_all) {
+        if (!reserve_list(&r->pending, &r->pending_cap, r->pending_count, count)) {
+            r->check_all = true;  // fall back to examining every node
+        } else {
+            memcpy(r->pending + r->pending_count, r->touched, count * sizeof(uint32_t));
+            r->pending_count += count;
+        }
+    }
+    return true;
+}
+
+// node slots and primitive range owned by a subtree; with free_slots the
+// descendants are also flagged as holes until the rebuild links them again
+typedef struct {
+    uint32_t node_lo, node_hi;
+    uint32_t prim_lo, prim_hi;
+} subtree_span;
+
+static void span_rec(const v3_bvh *bvh, v3_bvh_refitter *r, uint32_t node, subtree_span *s) {
+    const v3_bvh_node *n = &bvh->nodes[node];
+    if (n->count > 0) {
+        if (n->first < s->prim_lo) s->prim_lo = n->first;
+        if (n->first + n->count > s->prim_hi) s->prim_hi = n->first + n->count;
+        return;
+    }
+    if (n->first < s->node_lo) s->node_lo = n->first;
+    if (n->first + 2 > s->node_hi) s->node_hi = n->first + 2;
+    r->parent[n->first] = V3_BVH_HOLE;
+    r->parent[n->first + 1] = V3_BVH_HOLE;
+    span_rec(bvh, r, n->first, s);
+    span_rec(bvh, r, n->first + 1, s);
+}
+
+// Rebuild an internal node's subtree over the same primitives. Its
+// descendants' slots are reused; a smaller new subtree leaves unused slots
+// behind, and a larger one is cut short with bigger leaves.
+static void rebuild_subtree(v3_bvh *bvh, v3_bvh_refitter *r, v3_aabb *boxes, uint32_t node) {
+    subtree_span s = {UINT32_MAX, 0, UINT32_MAX, 0};
+    span_rec(bvh, r, node, &s);
+    build_ctx ctx = {.boxes = boxes, .prims = bvh->prims, .nodes = bvh->nodes,
+                     .node_count = s.node_lo, .node_limit = s.node_hi};
+    int depth = 0;
+    for (uint32_t a = r->parent[node]; a != V3_BVH_NONE; a = r->parent[a]) depth++;
+    build_rec(&ctx, node, s.prim_lo, s.prim_hi - s.prim_lo, depth);
+    link_rec(bvh, r, node);
+    for (uint32_t a = r->parent[node]; a != V3_BVH_NONE; a = r->parent[a]) {
+        refit_node(bvh, boxes, r->cost, a);
+    }
+}
+
+static bool degraded(const v3_bvh *bvh, const v3_bvh_refitter *r, uint32_t node, float factor) {
+    const v3_bvh_node *n = &bvh->nodes[node];
+    if (n->count > 0) return false;  // a leaf's cost per area is its count
+    return cost_per_area(r->cost[node], node_area(n)) > factor * r->built[node];
+}
+
+static size_t rebuild_rec(v3_bvh *bvh, v3_bvh_refitter *r, v3_aabb *boxes, uint32_t node, float factor) {
+    uint32_t a = bvh->nodes[node].first, b = a + 1;
+    bool da = degraded(bvh, r, a, factor), db = degraded(bvh, r, b, factor);
+    size_t rebuilt = 0;
+    if (da != db) {
+        // the damage is on one side: fix that side and look again
+        rebuilt = rebuild_rec(bvh, r, boxes, da ? a : b, factor);
+        if (!degraded(bvh, r, node, factor)) return rebuilt;
+    }
+    rebuild_subtree(bvh, r, boxes, node);
+    return rebuilt + 1;
+}
+
+size_t v3_bvh_rebuild_degraded(v3_bvh *bvh, v3_bvh_refitter *r, v3_aabb *boxes, float factor) {
+    if (bvh == NULL || r == NULL || boxes == NULL) {
+        v3_error("v3_bvh_rebuild_degraded received NULL pointer");
+        return 0;
+    }
+    size_t count = r->check_all ? bvh->node_count : r->pending_count;
+    if (!r->check_all) qsort(r->pending, count, sizeof(uint32_t), cmp_asc);
+    // parents before children: start at the top of each degraded path
+    size_t rebuilt = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t node = r->check_all ? (uint32_t)i : r->pending[i];
+        if (!r->check_all && i > 0 && node == r->pending[i - 1]) continue;
+        uint32_t parent = r->parent[node];
+        if (parent == V3_BVH_HOLE || !degraded(bvh, r, node, factor)) continue;
+        if (parent != V3_BVH_NONE && degraded(bvh, r, parent, factor)) continue;
+        rebuilt += rebuild_rec(bvh, r, boxes, node, factor);
+    }
+    r->pending_count = 0;
+    r->check_all = false;
+    return rebuilt;
+}
+
+// ---------- traversal ----------
+// slab test; returns the entry distance or INFINITY on a miss
+static float ray_box(const v3_bvh_node *node, const float *orig, const float *inv, float t_max) {
+    float t0 = 0.0f, t1 = t_max;
+    for (int k = 0; k < 3; k++) {
+        float a = (node->bmin[k] - orig[k]) * inv[k];
+        float b = (node->bmax[k] - orig[k]) * inv[k];
+        // fminf/fmaxf drop the NaN from 0 * inf when the origin lies on a slab
+        t0 = fmaxf(t0, fminf(a, b));
+        t1 = fminf(t1, fmaxf(a, b));
+    }
+    return t0 <= t1 ? t0 : INFINITY;
+}
+
+bool v3_bvh_intersect(v3_bvh *bvh, float *orig, float *dir, float *t_max,
+                      v3_bvh_hit_fn fn, void *ctx) {
+    if (bvh == NULL || orig == NULL || dir == NULL || t_max == NULL || fn == NULL) {
+        v3_error("v3_bvh_intersect received NULL pointer");
+        return false;
+    }
+    if (bvh->node_count == 0) return false;
+
+    float inv[3] = {1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2]};
+    bool hit = false;
+    uint32_t stack[V3_BVH_STACK];
+    int sp = 0;
+
+    if (ray_box(&bvh->nodes[0], orig, inv, *t_max) == INFINITY) return false;
+    uint32_t node = 0;
+    for (;;) {
+        const v3_bvh_node *n = &bvh->nodes[node];
+        if (n->count > 0) {
+            for (uint32_t i = 0; i < n->count; i++) {
+                hit |= fn(ctx, bvh->prims[n->first + i], t_max);
+            }
+        } else {
+            // visit the nearer child first, keep the other for later
+            uint32_t a = n->first, b = n->first + 1;
+            float ta = ray_box(&bvh->nodes[a], orig, inv, *t_max);
+            float tb = ray_box(&bvh->nodes[b], orig, inv, *t_max);
+            if (tb < ta) {
+                uint32_t tmp = a; a = b; b = tmp;
+                float tt = ta; ta = tb; tb = tt;
+            }
+            if (ta != INFINITY) {
+                if (tb != INFINITY) {
+                    if (sp == V3_BVH_STACK) {
+                        v3_error("v3_bvh_intersect tree deeper than V3_BVH_MAX_DEPTH");
+                        return hit;
+                    }
+                    stack[sp++] = b;
+                }
+                node = a;
+                continue;
+            }
+        }
+        // pop, skipping nodes that a closer hit has since ruled out
+        for (;;) {
+            if (sp == 0) return hit;
+            node = stack[--sp];
+            if (ray_box(&bvh->nodes[node], orig, inv, *t_max) != INFINITY) break;
+        }
+    }
+}
+
+// ---------- any-hit traversal ----------
+bool v3_bvh_occluded(v3_bvh *bvh, float *orig, float *dir, float t_max,
+                     v3_bvh_any_fn fn, void *ctx) {
+    if (bvh == NULL || orig == NULL || dir == NULL || fn == NULL) {
+        v3_error("v3_bvh_occluded received NULL pointer");
+        return false;
+    }
+    if (bvh->node_count == 0) return false;
+
+    float inv[3] = {1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2]};
+    uint32_t stack[V3_BVH_STACK];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0) {
+        const v3_bvh_node *n = &bvh->nodes[stack[--sp]];
+        if (ray_box(n, orig, inv, t_max) == INFINITY) continue;
+        if (n->count > 0) {
+            for (uint32_t i = 0; i < n->count; i++) {
+                if (fn(ctx, 0, bvh->prims[n->first + i], t_max)) return true;
+            }
+        } else if (sp + 2 > V3_BVH_STACK) {
+            v3_error("v3_bvh_occluded tree deeper than V3_BVH_MAX_DEPTH");
+            return false;
+        } else {
+            stack[sp++] = n->first + 1;
+            stack[sp++] = n->first;
+        }
+    }
+    return false;
+}
+
+// Packet rays in SoA lanes padded to a multiple of four; padding lanes have
+// t_max = -1 and never enter a box.
+typedef struct {
+    _Alignas(16) float ox[V3_BVH_PACKET], oy[V3_BVH_PACKET], oz[V3_BVH_PACKET];
+    _Alignas(16) float ix[V3_BVH_PACKET], iy[V3_BVH_PACKET], iz[V3_BVH_PACKET];
+    _Alignas(16) float t_max[V3_BVH_PACKET];
+} packet_rays;
+
+// bit i set when ray i of active enters the node's box
+static uint64_t packet_box(const v3_bvh_node *node, const packet_rays *p, size_t lanes, uint64_t active) {
+    uint64_t hit = 0;
+#ifdef __SSE__
+    const __m128 bx0 = _mm_set1_ps(node->bmin[0]), by0 = _mm_set1_ps(node->bmin[1]), bz0 = _mm_set1_ps(node->bmin[2]);
+    const __m128 bx1 = _mm_set1_ps(node->bmax[0]), by1 = _mm_set1_ps(node->bmax[1]), bz1 = _mm_set1_ps(node->bmax[2]);
+    for (size_t i = 0; i < lanes; i += 4) {
+        if (((active >> i) & 0xfu) == 0) continue;
+        __m128 ox = _mm_load_ps(p->ox + i), oy = _mm_load_ps(p->oy + i), oz = _mm_load_ps(p->oz + i);
+        __m128 ix = _mm_load_ps(p->ix + i), iy = _mm_load_ps(p->iy + i), iz = _mm_load_ps(p->iz + i);
+        __m128 ax = _mm_mul_ps(_mm_sub_ps(bx0, ox), ix), bx = _mm_mul_ps(_mm_sub_ps(bx1, ox), ix);
+        __m128 ay = _mm_mul_ps(_mm_sub_ps(by0, oy), iy), by = _mm_mul_ps(_mm_sub_ps(by1, oy), iy);
+        __m128 az = _mm_mul_ps(_mm_sub_ps(bz0, oz), iz), bz = _mm_mul_ps(_mm_sub_ps(bz1, oz), iz);
+        // min/max return their second operand when either is NaN, so the
+        // running bound comes second and a 0 * inf slab is ignored
+        __m128 t0 = _mm_max_ps(_mm_min_ps(ax, bx), _mm_setzero_ps());
+        __m128 t1 = _mm_min_ps(_mm_max_ps(ax, bx), _mm_load_ps(p->t_max + i));
+        t0 = _mm_max_ps(_mm_min_ps(ay, by), t0);
+        t1 = _mm_min_ps(_mm_max_ps(ay, by), t1);
+        t0 = _mm_max_ps(_mm_min_ps(az, bz), t0);
+        t1 = _mm_min_ps(_mm_max_ps(az, bz), t1);
+        hit |= (uint64_t)_mm_movemask_ps(_mm_cmple_ps(t0, t1)) << i;
+    }
+#else
+    for (size_t i = 0; i < lanes; i++) {
+        if (!(active >> i & 1u)) continue;
+        float o[3] = {p->ox[i], p->oy[i], p->oz[i]}, inv[3] = {p->ix[i], p->iy[i], p->iz[i]};
+        if (p->t_max[i] >= 0.0f && ray_box(node, o, inv, p->t_max[i]) != INFINITY) hit |= (uint64_t)1 << i;
+    }
+#endif
+    return hit & active;
+}
+
+size_t v3_bvh_occluded_packet(v3_bvh *bvh, const v3_ray_soa *rays, const float *t_max, size_t count,
+                              uint8_t *occluded, v3_bvh_any_fn fn, void *ctx) {
+    if (bvh == NULL || rays == NULL || t_max == NULL || occluded == NULL || fn == NULL) {
+        v3_error("v3_bvh_occluded_packet received NULL pointer");
+        return 0;
+    }
+    if (count > V3_BVH_PACKET) {
+        v3_error("v3_bvh_occluded_packet takes at most V3_BVH_PACKET rays");
+        return 0;
+    }
+    memset(occluded, 0, count);
+    if (count == 0 || bvh->node_count == 0) return 0;
+
+    packet_rays p;
+    size_t lanes = (count + 3) & ~(size_t)3;
+    for (size_t i = 0; i < lanes; i++) {
+        bool real = i < count;
+        p.ox[i] = real ? rays->ox[i] : 0.0f;
+        p.oy[i] = real ? rays->oy[i] : 0.0f;
+        p.oz[i] = real ? rays->oz[i] : 0.0f;
+        p.ix[i] = real ? 1.0f / rays->dx[i] : 1.0f;
+        p.iy[i] = real ? 1.0f / rays->dy[i] : 1.0f;
+        p.iz[i] = real ? 1.0f / rays->dz[i] : 1.0f;
+        p.t_max[i] = real ? t_max[i] : -1.0f;
+    }
+    uint64_t active = count == 64 ? UINT64_MAX : ((uint64_t)1 << count) - 1;
+    size_t blocked = 0;
+
+    uint32_t stack[V3_BVH_STACK];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0 && active != 0) {
+        const v3_bvh_node *n = &bvh->nodes[stack[--sp]];
+        uint64_t in = packet_box(n, &p, lanes, active);
+        if (in == 0) continue;
+        if (n->count > 0) {
+            for (uint32_t k = 0; k < n->count && in != 0; k++) {
+                uint32_t prim = bvh->prims[n->first + k];
+                for (uint64_t m = in; m != 0; m &= m - 1) {
+                    uint32_t r = (uint32_t)__builtin_ctzll(m);
+                    if (fn(ctx, r, prim, p.t_max[r])) {
+                        occluded[r] = 1;
+                        in &= ~((uint64_t)1 << r);
+                        active &= ~((uint64_t)1 << r);
+                        blocked++;
+                    }
+                }
+            }
+        } else if (sp + 2 > V3_BVH_STACK) {
+            v3_error("v3_bvh_occluded_packet tree deeper than V3_BVH_MAX_DEPTH");
+            return blocked;
+        } else {
+            stack[sp++] = n->first + 1;
+            stack[sp++] = n->first;
+        }
+    }
+    return blocked;
+}
+
+// A stream chunk: per-ray origin and inverse direction, the ray lists of the
+// nodes on the current path one after another in ids, and a stack of list
+// ranges. A node's list is what reached its parent; the node filters it into
+// a new list at the end of ids, which both children then share.
+typedef struct {
+    float (*ray)[6];
+    uint32_t *ids;
+    size_t ids_cap;
+} stream_scratch;
+
+typedef struct {
+    uint32_t node;
+    uint32_t begin, end;   // range of the parent's filtered list in ids
+} stream_entry;
+
+static bool stream_reserve(stream_scratch *s, size_t need) {
+    if (need <= s->ids_cap) return true;
+    size_t cap = s->ids_cap * 2 > need ? s->ids_cap * 2 : need;
+    uint32_t *ids = realloc(s->ids, cap * sizeof(uint32_t));
+    if (ids == NULL) return false;
+    s->ids = ids;
+    s->ids_cap = cap;
+    return true;
+}
+
+static size_t stream_chunk(v3_bvh *bvh, stream_scratch *s, const float *t_max, size_t count,
+                           uint8_t *occluded, v3_bvh_any_fn fn, void *ctx, size_t base) {
+    for (size_t i = 0; i < count; i++) s->ids[i] = (uint32_t)i;
+    stream_entry stack[V3_BVH_STACK];
+    int sp = 0;
+    stack[sp++] = (stream_entry){0, 0, (uint32_t)count};
+    size_t blocked = 0;
+    while (sp > 0) {
+        stream_entry e = stack[--sp];
+        const v3_bvh_node *n = &bvh->nodes[e.node];
+        // everything past the parent's list belongs to finished subtrees
+        size_t top = e.end;
+        if (!stream_reserve(s, top + (e.end - e.begin))) {
+            v3_error("v3_bvh_occluded_stream out of memory");
+            return blocked;
+        }
+        size_t begin = top;
+        for (size_t i = e.begin; i < e.end; i++) {
+            uint32_t r = s->ids[i];
+            if (occluded[r]) continue;
+            const float *ray = s->ray[r];
+            if (ray_box(n, ray, ray + 3, t_max[base + r]) != INFINITY) s->ids[top++] = r;
+        }
+        if (top == begin) continue;
+        if (n->count > 0) {
+            for (uint32_t k = 0; k < n->count; k++) {
+                uint32_t prim = bvh->prims[n->first + k];
+                for (size_t i = begin; i < top; i++) {
+                    uint32_t r = s->ids[i];
+                    if (!occluded[r] && fn(ctx, (uint32_t)(base + r), prim, t_max[base + r])) {
+                        occluded[r] = 1;
+                        blocked++;
+                    }
+                }
+            }
+        } else if (sp + 2 > V3_BVH_STACK) {
+            v3_error("v3_bvh_occluded_stream tree deeper than V3_BVH_MAX_DEPTH");
+            return blocked;
+        } else {
+            stack[sp++] = (stream_entry){n->first + 1, (uint32_t)begin, (uint32_t)top};
+            stack[sp++] = (stream_entry){n->first, (uint32_t)begin, (uint32_t)top};
+        }
+    }
+    return blocked;
+}
+
+size_t v3_bvh_occluded_stream(v3_bvh *bvh, const v3_ray_soa *rays, const float *t_max, size_t count,
+                              uint8_t *occluded, v3_bvh_any_fn fn, void *ctx) {
+    if (bvh == NULL || rays == NULL || t_max == NULL || occluded == NULL || fn == NULL) {
+        v3_error("v3_bvh_occluded_stream received NULL pointer");
+        return 0;
+    }
+    memset(occluded, 0, count);
+    if (count == 0 || bvh->node_count == 0) return 0;
+
+    size_t chunk = count < V3_BVH_STREAM ? count : V3_BVH_STREAM;
+    stream_scratch s = {.ray = malloc(chunk * sizeof(*s.ray)), .ids = NULL, .ids_cap = 0};
+    if (s.ray == NULL || !stream_reserve(&s, 4 * chunk)) {
+        v3_error("v3_bvh_occluded_stream out of memory");
+        free(s.ray);
+        return 0;
+    }
+    size_t blocked = 0;
+    for (size_t base = 0; base < count; base += chunk) {
+        size_t n = count - base < chunk ? count - base : chunk;
+        for (size_t i = 0; i < n; i++) {
+            float *ray = s.ray[i];
+            ray[0] = rays->ox[base + i];
+            ray[1] = rays->oy[base + i];
+            ray[2] = rays->oz[base + i];
+            ray[3] = 1.0f / rays->dx[base + i];
+            ray[4] = 1.0f / rays->dy[base + i];
+            ray[5] = 1.0f / rays->dz[base + i];
+        }
+        blocked += stream_chunk(bvh, &s, t_max, n, occluded + base, fn, ctx, base);
+    }
+    free(s.ray);
+    free(s.ids);
+    return blocked;
+}
+
+// ---------- compressed wide BVH ----------
+#define V3_WBVH_NODE 0x80u
+#define V3_WBVH_LEAF_MAX 127u
+#define V3_WBVH_EXP_MIN (-126)
+
+// 2^e as a float, built from its exponent bits
+static float exp2i(int e) {
+    uint32_t bits = (uint32_t)(e + 127) << 23;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// The binary nodes that become the children of the wide node for binary
+// node b: open the internal child with the largest surface area until there
+// are V3_WBVH_WIDTH of them or only leaves are left. A leaf root becomes a
+// wide node with itself as the only child.
+static int collapse(const v3_bvh *bvh, uint32_t b, uint32_t *kids) {
+    const v3_bvh_node *node = &bvh->nodes[b];
+    if (node->count > 0) {
+        kids[0] = b;
+        return 1;
+    }
+    int n = 0;
+    kids[n++] = node->first;
+    kids[n++] = node->first + 1;
+    while (n < V3_WBVH_WIDTH) {
+        int best = -1;
+        float best_area = -1.0f;
+        for (int i = 0; i < n; i++) {
+            const v3_bvh_node *c = &bvh->nodes[kids[i]];
+            if (c->count == 0 && node_area(c) > best_area) {
+                best_area = node_area(c);
+                best = i;
+            }
+        }
+        if (best < 0) break;
+        uint32_t first = bvh->nodes[kids[best]].first;
+        kids[best] = first;
+        kids[n++] = first + 1;
+    }
+    return n;
+}
+
+// Smallest step 2^e with which 255 steps from lo reach hi.
+static int quant_exp(float lo, float hi) {
+    float extent = hi - lo;
+    int e = V3_WBVH_EXP_MIN;
+    if (extent > 0.0f) {
+        frexpf(extent / 255.0f, &e);
+        if (e < V3_WBVH_EXP_MIN) e = V3_WBVH_EXP_MIN;
+    }
+    while (e < 127 && lo + 255.0f * exp2i(e) < hi) e++;
+    return e;
+}
+
+// Quantize child i's box outwards: decoding lo + q * step, as traversal
+// does, never lands inside the exact box.
+static void quantize_child(v3_wbvh_node *w, int i, const v3_bvh_node *c) {
+    for (int k = 0; k < 3; k++) {
+        float lo = w->origin[k], step = exp2i(w->exp[k]);
+        float qlo = floorf((c->bmin[k] - lo) / step), qhi = ceilf((c->bmax[k] - lo) / step);
+        qlo = qlo < 0.0f ? 0.0f : (qlo > 255.0f ? 255.0f : qlo);
+        qhi = qhi < 0.0f ? 0.0f : (qhi > 255.0f ? 255.0f : qhi);
+        while (qlo > 0.0f && lo + qlo * step > c->bmin[k]) qlo -= 1.0f;
+        while (qhi < 255.0f && lo + qhi * step < c->bmax[k]) qhi += 1.0f;
+        w->qlo[k][i] = (uint8_t)qlo;
+        w->qhi[k][i] = (uint8_t)qhi;
+    }
+}
+
+// What a wide node stands for: the subtree of binary node `node` (count ==
+// 0), or prims[first .. first + count) of the oversized leaf `node`, spread
+// over several leaf children. The same triple describes a child: count == 0
+// or count > V3_WBVH_LEAF_MAX makes it a wide node, anything else a leaf.
+typedef struct {
+    uint32_t node;
+    uint32_t first;
+    uint32_t count;
+} wide_source;
+
+static int wide_children(const v3_bvh *bvh, const wide_source *s, wide_source *kids) {
+    if (s->count == 0) {
+        uint32_t b[V3_WBVH_WIDTH];
+        int n = collapse(bvh, s->node, b);
+        for (int c = 0; c < n; c++) {
+            const v3_bvh_node *node = &bvh->nodes[b[c]];
+            kids[c] = (wide_source){b[c], node->count ? node->first : 0, node->count};
+        }
+        return n;
+    }
+    // even pieces of at most V3_WBVH_LEAF_MAX, or eight larger ones that
+    // are split again one level down
+    uint32_t n = (s->count + V3_WBVH_LEAF_MAX - 1) / V3_WBVH_LEAF_MAX;
+    if (n > V3_WBVH_WIDTH) n = V3_WBVH_WIDTH;
+    uint32_t at = s->first;
+    for (uint32_t c = 0; c < n; c++) {
+        uint32_t size = s->count / n + (c < s->count % n);
+        kids[c] = (wide_source){s->node, at, size};
+        at += size;
+    }
+    return (int)n;
+}
+
+bool v3_wbvh_convert(v3_wbvh *dst, v3_bvh *src) {
+    if (dst == NULL || src == NULL) {
+        v3_error("v3_wbvh_convert received NULL pointer");
+        return false;
+    }
+    memset(dst, 0, sizeof(*dst));
+    if (src->node_count == 0) return true;
+
+    // a wide node per binary internal node at most, plus a leaf root, plus
+    // the nodes that spread oversized leaves: their pieces hold 63 or more
+    // primitives, so fewer than count / 63 of them
+    size_t cap = src->node_count;
+    for (size_t i = 0; i < src->node_count; i++) {
+        if (src->nodes[i].count > V3_WBVH_LEAF_MAX) cap += src->nodes[i].count / 32 + 1;
+    }
+    dst->nodes = malloc(cap * sizeof(v3_wbvh_node));
+    dst->prims = malloc((src->prim_count ? src->prim_count : 1) * sizeof(uint32_t));
+    wide_source *source = malloc(cap * sizeof(wide_source));   // what each wide node stands for
+    uint8_t *depth = malloc(cap);                               // and its depth
+    if (dst->nodes == NULL || dst->prims == NULL || source == NULL || depth == NULL) {
+        v3_error("v3_wbvh_convert out of memory");
+        free(depth);
+        free(source);
+        v3_wbvh_free(dst);
+        return false;
+    }
+    // breadth first, so the internal children of a node are allocated together
+    // an oversized leaf root is spread from the root itself
+    const v3_bvh_node *root = &src->nodes[0];
+    source[0] = root->count > V3_WBVH_LEAF_MAX ? (wide_source){0, root->first, root->count} : (wide_source){0, 0, 0};
+    depth[0] = 0;
+    dst->node_count = 1;
+    size_t prims = 0;
+    for (size_t i = 0; i < dst->node_count; i++) {
+        const v3_bvh_node *b = &src->nodes[source[i].node];
+        v3_wbvh_node *w = &dst->nodes[i];
+        memset(w, 0, sizeof(*w));
+        for (int k = 0; k < 3; k++) {
+            w->origin[k] = b->bmin[k];
+            w->exp[k] = (int8_t)quant_exp(b->bmin[k], b->bmax[k]);
+        }
+        w->child_base = (uint32_t)dst->node_count;
+        w->prim_base = (uint32_t)prims;
+        wide_source kids[V3_WBVH_WIDTH];
+        int n = wide_children(src, &source[i], kids);
+        uint8_t rank = 0;
+        for (int c = 0; c < n; c++) {
+            const wide_source *k = &kids[c];
+            quantize_child(w, c, &src->nodes[k->node]);
+            w->mask |= (uint8_t)(1u << c);
+            bool node = k->count == 0 || k->count > V3_WBVH_LEAF_MAX;
+            if (node && depth[i] >= V3_BVH_MAX_DEPTH) {
+                v3_error("v3_wbvh_convert tree deeper than V3_BVH_MAX_DEPTH");
+                free(depth);
+                free(source);
+                v3_wbvh_free(dst);
+                return false;
+            } else if (node) {
+                w->meta[c] = (uint8_t)(V3_WBVH_NODE | rank++);
+                depth[dst->node_count] = (uint8_t)(depth[i] + 1);
+                source[dst->node_count++] = *k;
+            } else if (prims + k->count > src->prim_count || k->first + k->count > src->prim_count) {
+                v3_error("v3_wbvh_convert leaf out of range");
+                free(depth);
+                free(source);
+                v3_wbvh_free(dst);
+                return false;
+            } else {
+                w->meta[c] = (uint8_t)k->count;
+                memcpy(dst->prims + prims, src->prims + k->first, k->count * sizeof(uint32_t));
+                prims += k->count;
+            }
+        }
+    }
+    free(depth);
+    free(source);
+    dst->prim_count = prims;
+    v3_wbvh_node *shrunk = realloc(dst->nodes, dst->node_count * sizeof(v3_wbvh_node));
+    if (shrunk != NULL) dst->nodes = shrunk;
+    return true;
+}
+
+void v3_wbvh_free(v3_wbvh *w) {
+    if (w == NULL) return;
+    free(w->nodes);
+    free(w->prims);
+    memset(w, 0, sizeof(*w));
+}
+
+// Entry distances of a node's children into tnear; bit i of the result is
+// set when the ray enters child i before t_max.
+static unsigned wide_boxes(const v3_wbvh_node *w, const float *orig, const float *inv, float t_max,
+                           float *tnear) {
+    unsigned hit = 0;
+#ifdef __SSE2__
+    __m128 step[3], org[3], o[3], iv[3];
+    for (int k = 0; k < 3; k++) {
+        step[k] = _mm_set1_ps(exp2i(w->exp[k]));
+        org[k] = _mm_set1_ps(w->origin[k]);
+        o[k] = _mm_set1_ps(orig[k]);
+        iv[k] = _mm_set1_ps(inv[k]);
+    }
+    const __m128i zero = _mm_setzero_si128();
+    for (int g = 0; g < V3_WBVH_WIDTH; g += 4) {
+        __m128 t0 = _mm_setzero_ps(), t1 = _mm_set1_ps(t_max);
+        for (int k = 0; k < 3; k++) {
+            int32_t qlo, qhi;
+            memcpy(&qlo, &w->qlo[k][g], sizeof(qlo));
+            memcpy(&qhi, &w->qhi[k][g], sizeof(qhi));
+            // four bytes to four floats, then the planes origin + q * step
+            __m128i lo = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(qlo), zero), zero);
+            __m128i hi = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(qhi), zero), zero);
+            __m128 plo = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(lo), step[k]), org[k]);
+            __m128 phi = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(hi), step[k]), org[k]);
+            __m128 a = _mm_mul_ps(_mm_sub_ps(plo, o[k]), iv[k]), b = _mm_mul_ps(_mm_sub_ps(phi, o[k]), iv[k]);
+            // the running bound comes second so a NaN slab (0 * inf) is ignored
+            t0 = _mm_max_ps(_mm_min_ps(a, b), t0);
+            t1 = _mm_min_ps(_mm_max_ps(a, b), t1);
+        }
+        _mm_storeu_ps(tnear + g, t0);
+        hit |= (unsigned)_mm_movemask_ps(_mm_cmple_ps(t0, t1)) << g;
+    }
+#else
+    for (int c = 0; c < V3_WBVH_WIDTH; c++) {
+        float t0 = 0.0f, t1 = t_max;
+        for (int k = 0; k < 3; k++) {
+            float step = exp2i(w->exp[k]);
+            float a = ((float)w->qlo[k][c] * step + w->origin[k] - orig[k]) * inv[k];
+            float b = ((float)w->qhi[k][c] * step + w->origin[k] - orig[k]) * inv[k];
+            t0 = fmaxf(t0, fminf(a, b));
+            t1 = fminf(t1, fmaxf(a, b));
+        }
+        tnear[c] = t0;
+        if (t0 <= t1) hit |= 1u << c;
+    }
+#endif
+    return hit & w->mask;
+}
+
+// A pending subtree: wide node first (count == 0) or the leaf primitives
+// prims[first .. first + count), entered at distance t.
+typedef struct {
+    uint32_t first;
+    uint32_t count;
+    float t;
+} wide_entry;
+
+// stack entry for child c of w; prim is the offset of c's primitives
+static wide_entry wide_child(const v3_wbvh_node *w, int c, uint32_t prim, float t) {
+    uint8_t meta = w->meta[c];
+    if (meta & V3_WBVH_NODE) return (wide_entry){w->child_base + (meta & ~V3_WBVH_NODE), 0, t};
+    return (wide_entry){w->prim_base + prim, meta, t};
+}
+
+// primitive offsets of the leaf children, in child order
+static void leaf_offsets(const v3_wbvh_node *w, uint32_t *offset) {
+    uint32_t at = 0;
+    for (int c = 0; c < V3_WBVH_WIDTH; c++) {
+        offset[c] = at;
+        if (!(w->meta[c] & V3_WBVH_NODE)) at += w->meta[c];
+    }
+}
+
+bool v3_wbvh_intersect(v3_wbvh *w, float *orig, float *dir, float *t_max,
+                       v3_bvh_hit_fn fn, void *ctx) {
+    if (w == NULL || orig == NULL || dir == NULL || t_max == NULL || fn == NULL) {
+        v3_error("v3_wbvh_intersect received NULL pointer");
+        return false;
+    }
+    if (w->node_count == 0) return false;
+
+    float inv[3] = {1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2]};
+    bool hit = false;
+    wide_entry stack[V3_WBVH_STACK];
+    int sp = 0;
+    stack[sp++] = (wide_entry){0, 0, 0.0f};
+    while (sp > 0) {
+        wide_entry e = stack[--sp];
+        // skip subtrees that a closer hit has since ruled out
+        if (e.t > *t_max) continue;
+        if (e.count > 0) {
+            for (uint32_t i = 0; i < e.count; i++) hit |= fn(ctx, w->prims[e.first + i], t_max);
+            continue;
+        }
+        const v3_wbvh_node *n = &w->nodes[e.first];
+        float tnear[V3_WBVH_WIDTH];
+        unsigned in = wide_boxes(n, orig, inv, *t_max, tnear);
+        if (in == 0) continue;
+        uint32_t offset[V3_WBVH_WIDTH];
+        leaf_offsets(n, offset);
+        // sort the entered children far to near, so the nearest is popped first
+        int order[V3_WBVH_WIDTH], m = 0;
+        for (; in != 0; in &= in - 1) {
+            int c = __builtin_ctz(in), j = m++;
+            while (j > 0 && tnear[order[j - 1]] < tnear[c]) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = c;
+        }
+        if (sp + m > V3_WBVH_STACK) {
+            v3_error("v3_wbvh_intersect tree deeper than V3_BVH_MAX_DEPTH");
+            return hit;
+        }
+        for (int j = 0; j < m; j++) stack[sp++] = wide_child(n, order[j], offset[order[j]], tnear[order[j]]);
+    }
+    return hit;
+}
+
+bool v3_wbvh_occluded(v3_wbvh *w, float *orig, float *dir, float t_max,
+                      v3_bvh_any_fn fn, void *ctx) {
+    if (w == NULL || orig == NULL || dir == NULL || fn == NULL) {
+        v3_error("v3_wbvh_occluded received NULL pointer");
+        return false;
+    }
+    if (w->node_count == 0) return false;
+
+    float inv[3] = {1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2]};
+    uint32_t stack[V3_WBVH_STACK];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0) {
+        const v3_wbvh_node *n = &w->nodes[stack[--sp]];
+        float tnear[V3_WBVH_WIDTH];
+        unsigned in = wide_boxes(n, orig, inv, t_max, tnear);
+        uint32_t offset[V3_WBVH_WIDTH];
+        leaf_offsets(n, offset);
+        for (; in != 0; in &= in - 1) {
+            int c = __builtin_ctz(in);
+            wide_entry e = wide_child(n, c, offset[c], 0.0f);
+            if (e.count == 0) {
+                if (sp == V3_WBVH_STACK) {
+                    v3_error("v3_wbvh_occluded tree deeper than V3_BVH_MAX_DEPTH");
+                    return false;
+                }
+                stack[sp++] = e.first;
+                continue;
+            }
+            for (uint32_t i = 0; i < e.count; i++) {
+                if (fn(ctx, 0, w->prims[e.first + i], t_max)) return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,187 @@
+#ifndef V3BVH_H
+#define V3BVH_H
+
+#include "v3camera.h"
+#include "v3pool.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bounding volume hierarchy over arbitrary primitives given by their boxes.
+// The BVH only knows primitive indices; intersection is delegated to a
+// callback so the same tree serves spheres, triangles or anything else.
+
+typedef struct {
+    float min[3];
+    float max[3];
+} v3_aabb;
+
+// 32-byte node. Children are stored next to each other: an internal node's
+// children are nodes[first] and nodes[first + 1]; a leaf (count > 0) covers
+// prims[first .. first + count).
+typedef struct {
+    float bmin[3];
+    uint32_t first;
+    float bmax[3];
+    uint32_t count;
+} v3_bvh_node;
+
+typedef struct {
+    v3_bvh_node *nodes;   // nodes[0] is the root
+    size_t node_count;
+    uint32_t *prims;      // primitive indices in leaf order
+    size_t prim_count;
+} v3_bvh;
+
+// Build with a binned surface area heuristic. Returns false (after
+// reporting an error) on invalid input or allocation failure. Nodes at
+// depth V3_BVH_MAX_DEPTH (the root is depth 0) become leaves, so the fixed
+// traversal stacks always hold the whole path.
+#define V3_BVH_MAX_DEPTH 63
+bool v3_bvh_build(v3_bvh *bvh, v3_aabb *boxes, size_t count);
+void v3_bvh_free(v3_bvh *bvh);
+
+// Called for each primitive whose leaf the ray reaches. Must return true and
+// lower *t_max if it found a hit closer than *t_max.
+typedef bool (*v3_bvh_hit_fn)(void *ctx, uint32_t prim, float *t_max);
+
+// Closest-hit traversal of the ray orig + t*dir for t in (0, *t_max).
+// Returns true if any primitive reported a hit; *t_max is then the closest t.
+bool v3_bvh_intersect(v3_bvh *bvh, float *orig, float *dir, float *t_max,
+                      v3_bvh_hit_fn fn, void *ctx);
+
+// ---------- any-hit (occlusion) traversal ----------
+// Shadow rays only need to know whether something lies in (0, t_max). The
+// any-hit callback reports whether primitive prim blocks ray number `ray`
+// (0 for the single-ray form) before t_max; traversal stops at the first
+// blocker, visits children in storage order and never shrinks t_max, so the
+// callback need not compute a hit record.
+typedef bool (*v3_bvh_any_fn)(void *ctx, uint32_t ray, uint32_t prim, float t_max);
+
+bool v3_bvh_occluded(v3_bvh *bvh, float *orig, float *dir, float t_max,
+                     v3_bvh_any_fn fn, void *ctx);
+
+// Packet form for up to V3_BVH_PACKET coherent rays (e.g. from one tile to
+// one light): the packet walks the tree once, each box is tested against
+// the still-unoccluded rays four at a time, and rays drop out as they are
+// blocked. occluded[i] is set to 0 or 1; returns the number of blocked rays.
+#define V3_BVH_PACKET 64
+size_t v3_bvh_occluded_packet(v3_bvh *bvh, const v3_ray_soa *rays, const float *t_max, size_t count,
+                              uint8_t *occluded, v3_bvh_any_fn fn, void *ctx);
+
+// Stream form for any number of rays, coherent or not: every node filters
+// the list of rays that reached its parent down to those entering its box,
+// so a ray is only tested against nodes it actually reaches and blocked rays
+// leave every list. Works through the rays V3_BVH_STREAM at a time.
+#define V3_BVH_STREAM 1024
+size_t v3_bvh_occluded_stream(v3_bvh *bvh, const v3_ray_soa *rays, const float *t_max, size_t count,
+                              uint8_t *occluded, v3_bvh_any_fn fn, void *ctx);
+
+// ---------- compressed wide BVH ----------
+// An 8-wide tree converted from a binary one, with child boxes quantized to
+// 8 bits per plane relative to their parent (after Ylitie, Karras and Laine
+// 2017): one 80-byte node stands for up to seven 32-byte binary nodes, and
+// a ray tests all eight children of a node at once, decoding their boxes
+// with SSE. Child boxes decode to origin + q * 2^exp and are rounded
+// outwards, so they always contain the exact boxes and traversal finds the
+// same hits as the binary tree. A static, read-only form: refit the binary
+// tree and convert again when primitives move.
+#define V3_WBVH_WIDTH 8
+
+typedef struct {
+    float origin[3];          // minimum corner of the node's box
+    int8_t exp[3];            // per-axis quantization step 2^exp
+    uint8_t mask;             // bit i: child i exists
+    uint32_t child_base;      // the node's internal children, in order
+    uint32_t prim_base;       // the primitives of its leaf children, in order
+    uint8_t meta[V3_WBVH_WIDTH];   // 0x80 | rank for a node, else a leaf's primitive count
+    uint8_t qlo[3][V3_WBVH_WIDTH];
+    uint8_t qhi[3][V3_WBVH_WIDTH];
+} v3_wbvh_node;
+
+typedef struct {
+    v3_wbvh_node *nodes;  // nodes[0] is the root
+    size_t node_count;
+    uint32_t *prims;      // primitive indices in leaf order
+    size_t prim_count;
+} v3_wbvh;
+
+// Collapse src into wide nodes, opening the largest child until a node has
+// eight. Leaves keep their primitives. A wide leaf holds at most 127, so a
+// larger leaf (v3_bvh_build makes one when centroids coincide or at
+// V3_BVH_MAX_DEPTH) becomes a wide node, or a small tree of them, whose
+// leaf children share its box and split its primitives.
+bool v3_wbvh_convert(v3_wbvh *dst, v3_bvh *src);
+void v3_wbvh_free(v3_wbvh *w);
+
+// As v3_bvh_intersect and v3_bvh_occluded. Children are visited nearest
+// first for closest hits and in storage order for any hits.
+bool v3_wbvh_intersect(v3_wbvh *w, float *orig, float *dir, float *t_max,
+                       v3_bvh_hit_fn fn, void *ctx);
+bool v3_wbvh_occluded(v3_wbvh *w, float *orig, float *dir, float t_max,
+                      v3_bvh_any_fn fn, void *ctx);
+
+// ---------- refitting ----------
+// Moving primitives keep the tree topology: only the bounds are updated,
+// bottom-up, from the new primitive boxes (indexed as for the build).
+
+// SAH cost of the whole tree per unit root area, in the builder's cost model
+// (one primitive test = 1). Grows as refits stretch the boxes. O(nodes).
+float v3_bvh_sah_cost(v3_bvh *bvh);
+
+// Incremental state for a tree whose primitives move a few at a time:
+// parent links, the leaf of every primitive, and each subtree's SAH cost
+// now and right after it was built. All arrays are indexed by node, except
+// leaf which is indexed by primitive.
+typedef struct {
+    uint32_t *parent;     // UINT32_MAX for the root
+    uint32_t *leaf;
+    uint32_t *mark;       // generation of the last refit that reached the node
+    float *cost;          // subtree SAH cost (area-weighted, not normalized)
+    float *built;         // subtree cost per unit area when last (re)built
+    uint32_t *touched;    // scratch list for v3_bvh_refit_prims
+    size_t touched_cap;
+    uint32_t *pending;    // nodes refitted since the last degradation check
+    size_t pending_count, pending_cap;
+    bool check_all;       // a full refit changed every node
+    uint32_t generation;
+} v3_bvh_refitter;
+
+// Set up incremental refits of bvh, which must be current for its boxes.
+bool v3_bvh_refitter_init(v3_bvh_refitter *r, v3_bvh *bvh);
+void v3_bvh_refitter_free(v3_bvh_refitter *r);
+
+// Refit every node. Independent subtrees are refitted in parallel on pool
+// (the default pool if NULL). r, if not NULL, is kept current.
+void v3_bvh_refit(v3_bvh *bvh, v3_bvh_refitter *r, v3_aabb *boxes, v3_pool *pool);
+
+// Refit the leaves holding changed[0 .. n) and their ancestors, each node
+// once: the cost is O(n log N) rather than O(N). boxes must be current for
+// every primitive.
+bool v3_bvh_refit_prims(v3_bvh *bvh, v3_bvh_refitter *r, v3_aabb *boxes,
+                        const uint32_t *changed, size_t n);
+
+// Rebuild the subtrees whose SAH cost per unit area grew by more than factor
+// (e.g. 1.5) since they were built. Only nodes refitted since the previous
+// call are examined. From the highest degraded node of each refitted path,
+// the search follows a degraded child while its sibling is fine and rebuilds
+// the first node where both or neither child degraded, so a moving cluster
+// rebuilds only its own subtree. Subtrees are rebuilt in place in the node
+// slots they already own. Returns the number of subtrees rebuilt.
+size_t v3_bvh_rebuild_degraded(v3_bvh *bvh, v3_bvh_refitter *r, v3_aabb *boxes, float factor);
+
+// grow box to contain point p / another box
+void v3_aabb_empty(v3_aabb *box);
+void v3_aabb_grow_point(v3_aabb *box, float *p);
+void v3_aabb_grow_box(v3_aabb *box, v3_aabb *other);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
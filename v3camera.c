@@ -0,0 +1,291 @@
+#include "v3camera.h"
+#include "v3math.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+// integer hash (lowbias32) used for reproducible per-pixel samples
+static uint32_t hash32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// ---------- setup ----------
+bool v3_raygen_init(v3_raygen *rg, const v3_camera *cam, int width, int height) {
+    if (rg == NULL || cam == NULL) {
+        v3_error("v3_raygen_init received NULL pointer");
+        return false;
+    }
+    if (width <= 0 || height <= 0 || !(cam->fov > 0.0f && cam->fov < 180.0f) || cam->aperture < 0.0f) {
+        v3_error("v3_raygen_init invalid image size, fov or aperture");
+        return false;
+    }
+    float pos[3] = {cam->pos[0], cam->pos[1], cam->pos[2]};
+    float look[3] = {cam->look[0], cam->look[1], cam->look[2]};
+    float up_in[3] = {cam->up[0], cam->up[1], cam->up[2]};
+    float forward[3], right[3], up[3];
+    v3_from_points(forward, pos, look);
+    float dist = v3_length(forward);
+    v3_cross_product(right, forward, up_in);
+    if (dist == 0.0f || v3_length(right) == 0.0f) {
+        v3_error("v3_raygen_init camera look/up are degenerate");
+        return false;
+    }
+    v3_normalize(forward, forward);
+    v3_normalize(right, right);
+    v3_cross_product(up, right, forward);
+
+    memset(rg, 0, sizeof(*rg));
+    rg->thin_lens = cam->aperture > 0.0f;
+    float focus = !rg->thin_lens ? 1.0f : cam->focus > 0.0f ? cam->focus : dist;
+    float half_h = tanf(cam->fov * (float)M_PI / 360.0f) * focus;
+    float half_w = half_h * (float)width / (float)height;
+    for (int k = 0; k < 3; k++) {
+        rg->pos[k] = pos[k];
+        rg->corner[k] = focus * forward[k] - half_w * right[k] + half_h * up[k];
+        rg->step_x[k] = 2.0f * half_w / (float)width * right[k];
+        rg->step_y[k] = -2.0f * half_h / (float)height * up[k];
+        rg->lens_x[k] = cam->aperture * right[k];
+        rg->lens_y[k] = cam->aperture * up[k];
+    }
+    rg->width = width;
+    rg->height = height;
+    return true;
+}
+
+// ---------- tile generation ----------
+// Every sample is computed by a scalar function and by a 4-wide SSE2 copy
+// that performs the same float operations in the same order, so a pixel gets
+// the same ray whichever path (or tile split) produces it.
+
+#define QUARTER_PI 0.785398163f
+#define UNIT_SCALE (1.0f / 16777216.0f)
+
+// sin and cos for |a| <= pi/4 (Taylor to a^8, error below 1e-7)
+static void sincos_quarter(float a, float *sn, float *cs) {
+    float a2 = a * a;
+    *sn = a * (1.0f - a2 * (1.0f / 6.0f) * (1.0f - a2 * (1.0f / 20.0f) * (1.0f - a2 * (1.0f / 42.0f))));
+    *cs = 1.0f - a2 * 0.5f * (1.0f - a2 * (1.0f / 12.0f) * (1.0f - a2 * (1.0f / 30.0f) * (1.0f - a2 * (1.0f / 56.0f))));
+}
+
+// Shirley-Chiu concentric map of the unit square onto the unit disc; keeps
+// stratification and needs only a quarter-turn sin/cos.
+static void concentric_disc(float u, float v, float *x, float *y) {
+    float a = 2.0f * u - 1.0f, b = 2.0f * v - 1.0f;
+    bool wide = fabsf(a) > fabsf(b);
+    float r = wide ? a : b;
+    float num = wide ? b : a;
+    float den = r == 0.0f ? 1.0f : r;
+    float sn, cs;
+    sincos_quarter(QUARTER_PI * (num / den), &sn, &cs);
+    *x = r * (wide ? cs : sn);
+    *y = r * (wide ? sn : cs);
+}
+
+static uint32_t sample_key(const v3_raygen *rg, int x, int y, uint32_t sample) {
+    return hash32((uint32_t)y * (uint32_t)rg->width + (uint32_t)x) ^ hash32(sample * 0x9e3779b9u + 1u);
+}
+
+// subpixel position and lens sample (unit disc) for one pixel
+static void pixel_sample(const v3_raygen *rg, int x, int y, uint32_t sample,
+                         float *fx, float *fy, float *lx, float *ly) {
+    *fx = (float)x + 0.5f;
+    *fy = (float)y + 0.5f;
+    *lx = *ly = 0.0f;
+    if (!rg->jitter && !rg->thin_lens) return;
+
+    uint32_t h = sample_key(rg, x, y, sample);
+    if (rg->jitter) {
+        h = hash32(h);
+        *fx = (float)x + (float)(h >> 8) * UNIT_SCALE;
+        h = hash32(h);
+        *fy = (float)y + (float)(h >> 8) * UNIT_SCALE;
+    }
+    if (rg->thin_lens) {
+        uint32_t h1 = hash32(h);
+        uint32_t h2 = hash32(h1);
+        concentric_disc((float)(h1 >> 8) * UNIT_SCALE, (float)(h2 >> 8) * UNIT_SCALE, lx, ly);
+    }
+}
+
+static void ray_scalar(const v3_raygen *rg, float fx, float fy, float lx, float ly,
+                       v3_ray_soa *rays, size_t i) {
+    float o[3], d[3];
+    for (int k = 0; k < 3; k++) {
+        float off = lx * rg->lens_x[k] + ly * rg->lens_y[k];
+        o[k] = rg->pos[k] + off;
+        // aim at the same image-plane point from the displaced origin
+        d[k] = rg->corner[k] + fx * rg->step_x[k] + fy * rg->step_y[k] - off;
+    }
+    float len = sqrtf(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+    rays->ox[i] = o[0];
+    rays->oy[i] = o[1];
+    rays->oz[i] = o[2];
+    rays->dx[i] = d[0] / len;
+    rays->dy[i] = d[1] / len;
+    rays->dz[i] = d[2] / len;
+}
+
+#ifdef __SSE2__
+// 32-bit lane multiply without SSE4.1's pmulld
+static __m128i mullo4(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static __m128i hash4(__m128i x) {
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    x = mullo4(x, _mm_set1_epi32(0x7feb352d));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+    x = mullo4(x, _mm_set1_epi32((int)0x846ca68bu));
+    return _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+}
+
+static __m128 unit4(__m128i h) {
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 8)), _mm_set1_ps(UNIT_SCALE));
+}
+
+static __m128 select4(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static void concentric_disc4(__m128 u, __m128 v, __m128 *x, __m128 *y) {
+    __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), sign = _mm_set1_ps(-0.0f);
+    __m128 a = _mm_sub_ps(_mm_mul_ps(two, u), one);
+    __m128 b = _mm_sub_ps(_mm_mul_ps(two, v), one);
+    __m128 wide = _mm_cmpgt_ps(_mm_andnot_ps(sign, a), _mm_andnot_ps(sign, b));
+    __m128 r = select4(wide, a, b);
+    __m128 num = select4(wide, b, a);
+    __m128 den = select4(_mm_cmpeq_ps(r, _mm_setzero_ps()), one, r);
+    __m128 ang = _mm_mul_ps(_mm_set1_ps(QUARTER_PI), _mm_div_ps(num, den));
+
+    __m128 a2 = _mm_mul_ps(ang, ang);
+    __m128 t = _mm_sub_ps(one, _mm_mul_ps(a2, _mm_set1_ps(1.0f / 42.0f)));
+    t = _mm_sub_ps(one, _mm_mul_ps(_mm_mul_ps(a2, _mm_set1_ps(1.0f / 20.0f)), t));
+    t = _mm_sub_ps(one, _mm_mul_ps(_mm_mul_ps(a2, _mm_set1_ps(1.0f / 6.0f)), t));
+    __m128 sn = _mm_mul_ps(ang, t);
+    t = _mm_sub_ps(one, _mm_mul_ps(a2, _mm_set1_ps(1.0f / 56.0f)));
+    t = _mm_sub_ps(one, _mm_mul_ps(_mm_mul_ps(a2, _mm_set1_ps(1.0f / 30.0f)), t));
+    t = _mm_sub_ps(one, _mm_mul_ps(_mm_mul_ps(a2, _mm_set1_ps(1.0f / 12.0f)), t));
+    __m128 cs = _mm_sub_ps(one, _mm_mul_ps(_mm_mul_ps(a2, _mm_set1_ps(0.5f)), t));
+
+    *x = _mm_mul_ps(r, select4(wide, cs, sn));
+    *y = _mm_mul_ps(r, select4(wide, sn, cs));
+}
+
+// rays for pixels (x .. x+3, y)
+static void rays4(const v3_raygen *rg, int x, int y, uint32_t sample, v3_ray_soa *rays, size_t i) {
+    __m128 px = _mm_add_ps(_mm_cvtepi32_ps(_mm_setr_epi32(x, x + 1, x + 2, x + 3)), _mm_set1_ps(0.5f));
+    __m128 py = _mm_set1_ps((float)y + 0.5f);
+    __m128 ux = _mm_setzero_ps(), uy = _mm_setzero_ps();
+    if (rg->jitter || rg->thin_lens) {
+        uint32_t base = (uint32_t)y * (uint32_t)rg->width + (uint32_t)x;
+        __m128i h = hash4(_mm_add_epi32(_mm_set1_epi32((int)base), _mm_setr_epi32(0, 1, 2, 3)));
+        h = _mm_xor_si128(h, _mm_set1_epi32((int)hash32(sample * 0x9e3779b9u + 1u)));
+        if (rg->jitter) {
+            h = hash4(h);
+            px = _mm_add_ps(_mm_cvtepi32_ps(_mm_setr_epi32(x, x + 1, x + 2, x + 3)), unit4(h));
+            h = hash4(h);
+            py = _mm_add_ps(_mm_set1_ps((float)y), unit4(h));
+        }
+        if (rg->thin_lens) {
+            __m128i h1 = hash4(h);
+            __m128i h2 = hash4(h1);
+            concentric_disc4(unit4(h1), unit4(h2), &ux, &uy);
+        }
+    }
+
+    __m128 o[3], d[3];
+    for (int k = 0; k < 3; k++) {
+        __m128 off = _mm_add_ps(_mm_mul_ps(ux, _mm_set1_ps(rg->lens_x[k])),
+                                _mm_mul_ps(uy, _mm_set1_ps(rg->lens_y[k])));
+        o[k] = _mm_add_ps(_mm_set1_ps(rg->pos[k]), off);
+        __m128 t = _mm_add_ps(_mm_set1_ps(rg->corner[k]), _mm_mul_ps(px, _mm_set1_ps(rg->step_x[k])));
+        t = _mm_add_ps(t, _mm_mul_ps(py, _mm_set1_ps(rg->step_y[k])));
+        d[k] = _mm_sub_ps(t, off);
+    }
+    __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], d[0]), _mm_mul_ps(d[1], d[1])),
+                                        _mm_mul_ps(d[2], d[2])));
+    _mm_storeu_ps(rays->ox + i, o[0]);
+    _mm_storeu_ps(rays->oy + i, o[1]);
+    _mm_storeu_ps(rays->oz + i, o[2]);
+    _mm_storeu_ps(rays->dx + i, _mm_div_ps(d[0], len));
+    _mm_storeu_ps(rays->dy + i, _mm_div_ps(d[1], len));
+    _mm_storeu_ps(rays->dz + i, _mm_div_ps(d[2], len));
+}
+#endif
+
+void v3_raygen_tile(const v3_raygen *rg, int x0, int y0, int w, int h,
+                    uint32_t sample, v3_ray_soa *rays) {
+    if (rg == NULL || rays == NULL || rays->ox == NULL || rays->oy == NULL || rays->oz == NULL ||
+        rays->dx == NULL || rays->dy == NULL || rays->dz == NULL) {
+        v3_error("v3_raygen_tile received NULL pointer");
+        return;
+    }
+    if (w <= 0 || h <= 0) return;
+
+    for (int y = 0; y < h; y++) {
+        size_t row = (size_t)y * (size_t)w;
+        int x = 0;
+#ifdef __SSE2__
+        for (; x + 4 <= w; x += 4) {
+            rays4(rg, x0 + x, y0 + y, sample, rays, row + (size_t)x);
+        }
+#endif
+        for (; x < w; x++) {
+            float fx, fy, lx, ly;
+            pixel_sample(rg, x0 + x, y0 + y, sample, &fx, &fy, &lx, &ly);
+            ray_scalar(rg, fx, fy, lx, ly, rays, row + (size_t)x);
+        }
+    }
+}
+
+// ---------- buffers ----------
+bool v3_ray_soa_alloc(v3_ray_soa *rays, size_t count) {
+    if (rays == NULL) {
+        v3_error("v3_ray_soa_alloc received NULL pointer");
+        return false;
+    }
+    size_t stride = (count + 15) & ~(size_t)15;  // keep every array 64-byte aligned
+    if (stride == 0) stride = 16;
+    float *p = aligned_alloc(64, 6 * stride * sizeof(float));
+    if (p == NULL) {
+        v3_error("v3_ray_soa_alloc out of memory");
+        memset(rays, 0, sizeof(*rays));
+        return false;
+    }
+    rays->ox = p;
+    rays->oy = p + stride;
+    rays->oz = p + 2 * stride;
+    rays->dx = p + 3 * stride;
+    rays->dy = p + 4 * stride;
+    rays->dz = p + 5 * stride;
+    return true;
+}
+
+void v3_ray_soa_free(v3_ray_soa *rays) {
+    if (rays == NULL) return;
+    free(rays->ox);
+    memset(rays, 0, sizeof(*rays));
+}
@@ -0,0 +1,62 @@
+#ifndef V3CAMERA_H
+#define V3CAMERA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Primary ray generation for whole tiles. Rays are written as structure of
+// arrays so later stages can load four or eight rays per instruction.
+
+typedef struct {
+    float pos[3];
+    float look[3];     // point the camera looks at
+    float up[3];
+    float fov;         // vertical field of view in degrees
+    float aperture;    // lens radius; 0 gives a pinhole camera
+    float focus;       // distance to the sharp plane; 0 means |look - pos|
+} v3_camera;
+
+typedef struct {
+    float *ox, *oy, *oz;
+    float *dx, *dy, *dz;
+} v3_ray_soa;
+
+// Precomputed camera frame. A pixel position (px, py), measured from the
+// top-left image corner, maps to the image-plane point
+// pos + corner + px*step_x + py*step_y at the focus distance.
+typedef struct {
+    float pos[3];
+    float corner[3];
+    float step_x[3];   // one pixel to the right
+    float step_y[3];   // one pixel down
+    float lens_x[3];   // aperture radius along the camera right/up axes,
+    float lens_y[3];   // zero for a pinhole
+    int width, height;
+    bool thin_lens;
+    bool jitter;       // random subpixel offsets instead of pixel centres
+} v3_raygen;
+
+// Returns false (after reporting an error) for a degenerate camera.
+// jitter starts out false.
+bool v3_raygen_init(v3_raygen *rg, const v3_camera *cam, int width, int height);
+
+// Write the w*h rays of the tile at (x0, y0) row-major into rays[0 .. w*h).
+// Directions are unit length. Jitter and lens positions are a hash of the
+// pixel and sample index, so a given sample is reproducible on any thread.
+void v3_raygen_tile(const v3_raygen *rg, int x0, int y0, int w, int h,
+                    uint32_t sample, v3_ray_soa *rays);
+
+// six 64-byte aligned arrays of count floats
+bool v3_ray_soa_alloc(v3_ray_soa *rays, size_t count);
+void v3_ray_soa_free(v3_ray_soa *rays);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,385 @@
+#ifndef V3CORO_HPP
+#define V3CORO_HPP
+
+// Optional C++20 coroutine layer over the batched kernels.
+//
+//   v3::task pipeline(std::FILE *in) {
+//       for (std::span<float> chunk : v3::read_chunks(in, 1 << 16)) {
+//           co_await v3::normalize(chunk, chunk);
+//           ...
+//       }
+//   }
+//   v3::sync_wait(pipeline(in));
+//
+// Awaited operations run on a v3_pool and resume the coroutine on the worker
+// that finished them. read_chunks reads the next chunk on the pool while the
+// current one is being processed.
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "v3async.h"
+#include "v3batch.h"
+#include "v3pool.h"
+
+namespace v3 {
+
+// ---------- task: lazily started coroutine ----------
+class task {
+public:
+    struct promise_type {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr error;
+
+        task get_return_object() {
+            return task{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct final_awaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                auto next = h.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        final_awaiter final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    task(task &&other) noexcept : h_(std::exchange(other.h_, {})) {}
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+    ~task() {
+        if (h_) h_.destroy();
+    }
+
+    // co_await a task from another coroutine: start it, resume the awaiter
+    // when it finishes
+    bool await_ready() const noexcept { return !h_ || h_.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        h_.promise().continuation = awaiting;
+        return h_;
+    }
+    void await_resume() {
+        if (h_.promise().error) std::rethrow_exception(h_.promise().error);
+    }
+
+private:
+    explicit task(std::coroutine_handle<promise_type> h) : h_(h) {}
+    std::coroutine_handle<promise_type> h_;
+};
+
+namespace detail {
+
+// eagerly started, self-destroying coroutine used to bridge to blocking code
+struct detached {
+    struct promise_type {
+        detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+struct signal {
+    std::mutex lock;
+    std::condition_variable cond;
+    bool done = false;
+
+    void set() {
+        // notify under the lock so the waiter cannot destroy us mid-notify
+        std::lock_guard<std::mutex> guard(lock);
+        done = true;
+        cond.notify_all();
+    }
+    void wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        cond.wait(guard, [this] { return done; });
+    }
+};
+
+inline detached run_and_signal(task &t, std::exception_ptr &error, signal &sig) {
+    try {
+        co_await t;
+    } catch (...) {
+        error = std::current_exception();
+    }
+    sig.set();
+}
+
+inline v3_pool *pool_or_default(v3_pool *pool) {
+    return pool != nullptr ? pool : v3_pool_default();
+}
+
+} // namespace detail
+
+// block the calling thread until the task has finished
+inline void sync_wait(task &&t) {
+    detail::signal sig;
+    std::exception_ptr error;
+    detail::run_and_signal(t, error, sig);
+    sig.wait();
+    if (error) std::rethrow_exception(error);
+}
+
+// ---------- awaitable batched operations ----------
+
+// Jobs at least this large are spread over the pool with parallel_for.
+constexpr std::size_t parallel_threshold = 1 << 16;
+
+class job_awaiter {
+public:
+    job_awaiter(const v3_job &job, v3_pool *pool) : job_(job), pool_(detail::pool_or_default(pool)) {}
+
+    bool await_ready() const noexcept { return job_.count == 0; }
+    void await_suspend(std::coroutine_handle<> h) {
+        resume_ = h;
+        if (!v3_pool_submit(pool_, &job_awaiter::run, this)) run(this);
+    }
+    void await_resume() const noexcept {}
+
+private:
+    static void run_range(void *arg, std::size_t begin, std::size_t end) {
+        v3_job_run_range(static_cast<const v3_job *>(arg), begin, end);
+    }
+
+    static void run(void *arg) {
+        auto *self = static_cast<job_awaiter *>(arg);
+        if (self->job_.count >= parallel_threshold) {
+            v3_pool_parallel_for(self->pool_, self->job_.count, parallel_threshold / 4,
+                                 &job_awaiter::run_range, &self->job_);
+        } else {
+            v3_job_run(&self->job_);
+        }
+        self->resume_.resume();
+    }
+
+    v3_job job_;
+    v3_pool *pool_;
+    std::coroutine_handle<> resume_;
+};
+
+namespace detail {
+
+inline std::size_t vec_count(std::span<float> v) {
+    if (v.size() % 3 != 0) throw std::invalid_argument("v3 span size is not a multiple of 3");
+    return v.size() / 3;
+}
+
+inline void require_same(std::size_t a, std::size_t b) {
+    if (a != b) throw std::invalid_argument("v3 spans have mismatched lengths");
+}
+
+inline job_awaiter binary(v3_op op, std::span<float> dst, std::span<float> a,
+                          std::span<float> b, v3_pool *pool) {
+    std::size_t n = vec_count(a);
+    require_same(n, vec_count(b));
+    bool scalar_out = op == V3_OP_DOT;
+    require_same(scalar_out ? n : n * 3, dst.size());
+    return job_awaiter(v3_job{op, dst.data(), a.data(), b.data(), 0.0f, n}, pool);
+}
+
+inline job_awaiter unary(v3_op op, std::span<float> dst, std::span<float> a,
+                         float s, v3_pool *pool) {
+    std::size_t n = vec_count(a);
+    bool scalar_out = op == V3_OP_LENGTH;
+    require_same(scalar_out ? n : n * 3, dst.size());
+    return job_awaiter(v3_job{op, dst.data(), a.data(), nullptr, s, n}, pool);
+}
+
+} // namespace detail
+
+inline job_awaiter add(std::span<float> dst, std::span<float> a, std::span<float> b, v3_pool *pool = nullptr) {
+    return detail::binary(V3_OP_ADD, dst, a, b, pool);
+}
+inline job_awaiter subtract(std::span<float> dst, std::span<float> a, std::span<float> b, v3_pool *pool = nullptr) {
+    return detail::binary(V3_OP_SUBTRACT, dst, a, b, pool);
+}
+inline job_awaiter cross_product(std::span<float> dst, std::span<float> a, std::span<float> b, v3_pool *pool = nullptr) {
+    return detail::binary(V3_OP_CROSS, dst, a, b, pool);
+}
+inline job_awaiter dot_product(std::span<float> dst, std::span<float> a, std::span<float> b, v3_pool *pool = nullptr) {
+    return detail::binary(V3_OP_DOT, dst, a, b, pool);
+}
+inline job_awaiter reflect(std::span<float> dst, std::span<float> v, std::span<float> n, v3_pool *pool = nullptr) {
+    return detail::binary(V3_OP_REFLECT, dst, v, n, pool);
+}
+inline job_awaiter scale(std::span<float> dst, std::span<float> a, float s, v3_pool *pool = nullptr) {
+    return detail::unary(V3_OP_SCALE, dst, a, s, pool);
+}
+inline job_awaiter length(std::span<float> dst, std::span<float> a, v3_pool *pool = nullptr) {
+    return detail::unary(V3_OP_LENGTH, dst, a, 0.0f, pool);
+}
+inline job_awaiter normalize(std::span<float> dst, std::span<float> a, v3_pool *pool = nullptr) {
+    return detail::unary(V3_OP_NORMALIZE, dst, a, 0.0f, pool);
+}
+
+// ---------- generator ----------
+template <typename T>
+class generator {
+public:
+    struct promise_type {
+        T *current = nullptr;
+        std::exception_ptr error;
+
+        generator get_return_object() {
+            return generator{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(T &value) noexcept {
+            current = &value;
+            return {};
+        }
+        std::suspend_always yield_value(T &&value) noexcept {
+            current = &value;
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+        void await_transform() = delete;  // generators only yield
+    };
+
+    class iterator {
+    public:
+        explicit iterator(std::coroutine_handle<promise_type> h) : h_(h) {}
+        T &operator*() const { return *h_.promise().current; }
+        iterator &operator++() {
+            advance(h_);
+            return *this;
+        }
+        bool operator==(std::default_sentinel_t) const { return !h_ || h_.done(); }
+
+    private:
+        std::coroutine_handle<promise_type> h_;
+    };
+
+    generator(generator &&other) noexcept : h_(std::exchange(other.h_, {})) {}
+    generator(const generator &) = delete;
+    generator &operator=(const generator &) = delete;
+    ~generator() {
+        if (h_) h_.destroy();
+    }
+
+    iterator begin() {
+        advance(h_);
+        return iterator{h_};
+    }
+    std::default_sentinel_t end() const noexcept { return {}; }
+
+private:
+    explicit generator(std::coroutine_handle<promise_type> h) : h_(h) {}
+
+    static void advance(std::coroutine_handle<promise_type> h) {
+        h.resume();
+        if (h.done() && h.promise().error) std::rethrow_exception(h.promise().error);
+    }
+
+    std::coroutine_handle<promise_type> h_;
+};
+
+// ---------- chunk streaming with read-ahead ----------
+namespace detail {
+
+// One pending fread. Whoever claims it first (the pool task or a consumer
+// that got there before the pool) performs the read, so waiting on a busy or
+// single-threaded pool cannot deadlock.
+struct read_op {
+    std::FILE *file = nullptr;
+    float *buf = nullptr;
+    std::size_t capacity = 0;   // vectors
+    std::size_t got = 0;        // vectors read
+    std::atomic<bool> claimed{false};
+    signal finished;
+
+    void perform() {
+        if (claimed.exchange(true)) return;
+        got = std::fread(buf, 3 * sizeof(float), capacity, file);
+        finished.set();
+    }
+    void wait() {
+        perform();
+        finished.wait();
+    }
+};
+
+inline void read_task(void *arg) {
+    auto *holder = static_cast<std::shared_ptr<read_op> *>(arg);
+    (*holder)->perform();
+    delete holder;
+}
+
+inline std::shared_ptr<read_op> start_read(std::FILE *file, float *buf, std::size_t capacity,
+                                           v3_pool *pool, bool async) {
+    auto op = std::make_shared<read_op>();
+    op->file = file;
+    op->buf = buf;
+    op->capacity = capacity;
+    if (async) {
+        auto *holder = new std::shared_ptr<read_op>(op);
+        if (!v3_pool_submit(pool, read_task, holder)) delete holder;
+    }
+    return op;
+}
+
+// makes sure an abandoned generator does not free a buffer under a pending read
+struct read_guard {
+    std::shared_ptr<read_op> pending;
+    ~read_guard() {
+        if (pending) pending->wait();
+    }
+};
+
+} // namespace detail
+
+// Yields consecutive chunks of up to chunk_vectors packed vectors from a
+// binary float file. With overlap (the default) the next chunk is read on the
+// pool while the caller processes the current one. A yielded span stays valid
+// until the generator is advanced.
+inline generator<std::span<float>> read_chunks(std::FILE *file, std::size_t chunk_vectors,
+                                               v3_pool *pool = nullptr, bool overlap = true) {
+    if (file == nullptr || chunk_vectors == 0) co_return;
+    pool = detail::pool_or_default(pool);
+
+    std::vector<float> buffers[2] = {std::vector<float>(3 * chunk_vectors),
+                                     std::vector<float>(3 * chunk_vectors)};
+    detail::read_guard guard;
+    int cur = 0;
+    guard.pending = detail::start_read(file, buffers[cur].data(), chunk_vectors, pool, overlap);
+
+    for (;;) {
+        guard.pending->wait();
+        std::size_t got = guard.pending->got;
+        guard.pending.reset();
+        if (got == 0) break;
+
+        if (overlap && got == chunk_vectors) {
+            guard.pending = detail::start_read(file, buffers[1 - cur].data(), chunk_vectors, pool, true);
+        }
+        co_yield std::span<float>(buffers[cur].data(), 3 * got);
+
+        if (!guard.pending) {
+            if (got < chunk_vectors) break;
+            guard.pending = detail::start_read(file, buffers[1 - cur].data(), chunk_vectors, pool, false);
+        }
+        cur = 1 - cur;
+    }
+}
+
+} // namespace v3
+
+#endif
@@ -0,0 +1,124 @@
+#include "v3coro.hpp"
+#include "v3math.h"
+
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+static int g_failures = 0;
+
+static void expect_true(const char *testname, bool cond) {
+    if (cond) {
+        std::printf("PASS: %s\n", testname);
+    } else {
+        std::printf("FAIL: %s\n", testname);
+        g_failures++;
+    }
+}
+
+// ---- Tests ----
+
+static v3::task normalize_then_scale(std::vector<float> &data, v3_pool *pool) {
+    co_await v3::normalize(data, data, pool);
+    co_await v3::scale(data, data, 2.0f, pool);
+}
+
+static v3::task nested(std::vector<float> &data, std::vector<float> &lengths, v3_pool *pool) {
+    co_await normalize_then_scale(data, pool);
+    co_await v3::length(lengths, data, pool);
+}
+
+static void test_awaitable_ops(v3_pool *pool) {
+    std::vector<float> data = {3, 0, 4, 0, 5, 0};
+    std::vector<float> lengths(2);
+    v3::sync_wait(nested(data, lengths, pool));
+    float exp0[3] = {1.2f, 0.0f, 1.6f};
+    expect_true("co_await normalize + scale", v3_equals(data.data(), exp0, 1e-5f));
+    expect_true("co_await length", std::fabs(lengths[0] - 2.0f) < 1e-5f &&
+                                   std::fabs(lengths[1] - 2.0f) < 1e-5f);
+
+    // large enough to take the parallel_for path
+    std::vector<float> big(3 * (v3::parallel_threshold + 11), 1.0f);
+    std::vector<float> ones(big.size(), 1.0f);
+    auto add_big = [&]() -> v3::task { co_await v3::add(big, big, ones, pool); };
+    v3::sync_wait(add_big());
+    bool ok = true;
+    for (float x : big) ok = ok && x == 2.0f;
+    expect_true("co_await add large job", ok);
+}
+
+static void test_mismatched_spans_throw(v3_pool *pool) {
+    std::vector<float> a(6), b(9), dst(6);
+    auto bad = [&]() -> v3::task { co_await v3::add(dst, a, b, pool); };
+    bool threw = false;
+    try {
+        v3::sync_wait(bad());
+    } catch (const std::invalid_argument &) {
+        threw = true;
+    }
+    expect_true("mismatched spans raise invalid_argument", threw);
+}
+
+static std::FILE *make_vector_file(std::size_t count) {
+    std::FILE *f = std::tmpfile();
+    for (std::size_t i = 0; i < count; i++) {
+        float v[3] = {(float)i, 0.0f, 0.0f};
+        std::fwrite(v, sizeof(float), 3, f);
+    }
+    std::rewind(f);
+    return f;
+}
+
+static v3::task stream_lengths(std::FILE *f, bool overlap, std::vector<float> &out, v3_pool *pool) {
+    for (std::span<float> chunk : v3::read_chunks(f, 100, pool, overlap)) {
+        std::vector<float> lens(chunk.size() / 3);
+        co_await v3::length(lens, chunk, pool);
+        out.insert(out.end(), lens.begin(), lens.end());
+    }
+}
+
+static void test_read_chunks(v3_pool *pool) {
+    for (int overlap = 0; overlap < 2; overlap++) {
+        std::FILE *f = make_vector_file(1050);
+        std::vector<float> out;
+        v3::sync_wait(stream_lengths(f, overlap != 0, out, pool));
+        bool ok = out.size() == 1050;
+        for (std::size_t i = 0; ok && i < out.size(); i++) ok = out[i] == (float)i;
+        expect_true(overlap ? "read_chunks with read-ahead" : "read_chunks without read-ahead", ok);
+        std::fclose(f);
+    }
+
+    // abandoning the stream with a read in flight must be safe
+    std::FILE *f = make_vector_file(1000);
+    int seen = 0;
+    for (std::span<float> chunk : v3::read_chunks(f, 100, pool)) {
+        (void)chunk;
+        if (++seen == 2) break;
+    }
+    expect_true("read_chunks early exit", seen == 2);
+    std::fclose(f);
+}
+
+int main() {
+    std::printf("=== v3corotest: Coroutine Layer Tests ===\n\n");
+
+    v3_pool *pool = v3_pool_create(2);
+    test_awaitable_ops(pool);
+    test_mismatched_spans_throw(pool);
+    test_read_chunks(pool);
+    // a single worker exercises the inline-read fallback
+    v3_pool *single = v3_pool_create(1);
+    test_read_chunks(single);
+    v3_pool_destroy(single);
+    v3_pool_destroy(pool);
+
+    std::printf("\n=== Summary ===\n");
+    if (g_failures == 0) {
+        std::printf("ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        std::printf("FAILURES: %d\n", g_failures);
+        return 1;
+    }
+}
@@ -0,0 +1,455 @@
+#include "v3dirty.h"
+#include "v3batch.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+struct v3_dirty {
+    _Atomic uint64_t *bits;   // bit b % 64 of word b / 64: block b is dirty
+    size_t count;
+    size_t blocks, words;
+    unsigned shift;           // log2 of the block size
+};
+
+static unsigned lowest_bit(uint64_t w) {
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctzll(w);
+#else
+    unsigned b = 0;
+    while (!(w >> b & 1u)) b++;
+    return b;
+#endif
+}
+
+// ---------- bitset ----------
+v3_dirty *v3_dirty_create(size_t count, size_t block_size) {
+    if (block_size == 0) block_size = V3_DIRTY_BLOCK_DEFAULT;
+    if ((block_size & (block_size - 1)) != 0) {
+        v3_error("v3_dirty_create block size must be a power of two");
+        return NULL;
+    }
+    v3_dirty *d = calloc(1, sizeof(*d));
+    if (d == NULL) {
+        v3_error("v3_dirty_create out of memory");
+        return NULL;
+    }
+    while ((size_t)1 << d->shift < block_size) d->shift++;
+    d->count = count;
+    d->blocks = (count + block_size - 1) >> d->shift;
+    d->words = (d->blocks + 63) / 64;
+    d->bits = calloc(d->words ? d->words : 1, sizeof(*d->bits));
+    if (d->bits == NULL) {
+        v3_error("v3_dirty_create out of memory");
+        free(d);
+        return NULL;
+    }
+    return d;
+}
+
+void v3_dirty_destroy(v3_dirty *d) {
+    if (d == NULL) return;
+    free((void *)d->bits);
+    free(d);
+}
+
+size_t v3_dirty_count(const v3_dirty *d) {
+    return d ? d->count : 0;
+}
+
+size_t v3_dirty_block_size(const v3_dirty *d) {
+    return d ? (size_t)1 << d->shift : 0;
+}
+
+// set the bits of blocks [b0, b1]
+static void mark_blocks(v3_dirty *d, size_t b0, size_t b1) {
+    for (size_t w = b0 / 64; w <= b1 / 64; w++) {
+        uint64_t mask = ~(uint64_t)0;
+        if (w == b0 / 64) mask &= ~(uint64_t)0 << (b0 % 64);
+        if (w == b1 / 64 && b1 % 64 != 63) mask &= ((uint64_t)1 << (b1 % 64 + 1)) - 1;
+        // skip the locked RMW when the blocks are already dirty
+        if ((atomic_load_explicit(&d->bits[w], memory_order_relaxed) & mask) != mask) {
+            atomic_fetch_or_explicit(&d->bits[w], mask, memory_order_relaxed);
+        }
+    }
+}
+
+void v3_dirty_mark(v3_dirty *d, size_t first, size_t n) {
+    if (d == NULL) {
+        v3_error("v3_dirty_mark received NULL pointer");
+        return;
+    }
+    if (first >= d->count || n > d->count - first) {
+        v3_error("v3_dirty_mark range out of bounds");
+        if (first >= d->count) return;
+        n = d->count - first;
+    }
+    if (n == 0) return;
+    mark_blocks(d, first >> d->shift, (first + n - 1) >> d->shift);
+}
+
+void v3_dirty_mark_indices(v3_dirty *d, const uint32_t *idx, size_t n) {
+    if (d == NULL || (idx == NULL && n > 0)) {
+        v3_error("v3_dirty_mark_indices received NULL pointer");
+        return;
+    }
+    size_t bad = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (idx[i] >= d->count) {
+            bad++;
+            continue;
+        }
+        size_t b = idx[i] >> d->shift;
+        mark_blocks(d, b, b);
+    }
+    if (bad != 0) fprintf(stderr, "Error: v3_dirty_mark_indices ignored %zu out-of-range index(es)\n", bad);
+}
+
+void v3_dirty_mark_all(v3_dirty *d) {
+    if (d == NULL) {
+        v3_error("v3_dirty_mark_all received NULL pointer");
+        return;
+    }
+    if (d->blocks > 0) mark_blocks(d, 0, d->blocks - 1);
+}
+
+size_t v3_dirty_mark_changed(v3_dirty *d, float *v, float *prev, float tol) {
+    if (d == NULL || v == NULL || prev == NULL) {
+        v3_error("v3_dirty_mark_changed received NULL pointer");
+        return 0;
+    }
+    size_t bs = (size_t)1 << d->shift, marked = 0;
+    for (size_t b = 0; b < d->blocks; b++) {
+        size_t first = b * bs, n = d->count - first < bs ? d->count - first : bs;
+        if (v3_any_changed_n(v + 3 * first, prev + 3 * first, tol, n)) {
+            mark_blocks(d, b, b);
+            marked++;
+        }
+    }
+    return marked;
+}
+
+void v3_dirty_clear(v3_dirty *d) {
+    if (d == NULL) return;
+    for (size_t w = 0; w < d->words; w++) atomic_store_explicit(&d->bits[w], 0, memory_order_relaxed);
+}
+
+size_t v3_dirty_blocks(const v3_dirty *d) {
+    if (d == NULL) return 0;
+    size_t n = 0;
+    for (size_t w = 0; w < d->words; w++) {
+        for (uint64_t x = atomic_load_explicit(&d->bits[w], memory_order_relaxed); x != 0; x &= x - 1) n++;
+    }
+    return n;
+}
+
+// first dirty block at or after b, or d->blocks
+static size_t next_set(const v3_dirty *d, size_t b) {
+    if (b >= d->blocks) return d->blocks;
+    size_t w = b / 64;
+    uint64_t x = atomic_load_explicit(&d->bits[w], memory_order_relaxed) & (~(uint64_t)0 << (b % 64));
+    while (x == 0) {
+        if (++w == d->words) return d->blocks;
+        x = atomic_load_explicit(&d->bits[w], memory_order_relaxed);
+    }
+    size_t r = w * 64 + lowest_bit(x);
+    return r < d->blocks ? r : d->blocks;
+}
+
+// first clean block at or after b, or d->blocks
+static size_t next_clear(const v3_dirty *d, size_t b) {
+    if (b >= d->blocks) return d->blocks;
+    size_t w = b / 64;
+    uint64_t x = ~atomic_load_explicit(&d->bits[w], memory_order_relaxed) & (~(uint64_t)0 << (b % 64));
+    while (x == 0) {
+        if (++w == d->words) return d->blocks;
+        x = ~atomic_load_explicit(&d->bits[w], memory_order_relaxed);
+    }
+    size_t r = w * 64 + lowest_bit(x);
+    return r < d->blocks ? r : d->blocks;
+}
+
+size_t v3_dirty_next(const v3_dirty *d, size_t from, size_t *end) {
+    if (d == NULL || end == NULL) {
+        v3_error("v3_dirty_next received NULL pointer");
+        if (end) *end = 0;
+        return 0;
+    }
+    *end = d->count;
+    if (from >= d->count) return d->count;
+    size_t b = next_set(d, from >> d->shift);
+    if (b == d->blocks) return d->count;
+    size_t first = b << d->shift;
+    if (first < from) first = from;
+    size_t e = next_clear(d, b + 1) << d->shift;
+    *end = e < d->count ? e : d->count;
+    return first;
+}
+
+// ---------- vertex normals ----------
+// Same operations as the v3_normalize_n kernel; a zero sum stays zero.
+static void normalize_sum(float *dst, float x, float y, float z) {
+    float len = sqrtf(x * x + y * y + z * z);
+    bool ok = len != 0.0f && isfinite(len);
+    float inv = ok ? 1.0f / len : 0.0f;
+    dst[0] = x * inv;
+    dst[1] = y * inv;
+    dst[2] = z * inv;
+}
+
+static void face_normal(v3_normals *n, const float *verts, uint32_t t) {
+    const uint32_t *ix = n->indices + 3 * (size_t)t;
+    const float *p0 = verts + 3 * (size_t)ix[0], *p1 = verts + 3 * (size_t)ix[1], *p2 = verts + 3 * (size_t)ix[2];
+    float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    float *f = n->face + 3 * (size_t)t;
+    f[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    f[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    f[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static void vertex_normal(const v3_normals *n, float *normals, uint32_t v) {
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    for (uint32_t k = n->first[v]; k < n->first[v + 1]; k++) {
+        const float *f = n->face + 3 * (size_t)n->tris[k];
+        x += f[0];
+        y += f[1];
+        z += f[2];
+    }
+    normalize_sum(normals + 3 * (size_t)v, x, y, z);
+}
+
+bool v3_normals_init(v3_normals *n, const uint32_t *indices, size_t tri_count, size_t vertex_count) {
+    if (n == NULL || (indices == NULL && tri_count > 0)) {
+        v3_error("v3_normals_init received NULL pointer");
+        return false;
+    }
+    memset(n, 0, sizeof(*n));
+    if (3 * tri_count >= UINT32_MAX || vertex_count >= UINT32_MAX) {
+        v3_error("v3_normals_init mesh too large for 32-bit indices");
+        return false;
+    }
+    for (size_t i = 0; i < 3 * tri_count; i++) {
+        if (indices[i] >= vertex_count) {
+            v3_error("v3_normals_init vertex index out of range");
+            return false;
+        }
+    }
+    n->indices = indices;
+    n->tri_count = tri_count;
+    n->vertex_count = vertex_count;
+    n->first = calloc(vertex_count + 1, sizeof(uint32_t));
+    n->tris = malloc((tri_count ? 3 * tri_count : 1) * sizeof(uint32_t));
+    n->face = malloc((tri_count ? 3 * tri_count : 1) * sizeof(float));
+    n->tri_mark = calloc(tri_count ? tri_count : 1, sizeof(uint32_t));
+    n->vert_mark = calloc(vertex_count ? vertex_count : 1, sizeof(uint32_t));
+    n->list = malloc((tri_count ? tri_count : 1) * sizeof(uint32_t));
+    if (n->first == NULL || n->tris == NULL || n->face == NULL || n->tri_mark == NULL ||
+        n->vert_mark == NULL || n->list == NULL) {
+        v3_error("v3_normals_init out of memory");
+        v3_normals_free(n);
+        return false;
+    }
+
+    // counting sort of the corners by vertex; triangles stay in index order
+    for (size_t i = 0; i < 3 * tri_count; i++) n->first[indices[i] + 1]++;
+    for (size_t v = 0; v < vertex_count; v++) n->first[v + 1] += n->first[v];
+    uint32_t *fill = malloc((vertex_count ? vertex_count : 1) * sizeof(uint32_t));
+    if (fill == NULL) {
+        v3_error("v3_normals_init out of memory");
+        v3_normals_free(n);
+        return false;
+    }
+    memcpy(fill, n->first, vertex_count * sizeof(uint32_t));
+    for (size_t i = 0; i < 3 * tri_count; i++) n->tris[fill[indices[i]]++] = (uint32_t)(i / 3);
+    free(fill);
+    return true;
+}
+
+void v3_normals_free(v3_normals *n) {
+    if (n == NULL) return;
+    free(n->first);
+    free(n->tris);
+    free(n->face);
+    free(n->tri_mark);
+    free(n->vert_mark);
+    free(n->list);
+    memset(n, 0, sizeof(*n));
+}
+
+void v3_normals_compute(v3_normals *n, float *verts, float *normals) {
+    if (n == NULL || verts == NULL || normals == NULL) {
+        v3_error("v3_normals_compute received NULL pointer");
+        return;
+    }
+    for (size_t t = 0; t < n->tri_count; t++) face_normal(n, verts, (uint32_t)t);
+    for (size_t v = 0; v < n->vertex_count; v++) vertex_normal(n, normals, (uint32_t)v);
+    n->computed = true;
+}
+
+// a new mark generation; marks are reset when the counter wraps
+static uint32_t next_generation(v3_normals *n) {
+    if (++n->generation == 0) {
+        memset(n->tri_mark, 0, n->tri_count * sizeof(uint32_t));
+        memset(n->vert_mark, 0, n->vertex_count * sizeof(uint32_t));
+        n->generation = 1;
+    }
+    return n->generation;
+}
+
+size_t v3_normals_update(v3_normals *n, const v3_dirty *d, float *verts, float *normals) {
+    if (n == NULL || d == NULL || verts == NULL || normals == NULL) {
+        v3_error("v3_normals_update received NULL pointer");
+        return 0;
+    }
+    if (v3_dirty_count(d) != n->vertex_count) {
+        v3_error("v3_normals_update dirty set does not track the vertices");
+        return 0;
+    }
+    // the face cache is filled by the first full compute
+    if (!n->computed) {
+        v3_normals_compute(n, verts, normals);
+        return n->vertex_count;
+    }
+    uint32_t gen = next_generation(n);
+
+    // faces around dirty vertices
+    size_t listed = 0, end;
+    for (size_t b = v3_dirty_next(d, 0, &end); b < n->vertex_count; b = v3_dirty_next(d, end, &end)) {
+        for (size_t v = b; v < end; v++) {
+            for (uint32_t k = n->first[v]; k < n->first[v + 1]; k++) {
+                uint32_t t = n->tris[k];
+                if (n->tri_mark[t] == gen) continue;
+                n->tri_mark[t] = gen;
+                face_normal(n, verts, t);
+                n->list[listed++] = t;
+            }
+        }
+    }
+
+    // every corner of those faces, once
+    size_t written = 0;
+    for (size_t i = 0; i < listed; i++) {
+        const uint32_t *ix = n->indices + 3 * (size_t)n->list[i];
+        for (int c = 0; c < 3; c++) {
+            if (n->vert_mark[ix[c]] == gen) continue;
+            n->vert_mark[ix[c]] = gen;
+            vertex_normal(n, normals, ix[c]);
+            written++;
+        }
+    }
+    return written;
+}
+
+// ---------- bounds ----------
+// plain compares rather than v3_aabb_grow_point's fminf/fmaxf calls (4x
+// faster here); a NaN coordinate is skipped either way
+static void block_box(v3_aabb *box, float *points, size_t first, size_t end) {
+    v3_aabb_empty(box);
+    for (size_t i = first; i < end; i++) {
+        const float *p = points + 3 * i;
+        for (int k = 0; k < 3; k++) {
+            box->min[k] = p[k] < box->min[k] ? p[k] : box->min[k];
+            box->max[k] = p[k] > box->max[k] ? p[k] : box->max[k];
+        }
+    }
+}
+
+static void group_box(v3_bounds *b, size_t g) {
+    v3_aabb_empty(&b->group[g]);
+    size_t end = (g + 1) * 64 < b->blocks ? (g + 1) * 64 : b->blocks;
+    for (size_t k = g * 64; k < end; k++) v3_aabb_grow_box(&b->group[g], &b->block[k]);
+}
+
+static void total_box(v3_bounds *b) {
+    v3_aabb_empty(&b->total);
+    for (size_t g = 0; g < b->groups; g++) v3_aabb_grow_box(&b->total, &b->group[g]);
+}
+
+bool v3_bounds_init(v3_bounds *b, const v3_dirty *d, float *points) {
+    if (b == NULL || d == NULL || (points == NULL && v3_dirty_count(d) > 0)) {
+        v3_error("v3_bounds_init received NULL pointer");
+        return false;
+    }
+    memset(b, 0, sizeof(*b));
+    b->blocks = d->blocks;
+    b->groups = d->words;
+    b->block = malloc((b->blocks ? b->blocks : 1) * sizeof(v3_aabb));
+    b->group = malloc((b->groups ? b->groups : 1) * sizeof(v3_aabb));
+    if (b->block == NULL || b->group == NULL) {
+        v3_error("v3_bounds_init out of memory");
+        v3_bounds_free(b);
+        return false;
+    }
+    size_t bs = (size_t)1 << d->shift;
+    for (size_t k = 0; k < b->blocks; k++) {
+        block_box(&b->block[k], points, k * bs, (k + 1) * bs < d->count ? (k + 1) * bs : d->count);
+    }
+    for (size_t g = 0; g < b->groups; g++) group_box(b, g);
+    total_box(b);
+    return true;
+}
+
+void v3_bounds_free(v3_bounds *b) {
+    if (b == NULL) return;
+    free(b->block);
+    free(b->group);
+    memset(b, 0, sizeof(*b));
+}
+
+void v3_bounds_update(v3_bounds *b, const v3_dirty *d, float *points) {
+    if (b == NULL || d == NULL || points == NULL) {
+        v3_error("v3_bounds_update received NULL pointer");
+        return;
+    }
+    if (d->blocks != b->blocks) {
+        v3_error("v3_bounds_update dirty set does not match the bounds");
+        return;
+    }
+    size_t bs = (size_t)1 << d->shift;
+    bool any = false;
+    for (size_t g = 0; g < d->words; g++) {
+        uint64_t x = atomic_load_explicit(&d->bits[g], memory_order_relaxed);
+        if (x == 0) continue;
+        for (; x != 0; x &= x - 1) {
+            size_t k = g * 64 + lowest_bit(x);
+            block_box(&b->block[k], points, k * bs, (k + 1) * bs < d->count ? (k + 1) * bs : d->count);
+        }
+        group_box(b, g);
+        any = true;
+    }
+    if (any) total_box(b);
+}
+
+// ---------- BVH ----------
+bool v3_bvh_refit_dirty(v3_bvh *bvh, v3_bvh_refitter *r, v3_aabb *boxes, const v3_dirty *d) {
+    if (bvh == NULL || r == NULL || boxes == NULL || d == NULL) {
+        v3_error("v3_bvh_refit_dirty received NULL pointer");
+        return false;
+    }
+    if (d->count != bvh->prim_count) {
+        v3_error("v3_bvh_refit_dirty dirty set does not track the primitives");
+        return false;
+    }
+    size_t n = v3_dirty_blocks(d) << d->shift;
+    if (n == 0) return true;
+    uint32_t *changed = malloc(n * sizeof(uint32_t));
+    if (changed == NULL) {
+        v3_error("v3_bvh_refit_dirty out of memory");
+        return false;
+    }
+    size_t listed = 0, end;
+    for (size_t b = v3_dirty_next(d, 0, &end); b < d->count; b = v3_dirty_next(d, end, &end)) {
+        for (size_t i = b; i < end; i++) changed[listed++] = (uint32_t)i;
+    }
+    bool ok = v3_bvh_refit_prims(bvh, r, boxes, changed, listed);
+    free(changed);
+    return ok;
+}
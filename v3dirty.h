@@ -0,0 +1,113 @@
+#ifndef V3DIRTY_H
+#define V3DIRTY_H
+
+#include "v3bvh.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Dirty-range tracking for arrays of count elements (vectors, boxes, ...).
+// Writers mark the ranges they touched; consumers of derived data (vertex
+// normals, bounds, a BVH) then recompute only what depends on dirty blocks,
+// so the cost follows the size of the change rather than of the array.
+//
+//   v3_dirty_mark(d, first, n);                 // after writing verts[first .. first+n)
+//   v3_normals_update(&nrm, d, verts, normals);
+//   v3_bounds_update(&bounds, d, verts);
+//   v3_dirty_clear(d);                          // once every consumer is current
+//
+// Elements are grouped into blocks of a power-of-two size with one bit each.
+// Marking is atomic, so pool workers may mark concurrently; updates and
+// clearing must not run concurrently with marking.
+
+#define V3_DIRTY_BLOCK_DEFAULT 256
+
+typedef struct v3_dirty v3_dirty;
+
+// block_size must be a power of two; 0 selects V3_DIRTY_BLOCK_DEFAULT.
+// Everything starts clean.
+v3_dirty *v3_dirty_create(size_t count, size_t block_size);
+void v3_dirty_destroy(v3_dirty *d);
+
+size_t v3_dirty_count(const v3_dirty *d);        // elements tracked
+size_t v3_dirty_block_size(const v3_dirty *d);
+
+// Mark elements [first, first + n) / idx[0 .. n) as written. Out-of-range
+// elements are reported and ignored.
+void v3_dirty_mark(v3_dirty *d, size_t first, size_t n);
+void v3_dirty_mark_indices(v3_dirty *d, const uint32_t *idx, size_t n);
+void v3_dirty_mark_all(v3_dirty *d);
+
+// For a vector array whose previous contents are in prev: mark the blocks in
+// which some vector changed by more than tol (see v3_any_changed_n). Returns
+// the number of blocks marked.
+size_t v3_dirty_mark_changed(v3_dirty *d, float *v, float *prev, float tol);
+
+void v3_dirty_clear(v3_dirty *d);
+size_t v3_dirty_blocks(const v3_dirty *d);        // dirty blocks
+
+// The next dirty run at or after element from: returns its first element and
+// sets *end past its last, or returns v3_dirty_count(d) if there is none.
+//   for (size_t b = v3_dirty_next(d, 0, &e); b < v3_dirty_count(d); b = v3_dirty_next(d, e, &e))
+size_t v3_dirty_next(const v3_dirty *d, size_t from, size_t *end);
+
+// ---------- vertex normals ----------
+// Area-weighted vertex normals of an indexed triangle mesh: the normalized
+// sum of (v1 - v0) x (v2 - v0) over the triangles using the vertex, in a
+// fixed order, so incremental and full results are bit-identical. Vertices
+// without triangles (or with a zero sum) get a zero normal.
+typedef struct {
+    const uint32_t *indices;   // 3 per triangle, not copied
+    size_t tri_count, vertex_count;
+    uint32_t *first;           // triangles of vertex v: tris[first[v] .. first[v + 1])
+    uint32_t *tris;
+    float *face;               // per-triangle cross product
+    uint32_t *tri_mark, *vert_mark;
+    uint32_t *list;            // scratch: triangles touched by an update
+    uint32_t generation;
+    bool computed;             // face holds every triangle (set by v3_normals_compute)
+} v3_normals;
+
+bool v3_normals_init(v3_normals *n, const uint32_t *indices, size_t tri_count, size_t vertex_count);
+void v3_normals_free(v3_normals *n);
+
+// Recompute every normal.
+void v3_normals_compute(v3_normals *n, float *verts, float *normals);
+
+// Recompute the normals that depend on dirty vertices of d (which must track
+// vertex_count elements): the faces around dirty vertices and the normals of
+// all their corners. Returns the number of normals written. The first call
+// after init has no face cache to update and recomputes everything, as
+// v3_normals_compute would.
+size_t v3_normals_update(v3_normals *n, const v3_dirty *d, float *verts, float *normals);
+
+// ---------- bounds ----------
+// Box of a point array kept as per-block boxes and per-64-block group boxes,
+// so an update costs O(dirty points + count / (64 * block size)).
+typedef struct {
+    v3_aabb *block;
+    v3_aabb *group;
+    size_t blocks, groups;
+    v3_aabb total;             // empty (min > max) for no points
+} v3_bounds;
+
+// Compute the bounds of the count points tracked by d.
+bool v3_bounds_init(v3_bounds *b, const v3_dirty *d, float *points);
+void v3_bounds_free(v3_bounds *b);
+void v3_bounds_update(v3_bounds *b, const v3_dirty *d, float *points);
+
+// ---------- BVH ----------
+// v3_bvh_refit_prims over every primitive in a dirty block of d (which
+// tracks the primitives, i.e. boxes).
+bool v3_bvh_refit_dirty(v3_bvh *bvh, v3_bvh_refitter *r, v3_aabb *boxes, const v3_dirty *d);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
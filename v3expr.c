@@ -0,0 +1,588 @@
+#include "v3expr.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Elements per block. A vector temporary is 3 KiB, so a typical chain's
+// live buffers stay in L1 while the block is processed.
+#define V3_EXPR_BLOCK 256
+#define V3_EXPR_PARALLEL_MIN 16   // blocks below which a run stays on the caller
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+typedef enum {
+    OP_VECTORS,
+    OP_GATHER,
+    OP_SCALARS,
+    OP_CONSTANT,
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DOT,
+    OP_CROSS,
+    OP_LENGTH,
+    OP_NORMALIZE,
+    OP_REFLECT,
+} op_kind;
+
+typedef struct {
+    op_kind op;
+    bool vec;            // result has 3 components
+    v3_expr_id a, b;
+    float *src;
+    uint32_t *idx;
+    float c;
+} node;
+
+typedef struct {
+    v3_expr_id id;
+    float *dst;
+} output;
+
+// one node of the evaluation order with its buffer offsets in an arena
+typedef struct {
+    v3_expr_id id;
+    uint32_t dst, a, b;
+} step;
+
+struct v3_expr {
+    node *nodes;
+    size_t node_count, node_cap;
+    output *outputs;
+    size_t output_count, output_cap;
+    step *steps;
+    size_t step_count;
+    uint32_t *slots;     // arena offset of each needed node's buffer
+    size_t stride;       // floats of arena per worker
+    size_t temporaries;
+    float *arena;
+    size_t arena_floats;
+    bool failed;
+};
+
+// ---------- lanes ----------
+// The kernels are written once over `lane`, four floats with SSE2 and one
+// otherwise. Both perform the same IEEE operations in the same order as the
+// v3batch.h kernels, so fused and unfused results match bit for bit.
+#ifdef __SSE2__
+typedef __m128 lane;
+#define LANES 4
+static inline lane lane_load(const float *p) { return _mm_load_ps(p); }
+static inline void lane_store(float *p, lane v) { _mm_store_ps(p, v); }
+static inline lane lane_set(float s) { return _mm_set1_ps(s); }
+static inline lane lane_add(lane a, lane b) { return _mm_add_ps(a, b); }
+static inline lane lane_sub(lane a, lane b) { return _mm_sub_ps(a, b); }
+static inline lane lane_mul(lane a, lane b) { return _mm_mul_ps(a, b); }
+static inline lane lane_div(lane a, lane b) { return _mm_div_ps(a, b); }
+static inline lane lane_sqrt(lane a) { return _mm_sqrt_ps(a); }
+
+// v where x is nonzero and finite (x >= 0 or NaN here), else 0; the bits of
+// *bad mark the other lanes
+static inline lane lane_guard(lane x, lane v, unsigned *bad) {
+    lane ok = _mm_and_ps(_mm_cmpneq_ps(x, _mm_setzero_ps()), _mm_cmplt_ps(x, _mm_set1_ps(INFINITY)));
+    *bad = ~(unsigned)_mm_movemask_ps(ok) & 0xfu;
+    return _mm_and_ps(ok, v);
+}
+#else
+typedef float lane;
+#define LANES 1
+static inline lane lane_load(const float *p) { return *p; }
+static inline void lane_store(float *p, lane v) { *p = v; }
+static inline lane lane_set(float s) { return s; }
+static inline lane lane_add(lane a, lane b) { return a + b; }
+static inline lane lane_sub(lane a, lane b) { return a - b; }
+static inline lane lane_mul(lane a, lane b) { return a * b; }
+static inline lane lane_div(lane a, lane b) { return a / b; }
+static inline lane lane_sqrt(lane a) { return sqrtf(a); }
+
+static inline lane lane_guard(lane x, lane v, unsigned *bad) {
+    bool ok = x != 0.0f && isfinite(x);
+    *bad = !ok;
+    return ok ? v : 0.0f;
+}
+#endif
+
+// lanes of bad that belong to elements below n, for the chunk at i
+static size_t count_bad(unsigned bad, size_t i, size_t n) {
+    size_t c = 0;
+    for (size_t k = 0; k < LANES; k++) c += (bad >> k & 1u) && i + k < n;
+    return c;
+}
+
+// ---------- block kernels ----------
+// Buffers are structure of arrays: component k of a vector buffer starts at
+// k * V3_EXPR_BLOCK. n4 is n rounded up to whole lanes; padding is zero.
+enum { B = V3_EXPR_BLOCK };
+
+typedef struct {
+    size_t normalize, reflect;
+} bad_counts;
+
+static void load_vectors(float *d, const float *src, const uint32_t *idx, size_t n, size_t n4) {
+    for (size_t i = 0; i < n; i++) {
+        const float *v = src + 3 * (size_t)(idx ? idx[i] : i);
+        d[i] = v[0];
+        d[B + i] = v[1];
+        d[2 * B + i] = v[2];
+    }
+    for (size_t i = n; i < n4; i++) d[i] = d[B + i] = d[2 * B + i] = 0.0f;
+}
+
+static void store_vectors(float *dst, const float *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[3 * i] = s[i];
+        dst[3 * i + 1] = s[B + i];
+        dst[3 * i + 2] = s[2 * B + i];
+    }
+}
+
+// componentwise a op b; a scalar operand is reused for every component
+static void binary(op_kind op, float *d, const float *a, bool va, const float *b, bool vb, size_t n4) {
+    int comps = va || vb ? 3 : 1;
+    for (int k = 0; k < comps; k++) {
+        const float *pa = a + (va ? k * B : 0), *pb = b + (vb ? k * B : 0);
+        float *pd = d + k * B;
+        for (size_t i = 0; i < n4; i += LANES) {
+            lane x = lane_load(pa + i), y = lane_load(pb + i);
+            lane r = op == OP_ADD ? lane_add(x, y) : op == OP_SUBTRACT ? lane_sub(x, y) : lane_mul(x, y);
+            lane_store(pd + i, r);
+        }
+    }
+}
+
+static void dot(float *d, const float *a, const float *b, size_t n4) {
+    for (size_t i = 0; i < n4; i += LANES) {
+        lane r = lane_add(lane_add(lane_mul(lane_load(a + i), lane_load(b + i)),
+                                   lane_mul(lane_load(a + B + i), lane_load(b + B + i))),
+                          lane_mul(lane_load(a + 2 * B + i), lane_load(b + 2 * B + i)));
+        lane_store(d + i, r);
+    }
+}
+
+static void cross(float *d, const float *a, const float *b, size_t n4) {
+    for (size_t i = 0; i < n4; i += LANES) {
+        lane ax = lane_load(a + i), ay = lane_load(a + B + i), az = lane_load(a + 2 * B + i);
+        lane bx = lane_load(b + i), by = lane_load(b + B + i), bz = lane_load(b + 2 * B + i);
+        lane_store(d + i, lane_sub(lane_mul(ay, bz), lane_mul(az, by)));
+        lane_store(d + B + i, lane_sub(lane_mul(az, bx), lane_mul(ax, bz)));
+        lane_store(d + 2 * B + i, lane_sub(lane_mul(ax, by), lane_mul(ay, bx)));
+    }
+}
+
+static void length(float *d, const float *a, size_t n4) {
+    dot(d, a, a, n4);
+    for (size_t i = 0; i < n4; i += LANES) lane_store(d + i, lane_sqrt(lane_load(d + i)));
+}
+
+static size_t normalize(float *d, const float *a, size_t n, size_t n4) {
+    size_t bad = 0;
+    for (size_t i = 0; i < n4; i += LANES) {
+        lane x = lane_load(a + i), y = lane_load(a + B + i), z = lane_load(a + 2 * B + i);
+        lane len = lane_sqrt(lane_add(lane_add(lane_mul(x, x), lane_mul(y, y)), lane_mul(z, z)));
+        unsigned mask;
+        lane inv = lane_guard(len, lane_div(lane_set(1.0f), len), &mask);
+        bad += count_bad(mask, i, n);
+        lane_store(d + i, lane_mul(x, inv));
+        lane_store(d + B + i, lane_mul(y, inv));
+        lane_store(d + 2 * B + i, lane_mul(z, inv));
+    }
+    return bad;
+}
+
+// v - 2 dot(v,n) / dot(n,n) * n; a zero normal copies v
+static size_t reflect(float *d, const float *v, const float *nrm, size_t n, size_t n4) {
+    size_t bad = 0;
+    for (size_t i = 0; i < n4; i += LANES) {
+        lane vx = lane_load(v + i), vy = lane_load(v + B + i), vz = lane_load(v + 2 * B + i);
+        lane nx = lane_load(nrm + i), ny = lane_load(nrm + B + i), nz = lane_load(nrm + 2 * B + i);
+        lane nn = lane_add(lane_add(lane_mul(nx, nx), lane_mul(ny, ny)), lane_mul(nz, nz));
+        lane vn = lane_add(lane_add(lane_mul(vx, nx), lane_mul(vy, ny)), lane_mul(vz, nz));
+        unsigned mask;
+        lane k = lane_guard(nn, lane_div(lane_mul(lane_set(2.0f), vn), nn), &mask);
+        bad += count_bad(mask, i, n);
+        lane_store(d + i, lane_sub(vx, lane_mul(k, nx)));
+        lane_store(d + B + i, lane_sub(vy, lane_mul(k, ny)));
+        lane_store(d + 2 * B + i, lane_sub(vz, lane_mul(k, nz)));
+    }
+    return bad;
+}
+
+// evaluate every step for elements [first, first + n) in one arena
+static void run_block(const v3_expr *e, float *arena, size_t first, size_t n, bad_counts *bad) {
+    size_t n4 = (n + LANES - 1) / LANES * LANES;
+    for (size_t s = 0; s < e->step_count; s++) {
+        const step *st = &e->steps[s];
+        const node *nd = &e->nodes[st->id];
+        float *d = arena + st->dst, *a = arena + st->a, *b = arena + st->b;
+        switch (nd->op) {
+        case OP_VECTORS:
+            load_vectors(d, nd->src + 3 * first, NULL, n, n4);
+            break;
+        case OP_GATHER:
+            load_vectors(d, nd->src, nd->idx + first, n, n4);
+            break;
+        case OP_SCALARS:
+            memcpy(d, nd->src + first, n * sizeof(float));
+            for (size_t i = n; i < n4; i++) d[i] = 0.0f;
+            break;
+        case OP_CONSTANT:
+            for (size_t i = 0; i < n4; i++) d[i] = nd->c;
+            break;
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+            binary(nd->op, d, a, e->nodes[nd->a].vec, b, e->nodes[nd->b].vec, n4);
+            break;
+        case OP_DOT:
+            dot(d, a, b, n4);
+            break;
+        case OP_CROSS:
+            cross(d, a, b, n4);
+            break;
+        case OP_LENGTH:
+            length(d, a, n4);
+            break;
+        case OP_NORMALIZE:
+            bad->normalize += normalize(d, a, n, n4);
+            break;
+        case OP_REFLECT:
+            bad->reflect += reflect(d, a, b, n, n4);
+            break;
+        }
+    }
+    // outputs go last, so an output may overwrite its own inputs in place
+    for (size_t o = 0; o < e->output_count; o++) {
+        const output *out = &e->outputs[o];
+        const float *src = arena + e->slots[out->id];
+        if (e->nodes[out->id].vec) {
+            store_vectors(out->dst + 3 * first, src, n);
+        } else {
+            memcpy(out->dst + first, src, n * sizeof(float));
+        }
+    }
+}
+
+// ---------- recording ----------
+v3_expr *v3_expr_create(void) {
+    v3_expr *e = calloc(1, sizeof(*e));
+    if (e == NULL) v3_error("v3_expr_create out of memory");
+    return e;
+}
+
+void v3_expr_destroy(v3_expr *e) {
+    if (e == NULL) return;
+    free(e->nodes);
+    free(e->outputs);
+    free(e->steps);
+    free(e->slots);
+    free(e->arena);
+    free(e);
+}
+
+void v3_expr_clear(v3_expr *e) {
+    if (e == NULL) return;
+    e->node_count = 0;
+    e->output_count = 0;
+    e->step_count = 0;
+    e->failed = false;
+}
+
+static v3_expr_id push_node(v3_expr *e, node nd) {
+    if (e->node_count == e->node_cap) {
+        size_t cap = e->node_cap ? 2 * e->node_cap : 16;
+        node *nodes = cap < V3_EXPR_INVALID ? realloc(e->nodes, cap * sizeof(node)) : NULL;
+        if (nodes == NULL) {
+            v3_error("v3_expr out of memory");
+            e->failed = true;
+            return V3_EXPR_INVALID;
+        }
+        e->nodes = nodes;
+        e->node_cap = cap;
+    }
+    e->nodes[e->node_count] = nd;
+    return (v3_expr_id)e->node_count++;
+}
+
+static v3_expr_id leaf(v3_expr *e, const char *what, node nd, bool ok) {
+    if (e == NULL) {
+        v3_error(what);
+        return V3_EXPR_INVALID;
+    }
+    if (!ok) {
+        v3_error(what);
+        e->failed = true;
+        return V3_EXPR_INVALID;
+    }
+    return push_node(e, nd);
+}
+
+v3_expr_id v3_expr_vectors(v3_expr *e, float *v) {
+    node nd = {.op = OP_VECTORS, .vec = true, .a = V3_EXPR_INVALID, .b = V3_EXPR_INVALID, .src = v};
+    return leaf(e, "v3_expr_vectors received NULL pointer", nd, v != NULL);
+}
+
+v3_expr_id v3_expr_gather(v3_expr *e, float *v, uint32_t *idx) {
+    node nd = {.op = OP_GATHER, .vec = true, .a = V3_EXPR_INVALID, .b = V3_EXPR_INVALID, .src = v, .idx = idx};
+    return leaf(e, "v3_expr_gather received NULL pointer", nd, v != NULL && idx != NULL);
+}
+
+v3_expr_id v3_expr_scalars(v3_expr *e, float *s) {
+    node nd = {.op = OP_SCALARS, .vec = false, .a = V3_EXPR_INVALID, .b = V3_EXPR_INVALID, .src = s};
+    return leaf(e, "v3_expr_scalars received NULL pointer", nd, s != NULL);
+}
+
+v3_expr_id v3_expr_constant(v3_expr *e, float s) {
+    node nd = {.op = OP_CONSTANT, .vec = false, .a = V3_EXPR_INVALID, .b = V3_EXPR_INVALID, .c = s};
+    return leaf(e, "v3_expr_constant received NULL pointer", nd, true);
+}
+
+// Operands must exist and have the kind given by vec_a / vec_b (1 vector,
+// 0 scalar, -1 either; vec_b of -2 marks a unary operation).
+static v3_expr_id op_node(v3_expr *e, const char *name, op_kind op, v3_expr_id a, v3_expr_id b,
+                          int vec_a, int vec_b, bool vec) {
+    if (e == NULL) {
+        fprintf(stderr, "Error: %s received NULL pointer\n", name);
+        return V3_EXPR_INVALID;
+    }
+    bool ok = a < e->node_count && (b == V3_EXPR_INVALID ? vec_b == -2 : b < e->node_count);
+    if (ok && vec_a >= 0) ok = e->nodes[a].vec == (bool)vec_a;
+    if (ok && vec_b >= 0) ok = e->nodes[b].vec == (bool)vec_b;
+    if (!ok) {
+        // an invalid operand was already reported when it was made
+        if (a != V3_EXPR_INVALID && (vec_b == -2 || b != V3_EXPR_INVALID)) {
+            fprintf(stderr, "Error: %s received an invalid or mistyped operand\n", name);
+        }
+        e->failed = true;
+        return V3_EXPR_INVALID;
+    }
+    if (vec_a == -1 && vec_b == -1) vec = e->nodes[a].vec || e->nodes[b].vec;
+    node nd = {.op = op, .vec = vec, .a = a, .b = b};
+    return push_node(e, nd);
+}
+
+v3_expr_id v3_expr_add(v3_expr *e, v3_expr_id a, v3_expr_id b) {
+    return op_node(e, "v3_expr_add", OP_ADD, a, b, -1, -1, false);
+}
+
+v3_expr_id v3_expr_subtract(v3_expr *e, v3_expr_id a, v3_expr_id b) {
+    return op_node(e, "v3_expr_subtract", OP_SUBTRACT, a, b, -1, -1, false);
+}
+
+v3_expr_id v3_expr_multiply(v3_expr *e, v3_expr_id a, v3_expr_id b) {
+    return op_node(e, "v3_expr_multiply", OP_MULTIPLY, a, b, -1, -1, false);
+}
+
+v3_expr_id v3_expr_scale(v3_expr *e, v3_expr_id a, float s) {
+    if (e == NULL) {
+        v3_error("v3_expr_scale received NULL pointer");
+        return V3_EXPR_INVALID;
+    }
+    return v3_expr_multiply(e, a, v3_expr_constant(e, s));
+}
+
+v3_expr_id v3_expr_dot_product(v3_expr *e, v3_expr_id a, v3_expr_id b) {
+    return op_node(e, "v3_expr_dot_product", OP_DOT, a, b, 1, 1, false);
+}
+
+v3_expr_id v3_expr_cross_product(v3_expr *e, v3_expr_id a, v3_expr_id b) {
+    return op_node(e, "v3_expr_cross_product", OP_CROSS, a, b, 1, 1, true);
+}
+
+v3_expr_id v3_expr_length(v3_expr *e, v3_expr_id a) {
+    return op_node(e, "v3_expr_length", OP_LENGTH, a, V3_EXPR_INVALID, 1, -2, false);
+}
+
+v3_expr_id v3_expr_normalize(v3_expr *e, v3_expr_id a) {
+    return op_node(e, "v3_expr_normalize", OP_NORMALIZE, a, V3_EXPR_INVALID, 1, -2, true);
+}
+
+v3_expr_id v3_expr_reflect(v3_expr *e, v3_expr_id v, v3_expr_id n) {
+    return op_node(e, "v3_expr_reflect", OP_REFLECT, v, n, 1, 1, true);
+}
+
+bool v3_expr_output(v3_expr *e, v3_expr_id id, float *dst) {
+    if (e == NULL || dst == NULL) {
+        v3_error("v3_expr_output received NULL pointer");
+        if (e) e->failed = true;
+        return false;
+    }
+    if (id >= e->node_count) {
+        if (id != V3_EXPR_INVALID) v3_error("v3_expr_output received an invalid node");
+        e->failed = true;
+        return false;
+    }
+    if (e->output_count == e->output_cap) {
+        size_t cap = e->output_cap ? 2 * e->output_cap : 4;
+        output *outputs = realloc(e->outputs, cap * sizeof(output));
+        if (outputs == NULL) {
+            v3_error("v3_expr out of memory");
+            e->failed = true;
+            return false;
+        }
+        e->outputs = outputs;
+        e->output_cap = cap;
+    }
+    e->outputs[e->output_count++] = (output){id, dst};
+    return true;
+}
+
+// ---------- planning ----------
+// Nodes only refer to earlier nodes, so index order is an evaluation order.
+// Buffers are handed out like registers: a node's buffer returns to a free
+// list after its last reader (outputs stay live to the end of the block).
+static bool plan(v3_expr *e) {
+    size_t n = e->node_count;
+    size_t *last = malloc((n ? n : 1) * sizeof(size_t));
+    bool *needed = calloc(n ? n : 1, sizeof(bool));
+    uint32_t *free_vec = malloc((n ? n : 1) * sizeof(uint32_t));
+    uint32_t *free_scalar = malloc((n ? n : 1) * sizeof(uint32_t));
+    step *steps = realloc(e->steps, (n ? n : 1) * sizeof(step));
+    if (steps) e->steps = steps;
+    uint32_t *slots = realloc(e->slots, (n ? n : 1) * sizeof(uint32_t));
+    if (slots) e->slots = slots;
+    bool ok = last && needed && free_vec && free_scalar && steps && slots;
+    if (!ok) {
+        v3_error("v3_expr_run out of memory");
+    } else {
+        for (size_t o = 0; o < e->output_count; o++) needed[e->outputs[o].id] = true;
+        for (size_t i = n; i-- > 0;) {
+            if (!needed[i]) continue;
+            if (e->nodes[i].a != V3_EXPR_INVALID) needed[e->nodes[i].a] = true;
+            if (e->nodes[i].b != V3_EXPR_INVALID) needed[e->nodes[i].b] = true;
+        }
+        for (size_t i = 0; i < n; i++) last[i] = i;
+        for (size_t i = 0; i < n; i++) {
+            if (!needed[i]) continue;
+            if (e->nodes[i].a != V3_EXPR_INVALID) last[e->nodes[i].a] = i;
+            if (e->nodes[i].b != V3_EXPR_INVALID) last[e->nodes[i].b] = i;
+        }
+        for (size_t o = 0; o < e->output_count; o++) last[e->outputs[o].id] = n;
+
+        size_t nfree_vec = 0, nfree_scalar = 0, stride = 0, buffers = 0;
+        e->step_count = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (!needed[i]) continue;
+            const node *nd = &e->nodes[i];
+            uint32_t off;
+            if (nd->vec && nfree_vec > 0) {
+                off = free_vec[--nfree_vec];
+            } else if (!nd->vec && nfree_scalar > 0) {
+                off = free_scalar[--nfree_scalar];
+            } else {
+                off = (uint32_t)stride;
+                stride += nd->vec ? 3 * B : B;
+                buffers++;
+            }
+            e->slots[i] = off;
+            step st = {(v3_expr_id)i, off, 0, 0};
+            if (nd->a != V3_EXPR_INVALID) st.a = e->slots[nd->a];
+            if (nd->b != V3_EXPR_INVALID) st.b = e->slots[nd->b];
+            e->steps[e->step_count++] = st;
+
+            // release operands read for the last time (once if a == b), and
+            // the node itself if nothing reads it
+            v3_expr_id release[3] = {nd->a, nd->b == nd->a ? V3_EXPR_INVALID : nd->b, (v3_expr_id)i};
+            for (int k = 0; k < 3; k++) {
+                v3_expr_id r = release[k];
+                if (r == V3_EXPR_INVALID || last[r] != i) continue;
+                if (e->nodes[r].vec) {
+                    free_vec[nfree_vec++] = e->slots[r];
+                } else {
+                    free_scalar[nfree_scalar++] = e->slots[r];
+                }
+            }
+        }
+        e->stride = stride;
+        e->temporaries = buffers;
+    }
+    free(last);
+    free(needed);
+    free(free_vec);
+    free(free_scalar);
+    return ok;
+}
+
+// ---------- evaluation ----------
+typedef struct {
+    const v3_expr *e;
+    size_t count, blocks, tasks;
+    _Atomic size_t bad_normalize, bad_reflect;
+} run_ctx;
+
+// task t evaluates a contiguous range of blocks in its own part of the arena
+static void run_tasks(void *arg, size_t begin, size_t end) {
+    run_ctx *rc = arg;
+    bad_counts bad = {0, 0};
+    for (size_t t = begin; t < end; t++) {
+        float *arena = rc->e->arena + t * rc->e->stride;
+        size_t b0 = t * rc->blocks / rc->tasks, b1 = (t + 1) * rc->blocks / rc->tasks;
+        for (size_t blk = b0; blk < b1; blk++) {
+            size_t first = blk * B;
+            size_t n = rc->count - first < B ? rc->count - first : B;
+            run_block(rc->e, arena, first, n, &bad);
+        }
+    }
+    atomic_fetch_add(&rc->bad_normalize, bad.normalize);
+    atomic_fetch_add(&rc->bad_reflect, bad.reflect);
+}
+
+bool v3_expr_run(v3_expr *e, size_t count, v3_pool *pool) {
+    if (e == NULL) {
+        v3_error("v3_expr_run received NULL pointer");
+        return false;
+    }
+    if (e->failed) {
+        v3_error("v3_expr_run on an expression with invalid nodes");
+        return false;
+    }
+    if (!plan(e)) return false;
+    if (count == 0 || e->step_count == 0) return true;
+
+    if (pool == NULL) pool = v3_pool_default();
+    size_t blocks = (count + B - 1) / B;
+    size_t tasks = blocks >= V3_EXPR_PARALLEL_MIN ? v3_pool_size(pool) : 1;
+    if (tasks > blocks) tasks = blocks;
+    if (tasks == 0) tasks = 1;
+
+    size_t need = tasks * e->stride;
+    if (need > e->arena_floats) {
+        free(e->arena);
+        e->arena = aligned_alloc(64, need * sizeof(float));
+        if (e->arena == NULL) {
+            e->arena_floats = 0;
+            v3_error("v3_expr_run out of memory");
+            return false;
+        }
+        e->arena_floats = need;
+    }
+
+    run_ctx rc = {.e = e, .count = count, .blocks = blocks, .tasks = tasks};
+    atomic_init(&rc.bad_normalize, 0);
+    atomic_init(&rc.bad_reflect, 0);
+    if (tasks == 1) {
+        run_tasks(&rc, 0, 1);
+    } else {
+        v3_pool_parallel_for(pool, tasks, 1, run_tasks, &rc);
+    }
+    size_t bad = atomic_load(&rc.bad_normalize);
+    if (bad != 0) {
+        fprintf(stderr, "Error: v3_expr_run could not normalize %zu zero-length or non-finite vector(s)\n", bad);
+    }
+    bad = atomic_load(&rc.bad_reflect);
+    if (bad != 0) fprintf(stderr, "Error: v3_expr_run reflect undefined for %zu zero-length normal(s)\n", bad);
+    return true;
+}
+
+size_t v3_expr_temporaries(v3_expr *e) {
+    return e ? e->temporaries : 0;
+}
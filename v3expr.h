@@ -0,0 +1,76 @@
+#ifndef V3EXPR_H
+#define V3EXPR_H
+
+#include "v3pool.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lazy expressions over packed vector arrays. Operations only record nodes;
+// v3_expr_run evaluates every output in one fused pass over blocks of
+// elements, keeping intermediates in small cache-resident buffers instead
+// of full temporary arrays:
+//
+//   v3_expr *e = v3_expr_create();
+//   v3_expr_id n = v3_expr_normalize(e, v3_expr_cross_product(e, v3_expr_vectors(e, a),
+//                                                            v3_expr_vectors(e, b)));
+//   v3_expr_output(e, v3_expr_add(e, v3_expr_scale(e, n, s), v3_expr_vectors(e, c)), dst);
+//   v3_expr_run(e, count, NULL);
+//
+// Nodes are either vectors (3 floats per element) or scalars (1 float per
+// element). add, subtract and multiply work componentwise and broadcast a
+// scalar operand across the components of a vector one. Results are
+// bit-identical to the corresponding v3batch.h calls. Recording functions
+// return V3_EXPR_INVALID on bad operands, and a graph that saw one fails
+// to run until v3_expr_clear.
+
+typedef struct v3_expr v3_expr;
+typedef uint32_t v3_expr_id;
+
+#define V3_EXPR_INVALID UINT32_MAX
+
+v3_expr *v3_expr_create(void);
+void v3_expr_destroy(v3_expr *e);
+
+// Forget all nodes and outputs; buffers are kept for the next expression.
+void v3_expr_clear(v3_expr *e);
+
+// Inputs are read at run time, so their contents may change between runs.
+v3_expr_id v3_expr_vectors(v3_expr *e, float *v);                 // v[i]
+v3_expr_id v3_expr_gather(v3_expr *e, float *v, uint32_t *idx);   // v[idx[i]]
+v3_expr_id v3_expr_scalars(v3_expr *e, float *s);                 // s[i]
+v3_expr_id v3_expr_constant(v3_expr *e, float s);                 // s
+
+v3_expr_id v3_expr_add(v3_expr *e, v3_expr_id a, v3_expr_id b);
+v3_expr_id v3_expr_subtract(v3_expr *e, v3_expr_id a, v3_expr_id b);
+v3_expr_id v3_expr_multiply(v3_expr *e, v3_expr_id a, v3_expr_id b);
+v3_expr_id v3_expr_scale(v3_expr *e, v3_expr_id a, float s);
+v3_expr_id v3_expr_dot_product(v3_expr *e, v3_expr_id a, v3_expr_id b);  // scalar
+v3_expr_id v3_expr_cross_product(v3_expr *e, v3_expr_id a, v3_expr_id b);
+v3_expr_id v3_expr_length(v3_expr *e, v3_expr_id a);                     // scalar
+v3_expr_id v3_expr_normalize(v3_expr *e, v3_expr_id a);
+v3_expr_id v3_expr_reflect(v3_expr *e, v3_expr_id v, v3_expr_id n);
+
+// Write node id to dst (count vectors or count scalars) on every run. A node
+// may be both an output and an operand of later nodes.
+bool v3_expr_output(v3_expr *e, v3_expr_id id, float *dst);
+
+// Evaluate all outputs for elements [0, count). Blocks are split across pool
+// (the default pool if NULL); results do not depend on the split. Zero-length
+// normalize inputs and reflect normals are handled as in v3batch.h and
+// reported once per run.
+bool v3_expr_run(v3_expr *e, size_t count, v3_pool *pool);
+
+// Number of block buffers the last run needed per worker, after reuse.
+size_t v3_expr_temporaries(v3_expr *e);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,189 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "v3hist.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+static int msb64(uint64_t v) {
+    return 63 - __builtin_clzll(v);
+}
+
+// Values below 2 * SUB map to themselves. Above, with shift = msb - SUB_BITS,
+// value >> shift lies in [SUB, 2 * SUB) and the bucket is shift * SUB plus
+// that, so consecutive powers of two get consecutive runs of SUB buckets.
+static size_t bucket_of(uint64_t v) {
+    if (v < 2 * V3_HIST_SUB) return (size_t)v;
+    int shift = msb64(v) - V3_HIST_SUB_BITS;
+    return (size_t)shift * V3_HIST_SUB + (size_t)(v >> shift);
+}
+
+// highest value that maps to bucket b
+static uint64_t bucket_high(size_t b) {
+    if (b < 2 * V3_HIST_SUB) return b;
+    int shift = (int)(b / V3_HIST_SUB) - 1;
+    uint64_t low = (uint64_t)(b - (size_t)shift * V3_HIST_SUB) << shift;
+    return low + (((uint64_t)1 << shift) - 1);
+}
+
+// ---------- histogram ----------
+bool v3_hist_init(v3_hist *h) {
+    if (h == NULL) {
+        v3_error("v3_hist_init received NULL pointer");
+        return false;
+    }
+    h->counts = calloc(V3_HIST_BUCKETS, sizeof(uint64_t));
+    if (h->counts == NULL) {
+        v3_error("v3_hist_init out of memory");
+        return false;
+    }
+    h->total = 0;
+    h->min = UINT64_MAX;
+    h->max = 0;
+    h->sum = 0.0;
+    return true;
+}
+
+void v3_hist_free(v3_hist *h) {
+    if (h == NULL) return;
+    free(h->counts);
+    h->counts = NULL;
+}
+
+void v3_hist_reset(v3_hist *h) {
+    if (h == NULL || h->counts == NULL) return;
+    memset(h->counts, 0, V3_HIST_BUCKETS * sizeof(uint64_t));
+    h->total = 0;
+    h->min = UINT64_MAX;
+    h->max = 0;
+    h->sum = 0.0;
+}
+
+void v3_hist_record(v3_hist *h, uint64_t value) {
+    h->counts[bucket_of(value)]++;
+    h->total++;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+    h->sum += (double)value;
+}
+
+void v3_hist_merge(v3_hist *dst, const v3_hist *src) {
+    if (dst == NULL || src == NULL) {
+        v3_error("v3_hist_merge received NULL pointer");
+        return;
+    }
+    if (src->total == 0) return;
+    for (size_t b = 0; b < V3_HIST_BUCKETS; b++) dst->counts[b] += src->counts[b];
+    dst->total += src->total;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+    dst->sum += src->sum;
+}
+
+uint64_t v3_hist_percentile(const v3_hist *h, double p) {
+    if (h == NULL || h->total == 0) return 0;
+    if (p < 0.0) p = 0.0;
+    if (p > 100.0) p = 100.0;
+    // rank of the value, 1-based: at least one value is always included
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)h->total + 0.5);
+    if (rank == 0) rank = 1;
+    if (rank > h->total) rank = h->total;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < V3_HIST_BUCKETS; b++) {
+        seen += h->counts[b];
+        if (seen >= rank) {
+            uint64_t v = bucket_high(b);
+            if (v < h->min) v = h->min;
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+double v3_hist_mean(const v3_hist *h) {
+    return h && h->total ? h->sum / (double)h->total : 0.0;
+}
+
+uint64_t v3_hist_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// ---------- per-thread recording ----------
+bool v3_hist_group_init(v3_hist_group *g, v3_pool *pool) {
+    if (g == NULL) {
+        v3_error("v3_hist_group_init received NULL pointer");
+        return false;
+    }
+    g->pool = pool ? pool : v3_pool_default();
+    g->count = v3_pool_size(g->pool) + 1;
+    g->shards = calloc(g->count, sizeof(v3_hist));
+    if (g->shards == NULL) {
+        v3_error("v3_hist_group_init out of memory");
+        return false;
+    }
+    for (unsigned i = 0; i < g->count; i++) {
+        if (!v3_hist_init(&g->shards[i])) {
+            g->count = i;
+            v3_hist_group_free(g);
+            return false;
+        }
+    }
+    return true;
+}
+
+void v3_hist_group_free(v3_hist_group *g) {
+    if (g == NULL || g->shards == NULL) return;
+    for (unsigned i = 0; i < g->count; i++) v3_hist_free(&g->shards[i]);
+    free(g->shards);
+    g->shards = NULL;
+    g->count = 0;
+}
+
+void v3_hist_group_reset(v3_hist_group *g) {
+    if (g == NULL) return;
+    for (unsigned i = 0; i < g->count; i++) v3_hist_reset(&g->shards[i]);
+}
+
+v3_hist *v3_hist_group_local(v3_hist_group *g) {
+    int worker = v3_pool_current_worker(g->pool);
+    return &g->shards[worker + 1];
+}
+
+void v3_hist_group_merge(v3_hist *dst, const v3_hist_group *g) {
+    if (dst == NULL || g == NULL) {
+        v3_error("v3_hist_group_merge received NULL pointer");
+        return;
+    }
+    for (unsigned i = 0; i < g->count; i++) v3_hist_merge(dst, &g->shards[i]);
+}
+
+// ---------- export ----------
+void v3_hist_write_csv_header(FILE *f) {
+    fprintf(f, "name,count,min_ns,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+}
+
+void v3_hist_write_csv(FILE *f, const char *name, const v3_hist *h) {
+    fprintf(f, "%s,%llu,%llu,%.1f,%llu,%llu,%llu,%llu,%llu\n", name, (unsigned long long)h->total,
+            (unsigned long long)(h->total ? h->min : 0), v3_hist_mean(h),
+            (unsigned long long)v3_hist_percentile(h, 50.0), (unsigned long long)v3_hist_percentile(h, 90.0),
+            (unsigned long long)v3_hist_percentile(h, 99.0), (unsigned long long)v3_hist_percentile(h, 99.9),
+            (unsigned long long)h->max);
+}
+
+void v3_hist_write_json(FILE *f, const char *name, const v3_hist *h) {
+    fprintf(f,
+            "{\"name\": \"%s\", \"count\": %llu, \"min_ns\": %llu, \"mean_ns\": %.1f, \"p50_ns\": %llu, "
+            "\"p90_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu}",
+            name, (unsigned long long)h->total, (unsigned long long)(h->total ? h->min : 0), v3_hist_mean(h),
+            (unsigned long long)v3_hist_percentile(h, 50.0), (unsigned long long)v3_hist_percentile(h, 90.0),
+            (unsigned long long)v3_hist_percentile(h, 99.0), (unsigned long long)v3_hist_percentile(h, 99.9),
+            (unsigned long long)h->max);
+}
@@ -0,0 +1,87 @@
+#ifndef V3HIST_H
+#define V3HIST_H
+
+#include "v3pool.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Latency histograms in the style of HdrHistogram: values (nanoseconds by
+// convention) below 2 * V3_HIST_SUB are counted exactly, larger ones in
+// V3_HIST_SUB linear buckets per power of two, so any value from 1 ns to
+// hours is kept to within 1 / V3_HIST_SUB (0.8%) with a fixed-size array
+// and O(1) recording. Percentiles report the highest value of their bucket.
+//
+//   v3_hist_group g;                          // one histogram per pool thread
+//   v3_hist_group_init(&g, pool);
+//   ... in any pool task: v3_hist_record(v3_hist_group_local(&g), ns);
+//   v3_hist total;
+//   v3_hist_init(&total);
+//   v3_hist_group_merge(&total, &g);
+//   uint64_t p99 = v3_hist_percentile(&total, 99.0);
+
+#define V3_HIST_SUB_BITS 7
+#define V3_HIST_SUB (1u << V3_HIST_SUB_BITS)
+#define V3_HIST_BUCKETS ((64 - V3_HIST_SUB_BITS) * V3_HIST_SUB + V3_HIST_SUB)
+
+typedef struct {
+    uint64_t *counts;   // V3_HIST_BUCKETS
+    uint64_t total;     // values recorded
+    uint64_t min, max;  // exact; min is UINT64_MAX while empty
+    double sum;
+} v3_hist;
+
+bool v3_hist_init(v3_hist *h);
+void v3_hist_free(v3_hist *h);
+void v3_hist_reset(v3_hist *h);
+
+// Not thread-safe: give every thread its own histogram (v3_hist_group).
+void v3_hist_record(v3_hist *h, uint64_t value);
+
+// Add every value of src to dst.
+void v3_hist_merge(v3_hist *dst, const v3_hist *src);
+
+// Smallest recorded value v such that p percent of the values are <= v, up
+// to bucket precision and clamped to [min, max]; 0 for an empty histogram.
+uint64_t v3_hist_percentile(const v3_hist *h, double p);
+double v3_hist_mean(const v3_hist *h);
+
+// Monotonic clock in nanoseconds, for the values above.
+uint64_t v3_hist_now_ns(void);
+
+// ---------- per-thread recording ----------
+// One histogram per worker of pool plus one shared by every thread outside
+// it (e.g. the thread calling v3_pool_parallel_for, which takes part in the
+// work), so recording from pool tasks never contends. Only one non-worker
+// thread may record at a time.
+typedef struct {
+    v3_pool *pool;
+    v3_hist *shards;    // shards[0]: non-workers, shards[1 + i]: worker i
+    unsigned count;
+} v3_hist_group;
+
+bool v3_hist_group_init(v3_hist_group *g, v3_pool *pool);
+void v3_hist_group_free(v3_hist_group *g);
+void v3_hist_group_reset(v3_hist_group *g);
+v3_hist *v3_hist_group_local(v3_hist_group *g);
+void v3_hist_group_merge(v3_hist *dst, const v3_hist_group *g);
+
+// ---------- export ----------
+// A summary row: count, min, mean, p50, p90, p99, p99.9 and max in ns.
+// CSV rows follow v3_hist_write_csv_header; JSON rows are one object per
+// line, without separators (see v3bench for a complete document).
+void v3_hist_write_csv_header(FILE *f);
+void v3_hist_write_csv(FILE *f, const char *name, const v3_hist *h);
+void v3_hist_write_json(FILE *f, const char *name, const v3_hist *h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
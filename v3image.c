@@ -0,0 +1,270 @@
+#include "v3image.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Every kernel has a scalar form and a 4-wide SSE2 form that perform the
+// same float operations in the same order, so output does not depend on
+// where a buffer is split between the two.
+
+#define V3_IMAGE_GRAIN 16384      // pixels per parallel_for chunk
+#define V3_IMAGE_PARALLEL_MIN 65536
+
+// polynomial fits on [0, 1): log2(1 + t) (abs error 1.7e-5), 2^t (rel error 1.1e-7)
+#define LOG2_C0 1.65146709e-05f
+#define LOG2_C1 1.44149241f
+#define LOG2_C2 -0.706486449f
+#define LOG2_C3 0.409470299f
+#define LOG2_C4 -0.187488605f
+#define LOG2_C5 0.0430049578f
+#define EXP2_C0 0.999999898f
+#define EXP2_C1 0.69315449f
+#define EXP2_C2 0.240141818f
+#define EXP2_C3 0.0558603371f
+#define EXP2_C4 0.00894959042f
+#define EXP2_C5 0.00189375406f
+
+#define SRGB_CUTOFF 0.0031308f
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+static uint32_t float_bits(float x) {
+    uint32_t u;
+    memcpy(&u, &x, sizeof(u));
+    return u;
+}
+
+static float bits_float(uint32_t u) {
+    float x;
+    memcpy(&x, &u, sizeof(x));
+    return x;
+}
+
+static float clamp01(float x) {
+    x = x > 0.0f ? x : 0.0f;   // also maps NaN to 0, like _mm_max_ps
+    return x < 1.0f ? x : 1.0f;
+}
+
+// ---------- scalar kernels ----------
+// x^(1/2.4) for x in (0, 1] as exp2(log2(x) / 2.4)
+static float pow_inv24(float x) {
+    uint32_t u = float_bits(x);
+    float e = (float)((int32_t)(u >> 23) - 127);
+    float t = bits_float((u & 0x007fffffu) | 0x3f800000u) - 1.0f;
+    float l = LOG2_C5;
+    l = l * t + LOG2_C4;
+    l = l * t + LOG2_C3;
+    l = l * t + LOG2_C2;
+    l = l * t + LOG2_C1;
+    l = l * t + LOG2_C0;
+    float y = (e + l) * (1.0f / 2.4f);
+
+    int32_t i = (int32_t)y;            // truncate, then floor for negatives
+    if ((float)i > y) i -= 1;
+    float f = y - (float)i;
+    float p = EXP2_C5;
+    p = p * f + EXP2_C4;
+    p = p * f + EXP2_C3;
+    p = p * f + EXP2_C2;
+    p = p * f + EXP2_C1;
+    p = p * f + EXP2_C0;
+    return bits_float(float_bits(p) + ((uint32_t)i << 23));
+}
+
+static uint8_t srgb8(float x) {
+    x = clamp01(x);
+    float lin = x * 12.92f;
+    float pw = pow_inv24(x) * 1.055f - 0.055f;
+    float v = x <= SRGB_CUTOFF ? lin : pw;
+    return (uint8_t)(int32_t)(v * 255.0f + 0.5f);
+}
+
+static float tonemap(float x, float exposure, v3_tonemap op) {
+    x = x * exposure;
+    if (op == V3_TONEMAP_FILMIC) {
+        x = x > 0.0f ? x : 0.0f;
+        float num = x * (x * 2.51f + 0.03f);
+        float den = x * (x * 2.43f + 0.59f) + 0.14f;
+        x = num / den;
+    }
+    return clamp01(x);
+}
+
+// ---------- SSE2 kernels ----------
+#ifdef __SSE2__
+static __m128 pow_inv24_4(__m128 x) {
+    __m128i u = _mm_castps_si128(x);
+    __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(u, 23), _mm_set1_epi32(127)));
+    __m128 t = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_and_si128(u, _mm_set1_epi32(0x007fffff)),
+                                                         _mm_set1_epi32(0x3f800000))),
+                          _mm_set1_ps(1.0f));
+    __m128 l = _mm_set1_ps(LOG2_C5);
+    l = _mm_add_ps(_mm_mul_ps(l, t), _mm_set1_ps(LOG2_C4));
+    l = _mm_add_ps(_mm_mul_ps(l, t), _mm_set1_ps(LOG2_C3));
+    l = _mm_add_ps(_mm_mul_ps(l, t), _mm_set1_ps(LOG2_C2));
+    l = _mm_add_ps(_mm_mul_ps(l, t), _mm_set1_ps(LOG2_C1));
+    l = _mm_add_ps(_mm_mul_ps(l, t), _mm_set1_ps(LOG2_C0));
+    __m128 y = _mm_mul_ps(_mm_add_ps(e, l), _mm_set1_ps(1.0f / 2.4f));
+
+    __m128i i = _mm_cvttps_epi32(y);
+    // floor: subtract 1 where truncation rounded up (mask is all ones = -1)
+    i = _mm_add_epi32(i, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(i), y)));
+    __m128 f = _mm_sub_ps(y, _mm_cvtepi32_ps(i));
+    __m128 p = _mm_set1_ps(EXP2_C5);
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(EXP2_C4));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(EXP2_C3));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(EXP2_C2));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(EXP2_C1));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(EXP2_C0));
+    return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(p), _mm_slli_epi32(i, 23)));
+}
+
+static __m128 clamp01_4(__m128 x) {
+    return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+static __m128 tonemap4(__m128 x, float exposure, v3_tonemap op) {
+    x = _mm_mul_ps(x, _mm_set1_ps(exposure));
+    if (op == V3_TONEMAP_FILMIC) {
+        x = _mm_max_ps(x, _mm_setzero_ps());
+        __m128 num = _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(2.51f)), _mm_set1_ps(0.03f)));
+        __m128 den = _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(2.43f)), _mm_set1_ps(0.59f))),
+                                _mm_set1_ps(0.14f));
+        x = _mm_div_ps(num, den);
+    }
+    return clamp01_4(x);
+}
+
+// 4 linear values to sRGB code values as 32-bit integers
+static __m128i srgb8_4(__m128 x) {
+    x = clamp01_4(x);
+    __m128 lin = _mm_mul_ps(x, _mm_set1_ps(12.92f));
+    __m128 pw = _mm_sub_ps(_mm_mul_ps(pow_inv24_4(x), _mm_set1_ps(1.055f)), _mm_set1_ps(0.055f));
+    __m128 low = _mm_cmple_ps(x, _mm_set1_ps(SRGB_CUTOFF));
+    __m128 v = _mm_or_ps(_mm_and_ps(low, lin), _mm_andnot_ps(low, pw));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+// 16 code values (four groups of 4) to bytes
+static void store_bytes16(uint8_t *dst, __m128i a, __m128i b, __m128i c, __m128i d) {
+    __m128i lo = _mm_packs_epi32(a, b);
+    __m128i hi = _mm_packs_epi32(c, d);
+    _mm_storeu_si128((__m128i *)dst, _mm_packus_epi16(lo, hi));
+}
+#endif
+
+// ---------- batched API ----------
+void v3_image_tonemap_n(float *dst, float *rgb, size_t count, float exposure, v3_tonemap op) {
+    if (dst == NULL || rgb == NULL) {
+        v3_error("v3_image_tonemap_n received NULL pointer");
+        return;
+    }
+    size_t n = 3 * count, i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(dst + i, tonemap4(_mm_loadu_ps(rgb + i), exposure, op));
+    }
+#endif
+    for (; i < n; i++) dst[i] = tonemap(rgb[i], exposure, op);
+}
+
+void v3_image_srgb8_n(uint8_t *dst, float *linear, size_t count) {
+    if (dst == NULL || linear == NULL) {
+        v3_error("v3_image_srgb8_n received NULL pointer");
+        return;
+    }
+    size_t n = 3 * count, i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= n; i += 16) {
+        store_bytes16(dst + i, srgb8_4(_mm_loadu_ps(linear + i)), srgb8_4(_mm_loadu_ps(linear + i + 4)),
+                      srgb8_4(_mm_loadu_ps(linear + i + 8)), srgb8_4(_mm_loadu_ps(linear + i + 12)));
+    }
+#endif
+    for (; i < n; i++) dst[i] = srgb8(linear[i]);
+}
+
+typedef struct {
+    uint8_t *dst;
+    float *rgb;
+    float exposure;
+    v3_tonemap op;
+} srgb8_ctx;
+
+static void to_srgb8_range(void *arg, size_t begin, size_t end) {
+    srgb8_ctx *c = arg;
+    size_t i = 3 * begin, n = 3 * end;
+#ifdef __SSE2__
+    for (; i + 16 <= n; i += 16) {
+        __m128i q[4];
+        for (int k = 0; k < 4; k++) {
+            q[k] = srgb8_4(tonemap4(_mm_loadu_ps(c->rgb + i + 4 * k), c->exposure, c->op));
+        }
+        store_bytes16(c->dst + i, q[0], q[1], q[2], q[3]);
+    }
+#endif
+    for (; i < n; i++) c->dst[i] = srgb8(tonemap(c->rgb[i], c->exposure, c->op));
+}
+
+void v3_image_to_srgb8(uint8_t *dst, float *rgb, size_t count, float exposure,
+                       v3_tonemap op, v3_pool *pool) {
+    if (dst == NULL || rgb == NULL) {
+        v3_error("v3_image_to_srgb8 received NULL pointer");
+        return;
+    }
+    srgb8_ctx c = {dst, rgb, exposure, op};
+    if (count < V3_IMAGE_PARALLEL_MIN) {
+        to_srgb8_range(&c, 0, count);
+        return;
+    }
+    if (pool == NULL) pool = v3_pool_default();
+    v3_pool_parallel_for(pool, count, V3_IMAGE_GRAIN, to_srgb8_range, &c);
+}
+
+// ---------- writers ----------
+bool v3_image_write_ppm(const char *path, uint8_t *rgb8, int width, int height) {
+    if (path == NULL || rgb8 == NULL) {
+        v3_error("v3_image_write_ppm received NULL pointer");
+        return false;
+    }
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Error: cannot open %s for writing\n", path);
+        return false;
+    }
+    size_t bytes = 3 * (size_t)width * (size_t)height;
+    bool ok = fprintf(f, "P6\n%d %d\n255\n", width, height) > 0 && fwrite(rgb8, 1, bytes, f) == bytes;
+    if (fclose(f) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Error: failed writing %s\n", path);
+    return ok;
+}
+
+bool v3_image_write_pfm(const char *path, float *rgb, int width, int height) {
+    if (path == NULL || rgb == NULL) {
+        v3_error("v3_image_write_pfm received NULL pointer");
+        return false;
+    }
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Error: cannot open %s for writing\n", path);
+        return false;
+    }
+    // a negative scale marks little-endian samples
+    uint16_t probe = 1;
+    bool little = *(uint8_t *)&probe == 1;
+    bool ok = fprintf(f, "PF\n%d %d\n%s\n", width, height, little ? "-1.0" : "1.0") > 0;
+    size_t row = 3 * (size_t)width;
+    for (int y = height - 1; ok && y >= 0; y--) {
+        ok = fwrite(rgb + (size_t)y * row, sizeof(float), row, f) == row;
+    }
+    if (fclose(f) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Error: failed writing %s\n", path);
+    return ok;
+}
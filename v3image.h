@@ -0,0 +1,48 @@
+#ifndef V3IMAGE_H
+#define V3IMAGE_H
+
+#include "v3pool.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Color output pipeline for packed float r g b images: exposure, tonemap,
+// sRGB encoding and 8-bit quantization in one pass, plus buffered writers.
+// Channels are independent, so count is the number of pixels and every
+// buffer holds 3 * count values.
+
+typedef enum {
+    V3_TONEMAP_CLAMP,    // clamp to [0, 1]
+    V3_TONEMAP_FILMIC,   // ACES filmic curve (Narkowicz fit)
+} v3_tonemap;
+
+// dst = tonemap(rgb * exposure), linear, in [0, 1]. dst may equal rgb.
+void v3_image_tonemap_n(float *dst, float *rgb, size_t count, float exposure, v3_tonemap op);
+
+// 8-bit sRGB of linear values in [0, 1] (values outside are clamped).
+// The transfer curve uses a polynomial log2/exp2 pow that stays within one
+// code value of the exact curve.
+void v3_image_srgb8_n(uint8_t *dst, float *linear, size_t count);
+
+// Fused exposure, tonemap, sRGB encode and quantize. Large images are split
+// across pool (the default pool if NULL); results do not depend on the split.
+void v3_image_to_srgb8(uint8_t *dst, float *rgb, size_t count, float exposure,
+                       v3_tonemap op, v3_pool *pool);
+
+// binary PPM (P6) from 8-bit sRGB rows, top row first
+bool v3_image_write_ppm(const char *path, uint8_t *rgb8, int width, int height);
+
+// little-endian PFM (PF) of linear float rows, top row first in memory
+// (the file stores rows bottom to top as the format requires)
+bool v3_image_write_pfm(const char *path, float *rgb, int width, int height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -175,6 +175,115 @@ void v3_reflect(float *dst, float *v, float *n) {
     dst[2] = vz - 2.0f * dotvn * nn[2];
 }
 
+bool v3_refract(float *dst, float *d, float *n, float eta) {
+    if (!v3_valid_ptr3(dst) || !v3_valid_ptr3(d) || !v3_valid_ptr3(n)) {
+        v3_error("v3_refract received NULL pointer");
+        return false;
+    }
+    float refl[3];
+    return v3_reflect_refract(refl, dst, d, n, eta);
+}
+
+bool v3_reflect_refract(float *refl, float *refr, float *d, float *n, float eta) {
+    if (!v3_valid_ptr3(refl) || !v3_valid_ptr3(refr) || !v3_valid_ptr3(d) || !v3_valid_ptr3(n)) {
+        v3_error("v3_reflect_refract received NULL pointer");
+        return false;
+    }
+    // read everything first so refl or refr may alias an input
+    float dx = d[0], dy = d[1], dz = d[2];
+    float nx = n[0], ny = n[1], nz = n[2];
+    float cosi = -(dx*nx + dy*ny + dz*nz);
+
+    // r = d - 2*dot(d,n)*n = d + 2*cosi*n
+    float r = 2.0f * cosi;
+    refl[0] = dx + r * nx;
+    refl[1] = dy + r * ny;
+    refl[2] = dz + r * nz;
+
+    // t = eta*d + (eta*cosi - cos_t)*n with cos_t^2 = 1 - eta^2*(1 - cosi^2)
+    float k = 1.0f - eta * eta * (1.0f - cosi * cosi);
+    if (k < 0.0f) return false;
+    float s = eta * cosi - sqrtf(k);
+    refr[0] = eta * dx + s * nx;
+    refr[1] = eta * dy + s * ny;
+    refr[2] = eta * dz + s * nz;
+    return true;
+}
+
+float v3_fresnel_exact(float cos_i, float eta) {
+    cos_i = clampf(cos_i, 0.0f, 1.0f);
+    float k = 1.0f - eta * eta * (1.0f - cos_i * cos_i);
+    if (k < 0.0f) return 1.0f;
+    float cos_t = sqrtf(k);
+    float ds = eta * cos_i + cos_t, dp = cos_i + eta * cos_t;
+    // both vanish only for a grazing ray with eta == 1
+    if (ds == 0.0f || dp == 0.0f) return 1.0f;
+    float rs = (eta * cos_i - cos_t) / ds;
+    float rp = (cos_i - eta * cos_t) / dp;
+    return 0.5f * (rs * rs + rp * rp);
+}
+
+float v3_fresnel_schlick(float cos_i, float eta) {
+    cos_i = clampf(cos_i, 0.0f, 1.0f);
+    float r0 = (1.0f - eta) / (1.0f + eta);
+    r0 *= r0;
+    float c = cos_i;
+    if (eta > 1.0f) {
+        // leaving the denser medium: use the transmitted angle
+        float k = 1.0f - eta * eta * (1.0f - cos_i * cos_i);
+        if (k < 0.0f) return 1.0f;
+        c = sqrtf(k);
+    }
+    float x = 1.0f - c, x2 = x * x;
+    return r0 + (1.0f - r0) * (x2 * x2 * x);
+}
+
+void v3_transform_point(float *dst, float *m, float *p) {
+    if (!v3_valid_ptr3(dst) || m == NULL || !v3_valid_ptr3(p)) {
+        v3_error("v3_transform_point received NULL pointer");
+        return;
+    }
+    float x = p[0], y = p[1], z = p[2];
+    dst[0] = m[0]*x + m[1]*y + m[2]*z + m[3];
+    dst[1] = m[4]*x + m[5]*y + m[6]*z + m[7];
+    dst[2] = m[8]*x + m[9]*y + m[10]*z + m[11];
+}
+
+void v3_transform_vector(float *dst, float *m, float *v) {
+    if (!v3_valid_ptr3(dst) || m == NULL || !v3_valid_ptr3(v)) {
+        v3_error("v3_transform_vector received NULL pointer");
+        return;
+    }
+    float x = v[0], y = v[1], z = v[2];
+    dst[0] = m[0]*x + m[1]*y + m[2]*z;
+    dst[1] = m[4]*x + m[5]*y + m[6]*z;
+    dst[2] = m[8]*x + m[9]*y + m[10]*z;
+}
+
+bool v3_affine_invert(float *dst, float *m) {
+    if (dst == NULL || m == NULL) {
+        v3_error("v3_affine_invert received NULL pointer");
+        return false;
+    }
+    // inverse of R from its cofactors, then t' = -R^-1 * t
+    float c[9] = {
+        m[5]*m[10] - m[6]*m[9], m[2]*m[9] - m[1]*m[10], m[1]*m[6] - m[2]*m[5],
+        m[6]*m[8] - m[4]*m[10], m[0]*m[10] - m[2]*m[8], m[2]*m[4] - m[0]*m[6],
+        m[4]*m[9] - m[5]*m[8], m[1]*m[8] - m[0]*m[9], m[0]*m[5] - m[1]*m[4],
+    };
+    float det = m[0]*c[0] + m[1]*c[3] + m[2]*c[6];
+    if (det == 0.0f || !isfinite(det)) return false;
+    float inv = 1.0f / det, t[3] = {m[3], m[7], m[11]};
+    for (int r = 0; r < 3; r++) {
+        float *row = dst + 4 * r;
+        row[0] = c[3 * r] * inv;
+        row[1] = c[3 * r + 1] * inv;
+        row[2] = c[3 * r + 2] * inv;
+        row[3] = -(row[0]*t[0] + row[1]*t[1] + row[2]*t[2]);
+    }
+    return true;
+}
+
 bool v3_equals(float *a, float *b, float tolerance) {
     if (!v3_valid_ptr3(a) || !v3_valid_ptr3(b)) return false;
     if (tolerance < 0.0f) tolerance = -tolerance;
@@ -27,6 +27,30 @@ float v3_angle_quick(float *a, float *b);  // returns cos(theta), no acos
 // reflect v about n: dst = v - 2*proj_n(v) (n need not be normalized)
 void v3_reflect(float *dst, float *v, float *n);
 
+// Snell refraction of unit d through a surface with unit normal n facing
+// against d, eta = n_from / n_to. Returns false on total internal reflection
+// and leaves dst unchanged.
+bool v3_refract(float *dst, float *d, float *n, float eta);
+
+// reflect and refract together from one dot(d, n) (unit d and n as above);
+// refl is always written, refr only when the result is true
+bool v3_reflect_refract(float *refl, float *refr, float *d, float *n, float eta);
+
+// Fresnel reflectance of a dielectric for unpolarized light, cos_i = -dot(d, n)
+// and eta = n_from / n_to; 1 under total internal reflection. The exact form
+// averages the s and p terms; Schlick's approximation uses the cosine on the
+// optically thinner side, so it also holds from inside glass.
+float v3_fresnel_exact(float cos_i, float eta);
+float v3_fresnel_schlick(float cos_i, float eta);
+
+// Affine transform by m, a row-major 3x4 matrix [R | t] (12 floats):
+// points get R*p + t, direction vectors R*v. dst may be the input.
+void v3_transform_point(float *dst, float *m, float *p);
+void v3_transform_vector(float *dst, float *m, float *v);
+
+// dst = inverse of the affine m; false (dst unchanged) if R is singular
+bool v3_affine_invert(float *dst, float *m);
+
 float v3_length(float *a);
 
 void v3_normalize(float *dst, float *a);
@@ -0,0 +1,191 @@
+#define _GNU_SOURCE  // sched_getaffinity, CPU_ISSET
+
+#include "v3numa.h"
+
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define V3_PAGE_SIZE 4096
+#define V3_MAX_NODES 256
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+// Parse a kernel cpulist/nodelist such as "0-3,8,10-11" into a membership
+// table. Returns false if the file cannot be read.
+static bool read_list(const char *path, bool *member, size_t max) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return false;
+
+    char buf[4096];
+    size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[len] = '\0';
+
+    memset(member, 0, max * sizeof(bool));
+    char *p = buf;
+    while (*p != '\0' && *p != '\n') {
+        char *end;
+        unsigned long lo = strtoul(p, &end, 10);
+        if (end == p) return false;
+        unsigned long hi = lo;
+        p = end;
+        if (*p == '-') {
+            hi = strtoul(p + 1, &end, 10);
+            p = end;
+        }
+        for (unsigned long i = lo; i <= hi && i < max; i++) member[i] = true;
+        if (*p == ',') p++;
+    }
+    return true;
+}
+
+// ---------- topology ----------
+unsigned v3_numa_node_count(void) {
+    bool nodes[V3_MAX_NODES];
+    if (!read_list("/sys/devices/system/node/online", nodes, V3_MAX_NODES)) return 1;
+
+    unsigned count = 0;
+    for (size_t i = 0; i < V3_MAX_NODES; i++) count += nodes[i];
+    return count > 0 ? count : 1;
+}
+
+size_t v3_numa_cpus_by_node(int *cpus, unsigned *nodes, size_t max) {
+    if (cpus == NULL || nodes == NULL) {
+        v3_error("v3_numa_cpus_by_node received NULL pointer");
+        return 0;
+    }
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return 0;
+
+    size_t n = 0;
+    bool online[V3_MAX_NODES];
+    if (read_list("/sys/devices/system/node/online", online, V3_MAX_NODES)) {
+        bool in_node[CPU_SETSIZE];
+        for (unsigned node = 0; node < V3_MAX_NODES && n < max; node++) {
+            if (!online[node]) continue;
+            char path[64];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+            if (!read_list(path, in_node, CPU_SETSIZE)) continue;
+            for (int cpu = 0; cpu < CPU_SETSIZE && n < max; cpu++) {
+                if (in_node[cpu] && CPU_ISSET(cpu, &allowed)) {
+                    cpus[n] = cpu;
+                    nodes[n] = node;
+                    n++;
+                }
+            }
+        }
+    }
+    if (n == 0) {
+        // no sysfs topology: treat every allowed CPU as node 0
+        for (int cpu = 0; cpu < CPU_SETSIZE && n < max; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus[n] = cpu;
+                nodes[n] = 0;
+                n++;
+            }
+        }
+    }
+    return n;
+}
+
+size_t v3_numa_spread(const int *cpus, const unsigned *nodes, size_t n, int *out_cpus, unsigned *out_nodes,
+                      size_t count) {
+    if (cpus == NULL || nodes == NULL || out_cpus == NULL || out_nodes == NULL) {
+        v3_error("v3_numa_spread received NULL pointer");
+        return 0;
+    }
+    if (n == 0 || count == 0) return 0;
+    bool *chosen = calloc(n, sizeof(bool));
+    if (chosen == NULL) {
+        v3_error("v3_numa_spread out of memory");
+        return 0;
+    }
+    // round r takes the r-th CPU of every node that has one
+    size_t want = count < n ? count : n, picked = 0;
+    for (size_t r = 0; picked < want; r++) {
+        size_t pos = 0;
+        for (size_t i = 0; i < n && picked < want; i++) {
+            pos = i > 0 && nodes[i] == nodes[i - 1] ? pos + 1 : 0;
+            if (pos == r) {
+                chosen[i] = true;
+                picked++;
+            }
+        }
+    }
+    // keep the input's node order; more entries than CPUs wrap around
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!chosen[i]) continue;
+        out_cpus[k] = cpus[i];
+        out_nodes[k] = nodes[i];
+        k++;
+    }
+    for (; k < count; k++) {
+        out_cpus[k] = out_cpus[k % n];
+        out_nodes[k] = out_nodes[k % n];
+    }
+    free(chosen);
+    return count;
+}
+
+size_t v3_numa_worker_cpus(int *cpus, unsigned *nodes, size_t count) {
+    if (cpus == NULL || nodes == NULL) {
+        v3_error("v3_numa_worker_cpus received NULL pointer");
+        return 0;
+    }
+    int *all = malloc(CPU_SETSIZE * sizeof(int));
+    unsigned *all_nodes = malloc(CPU_SETSIZE * sizeof(unsigned));
+    size_t n = 0;
+    if (all == NULL || all_nodes == NULL) {
+        v3_error("v3_numa_worker_cpus out of memory");
+    } else {
+        n = v3_numa_cpus_by_node(all, all_nodes, CPU_SETSIZE);
+    }
+    size_t written = n > 0 ? v3_numa_spread(all, all_nodes, n, cpus, nodes, count) : 0;
+    free(all_nodes);
+    free(all);
+    return written;
+}
+
+// ---------- placement ----------
+static void zero_range(void *arg, size_t begin, size_t end) {
+    float *p = arg;
+    memset(p + 3 * begin, 0, (end - begin) * 3 * sizeof(float));
+}
+
+float *v3_numa_alloc(v3_pool *pool, size_t count) {
+    size_t bytes = count * 3 * sizeof(float);
+    bytes = (bytes + V3_PAGE_SIZE - 1) / V3_PAGE_SIZE * V3_PAGE_SIZE;
+    if (bytes == 0) bytes = V3_PAGE_SIZE;
+
+    // aligned_alloc leaves large blocks untouched, so no page has a node yet
+    float *p = aligned_alloc(V3_PAGE_SIZE, bytes);
+    if (p == NULL) {
+        v3_error("v3_numa_alloc out of memory");
+        return NULL;
+    }
+    v3_pool_parallel_for_static(pool, count, zero_range, p);
+    return p;
+}
+
+void v3_numa_free(float *p) {
+    free(p);
+}
+
+static void run_range(void *arg, size_t begin, size_t end) {
+    v3_job_run_range(arg, begin, end);
+}
+
+void v3_numa_run(v3_pool *pool, const v3_job *job) {
+    if (job == NULL) {
+        v3_error("v3_numa_run received NULL pointer");
+        return;
+    }
+    v3_pool_parallel_for_static(pool, job->count, run_range, (void *)job);
+}
@@ -0,0 +1,48 @@
+#ifndef V3NUMA_H
+#define V3NUMA_H
+
+#include <stddef.h>
+
+#include "v3async.h"
+#include "v3pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// NUMA placement helpers. Linux places a page on the node of the thread that
+// first writes it, so buffers allocated here are zeroed in parallel by a
+// pinned pool using the same static chunking that v3_numa_run uses later:
+// every chunk is then processed by a thread on the node that holds it.
+
+// number of NUMA nodes (1 when the topology cannot be read)
+unsigned v3_numa_node_count(void);
+
+// Fill cpus[]/nodes[] with up to max CPUs this process may run on, ordered
+// node by node. Returns the number of entries written, 0 on failure.
+size_t v3_numa_cpus_by_node(int *cpus, unsigned *nodes, size_t max);
+
+// Choose count worker CPUs from the n node-ordered entries of cpus/nodes,
+// taking them round-robin across nodes so a pool smaller than one node
+// still reaches every node's memory. The result stays ordered by node;
+// more workers than CPUs wrap around. Returns count, 0 on failure.
+size_t v3_numa_spread(const int *cpus, const unsigned *nodes, size_t n, int *out_cpus, unsigned *out_nodes,
+                      size_t count);
+
+// v3_numa_spread over every CPU this process may run on
+size_t v3_numa_worker_cpus(int *cpus, unsigned *nodes, size_t count);
+
+// Allocate `count` packed vectors, page aligned, zeroed by first touch on
+// the pool's workers. Use a pool created with V3_POOL_PIN_THREADS for the
+// placement to stick. Release with v3_numa_free.
+float *v3_numa_alloc(v3_pool *pool, size_t count);
+void v3_numa_free(float *p);
+
+// run a batched job with the static worker-to-chunk mapping of v3_numa_alloc
+void v3_numa_run(v3_pool *pool, const v3_job *job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,188 @@
+#define _GNU_SOURCE  // syscall
+
+#include "v3perf.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+#define V3_PERF_HW_EVENTS 6
+#define V3_PERF_FP_EVENTS 4
+
+struct v3_perf {
+    int hw[V3_PERF_HW_EVENTS];   // hw[0] leads the group; -1 when closed
+    int fp[V3_PERF_FP_EVENTS];
+    char reason[128];
+};
+
+static void close_group(int *fds, int n) {
+    for (int i = 0; i < n; i++) {
+#ifdef __linux__
+        if (fds[i] >= 0) close(fds[i]);
+#endif
+        fds[i] = -1;
+    }
+}
+
+#ifdef __linux__
+static int open_event(uint32_t type, uint64_t config, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group < 0;   // members follow the leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+// open every event of a group or none of them
+static bool open_group(int *fds, uint32_t type, const uint64_t *configs, int n) {
+    for (int i = 0; i < n; i++) {
+        fds[i] = open_event(type, configs[i], i == 0 ? -1 : fds[0]);
+        if (fds[i] < 0) {
+            int err = errno;
+            close_group(fds, i);
+            errno = err;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool is_intel(void) {
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (f == NULL) return false;
+    char line[256];
+    bool intel = false;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (strncmp(line, "vendor_id", 9) == 0) {
+            intel = strstr(line, "GenuineIntel") != NULL;
+            break;
+        }
+    }
+    fclose(f);
+    return intel;
+}
+
+// Read a group into values[n], scaled by enabled / running time.
+static bool read_group(const int *fds, int n, uint64_t *values) {
+    uint64_t buf[3 + V3_PERF_HW_EVENTS];
+    ssize_t want = (ssize_t)((3 + (size_t)n) * sizeof(uint64_t));
+    if (read(fds[0], buf, sizeof(buf)) != want || buf[0] != (uint64_t)n) return false;
+    double scale = buf[2] > 0 ? (double)buf[1] / (double)buf[2] : 0.0;
+    for (int i = 0; i < n; i++) values[i] = (uint64_t)((double)buf[3 + i] * scale + 0.5);
+    return true;
+}
+#endif
+
+v3_perf *v3_perf_open(void) {
+    v3_perf *p = malloc(sizeof(*p));
+    if (p == NULL) {
+        v3_error("v3_perf_open out of memory");
+        return NULL;
+    }
+    for (int i = 0; i < V3_PERF_HW_EVENTS; i++) p->hw[i] = -1;
+    for (int i = 0; i < V3_PERF_FP_EVENTS; i++) p->fp[i] = -1;
+    p->reason[0] = '\0';
+#ifdef __linux__
+    static const uint64_t hw[V3_PERF_HW_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES,          PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_REFERENCES,    PERF_COUNT_HW_CACHE_MISSES,
+    };
+    // FP_ARITH_INST_RETIRED (event 0xc7): scalar, 128-, 256- and 512-bit
+    // packed single precision
+    static const uint64_t fp[V3_PERF_FP_EVENTS] = {0x02c7, 0x08c7, 0x20c7, 0x80c7};
+    if (!open_group(p->hw, PERF_TYPE_HARDWARE, hw, V3_PERF_HW_EVENTS)) {
+        snprintf(p->reason, sizeof(p->reason), "no hardware counters (%s)", strerror(errno));
+    } else if (is_intel()) {
+        open_group(p->fp, PERF_TYPE_RAW, fp, V3_PERF_FP_EVENTS);
+    }
+#else
+    snprintf(p->reason, sizeof(p->reason), "perf_event_open needs Linux");
+#endif
+    return p;
+}
+
+void v3_perf_close(v3_perf *p) {
+    if (p == NULL) return;
+    close_group(p->hw, V3_PERF_HW_EVENTS);
+    close_group(p->fp, V3_PERF_FP_EVENTS);
+    free(p);
+}
+
+bool v3_perf_available(const v3_perf *p, const char **reason) {
+    if (p == NULL) {
+        if (reason) *reason = "no perf handle";
+        return false;
+    }
+    if (reason) *reason = p->reason;
+    return p->hw[0] >= 0;
+}
+
+bool v3_perf_start(v3_perf *p) {
+    if (p == NULL) {
+        v3_error("v3_perf_start received NULL pointer");
+        return false;
+    }
+#ifdef __linux__
+    const int leaders[2] = {p->hw[0], p->fp[0]};
+    for (int i = 0; i < 2; i++) {
+        if (leaders[i] < 0) continue;
+        ioctl(leaders[i], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leaders[i], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+    return p->hw[0] >= 0;
+}
+
+bool v3_perf_stop(v3_perf *p, v3_perf_counts *counts) {
+    if (p == NULL || counts == NULL) {
+        v3_error("v3_perf_stop received NULL pointer");
+        return false;
+    }
+    memset(counts, 0, sizeof(*counts));
+#ifdef __linux__
+    if (p->hw[0] >= 0) ioctl(p->hw[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    if (p->fp[0] >= 0) ioctl(p->fp[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    uint64_t v[V3_PERF_HW_EVENTS];
+    if (p->hw[0] >= 0 && read_group(p->hw, V3_PERF_HW_EVENTS, v)) {
+        counts->hw = true;
+        counts->cycles = v[0];
+        counts->instructions = v[1];
+        counts->branches = v[2];
+        counts->branch_misses = v[3];
+        counts->cache_references = v[4];
+        counts->cache_misses = v[5];
+    }
+    if (p->fp[0] >= 0 && read_group(p->fp, V3_PERF_FP_EVENTS, v)) {
+        counts->fp = true;
+        counts->fp_scalar = v[0];
+        counts->fp_128 = v[1];
+        counts->fp_256 = v[2];
+        counts->fp_512 = v[3];
+    }
+#endif
+    return counts->hw;
+}
+
+double v3_perf_flops(const v3_perf_counts *c) {
+    if (c == NULL || !c->fp) return 0.0;
+    return (double)c->fp_scalar + 4.0 * (double)c->fp_128 + 8.0 * (double)c->fp_256 + 16.0 * (double)c->fp_512;
+}
@@ -0,0 +1,61 @@
+#ifndef V3PERF_H
+#define V3PERF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hardware performance counters for the calling thread (Linux
+// perf_event_open, user space only). Counting is optional: without a PMU,
+// with perf_event_paranoid too strict or on other systems the handle opens
+// anyway and v3_perf_available reports why nothing is counted.
+//
+//   v3_perf *perf = v3_perf_open();
+//   v3_perf_start(perf);
+//   v3_add_n(dst, a, b, count);
+//   v3_perf_counts c;
+//   v3_perf_stop(perf, &c);       // c.instructions / c.cycles is the IPC
+//
+// Two groups are counted: cycles, instructions, branches, branch misses,
+// cache references and cache misses (last-level cache), and on Intel CPUs
+// the single-precision FP_ARITH_INST_RETIRED events by vector width. When
+// the kernel multiplexes the groups the counts are scaled to the full
+// interval. Threads other than the caller (pool workers) are not counted.
+
+typedef struct {
+    bool hw;            // the first group below was counted
+    bool fp;            // the fp_* counts are valid
+    uint64_t cycles, instructions;
+    uint64_t branches, branch_misses;
+    uint64_t cache_references, cache_misses;
+    // single-precision FP arithmetic instructions retired: scalar and
+    // 128/256/512-bit packed. A fused multiply-add counts twice.
+    uint64_t fp_scalar, fp_128, fp_256, fp_512;
+} v3_perf_counts;
+
+typedef struct v3_perf v3_perf;
+
+v3_perf *v3_perf_open(void);
+void v3_perf_close(v3_perf *p);
+
+// false with a reason (e.g. "no hardware counters (No such file or
+// directory)") when no group could be opened; reason may be NULL.
+bool v3_perf_available(const v3_perf *p, const char **reason);
+
+// Reset and start counting / stop and read. stop zeroes *counts and clears
+// its flags for the groups that are not available.
+bool v3_perf_start(v3_perf *p);
+bool v3_perf_stop(v3_perf *p, v3_perf_counts *counts);
+
+// Floating-point operations from the fp_* counts: 1, 4, 8 or 16 per
+// instruction by width.
+double v3_perf_flops(const v3_perf_counts *c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,446 @@
+#define _GNU_SOURCE  // pthread_setaffinity_np
+
+#include "v3pool.h"
+#include "v3numa.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct v3_task {
+    v3_task_fn fn;
+    void *arg;
+    struct v3_task *next;
+} v3_task;
+
+typedef struct {
+    v3_pool *pool;
+    unsigned index;
+    pthread_t thread;
+    int cpu;             // -1 when not pinned
+    unsigned node;
+    v3_task *head;       // tasks submitted to this worker only
+    v3_task *tail;
+} v3_worker;
+
+struct v3_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t has_work;
+    v3_task *head;
+    v3_task *tail;
+    bool stopping;
+    unsigned nthreads;
+    v3_worker *workers;
+};
+
+static _Thread_local v3_worker *tl_worker = NULL;
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+static unsigned online_cpus(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1u;
+}
+
+static void task_push(v3_task **head, v3_task **tail, v3_task *t) {
+    if (*tail != NULL) (*tail)->next = t;
+    else *head = t;
+    *tail = t;
+}
+
+static v3_task *task_pop(v3_task **head, v3_task **tail) {
+    v3_task *t = *head;
+    if (t != NULL) {
+        *head = t->next;
+        if (*head == NULL) *tail = NULL;
+    }
+    return t;
+}
+
+static void pin_to_cpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        v3_error("v3_pool could not pin worker thread");
+    }
+#else
+    (void)cpu;
+#endif
+}
+
+static void *worker_main(void *arg) {
+    v3_worker *w = arg;
+    v3_pool *pool = w->pool;
+    tl_worker = w;
+    if (w->cpu >= 0) pin_to_cpu(w->cpu);
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (w->head == NULL && pool->head == NULL && !pool->stopping) {
+            pthread_cond_wait(&pool->has_work, &pool->lock);
+        }
+        // own queue first so pinned work is never starved by shared work
+        v3_task *t = task_pop(&w->head, &w->tail);
+        if (t == NULL) t = task_pop(&pool->head, &pool->tail);
+        if (t == NULL) break;  // stopping and drained
+        pthread_mutex_unlock(&pool->lock);
+
+        t->fn(t->arg);
+        free(t);
+
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// ---------- pool lifetime ----------
+v3_pool *v3_pool_create(unsigned nthreads) {
+    return v3_pool_create_ex(nthreads, 0);
+}
+
+v3_pool *v3_pool_create_ex(unsigned nthreads, unsigned flags) {
+    if (nthreads == 0) nthreads = online_cpus();
+
+    v3_pool *pool = calloc(1, sizeof(*pool));
+    if (pool == NULL) {
+        v3_error("v3_pool_create out of memory");
+        return NULL;
+    }
+    pool->workers = calloc(nthreads, sizeof(v3_worker));
+    int *cpus = calloc(nthreads, sizeof(int));
+    unsigned *nodes = calloc(nthreads, sizeof(unsigned));
+    if (pool->workers == NULL || cpus == NULL || nodes == NULL) {
+        v3_error("v3_pool_create out of memory");
+        free(nodes);
+        free(cpus);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->has_work, NULL);
+
+    // pinned workers are spread round-robin over the nodes and ordered by
+    // node, so a static split of an array maps contiguous chunks to
+    // contiguous nodes and every node gets a share
+    size_t ncpus = 0;
+    if (flags & V3_POOL_PIN_THREADS) {
+        ncpus = v3_numa_worker_cpus(cpus, nodes, nthreads);
+        if (ncpus == 0) v3_error("v3_pool_create could not read CPU topology, not pinning");
+    }
+
+    for (unsigned i = 0; i < nthreads; i++) {
+        v3_worker *w = &pool->workers[i];
+        w->pool = pool;
+        w->index = i;
+        w->cpu = ncpus > 0 ? cpus[i] : -1;
+        w->node = ncpus > 0 ? nodes[i] : 0;
+    }
+    free(nodes);
+    free(cpus);
+
+    for (unsigned i = 0; i < nthreads; i++) {
+        if (pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]) != 0) {
+            v3_error("v3_pool_create could not start worker thread");
+            break;
+        }
+        pool->nthreads++;
+    }
+    if (pool->nthreads == 0) {
+        v3_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void v3_pool_destroy(v3_pool *pool) {
+    if (pool == NULL) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned i = 0; i < pool->nthreads; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    pthread_cond_destroy(&pool->has_work);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+unsigned v3_pool_size(v3_pool *pool) {
+    return pool != NULL ? pool->nthreads : 0;
+}
+
+static v3_pool *g_default_pool = NULL;
+static pthread_once_t g_default_once = PTHREAD_ONCE_INIT;
+
+static void create_default_pool(void) {
+    g_default_pool = v3_pool_create(0);
+}
+
+v3_pool *v3_pool_default(void) {
+    pthread_once(&g_default_once, create_default_pool);
+    return g_default_pool;
+}
+
+int v3_pool_current_worker(v3_pool *pool) {
+    if (tl_worker == NULL || pool == NULL || tl_worker->pool != pool) return -1;
+    return (int)tl_worker->index;
+}
+
+unsigned v3_pool_worker_node(v3_pool *pool, unsigned worker) {
+    if (pool == NULL || worker >= pool->nthreads) return 0;
+    return pool->workers[worker].node;
+}
+
+static v3_task *task_new(v3_task_fn fn, void *arg) {
+    v3_task *t = malloc(sizeof(*t));
+    if (t == NULL) {
+        v3_error("v3_pool_submit out of memory");
+        return NULL;
+    }
+    t->fn = fn;
+    t->arg = arg;
+    t->next = NULL;
+    return t;
+}
+
+bool v3_pool_submit(v3_pool *pool, v3_task_fn fn, void *arg) {
+    if (pool == NULL || fn == NULL) {
+        v3_error("v3_pool_submit received NULL pointer");
+        return false;
+    }
+    v3_task *t = task_new(fn, arg);
+    if (t == NULL) return false;
+
+    pthread_mutex_lock(&pool->lock);
+    task_push(&pool->head, &pool->tail, t);
+    pthread_cond_signal(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+    return true;
+}
+
+bool v3_pool_submit_to(v3_pool *pool, unsigned worker, v3_task_fn fn, void *arg) {
+    if (pool == NULL || fn == NULL) {
+        v3_error("v3_pool_submit_to received NULL pointer");
+        return false;
+    }
+    if (worker >= pool->nthreads) {
+        v3_error("v3_pool_submit_to worker index out of range");
+        return false;
+    }
+    v3_task *t = task_new(fn, arg);
+    if (t == NULL) return false;
+
+    pthread_mutex_lock(&pool->lock);
+    v3_worker *w = &pool->workers[worker];
+    task_push(&w->head, &w->tail, t);
+    // a single signal could wake a different worker
+    pthread_cond_broadcast(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+    return true;
+}
+
+// ---------- parallel_for ----------
+// Shared by the caller and the helper tasks. Chunks are claimed with an atomic
+// counter, so helpers that start late (pool busy) simply find nothing left.
+// The caller waits for chunk completion, not for helpers to exit; the last
+// reference frees the state.
+typedef struct {
+    v3_range_fn fn;
+    void *arg;
+    size_t count;
+    size_t chunk;
+    size_t nchunks;
+    atomic_size_t next;
+    atomic_size_t done;
+    atomic_uint refs;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+} v3_pfor;
+
+static void pfor_run(v3_pfor *pf) {
+    size_t c;
+    while ((c = atomic_fetch_add(&pf->next, 1)) < pf->nchunks) {
+        size_t begin = c * pf->chunk;
+        size_t end = begin + pf->chunk;
+        if (end > pf->count) end = pf->count;
+        pf->fn(pf->arg, begin, end);
+
+        if (atomic_fetch_add(&pf->done, 1) + 1 == pf->nchunks) {
+            pthread_mutex_lock(&pf->lock);
+            pthread_cond_broadcast(&pf->finished);
+            pthread_mutex_unlock(&pf->lock);
+        }
+    }
+}
+
+static void pfor_release(v3_pfor *pf) {
+    if (atomic_fetch_sub(&pf->refs, 1) == 1) {
+        pthread_cond_destroy(&pf->finished);
+        pthread_mutex_destroy(&pf->lock);
+        free(pf);
+    }
+}
+
+static void pfor_helper(void *arg) {
+    v3_pfor *pf = arg;
+    pfor_run(pf);
+    pfor_release(pf);
+}
+
+void v3_pool_parallel_for(v3_pool *pool, size_t count, size_t grain,
+                          v3_range_fn fn, void *arg) {
+    if (fn == NULL) {
+        v3_error("v3_pool_parallel_for received NULL pointer");
+        return;
+    }
+    if (count == 0) return;
+    if (pool == NULL) pool = v3_pool_default();
+    if (grain == 0) grain = 1;
+
+    unsigned threads = v3_pool_size(pool);
+    size_t nchunks = (count + grain - 1) / grain;
+    // a few chunks per thread smooths out uneven chunk cost
+    size_t max_chunks = 4 * (size_t)(threads + 1);
+    if (nchunks > max_chunks) nchunks = max_chunks;
+    if (threads == 0 || nchunks <= 1) {
+        fn(arg, 0, count);
+        return;
+    }
+
+    v3_pfor *pf = malloc(sizeof(*pf));
+    if (pf == NULL) {
+        v3_error("v3_pool_parallel_for out of memory, running serially");
+        fn(arg, 0, count);
+        return;
+    }
+    pf->fn = fn;
+    pf->arg = arg;
+    pf->count = count;
+    pf->chunk = (count + nchunks - 1) / nchunks;
+    pf->nchunks = (count + pf->chunk - 1) / pf->chunk;
+    atomic_init(&pf->next, 0);
+    atomic_init(&pf->done, 0);
+    pthread_mutex_init(&pf->lock, NULL);
+    pthread_cond_init(&pf->finished, NULL);
+
+    unsigned helpers = threads;
+    if (helpers > pf->nchunks - 1) helpers = (unsigned)(pf->nchunks - 1);
+    atomic_init(&pf->refs, helpers + 1);
+    for (unsigned i = 0; i < helpers; i++) {
+        if (!v3_pool_submit(pool, pfor_helper, pf)) {
+            atomic_fetch_sub(&pf->refs, 1);
+        }
+    }
+
+    pfor_run(pf);
+
+    pthread_mutex_lock(&pf->lock);
+    while (atomic_load(&pf->done) < pf->nchunks) {
+        pthread_cond_wait(&pf->finished, &pf->lock);
+    }
+    pthread_mutex_unlock(&pf->lock);
+    pfor_release(pf);
+}
+
+// ---------- static parallel_for ----------
+// Chunk sizes are rounded to whole pages of packed vectors (1024 vectors =
+// 3 pages) so that neighbouring chunks share as few pages as possible.
+#define V3_STATIC_ALIGN 1024
+
+typedef struct {
+    v3_range_fn fn;
+    void *arg;
+    size_t count;
+    size_t chunk;
+    unsigned remaining;  // guarded by lock
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+} v3_pstatic;
+
+typedef struct {
+    v3_pstatic *shared;
+    unsigned index;
+} v3_pstatic_part;
+
+static void pstatic_run(v3_pstatic *ps, unsigned index) {
+    size_t begin = (size_t)index * ps->chunk;
+    size_t end = begin + ps->chunk;
+    if (end > ps->count) end = ps->count;
+    if (begin < end) ps->fn(ps->arg, begin, end);
+
+    pthread_mutex_lock(&ps->lock);
+    if (--ps->remaining == 0) pthread_cond_broadcast(&ps->finished);
+    pthread_mutex_unlock(&ps->lock);
+}
+
+static void pstatic_task(void *arg) {
+    v3_pstatic_part *part = arg;
+    pstatic_run(part->shared, part->index);
+}
+
+void v3_pool_parallel_for_static(v3_pool *pool, size_t count,
+                                 v3_range_fn fn, void *arg) {
+    if (fn == NULL) {
+        v3_error("v3_pool_parallel_for_static received NULL pointer");
+        return;
+    }
+    if (count == 0) return;
+    if (pool == NULL) pool = v3_pool_default();
+    if (v3_pool_current_worker(pool) >= 0) {
+        // waiting on sibling workers from inside the pool could deadlock
+        v3_pool_parallel_for(pool, count, V3_STATIC_ALIGN, fn, arg);
+        return;
+    }
+    unsigned n = v3_pool_size(pool);
+    if (n <= 1) {
+        fn(arg, 0, count);
+        return;
+    }
+
+    v3_pstatic ps;
+    ps.fn = fn;
+    ps.arg = arg;
+    ps.count = count;
+    ps.chunk = (count + n - 1) / n;
+    ps.chunk = (ps.chunk + V3_STATIC_ALIGN - 1) / V3_STATIC_ALIGN * V3_STATIC_ALIGN;
+    ps.remaining = n;
+    pthread_mutex_init(&ps.lock, NULL);
+    pthread_cond_init(&ps.finished, NULL);
+
+    v3_pstatic_part *parts = malloc(n * sizeof(*parts));
+    if (parts == NULL) {
+        v3_error("v3_pool_parallel_for_static out of memory, running serially");
+        fn(arg, 0, count);
+    } else {
+        for (unsigned i = 0; i < n; i++) {
+            parts[i].shared = &ps;
+            parts[i].index = i;
+            if (!v3_pool_submit_to(pool, i, pstatic_task, &parts[i])) {
+                pstatic_run(&ps, i);  // keeps the result correct, loses placement
+            }
+        }
+        // once remaining reads 0 under the lock no worker touches ps again
+        pthread_mutex_lock(&ps.lock);
+        while (ps.remaining != 0) {
+            pthread_cond_wait(&ps.finished, &ps.lock);
+        }
+        pthread_mutex_unlock(&ps.lock);
+        free(parts);
+    }
+    pthread_cond_destroy(&ps.finished);
+    pthread_mutex_destroy(&ps.lock);
+}
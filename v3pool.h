@@ -0,0 +1,63 @@
+#ifndef V3POOL_H
+#define V3POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fixed-size worker thread pool shared by the batched and async layers.
+
+typedef struct v3_pool v3_pool;
+
+typedef void (*v3_task_fn)(void *arg);
+typedef void (*v3_range_fn)(void *arg, size_t begin, size_t end);
+
+// v3_pool_create_ex flags
+#define V3_POOL_PIN_THREADS 1u  // pin workers to CPUs spread round-robin over the nodes
+
+// nthreads == 0 uses the number of online CPUs
+v3_pool *v3_pool_create(unsigned nthreads);
+v3_pool *v3_pool_create_ex(unsigned nthreads, unsigned flags);
+
+// waits for queued tasks to finish, then joins the workers
+void v3_pool_destroy(v3_pool *pool);
+
+unsigned v3_pool_size(v3_pool *pool);
+
+// process-wide pool, created on first use and kept until exit
+v3_pool *v3_pool_default(void);
+
+// index of the calling thread within pool, or -1 if it is not one of its workers
+int v3_pool_current_worker(v3_pool *pool);
+
+// NUMA node the worker is pinned to (0 for unpinned pools)
+unsigned v3_pool_worker_node(v3_pool *pool, unsigned worker);
+
+// queue fn(arg) for execution on a worker; returns false on allocation failure
+bool v3_pool_submit(v3_pool *pool, v3_task_fn fn, void *arg);
+
+// queue fn(arg) for one specific worker
+bool v3_pool_submit_to(v3_pool *pool, unsigned worker, v3_task_fn fn, void *arg);
+
+// split [0, count) into chunks of at least `grain` items and run
+// fn(arg, begin, end) on them in parallel. The calling thread takes part, so
+// this is safe to call from inside a pool task. Returns when every chunk is done.
+void v3_pool_parallel_for(v3_pool *pool, size_t count, size_t grain,
+                          v3_range_fn fn, void *arg);
+
+// Split [0, count) into one contiguous chunk per worker and run chunk i on
+// worker i. The mapping depends only on count and the pool size, so repeated
+// calls touch the same memory from the same (pinned) threads; use it for
+// first-touch initialization and for the passes that follow it. Called from
+// inside a pool task it falls back to v3_pool_parallel_for.
+void v3_pool_parallel_for_static(v3_pool *pool, size_t count,
+                                 v3_range_fn fn, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
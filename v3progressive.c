@@ -0,0 +1,216 @@
+#include "v3progressive.h"
+#include "v3trace.h"
+#include "v3math.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// luminance added to the mean before the relative error test, so that
+// near-black pixels converge instead of chasing relative noise
+#define V3_PROGRESSIVE_DARK 0.05f
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+static bool pixel_active(const v3_progressive *p, size_t px) {
+    uint32_t n = p->count[px];
+    if (n < 2 || n < (uint32_t)p->min_samples) return true;
+    if (n >= (uint32_t)p->max_samples) return false;
+    // standard error of the mean: sqrt(variance / n), variance = m2 / (n - 1)
+    float var_mean = p->m2[px] / ((float)(n - 1) * (float)n);
+    float limit = p->tolerance * (p->mean[px] + V3_PROGRESSIVE_DARK);
+    return var_mean > limit * limit;
+}
+
+// The buffers are sized for the image at init: the same tile grid is not
+// enough, every pixel index depends on the exact width and height.
+static bool check_settings(const v3_progressive *p, const char *fn) {
+    char msg[96];
+    if (p->scene->width != p->width || p->scene->height != p->height) {
+        snprintf(msg, sizeof(msg), "%s image size changed", fn);
+        v3_error(msg);
+        return false;
+    }
+    if (p->min_samples < 2) {
+        snprintf(msg, sizeof(msg), "%s needs min_samples >= 2", fn);
+        v3_error(msg);
+        return false;
+    }
+    if (p->max_samples < p->min_samples) {
+        snprintf(msg, sizeof(msg), "%s needs max_samples >= min_samples", fn);
+        v3_error(msg);
+        return false;
+    }
+    return true;
+}
+
+// ---------- lifetime ----------
+bool v3_progressive_init(v3_progressive *p, v3_scene *scene) {
+    if (p == NULL || scene == NULL) {
+        v3_error("v3_progressive_init received NULL pointer");
+        return false;
+    }
+    memset(p, 0, sizeof(*p));
+    p->scene = scene;
+    p->min_samples = 4;
+    p->max_samples = 256;
+    p->tolerance = 0.05f;
+    p->width = scene->width;
+    p->height = scene->height;
+    p->tiles_x = (scene->width + V3_TRACE_TILE - 1) / V3_TRACE_TILE;
+    p->tiles_y = (scene->height + V3_TRACE_TILE - 1) / V3_TRACE_TILE;
+    size_t pixels = (size_t)scene->width * scene->height;
+    size_t tiles = (size_t)p->tiles_x * p->tiles_y;
+    p->sum = malloc(pixels * 3 * sizeof(float));
+    p->mean = malloc(pixels * sizeof(float));
+    p->m2 = malloc(pixels * sizeof(float));
+    p->count = malloc(pixels * sizeof(uint32_t));
+    p->tiles = malloc(tiles * sizeof(uint32_t));
+    p->tile_live = malloc(tiles);
+    if (p->sum == NULL || p->mean == NULL || p->m2 == NULL || p->count == NULL ||
+        p->tiles == NULL || p->tile_live == NULL) {
+        v3_error("v3_progressive_init allocation failed");
+        v3_progressive_free(p);
+        return false;
+    }
+    if (!v3_progressive_reset(p)) {
+        v3_progressive_free(p);
+        return false;
+    }
+    return true;
+}
+
+void v3_progressive_free(v3_progressive *p) {
+    if (p == NULL) return;
+    free(p->sum);
+    free(p->mean);
+    free(p->m2);
+    free(p->count);
+    free(p->tiles);
+    free(p->tile_live);
+    memset(p, 0, sizeof(*p));
+}
+
+bool v3_progressive_reset(v3_progressive *p) {
+    if (p == NULL || p->scene == NULL) {
+        v3_error("v3_progressive_reset received NULL pointer");
+        return false;
+    }
+    v3_scene *s = p->scene;
+    if (!check_settings(p, "v3_progressive_reset")) return false;
+    if (!v3_raygen_init(&p->rg, &s->camera, s->width, s->height)) return false;
+    p->rg.jitter = true;
+
+    size_t pixels = (size_t)s->width * s->height;
+    memset(p->sum, 0, pixels * 3 * sizeof(float));
+    memset(p->mean, 0, pixels * sizeof(float));
+    memset(p->m2, 0, pixels * sizeof(float));
+    memset(p->count, 0, pixels * sizeof(uint32_t));
+    p->tile_count = (size_t)p->tiles_x * p->tiles_y;
+    for (size_t i = 0; i < p->tile_count; i++) p->tiles[i] = (uint32_t)i;
+    p->pass = 0;
+    p->rays = 0;
+    return true;
+}
+
+// ---------- passes ----------
+typedef struct {
+    v3_progressive *p;
+    _Atomic uint64_t rays;
+    _Atomic size_t sampled;
+} pass_ctx;
+
+static void pass_tiles(void *arg, size_t begin, size_t end) {
+    pass_ctx *pc = arg;
+    v3_progressive *p = pc->p;
+    v3_scene *s = p->scene;
+    enum { N = V3_TRACE_TILE * V3_TRACE_TILE };
+    float buf[6][N];
+    v3_ray_soa rays = {buf[0], buf[1], buf[2], buf[3], buf[4], buf[5]};
+    uint64_t count = 0;
+    size_t sampled = 0;
+    for (size_t k = begin; k < end; k++) {
+        uint32_t tile = p->tiles[k];
+        int x0 = (int)(tile % (uint32_t)p->tiles_x) * V3_TRACE_TILE;
+        int y0 = (int)(tile / (uint32_t)p->tiles_x) * V3_TRACE_TILE;
+        int w = x0 + V3_TRACE_TILE < s->width ? V3_TRACE_TILE : s->width - x0;
+        int h = y0 + V3_TRACE_TILE < s->height ? V3_TRACE_TILE : s->height - y0;
+        // ray generation is cheap next to tracing, so the whole tile is
+        // generated and only the active pixels are traced
+        v3_raygen_tile(&p->rg, x0, y0, w, h, p->pass, &rays);
+        // a pixel is sampled when it or a neighbour in the tile is active:
+        // a few samples that happen to agree do not stop a pixel next to noise
+        bool active[N], dilated[N];
+        for (int i = 0; i < w * h; i++) {
+            active[i] = pixel_active(p, (size_t)(y0 + i / w) * s->width + (size_t)(x0 + i % w));
+        }
+        for (int i = 0; i < w * h; i++) {
+            int x = i % w, y = i / w;
+            dilated[i] = active[i] || (x > 0 && active[i - 1]) || (x + 1 < w && active[i + 1]) ||
+                         (y > 0 && active[i - w]) || (y + 1 < h && active[i + w]);
+        }
+        bool live = false;
+        for (int i = 0; i < w * h; i++) {
+            size_t px = (size_t)(y0 + i / w) * s->width + (size_t)(x0 + i % w);
+            if (!dilated[i] || p->count[px] >= (uint32_t)p->max_samples) continue;
+            float orig[3] = {rays.ox[i], rays.oy[i], rays.oz[i]};
+            float dir[3] = {rays.dx[i], rays.dy[i], rays.dz[i]};
+            float c[3];
+            v3_trace_ray(s, orig, dir, 0, c, &count);
+            float *acc = p->sum + 3 * px;
+            v3_add(acc, acc, c);
+
+            float y = 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+            uint32_t n = ++p->count[px];
+            float delta = y - p->mean[px];
+            p->mean[px] += delta / (float)n;
+            p->m2[px] += delta * (y - p->mean[px]);
+            sampled++;
+            live |= pixel_active(p, px);
+        }
+        p->tile_live[k] = live;
+    }
+    atomic_fetch_add(&pc->rays, count);
+    atomic_fetch_add(&pc->sampled, sampled);
+}
+
+size_t v3_progressive_pass(v3_progressive *p, v3_pool *pool) {
+    if (p == NULL || p->scene == NULL) {
+        v3_error("v3_progressive_pass received NULL pointer");
+        return 0;
+    }
+    if (p->tile_count == 0 || !check_settings(p, "v3_progressive_pass")) return 0;
+    if (pool == NULL) pool = v3_pool_default();
+
+    pass_ctx pc = {.p = p};
+    atomic_init(&pc.rays, 0);
+    atomic_init(&pc.sampled, 0);
+    v3_pool_parallel_for(pool, p->tile_count, 1, pass_tiles, &pc);
+
+    // keep the tiles that still have work, in order
+    size_t kept = 0;
+    for (size_t k = 0; k < p->tile_count; k++) {
+        if (p->tile_live[k]) p->tiles[kept++] = p->tiles[k];
+    }
+    p->tile_count = kept;
+    p->pass++;
+    p->rays += atomic_load(&pc.rays);
+    return atomic_load(&pc.sampled);
+}
+
+void v3_progressive_resolve(const v3_progressive *p, float *rgb) {
+    if (p == NULL || p->scene == NULL || rgb == NULL) {
+        v3_error("v3_progressive_resolve received NULL pointer");
+        return;
+    }
+    size_t pixels = (size_t)p->width * p->height;
+    for (size_t i = 0; i < pixels; i++) {
+        float inv = p->count[i] > 0 ? 1.0f / (float)p->count[i] : 0.0f;
+        for (int k = 0; k < 3; k++) rgb[3 * i + k] = p->sum[3 * i + k] * inv;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef V3PROGRESSIVE_H
+#define V3PROGRESSIVE_H
+
+#include "v3camera.h"
+#include "v3pool.h"
+#include "v3scene.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Progressive renderer for interactive previews. Each pass adds one jittered
+// sample to every pixel that still needs it and the accumulated image can be
+// resolved after any pass, so the first usable frame costs one sample per
+// pixel. Once a pixel has min_samples, it is only sampled again while the
+// standard error of its mean luminance exceeds tolerance relative to that
+// mean, or while a neighbour in its tile does; flat regions stop early and
+// the remaining rays go to edges, reflections and defocus. Tiles with no
+// active pixel are skipped.
+//
+// The image depends only on the scene and the settings, not on the pool.
+
+typedef struct {
+    v3_scene *scene;
+    v3_raygen rg;
+    int width, height;   // image size the buffers were allocated for
+    int tiles_x, tiles_y;
+    float *sum;          // 3 per pixel: radiance sums
+    float *mean, *m2;    // per pixel luminance mean and squared deviations (Welford)
+    uint32_t *count;     // samples per pixel
+    uint32_t *tiles;     // tiles still sampling, in raster order
+    uint8_t *tile_live;  // scratch: a tile kept an active pixel this pass
+    size_t tile_count;
+    uint32_t pass;
+    int min_samples;     // samples before a pixel's variance is trusted (at least 2)
+    int max_samples;     // per-pixel cap
+    float tolerance;     // target relative standard error of pixel luminance
+    uint64_t rays;       // total rays cast, as v3_trace_stats counts them
+} v3_progressive;
+
+// Allocate buffers for scene->width x scene->height and reset. Defaults are
+// min_samples 4, max_samples 256, tolerance 0.05; the fields may be changed
+// between passes, but reset and pass refuse min_samples < 2 and
+// max_samples < min_samples. The scene must outlive p.
+bool v3_progressive_init(v3_progressive *p, v3_scene *scene);
+void v3_progressive_free(v3_progressive *p);
+
+// Discard all samples and re-read the camera, e.g. after the scene changed.
+// The image size must not change (free and init again for that); reset and
+// pass fail with an error when it did.
+bool v3_progressive_reset(v3_progressive *p);
+
+// Run one pass on pool (the default pool if NULL). Returns the number of
+// pixels sampled; 0 once every pixel has converged or reached max_samples.
+size_t v3_progressive_pass(v3_progressive *p, v3_pool *pool);
+
+// Mean radiance per pixel (3 floats, row-major from the top-left) as in
+// v3_trace_render; pixels without samples are black.
+void v3_progressive_resolve(const v3_progressive *p, float *rgb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,191 @@
+#include "v3rcu.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+#define V3_RCU_READERS_DEFAULT 64
+
+// One cache line per reader so announcing an epoch does not bounce the
+// lines of other readers.
+typedef struct {
+    _Alignas(64) _Atomic uint64_t epoch;   // 0 while outside a critical section
+    atomic_bool used;
+} reader_slot;
+
+typedef struct {
+    void *version;
+    uint64_t epoch;    // global epoch when it was replaced
+} retired;
+
+struct v3_rcu {
+    _Atomic(void *) current;
+    _Alignas(64) _Atomic uint64_t epoch;
+    reader_slot *readers;
+    int max_readers;
+    void (*destroy)(void *version);
+
+    pthread_mutex_t lock;   // writers: publish, reclaim, the retired list
+    retired *retired;
+    size_t retired_count, retired_cap;
+};
+
+// Correctness argument, all operations below being seq_cst:
+// A reader stores its slot epoch e and then loads current. A writer swaps
+// current, then increments the epoch from E to E + 1 and tags the old
+// version with E; it frees the version once every active slot is above E.
+// A slot at e <= E may hold the old version and blocks the free. A slot
+// written with e > E read the epoch after the increment, hence after the
+// swap, so its load of current cannot return the old version. A slot the
+// writer saw as 0 was stored after the writer's scan, also after the swap.
+
+v3_rcu *v3_rcu_create(void *initial, void (*destroy)(void *version), int max_readers) {
+    if (destroy == NULL) {
+        v3_error("v3_rcu_create received NULL pointer");
+        return NULL;
+    }
+    if (max_readers <= 0) max_readers = V3_RCU_READERS_DEFAULT;
+    v3_rcu *r = aligned_alloc(64, (sizeof(v3_rcu) + 63) / 64 * 64);
+    reader_slot *slots = aligned_alloc(64, (size_t)max_readers * sizeof(reader_slot));
+    if (r == NULL || slots == NULL) {
+        v3_error("v3_rcu_create out of memory");
+        free(r);
+        free(slots);
+        return NULL;
+    }
+    atomic_init(&r->current, initial);
+    atomic_init(&r->epoch, 1);
+    r->readers = slots;
+    r->max_readers = max_readers;
+    r->destroy = destroy;
+    for (int i = 0; i < max_readers; i++) {
+        atomic_init(&slots[i].epoch, 0);
+        atomic_init(&slots[i].used, false);
+    }
+    pthread_mutex_init(&r->lock, NULL);
+    r->retired = NULL;
+    r->retired_count = r->retired_cap = 0;
+    return r;
+}
+
+void v3_rcu_destroy(v3_rcu *r) {
+    if (r == NULL) return;
+    for (size_t i = 0; i < r->retired_count; i++) r->destroy(r->retired[i].version);
+    void *cur = atomic_load(&r->current);
+    if (cur != NULL) r->destroy(cur);
+    pthread_mutex_destroy(&r->lock);
+    free(r->retired);
+    free(r->readers);
+    free(r);
+}
+
+int v3_rcu_register(v3_rcu *r) {
+    if (r == NULL) {
+        v3_error("v3_rcu_register received NULL pointer");
+        return -1;
+    }
+    for (int i = 0; i < r->max_readers; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&r->readers[i].used, &expected, true)) return i;
+    }
+    v3_error("v3_rcu_register out of reader slots");
+    return -1;
+}
+
+void v3_rcu_unregister(v3_rcu *r, int reader) {
+    if (r == NULL || reader < 0 || reader >= r->max_readers) return;
+    atomic_store(&r->readers[reader].epoch, 0);
+    atomic_store(&r->readers[reader].used, false);
+}
+
+void *v3_rcu_read_lock(v3_rcu *r, int reader) {
+    if (r == NULL || reader < 0 || reader >= r->max_readers) {
+        v3_error("v3_rcu_read_lock received an invalid reader");
+        return NULL;
+    }
+    atomic_store(&r->readers[reader].epoch, atomic_load(&r->epoch));
+    return atomic_load(&r->current);
+}
+
+void v3_rcu_read_unlock(v3_rcu *r, int reader) {
+    if (r == NULL || reader < 0 || reader >= r->max_readers) return;
+    atomic_store_explicit(&r->readers[reader].epoch, 0, memory_order_release);
+}
+
+// lowest epoch announced by an active reader, or UINT64_MAX; lock held
+static uint64_t oldest_reader(v3_rcu *r) {
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < r->max_readers; i++) {
+        uint64_t e = atomic_load(&r->readers[i].epoch);
+        if (e != 0 && e < oldest) oldest = e;
+    }
+    return oldest;
+}
+
+static size_t reclaim_locked(v3_rcu *r) {
+    if (r->retired_count == 0) return 0;
+    uint64_t oldest = oldest_reader(r);
+    size_t kept = 0, freed = 0;
+    for (size_t i = 0; i < r->retired_count; i++) {
+        if (r->retired[i].epoch < oldest) {
+            r->destroy(r->retired[i].version);
+            freed++;
+        } else {
+            r->retired[kept++] = r->retired[i];
+        }
+    }
+    r->retired_count = kept;
+    return freed;
+}
+
+bool v3_rcu_publish(v3_rcu *r, void *next) {
+    if (r == NULL) {
+        v3_error("v3_rcu_publish received NULL pointer");
+        return false;
+    }
+    pthread_mutex_lock(&r->lock);
+    // make room first so a failure leaves the current version in place
+    if (r->retired_count == r->retired_cap) {
+        size_t cap = r->retired_cap ? 2 * r->retired_cap : 8;
+        retired *list = realloc(r->retired, cap * sizeof(retired));
+        if (list == NULL) {
+            pthread_mutex_unlock(&r->lock);
+            v3_error("v3_rcu_publish out of memory");
+            return false;
+        }
+        r->retired = list;
+        r->retired_cap = cap;
+    }
+    void *old = atomic_exchange(&r->current, next);
+    uint64_t e = atomic_fetch_add(&r->epoch, 1);
+    if (old != NULL) r->retired[r->retired_count++] = (retired){old, e};
+    reclaim_locked(r);
+    pthread_mutex_unlock(&r->lock);
+    return true;
+}
+
+size_t v3_rcu_reclaim(v3_rcu *r) {
+    if (r == NULL) return 0;
+    pthread_mutex_lock(&r->lock);
+    size_t freed = reclaim_locked(r);
+    pthread_mutex_unlock(&r->lock);
+    return freed;
+}
+
+size_t v3_rcu_pending(v3_rcu *r) {
+    if (r == NULL) return 0;
+    pthread_mutex_lock(&r->lock);
+    size_t n = r->retired_count;
+    pthread_mutex_unlock(&r->lock);
+    return n;
+}
+
+uint64_t v3_rcu_epoch(v3_rcu *r) {
+    return r ? atomic_load(&r->epoch) : 0;
+}
@@ -0,0 +1,66 @@
+#ifndef V3RCU_H
+#define V3RCU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Read-mostly publication of immutable versions (RCU style) with epoch-based
+// reclamation, e.g. scene snapshots shared by query threads while an editor
+// publishes rebuilt scenes:
+//
+//   int me = v3_rcu_register(rcu);                  // once per reader thread
+//   const v3_scene *s = v3_rcu_read_lock(rcu, me);  // no lock, no RMW
+//   ... any number of queries against s ...
+//   v3_rcu_read_unlock(rcu, me);
+//
+//   v3_rcu_publish(rcu, next);                      // editor: swap, retire old
+//
+// A reader sees one complete version for its whole critical section and
+// never waits for a writer. Publishing never waits for readers either: the
+// old version is retired with the current epoch and destroyed by a later
+// publish or v3_rcu_reclaim once no reader that could still hold it remains
+// inside a critical section. Versions must not be modified once published.
+// Critical sections do not nest, and a reader slot belongs to one thread.
+
+typedef struct v3_rcu v3_rcu;
+
+// Manage versions that destroy(version) frees. max_readers is the number of
+// reader slots (0 selects 64). initial may be NULL.
+v3_rcu *v3_rcu_create(void *initial, void (*destroy)(void *version), int max_readers);
+
+// Destroy the current and every retired version; no reader may be active.
+void v3_rcu_destroy(v3_rcu *r);
+
+// Claim / return a reader slot; -1 when every slot is taken.
+int v3_rcu_register(v3_rcu *r);
+void v3_rcu_unregister(v3_rcu *r, int reader);
+
+// Enter / leave a read-side critical section. The returned version stays
+// valid until the matching unlock.
+void *v3_rcu_read_lock(v3_rcu *r, int reader);
+void v3_rcu_read_unlock(v3_rcu *r, int reader);
+
+// Make next the current version and retire the previous one. Writers are
+// serialized by an internal mutex; readers are unaffected. Returns false
+// only on allocation failure, in which case nothing changed.
+bool v3_rcu_publish(v3_rcu *r, void *next);
+
+// Destroy retired versions no active reader can hold. Returns the number
+// destroyed. publish calls this itself.
+size_t v3_rcu_reclaim(v3_rcu *r);
+
+// Retired versions still waiting for readers; the current epoch (1 + the
+// number of publishes).
+size_t v3_rcu_pending(v3_rcu *r);
+uint64_t v3_rcu_epoch(v3_rcu *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
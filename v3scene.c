@@ -0,0 +1,759 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "v3scene.h"
+#include "v3math.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define MAX_TOKENS 48
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+static void parse_error(const char *source, int line, const char *msg, const char *tok) {
+    fprintf(stderr, "Error: %s:%d: %s%s%s\n", source, line, msg,
+            tok ? " " : "", tok ? tok : "");
+}
+
+// arrays of a binary scene live in its mapping and must not be freed
+static bool mapped(v3_scene *scene, void *p) {
+    char *base = scene->mapping;
+    return base != NULL && (char *)p >= base && (char *)p < base + scene->mapping_size;
+}
+
+// grow *arr by doubling so it holds at least count + extra elements; a
+// *cap of 0 means the array may hold count elements and no more
+static bool reserve_extra(void **arr, size_t *cap, size_t count, size_t extra, size_t elem) {
+    if (count + extra <= *cap) return true;
+    size_t ncap = *cap ? *cap : 16;
+    while (ncap < count + extra) ncap *= 2;
+    void *p = realloc(*arr, ncap * elem);
+    if (p == NULL) return false;
+    *arr = p;
+    *cap = ncap;
+    return true;
+}
+
+// grow *arr so it holds at least count + 1 elements
+static bool reserve(void **arr, size_t *cap, size_t count, size_t elem) {
+    return reserve_extra(arr, cap, count, 1, elem);
+}
+
+typedef struct {
+    v3_scene *scene;
+    const char *source;
+    int line;
+    size_t material_cap, sphere_cap, plane_cap, tri_cap, tri_mat_cap, light_cap;
+    // the mesh between 'mesh NAME' and 'end', collected before its BVH is built
+    bool in_mesh;
+    int mesh_line;
+    char mesh_name[V3_SCENE_NAME_MAX];
+    float *mesh_verts;
+    uint32_t *mesh_mats;
+    size_t mesh_tri_count, mesh_vert_cap, mesh_mat_cap;
+} parser;
+
+static bool parse_floats(parser *ps, char **tok, int ntok, int at, float *out, int n) {
+    if (at + n > ntok) {
+        parse_error(ps->source, ps->line, "missing value after", tok[at - 1]);
+        return false;
+    }
+    for (int k = 0; k < n; k++) {
+        char *end;
+        out[k] = strtof(tok[at + k], &end);
+        if (*end != '\0' || !isfinite(out[k])) {
+            parse_error(ps->source, ps->line, "bad number", tok[at + k]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool find_material(parser *ps, const char *name, uint32_t *out) {
+    v3_scene *s = ps->scene;
+    for (size_t i = 0; i < s->material_count; i++) {
+        if (strcmp(s->materials[i].name, name) == 0) {
+            *out = (uint32_t)i;
+            return true;
+        }
+    }
+    parse_error(ps->source, ps->line, "unknown material", name);
+    return false;
+}
+
+// Parse "key values..." pairs after the statement keyword. keys[i] takes
+// sizes[i] floats into outs[i]; a size of 0 means a material name.
+static bool parse_pairs(parser *ps, char **tok, int ntok, const char *const *keys,
+                        const int *sizes, void *const *outs, bool *seen, int nkeys) {
+    int at = 1;
+    while (at < ntok) {
+        int k = 0;
+        while (k < nkeys && strcmp(tok[at], keys[k]) != 0) k++;
+        if (k == nkeys) {
+            parse_error(ps->source, ps->line, "unexpected", tok[at]);
+            return false;
+        }
+        at++;
+        if (sizes[k] == 0) {
+            if (at >= ntok) {
+                parse_error(ps->source, ps->line, "missing value after", keys[k]);
+                return false;
+            }
+            if (!find_material(ps, tok[at], outs[k])) return false;
+            at++;
+        } else {
+            if (!parse_floats(ps, tok, ntok, at, outs[k], sizes[k])) return false;
+            at += sizes[k];
+        }
+        if (seen) seen[k] = true;
+    }
+    return true;
+}
+
+static bool require(parser *ps, const bool *seen, const char *const *keys, int nkeys) {
+    for (int k = 0; k < nkeys; k++) {
+        if (!seen[k]) {
+            parse_error(ps->source, ps->line, "missing", keys[k]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool out_of_memory(parser *ps) {
+    parse_error(ps->source, ps->line, "out of memory", NULL);
+    return false;
+}
+
+// ---------- statements ----------
+static bool parse_camera(parser *ps, char **tok, int ntok) {
+    static const char *const keys[] = {"pos", "look", "up", "fov", "aperture", "focus"};
+    static const int sizes[] = {3, 3, 3, 1, 1, 1};
+    v3_camera *c = &ps->scene->camera;
+    void *const outs[] = {c->pos, c->look, c->up, &c->fov, &c->aperture, &c->focus};
+    if (!parse_pairs(ps, tok, ntok, keys, sizes, outs, NULL, 6)) return false;
+    if (c->aperture < 0.0f || c->focus < 0.0f) {
+        parse_error(ps->source, ps->line, "camera aperture and focus must not be negative", NULL);
+        return false;
+    }
+    return true;
+}
+
+static bool parse_material(parser *ps, char **tok, int ntok) {
+    if (ntok < 2) {
+        parse_error(ps->source, ps->line, "material needs a name", NULL);
+        return false;
+    }
+    if (strlen(tok[1]) >= V3_SCENE_NAME_MAX) {
+        parse_error(ps->source, ps->line, "material name too long:", tok[1]);
+        return false;
+    }
+    v3_scene *s = ps->scene;
+    v3_material m = {
+        .diffuse = {0.8f, 0.8f, 0.8f},
+        .specular = {0.0f, 0.0f, 0.0f},
+        .shininess = 32.0f,
+        .ior = 1.0f,
+    };
+    strcpy(m.name, tok[1]);
+    static const char *const keys[] = {"diffuse", "specular", "shininess", "reflect", "transmit", "ior"};
+    static const int sizes[] = {3, 3, 1, 1, 1, 1};
+    void *const outs[] = {m.diffuse, m.specular, &m.shininess, &m.reflect, &m.transmit, &m.ior};
+    // skip the name: parse_pairs starts at token 1
+    if (!parse_pairs(ps, tok + 1, ntok - 1, keys, sizes, outs, NULL, 6)) return false;
+    if (m.reflect < 0.0f || m.transmit < 0.0f || m.reflect + m.transmit > 1.0f || m.ior <= 0.0f) {
+        parse_error(ps->source, ps->line, "reflect/transmit must be in [0,1] with ior > 0 in", m.name);
+        return false;
+    }
+
+    // a redefinition replaces the earlier material of the same name
+    for (size_t i = 0; i < s->material_count; i++) {
+        if (strcmp(s->materials[i].name, m.name) == 0) {
+            s->materials[i] = m;
+            return true;
+        }
+    }
+    if (!reserve((void **)&s->materials, &ps->material_cap, s->material_count, sizeof(m))) {
+        return out_of_memory(ps);
+    }
+    s->materials[s->material_count++] = m;
+    return true;
+}
+
+static bool parse_light(parser *ps, char **tok, int ntok) {
+    v3_scene *s = ps->scene;
+    v3_light l = {.color = {1.0f, 1.0f, 1.0f}};
+    static const char *const keys[] = {"pos", "color"};
+    static const int sizes[] = {3, 3};
+    void *const outs[] = {l.pos, l.color};
+    bool seen[2] = {false, false};
+    if (!parse_pairs(ps, tok, ntok, keys, sizes, outs, seen, 2)) return false;
+    if (!require(ps, seen, keys, 1)) return false;
+    if (!reserve((void **)&s->lights, &ps->light_cap, s->light_count, sizeof(l))) {
+        return out_of_memory(ps);
+    }
+    s->lights[s->light_count++] = l;
+    return true;
+}
+
+static bool parse_sphere(parser *ps, char **tok, int ntok) {
+    v3_scene *s = ps->scene;
+    v3_sphere sp = {.radius = 0.0f};
+    static const char *const keys[] = {"center", "radius", "material"};
+    static const int sizes[] = {3, 1, 0};
+    void *const outs[] = {sp.center, &sp.radius, &sp.material};
+    bool seen[3] = {false, false, false};
+    if (!parse_pairs(ps, tok, ntok, keys, sizes, outs, seen, 3)) return false;
+    if (!require(ps, seen, keys, 3)) return false;
+    if (!(sp.radius > 0.0f)) {
+        parse_error(ps->source, ps->line, "sphere radius must be positive", NULL);
+        return false;
+    }
+    if (!reserve((void **)&s->spheres, &ps->sphere_cap, s->sphere_count, sizeof(sp))) {
+        return out_of_memory(ps);
+    }
+    s->spheres[s->sphere_count++] = sp;
+    return true;
+}
+
+static bool parse_plane(parser *ps, char **tok, int ntok) {
+    v3_scene *s = ps->scene;
+    v3_plane pl;
+    static const char *const keys[] = {"point", "normal", "material"};
+    static const int sizes[] = {3, 3, 0};
+    void *const outs[] = {pl.point, pl.normal, &pl.material};
+    bool seen[3] = {false, false, false};
+    if (!parse_pairs(ps, tok, ntok, keys, sizes, outs, seen, 3)) return false;
+    if (!require(ps, seen, keys, 3)) return false;
+    if (v3_length(pl.normal) == 0.0f) {
+        parse_error(ps->source, ps->line, "plane normal must be non-zero", NULL);
+        return false;
+    }
+    v3_normalize(pl.normal, pl.normal);
+    if (!reserve((void **)&s->planes, &ps->plane_cap, s->plane_count, sizeof(pl))) {
+        return out_of_memory(ps);
+    }
+    s->planes[s->plane_count++] = pl;
+    return true;
+}
+
+static bool parse_triangle(parser *ps, char **tok, int ntok) {
+    v3_scene *s = ps->scene;
+    float v[9];
+    if (!parse_floats(ps, tok, ntok, 1, v, 9)) return false;
+    if (ntok != 12 || strcmp(tok[10], "material") != 0) {
+        parse_error(ps->source, ps->line, "expected: triangle x y z x y z x y z material NAME", NULL);
+        return false;
+    }
+    uint32_t mat;
+    if (!find_material(ps, tok[11], &mat)) return false;
+
+    if (ps->in_mesh) {
+        // 9 floats per triangle: reserve counts in units of whole triangles
+        if (!reserve((void **)&ps->mesh_verts, &ps->mesh_vert_cap, ps->mesh_tri_count, 9 * sizeof(float)) ||
+            !reserve((void **)&ps->mesh_mats, &ps->mesh_mat_cap, ps->mesh_tri_count, sizeof(uint32_t))) {
+            return out_of_memory(ps);
+        }
+        memcpy(ps->mesh_verts + 9 * ps->mesh_tri_count, v, sizeof(v));
+        ps->mesh_mats[ps->mesh_tri_count++] = mat;
+        return true;
+    }
+    if (!reserve((void **)&s->tris, &ps->tri_cap, s->tri_count, sizeof(v3_tri_wt)) ||
+        !reserve((void **)&s->tri_materials, &ps->tri_mat_cap, s->tri_count, sizeof(uint32_t))) {
+        return out_of_memory(ps);
+    }
+    v3_tri_wt_precompute(&s->tris[s->tri_count], v, v + 3, v + 6);
+    s->tri_materials[s->tri_count] = mat;
+    s->tri_count++;
+    return true;
+}
+
+static bool find_mesh(parser *ps, const char *name, uint32_t *out) {
+    v3_scene *s = ps->scene;
+    for (size_t i = 0; i < s->mesh_count; i++) {
+        if (strcmp(s->meshes[i].name, name) == 0) {
+            *out = (uint32_t)i;
+            return true;
+        }
+    }
+    parse_error(ps->source, ps->line, "unknown mesh", name);
+    return false;
+}
+
+static bool parse_mesh(parser *ps, char **tok, int ntok) {
+    if (ntok != 2) {
+        parse_error(ps->source, ps->line, "expected: mesh NAME", NULL);
+        return false;
+    }
+    if (strlen(tok[1]) >= V3_SCENE_NAME_MAX) {
+        parse_error(ps->source, ps->line, "mesh name too long:", tok[1]);
+        return false;
+    }
+    v3_scene *s = ps->scene;
+    for (size_t i = 0; i < s->mesh_count; i++) {
+        if (strcmp(s->meshes[i].name, tok[1]) == 0) {
+            parse_error(ps->source, ps->line, "mesh defined twice:", tok[1]);
+            return false;
+        }
+    }
+    strcpy(ps->mesh_name, tok[1]);
+    ps->in_mesh = true;
+    ps->mesh_line = ps->line;
+    ps->mesh_tri_count = 0;
+    return true;
+}
+
+static bool parse_mesh_end(parser *ps, int ntok) {
+    if (ntok != 1) {
+        parse_error(ps->source, ps->line, "expected: end", NULL);
+        return false;
+    }
+    if (ps->mesh_tri_count == 0) {
+        parse_error(ps->source, ps->line, "empty mesh", ps->mesh_name);
+        return false;
+    }
+    ps->in_mesh = false;
+    return v3_scene_add_mesh(ps->scene, ps->mesh_name, ps->mesh_verts, ps->mesh_mats, ps->mesh_tri_count);
+}
+
+// to_world = translate * rotate * scale
+static bool instance_matrix(parser *ps, const float *scale, const float *rotate, const float *translate,
+                            float *m) {
+    float axis[3] = {rotate[0], rotate[1], rotate[2]};
+    float len = v3_length(axis);
+    if (len == 0.0f && rotate[3] != 0.0f) {
+        parse_error(ps->source, ps->line, "rotation axis must be non-zero", NULL);
+        return false;
+    }
+    if (scale[0] == 0.0f || scale[1] == 0.0f || scale[2] == 0.0f) {
+        parse_error(ps->source, ps->line, "scale must be non-zero", NULL);
+        return false;
+    }
+    float x = len > 0.0f ? axis[0] / len : 1.0f, y = len > 0.0f ? axis[1] / len : 0.0f;
+    float z = len > 0.0f ? axis[2] / len : 0.0f;
+    float a = rotate[3] * 3.14159265358979f / 180.0f, c = cosf(a), sn = sinf(a), k = 1.0f - c;
+    // Rodrigues' rotation about the unit axis (x, y, z)
+    float r[9] = {
+        c + x*x*k,    x*y*k - z*sn, x*z*k + y*sn,
+        y*x*k + z*sn, c + y*y*k,    y*z*k - x*sn,
+        z*x*k - y*sn, z*y*k + x*sn, c + z*z*k,
+    };
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) m[4 * i + j] = r[3 * i + j] * scale[j];
+        m[4 * i + 3] = translate[i];
+    }
+    return true;
+}
+
+static bool parse_instance(parser *ps, char **tok, int ntok) {
+    if (ntok < 2) {
+        parse_error(ps->source, ps->line, "instance needs a mesh name", NULL);
+        return false;
+    }
+    uint32_t mesh;
+    if (!find_mesh(ps, tok[1], &mesh)) return false;
+    float scale[3] = {1.0f, 1.0f, 1.0f}, rotate[4] = {0.0f, 1.0f, 0.0f, 0.0f}, translate[3] = {0.0f, 0.0f, 0.0f};
+    static const char *const keys[] = {"scale", "rotate", "translate"};
+    static const int sizes[] = {3, 4, 3};
+    void *const outs[] = {scale, rotate, translate};
+    // skip the mesh name: parse_pairs starts at token 1
+    if (!parse_pairs(ps, tok + 1, ntok - 1, keys, sizes, outs, NULL, 3)) return false;
+    float m[12];
+    if (!instance_matrix(ps, scale, rotate, translate, m)) return false;
+    return v3_scene_add_instance(ps->scene, mesh, m);
+}
+
+static bool parse_int(parser *ps, const char *tok, int lo, int *out) {
+    char *end;
+    long x = strtol(tok, &end, 10);
+    if (*end != '\0' || x < lo || x > 1 << 16) {
+        parse_error(ps->source, ps->line, "bad integer", tok);
+        return false;
+    }
+    *out = (int)x;
+    return true;
+}
+
+static bool parse_statement(parser *ps, char **tok, int ntok) {
+    v3_scene *s = ps->scene;
+    const char *kw = tok[0];
+    if (ps->in_mesh) {
+        if (strcmp(kw, "triangle") == 0) return parse_triangle(ps, tok, ntok);
+        if (strcmp(kw, "end") == 0) return parse_mesh_end(ps, ntok);
+        parse_error(ps->source, ps->line, "only triangles may appear inside mesh", ps->mesh_name);
+        return false;
+    }
+    if (strcmp(kw, "image") == 0) {
+        if (ntok != 3) {
+            parse_error(ps->source, ps->line, "expected: image W H", NULL);
+            return false;
+        }
+        return parse_int(ps, tok[1], 1, &s->width) && parse_int(ps, tok[2], 1, &s->height);
+    }
+    if (strcmp(kw, "depth") == 0) {
+        if (ntok != 2) {
+            parse_error(ps->source, ps->line, "expected: depth N", NULL);
+            return false;
+        }
+        return parse_int(ps, tok[1], 0, &s->max_depth);
+    }
+    if (strcmp(kw, "samples") == 0) {
+        if (ntok != 2) {
+            parse_error(ps->source, ps->line, "expected: samples N", NULL);
+            return false;
+        }
+        return parse_int(ps, tok[1], 1, &s->samples);
+    }
+    if (strcmp(kw, "exposure") == 0) {
+        if (ntok != 2) {
+            parse_error(ps->source, ps->line, "expected: exposure e", NULL);
+            return false;
+        }
+        if (!parse_floats(ps, tok, ntok, 1, &s->exposure, 1)) return false;
+        if (s->exposure < 0.0f) {
+            parse_error(ps->source, ps->line, "exposure must not be negative", NULL);
+            return false;
+        }
+        return true;
+    }
+    if (strcmp(kw, "tonemap") == 0) {
+        if (ntok == 2 && strcmp(tok[1], "clamp") == 0) {
+            s->tonemap = V3_TONEMAP_CLAMP;
+        } else if (ntok == 2 && strcmp(tok[1], "filmic") == 0) {
+            s->tonemap = V3_TONEMAP_FILMIC;
+        } else {
+            parse_error(ps->source, ps->line, "expected: tonemap clamp|filmic", NULL);
+            return false;
+        }
+        return true;
+    }
+    if (strcmp(kw, "background") == 0) {
+        return ntok == 4 ? parse_floats(ps, tok, ntok, 1, s->background, 3)
+                         : (parse_error(ps->source, ps->line, "expected: background r g b", NULL), false);
+    }
+    if (strcmp(kw, "ambient") == 0) {
+        return ntok == 4 ? parse_floats(ps, tok, ntok, 1, s->ambient, 3)
+                         : (parse_error(ps->source, ps->line, "expected: ambient r g b", NULL), false);
+    }
+    if (strcmp(kw, "camera") == 0) return parse_camera(ps, tok, ntok);
+    if (strcmp(kw, "material") == 0) return parse_material(ps, tok, ntok);
+    if (strcmp(kw, "light") == 0) return parse_light(ps, tok, ntok);
+    if (strcmp(kw, "sphere") == 0) return parse_sphere(ps, tok, ntok);
+    if (strcmp(kw, "plane") == 0) return parse_plane(ps, tok, ntok);
+    if (strcmp(kw, "triangle") == 0) return parse_triangle(ps, tok, ntok);
+    if (strcmp(kw, "mesh") == 0) return parse_mesh(ps, tok, ntok);
+    if (strcmp(kw, "instance") == 0) return parse_instance(ps, tok, ntok);
+    if (strcmp(kw, "end") == 0) {
+        parse_error(ps->source, ps->line, "end outside a mesh", NULL);
+        return false;
+    }
+    parse_error(ps->source, ps->line, "unknown statement", kw);
+    return false;
+}
+
+// ---------- public API ----------
+static void scene_defaults(v3_scene *s) {
+    memset(s, 0, sizeof(*s));
+    s->width = 640;
+    s->height = 480;
+    s->max_depth = 5;
+    s->samples = 1;
+    s->exposure = 1.0f;
+    s->tonemap = V3_TONEMAP_CLAMP;
+    s->ambient[0] = s->ambient[1] = s->ambient[2] = 0.1f;
+    s->camera.pos[2] = 5.0f;
+    s->camera.up[1] = 1.0f;
+    s->camera.fov = 45.0f;
+}
+
+bool v3_scene_parse(v3_scene *scene, FILE *f, const char *source) {
+    if (scene == NULL || f == NULL) {
+        v3_error("v3_scene_parse received NULL pointer");
+        return false;
+    }
+    scene_defaults(scene);
+    parser ps = {.scene = scene, .source = source ? source : "<scene>"};
+
+    char buf[1024];
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        ps.line++;
+        size_t len = strlen(buf);
+        if (len == sizeof(buf) - 1 && buf[len - 1] != '\n' && !feof(f)) {
+            parse_error(ps.source, ps.line, "line too long", NULL);
+            goto fail;
+        }
+        char *hash = strchr(buf, '#');
+        if (hash) *hash = '\0';
+
+        char *tok[MAX_TOKENS];
+        int ntok = 0;
+        char *save = NULL;
+        for (char *t = strtok_r(buf, " \t\r\n", &save); t != NULL; t = strtok_r(NULL, " \t\r\n", &save)) {
+            if (ntok == MAX_TOKENS) {
+                parse_error(ps.source, ps.line, "too many values", NULL);
+                goto fail;
+            }
+            tok[ntok++] = t;
+        }
+        if (ntok == 0) continue;
+        if (!parse_statement(&ps, tok, ntok)) goto fail;
+    }
+    if (ferror(f)) {
+        parse_error(ps.source, ps.line, "read error", NULL);
+        goto fail;
+    }
+    if (ps.in_mesh) {
+        parse_error(ps.source, ps.mesh_line, "missing end of mesh", ps.mesh_name);
+        goto fail;
+    }
+    if (!v3_scene_build_bvh(scene)) goto fail;
+    free(ps.mesh_verts);
+    free(ps.mesh_mats);
+    return true;
+
+fail:
+    free(ps.mesh_verts);
+    free(ps.mesh_mats);
+    v3_scene_free(scene);
+    return false;
+}
+
+bool v3_scene_load(v3_scene *scene, const char *path) {
+    if (scene == NULL || path == NULL) {
+        v3_error("v3_scene_load received NULL pointer");
+        return false;
+    }
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "Error: cannot open scene %s\n", path);
+        return false;
+    }
+    char magic[sizeof(V3_SCENE_BINARY_MAGIC)];
+    if (fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+        memcmp(magic, V3_SCENE_BINARY_MAGIC, sizeof(magic)) == 0) {
+        fclose(f);
+        return v3_scene_load_binary(scene, path);
+    }
+    rewind(f);
+    bool ok = v3_scene_parse(scene, f, path);
+    fclose(f);
+    return ok;
+}
+
+// world-space box of an instance: the transformed corners of its mesh box
+static void instance_box(const v3_scene *scene, const v3_instance *inst, v3_aabb *box) {
+    const v3_mesh *mesh = &scene->meshes[inst->mesh];
+    v3_aabb_empty(box);
+    for (int c = 0; c < 8; c++) {
+        float p[3] = {c & 1 ? mesh->bmax[0] : mesh->bmin[0], c & 2 ? mesh->bmax[1] : mesh->bmin[1],
+                      c & 4 ? mesh->bmax[2] : mesh->bmin[2]};
+        v3_transform_point(p, (float *)inst->to_world, p);
+        v3_aabb_grow_point(box, p);
+    }
+}
+
+bool v3_scene_build_bvh(v3_scene *scene) {
+    if (scene == NULL) {
+        v3_error("v3_scene_build_bvh received NULL pointer");
+        return false;
+    }
+    size_t n = scene->sphere_count + scene->tri_count + scene->instance_count;
+    v3_aabb *boxes = malloc((n ? n : 1) * sizeof(v3_aabb));
+    if (boxes == NULL) {
+        v3_error("v3_scene_build_bvh out of memory");
+        return false;
+    }
+    for (size_t i = 0; i < scene->sphere_count; i++) {
+        v3_sphere *sp = &scene->spheres[i];
+        for (int k = 0; k < 3; k++) {
+            boxes[i].min[k] = sp->center[k] - sp->radius;
+            boxes[i].max[k] = sp->center[k] + sp->radius;
+        }
+    }
+    for (size_t i = 0; i < scene->tri_count; i++) {
+        v3_aabb *b = &boxes[scene->sphere_count + i];
+        v3_aabb_empty(b);
+        v3_aabb_grow_point(b, scene->tris[i].v0);
+        v3_aabb_grow_point(b, scene->tris[i].v1);
+        v3_aabb_grow_point(b, scene->tris[i].v2);
+    }
+    for (size_t i = 0; i < scene->instance_count; i++) {
+        instance_box(scene, &scene->instances[i], &boxes[scene->sphere_count + scene->tri_count + i]);
+    }
+    if (!mapped(scene, scene->bvh.nodes)) v3_bvh_free(&scene->bvh);
+    bool ok = v3_bvh_build(&scene->bvh, boxes, n);
+    free(boxes);
+    return ok;
+}
+
+bool v3_scene_add_mesh(v3_scene *scene, const char *name, float *verts, uint32_t *materials, size_t count) {
+    if (scene == NULL || name == NULL || verts == NULL || materials == NULL) {
+        v3_error("v3_scene_add_mesh received NULL pointer");
+        return false;
+    }
+    if (scene->mapping != NULL) {
+        v3_error("v3_scene_add_mesh cannot grow a mapped binary scene");
+        return false;
+    }
+    if (count == 0 || strlen(name) >= V3_SCENE_NAME_MAX || scene->mesh_tri_count + count >= UINT32_MAX) {
+        v3_error("v3_scene_add_mesh needs triangles and a short name");
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (materials[i] >= scene->material_count) {
+            v3_error("v3_scene_add_mesh material index out of range");
+            return false;
+        }
+    }
+    v3_aabb *boxes = malloc(count * sizeof(v3_aabb));
+    if (boxes == NULL) {
+        v3_error("v3_scene_add_mesh out of memory");
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        float *v = verts + 9 * i;
+        v3_aabb_empty(&boxes[i]);
+        for (int k = 0; k < 3; k++) v3_aabb_grow_point(&boxes[i], v + 3 * k);
+    }
+    v3_bvh bvh;
+    bool ok = v3_bvh_build(&bvh, boxes, count);
+    free(boxes);
+    if (!ok) return false;
+
+    size_t tris = scene->mesh_tri_count, nodes = scene->mesh_node_count;
+    ok = reserve((void **)&scene->meshes, &scene->mesh_cap, scene->mesh_count, sizeof(v3_mesh)) &&
+         reserve_extra((void **)&scene->mesh_tris, &scene->mesh_tri_cap, tris, count, sizeof(v3_tri_wt)) &&
+         reserve_extra((void **)&scene->mesh_tri_materials, &scene->mesh_tri_mat_cap, tris, count,
+                       sizeof(uint32_t)) &&
+         reserve_extra((void **)&scene->mesh_prims, &scene->mesh_prim_cap, tris, count, sizeof(uint32_t)) &&
+         reserve_extra((void **)&scene->mesh_nodes, &scene->mesh_node_cap, nodes, bvh.node_count,
+                       sizeof(v3_bvh_node));
+    if (!ok) {
+        // arrays that did grow only gained capacity; the scene is unchanged
+        v3_error("v3_scene_add_mesh out of memory");
+        v3_bvh_free(&bvh);
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        float *v = verts + 9 * i;
+        v3_tri_wt_precompute(&scene->mesh_tris[tris + i], v, v + 3, v + 6);
+    }
+    memcpy(scene->mesh_tri_materials + tris, materials, count * sizeof(uint32_t));
+    memcpy(scene->mesh_prims + tris, bvh.prims, count * sizeof(uint32_t));
+    memcpy(scene->mesh_nodes + nodes, bvh.nodes, bvh.node_count * sizeof(v3_bvh_node));
+
+    v3_mesh *mesh = &scene->meshes[scene->mesh_count++];
+    memset(mesh, 0, sizeof(*mesh));
+    strcpy(mesh->name, name);
+    mesh->tri_first = (uint32_t)tris;
+    mesh->tri_count = (uint32_t)count;
+    mesh->node_first = (uint32_t)nodes;
+    mesh->node_count = (uint32_t)bvh.node_count;
+    mesh->prim_first = (uint32_t)tris;
+    memcpy(mesh->bmin, bvh.nodes[0].bmin, sizeof(mesh->bmin));
+    memcpy(mesh->bmax, bvh.nodes[0].bmax, sizeof(mesh->bmax));
+    scene->mesh_tri_count += count;
+    scene->mesh_node_count += bvh.node_count;
+    v3_bvh_free(&bvh);
+    return true;
+}
+
+bool v3_scene_add_instance(v3_scene *scene, uint32_t mesh, float *to_world) {
+    if (scene == NULL || to_world == NULL) {
+        v3_error("v3_scene_add_instance received NULL pointer");
+        return false;
+    }
+    if (scene->mapping != NULL) {
+        v3_error("v3_scene_add_instance cannot grow a mapped binary scene");
+        return false;
+    }
+    if (mesh >= scene->mesh_count) {
+        v3_error("v3_scene_add_instance mesh index out of range");
+        return false;
+    }
+    v3_instance inst = {.mesh = mesh};
+    memcpy(inst.to_world, to_world, sizeof(inst.to_world));
+    if (!v3_affine_invert(inst.to_object, inst.to_world)) {
+        v3_error("v3_scene_add_instance transform is not invertible");
+        return false;
+    }
+    if (!reserve((void **)&scene->instances, &scene->instance_cap, scene->instance_count, sizeof(v3_instance))) {
+        v3_error("v3_scene_add_instance out of memory");
+        return false;
+    }
+    scene->instances[scene->instance_count++] = inst;
+    return true;
+}
+
+static void *dup_array(const void *src, size_t count, size_t elem, bool *ok) {
+    if (count == 0) return NULL;
+    void *p = malloc(count * elem);
+    if (p == NULL) {
+        *ok = false;
+        return NULL;
+    }
+    memcpy(p, src, count * elem);
+    return p;
+}
+
+bool v3_scene_copy(v3_scene *dst, const v3_scene *src) {
+    if (dst == NULL || src == NULL) {
+        v3_error("v3_scene_copy received NULL pointer");
+        return false;
+    }
+    *dst = *src;
+    dst->mapping = NULL;
+    dst->mapping_size = 0;
+    // the copies below hold exactly count elements
+    dst->mesh_cap = dst->mesh_tri_cap = dst->mesh_tri_mat_cap = 0;
+    dst->mesh_prim_cap = dst->mesh_node_cap = dst->instance_cap = 0;
+    bool ok = true;
+    dst->materials = dup_array(src->materials, src->material_count, sizeof(v3_material), &ok);
+    dst->spheres = dup_array(src->spheres, src->sphere_count, sizeof(v3_sphere), &ok);
+    dst->planes = dup_array(src->planes, src->plane_count, sizeof(v3_plane), &ok);
+    dst->tris = dup_array(src->tris, src->tri_count, sizeof(v3_tri_wt), &ok);
+    dst->tri_materials = dup_array(src->tri_materials, src->tri_count, sizeof(uint32_t), &ok);
+    dst->lights = dup_array(src->lights, src->light_count, sizeof(v3_light), &ok);
+    dst->meshes = dup_array(src->meshes, src->mesh_count, sizeof(v3_mesh), &ok);
+    dst->mesh_tris = dup_array(src->mesh_tris, src->mesh_tri_count, sizeof(v3_tri_wt), &ok);
+    dst->mesh_tri_materials = dup_array(src->mesh_tri_materials, src->mesh_tri_count, sizeof(uint32_t), &ok);
+    dst->mesh_nodes = dup_array(src->mesh_nodes, src->mesh_node_count, sizeof(v3_bvh_node), &ok);
+    dst->mesh_prims = dup_array(src->mesh_prims, src->mesh_tri_count, sizeof(uint32_t), &ok);
+    dst->instances = dup_array(src->instances, src->instance_count, sizeof(v3_instance), &ok);
+    dst->bvh.nodes = dup_array(src->bvh.nodes, src->bvh.node_count, sizeof(v3_bvh_node), &ok);
+    dst->bvh.prims = dup_array(src->bvh.prims, src->bvh.prim_count, sizeof(uint32_t), &ok);
+    if (!ok) {
+        v3_error("v3_scene_copy out of memory");
+        v3_scene_free(dst);
+        return false;
+    }
+    return true;
+}
+
+void v3_scene_free(v3_scene *scene) {
+    if (scene == NULL) return;
+    if (scene->mapping != NULL) {
+        if (!mapped(scene, scene->bvh.nodes)) v3_bvh_free(&scene->bvh);
+        munmap(scene->mapping, scene->mapping_size);
+    } else {
+        free(scene->materials);
+        free(scene->spheres);
+        free(scene->planes);
+        free(scene->tris);
+        free(scene->tri_materials);
+        free(scene->lights);
+        free(scene->meshes);
+        free(scene->mesh_tris);
+        free(scene->mesh_tri_materials);
+        free(scene->mesh_nodes);
+        free(scene->mesh_prims);
+        free(scene->instances);
+        v3_bvh_free(&scene->bvh);
+    }
+    memset(scene, 0, sizeof(*scene));
+}
@@ -0,0 +1,172 @@
+#ifndef V3SCENE_H
+#define V3SCENE_H
+
+#include "v3bvh.h"
+#include "v3camera.h"
+#include "v3image.h"
+#include "v3tri.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Scene description for v3trace. Spheres, triangles and mesh instances are
+// held in a BVH whose primitive index p means spheres[p] for
+// p < sphere_count, then tris[p - sphere_count], then
+// instances[p - sphere_count - tri_count]; planes are unbounded and tested
+// apart.
+
+#define V3_SCENE_NAME_MAX 32
+
+typedef struct {
+    char name[V3_SCENE_NAME_MAX];
+    float diffuse[3];
+    float specular[3];
+    float shininess;   // Phong exponent
+    float reflect;     // weight of the mirror ray
+    float transmit;    // weight of the refracted ray
+    float ior;         // index of refraction inside the surface
+} v3_material;
+
+typedef struct {
+    float center[3];
+    float radius;
+    uint32_t material;
+} v3_sphere;
+
+typedef struct {
+    float point[3];
+    float normal[3];   // unit length
+    uint32_t material;
+} v3_plane;
+
+typedef struct {
+    float pos[3];
+    float color[3];
+} v3_light;
+
+// Instanced geometry is a two-level structure. A mesh is stored once: its
+// triangles are mesh_tris[tri_first .. tri_first + tri_count) and its own
+// (bottom-level) BVH is nodes[node_first ..] and prims[prim_first ..] of the
+// mesh_* arrays, with node and primitive indices local to the mesh. An
+// instance places a mesh with an affine transform and is one primitive of
+// the scene (top-level) BVH; rays are moved into object space to traverse
+// the mesh, so copies cost an instance record rather than their triangles.
+typedef struct {
+    char name[V3_SCENE_NAME_MAX];
+    uint32_t tri_first, tri_count;
+    uint32_t node_first, node_count;
+    uint32_t prim_first;
+    float bmin[3], bmax[3];   // object-space bounds
+} v3_mesh;
+
+typedef struct {
+    float to_world[12];    // row-major 3x4 [R | t], see v3_transform_point
+    float to_object[12];   // its inverse
+    uint32_t mesh;
+    uint32_t reserved;
+} v3_instance;
+
+typedef struct {
+    v3_camera camera;
+    int width, height;
+    int max_depth;     // reflection/refraction bounces after the primary ray
+    int samples;       // jittered camera rays per pixel
+    float background[3];
+    float ambient[3];
+    float exposure;     // output scale applied before tonemapping
+    v3_tonemap tonemap;
+
+    v3_material *materials;
+    size_t material_count;
+    v3_sphere *spheres;
+    size_t sphere_count;
+    v3_plane *planes;
+    size_t plane_count;
+    v3_tri_wt *tris;
+    uint32_t *tri_materials;
+    size_t tri_count;
+    v3_light *lights;
+    size_t light_count;
+
+    v3_mesh *meshes;
+    size_t mesh_count;
+    v3_tri_wt *mesh_tris;
+    uint32_t *mesh_tri_materials;
+    size_t mesh_tri_count;
+    v3_bvh_node *mesh_nodes;
+    size_t mesh_node_count;
+    uint32_t *mesh_prims;          // mesh_tri_count entries
+    v3_instance *instances;
+    size_t instance_count;
+    // room allocated by v3_scene_add_mesh/v3_scene_add_instance; 0 means
+    // the array holds exactly its count
+    size_t mesh_cap, mesh_tri_cap, mesh_tri_mat_cap, mesh_prim_cap, mesh_node_cap, instance_cap;
+
+    v3_bvh bvh;
+
+    // non-NULL when the arrays above point into a mapped binary scene
+    void *mapping;
+    size_t mapping_size;
+} v3_scene;
+
+// Text format, one statement per line, '#' starts a comment:
+//   image W H
+//   depth N
+//   samples N
+//   background r g b
+//   exposure e
+//   tonemap clamp|filmic
+//   ambient r g b
+//   camera pos x y z look x y z up x y z fov deg [aperture r] [focus d]
+//   material NAME diffuse r g b specular r g b shininess s
+//            reflect k transmit k ior n          (all keys optional)
+//   light pos x y z color r g b
+//   sphere center x y z radius r material NAME
+//   plane point x y z normal x y z material NAME
+//   triangle x y z x y z x y z material NAME
+//   mesh NAME                 triangles up to 'end' form mesh NAME, which
+//   end                       is drawn only through its instances
+//   instance NAME [scale x y z] [rotate x y z deg] [translate x y z]
+//                             a copy of mesh NAME, scaled, then rotated
+//                             about the axis, then translated
+// Materials and meshes must be defined before use. Each mesh BVH is built
+// at its 'end', the scene BVH after loading.
+bool v3_scene_load(v3_scene *scene, const char *path);
+bool v3_scene_parse(v3_scene *scene, FILE *f, const char *source);
+
+// Binary scenes hold the arrays above and the BVH in their in-memory layout,
+// each section 64-byte aligned. Loading maps the file copy-on-write and
+// points the scene into the mapping: nothing is parsed, copied or rebuilt,
+// only header and index bounds are checked. v3_scene_load detects binary
+// files by their leading magic.
+#define V3_SCENE_BINARY_MAGIC "V3SCENE"   // 8 bytes including the NUL
+bool v3_scene_save_binary(v3_scene *scene, const char *path);
+bool v3_scene_load_binary(v3_scene *scene, const char *path);
+
+// (re)build scene->bvh from the current spheres, triangles and instances;
+// mesh BVHs are left alone
+bool v3_scene_build_bvh(v3_scene *scene);
+
+// Add a mesh of count triangles (9 floats each, materials[i] for triangle
+// i) and build its BVH, or an instance of mesh with the affine to_world.
+// Call v3_scene_build_bvh afterwards. Not for mapped binary scenes.
+bool v3_scene_add_mesh(v3_scene *scene, const char *name, float *verts, uint32_t *materials, size_t count);
+bool v3_scene_add_instance(v3_scene *scene, uint32_t mesh, float *to_world);
+
+// Deep copy of src (including the BVH) into heap arrays, e.g. to edit a
+// private copy of a shared scene and publish it (see v3rcu.h).
+bool v3_scene_copy(v3_scene *dst, const v3_scene *src);
+
+void v3_scene_free(v3_scene *scene);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,348 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "v3scene.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define V3_SCENE_BINARY_VERSION 3
+#define V3_SCENE_BYTE_ORDER 0x01020304u
+#define SECTION_ALIGN 64
+
+enum {
+    SEC_MATERIALS,
+    SEC_SPHERES,
+    SEC_PLANES,
+    SEC_TRIS,
+    SEC_TRI_MATERIALS,
+    SEC_LIGHTS,
+    SEC_BVH_NODES,
+    SEC_BVH_PRIMS,
+    SEC_MESHES,
+    SEC_MESH_TRIS,
+    SEC_MESH_TRI_MATERIALS,
+    SEC_MESH_NODES,
+    SEC_MESH_PRIMS,
+    SEC_INSTANCES,
+    SEC_COUNT
+};
+
+typedef struct {
+    uint64_t offset;     // from the start of the file, multiple of SECTION_ALIGN
+    uint64_t count;
+    uint32_t elem_size;
+    uint32_t reserved;
+} section;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;  // rejects files written on a machine of other endianness
+    uint32_t header_size;
+    int32_t width, height, max_depth, samples;
+    float background[3];
+    float ambient[3];
+    float exposure;
+    int32_t tonemap;
+    v3_camera camera;
+    section sections[SEC_COUNT];
+} file_header;
+
+static const uint32_t k_elem_size[SEC_COUNT] = {
+    sizeof(v3_material), sizeof(v3_sphere), sizeof(v3_plane), sizeof(v3_tri_wt),
+    sizeof(uint32_t), sizeof(v3_light), sizeof(v3_bvh_node), sizeof(uint32_t),
+    sizeof(v3_mesh), sizeof(v3_tri_wt), sizeof(uint32_t), sizeof(v3_bvh_node),
+    sizeof(uint32_t), sizeof(v3_instance),
+};
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+static void bin_error(const char *path, const char *msg) {
+    fprintf(stderr, "Error: %s: %s\n", path, msg);
+}
+
+static uint64_t align_up(uint64_t x) {
+    return (x + SECTION_ALIGN - 1) & ~(uint64_t)(SECTION_ALIGN - 1);
+}
+
+// ---------- save ----------
+bool v3_scene_save_binary(v3_scene *scene, const char *path) {
+    if (scene == NULL || path == NULL) {
+        v3_error("v3_scene_save_binary received NULL pointer");
+        return false;
+    }
+    const void *data[SEC_COUNT] = {
+        scene->materials, scene->spheres, scene->planes, scene->tris,
+        scene->tri_materials, scene->lights, scene->bvh.nodes, scene->bvh.prims,
+        scene->meshes, scene->mesh_tris, scene->mesh_tri_materials, scene->mesh_nodes,
+        scene->mesh_prims, scene->instances,
+    };
+    uint64_t counts[SEC_COUNT] = {
+        scene->material_count, scene->sphere_count, scene->plane_count, scene->tri_count,
+        scene->tri_count, scene->light_count, scene->bvh.node_count, scene->bvh.prim_count,
+        scene->mesh_count, scene->mesh_tri_count, scene->mesh_tri_count, scene->mesh_node_count,
+        scene->mesh_tri_count, scene->instance_count,
+    };
+
+    file_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, V3_SCENE_BINARY_MAGIC, sizeof(hdr.magic));
+    hdr.version = V3_SCENE_BINARY_VERSION;
+    hdr.byte_order = V3_SCENE_BYTE_ORDER;
+    hdr.header_size = sizeof(hdr);
+    hdr.width = scene->width;
+    hdr.height = scene->height;
+    hdr.max_depth = scene->max_depth;
+    hdr.samples = scene->samples;
+    memcpy(hdr.background, scene->background, sizeof(hdr.background));
+    memcpy(hdr.ambient, scene->ambient, sizeof(hdr.ambient));
+    hdr.exposure = scene->exposure;
+    hdr.tonemap = (int32_t)scene->tonemap;
+    hdr.camera = scene->camera;
+    uint64_t offset = align_up(sizeof(hdr));
+    for (int i = 0; i < SEC_COUNT; i++) {
+        hdr.sections[i].offset = offset;
+        hdr.sections[i].count = counts[i];
+        hdr.sections[i].elem_size = k_elem_size[i];
+        offset = align_up(offset + counts[i] * k_elem_size[i]);
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        bin_error(path, "cannot open for writing");
+        return false;
+    }
+    static const char zeros[SECTION_ALIGN];
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    uint64_t pos = sizeof(hdr);
+    for (int i = 0; ok && i < SEC_COUNT; i++) {
+        ok = fwrite(zeros, 1, hdr.sections[i].offset - pos, f) == hdr.sections[i].offset - pos;
+        pos = hdr.sections[i].offset;
+        size_t bytes = (size_t)(counts[i] * k_elem_size[i]);
+        if (ok && bytes > 0) ok = fwrite(data[i], 1, bytes, f) == bytes;
+        pos += bytes;
+    }
+    // pad the tail so the file length matches the last aligned offset
+    if (ok) ok = fwrite(zeros, 1, offset - pos, f) == offset - pos;
+    if (fclose(f) != 0) ok = false;
+    if (!ok) bin_error(path, "write failed");
+    return ok;
+}
+
+// ---------- load ----------
+static bool check_sections(const file_header *hdr, size_t size, const char *path) {
+    for (int i = 0; i < SEC_COUNT; i++) {
+        const section *s = &hdr->sections[i];
+        if (s->elem_size != k_elem_size[i]) {
+            bin_error(path, "record size mismatch (written by an incompatible build)");
+            return false;
+        }
+        if (s->offset % SECTION_ALIGN != 0 || s->offset > size ||
+            s->count > (size - s->offset) / s->elem_size) {
+            bin_error(path, "section out of bounds");
+            return false;
+        }
+    }
+    if (hdr->sections[SEC_TRI_MATERIALS].count != hdr->sections[SEC_TRIS].count ||
+        hdr->sections[SEC_MESH_TRI_MATERIALS].count != hdr->sections[SEC_MESH_TRIS].count) {
+        bin_error(path, "triangle material count mismatch");
+        return false;
+    }
+    if (hdr->sections[SEC_MESH_PRIMS].count != hdr->sections[SEC_MESH_TRIS].count) {
+        bin_error(path, "mesh BVH does not match the mesh triangles");
+        return false;
+    }
+    return true;
+}
+
+// node and primitive indices of a BVH over prim_count primitives
+static bool check_bvh(const v3_bvh_node *nodes, size_t node_count, const uint32_t *prims,
+                      size_t prim_count) {
+    bool ok = true;
+    for (size_t i = 0; i < prim_count; i++) ok &= prims[i] < prim_count;
+    for (size_t i = 0; i < node_count; i++) {
+        const v3_bvh_node *n = &nodes[i];
+        if (n->count > 0) {
+            ok &= n->first <= prim_count && n->count <= prim_count - n->first;
+        } else {
+            // children come after their parent, so traversal cannot loop
+            ok &= n->first > i && n->first < node_count - 1;
+        }
+    }
+    if (!ok || node_count == 0) return ok;
+    // the traversal stacks hold paths of up to V3_BVH_MAX_DEPTH nodes;
+    // parents come first, so one pass sets every depth
+    uint8_t *depth = calloc(node_count, 1);
+    if (depth == NULL) return false;
+    for (size_t i = 0; i < node_count && ok; i++) {
+        const v3_bvh_node *n = &nodes[i];
+        if (n->count > 0) continue;
+        ok = depth[i] < V3_BVH_MAX_DEPTH;
+        for (uint32_t c = n->first; c <= n->first + 1; c++) {
+            if (depth[c] < depth[i] + 1) depth[c] = (uint8_t)(depth[i] + 1);
+        }
+    }
+    free(depth);
+    return ok;
+}
+
+static bool check_meshes(v3_scene *s, const char *path) {
+    bool ok = true;
+    for (size_t i = 0; i < s->mesh_count; i++) {
+        const v3_mesh *m = &s->meshes[i];
+        if (memchr(m->name, '\0', V3_SCENE_NAME_MAX) == NULL || m->tri_count == 0 ||
+            m->tri_first > s->mesh_tri_count || m->tri_count > s->mesh_tri_count - m->tri_first ||
+            m->prim_first > s->mesh_tri_count || m->tri_count > s->mesh_tri_count - m->prim_first ||
+            m->node_count == 0 || m->node_first > s->mesh_node_count ||
+            m->node_count > s->mesh_node_count - m->node_first) {
+            bin_error(path, "mesh range out of bounds");
+            return false;
+        }
+        ok &= check_bvh(s->mesh_nodes + m->node_first, m->node_count, s->mesh_prims + m->prim_first,
+                        m->tri_count);
+    }
+    if (!ok) {
+        bin_error(path, "mesh BVH index out of range or tree too deep");
+        return false;
+    }
+    for (size_t i = 0; i < s->mesh_tri_count; i++) ok &= s->mesh_tri_materials[i] < s->material_count;
+    for (size_t i = 0; i < s->instance_count; i++) ok &= s->instances[i].mesh < s->mesh_count;
+    if (!ok) {
+        bin_error(path, "mesh material or instance index out of range");
+        return false;
+    }
+    return true;
+}
+
+// index checks so a corrupt file cannot send the renderer out of bounds
+static bool check_indices(v3_scene *s, const char *path) {
+    for (size_t i = 0; i < s->material_count; i++) {
+        if (memchr(s->materials[i].name, '\0', V3_SCENE_NAME_MAX) == NULL) {
+            bin_error(path, "material name not terminated");
+            return false;
+        }
+    }
+    bool ok = true;
+    for (size_t i = 0; i < s->sphere_count; i++) ok &= s->spheres[i].material < s->material_count;
+    for (size_t i = 0; i < s->plane_count; i++) ok &= s->planes[i].material < s->material_count;
+    for (size_t i = 0; i < s->tri_count; i++) ok &= s->tri_materials[i] < s->material_count;
+    if (!ok) {
+        bin_error(path, "material index out of range");
+        return false;
+    }
+
+    if (!check_meshes(s, path)) return false;
+
+    v3_bvh *b = &s->bvh;
+    size_t prims = s->sphere_count + s->tri_count + s->instance_count;
+    if (b->prim_count != prims || (b->node_count == 0) != (prims == 0)) {
+        bin_error(path, "BVH does not match the primitives");
+        return false;
+    }
+    if (!check_bvh(b->nodes, b->node_count, b->prims, b->prim_count)) {
+        bin_error(path, "BVH index out of range or tree too deep");
+        return false;
+    }
+    return true;
+}
+
+bool v3_scene_load_binary(v3_scene *scene, const char *path) {
+    if (scene == NULL || path == NULL) {
+        v3_error("v3_scene_load_binary received NULL pointer");
+        return false;
+    }
+    memset(scene, 0, sizeof(*scene));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        bin_error(path, "cannot open");
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(file_header)) {
+        close(fd);
+        bin_error(path, "not a binary scene (too short)");
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    // private writable mapping: refits and edits stay in memory
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        bin_error(path, "mmap failed");
+        return false;
+    }
+
+    const file_header *hdr = map;
+    if (memcmp(hdr->magic, V3_SCENE_BINARY_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->byte_order != V3_SCENE_BYTE_ORDER || hdr->version != V3_SCENE_BINARY_VERSION ||
+        hdr->header_size != sizeof(file_header)) {
+        bin_error(path, "unsupported binary scene header");
+        munmap(map, size);
+        return false;
+    }
+    if (!check_sections(hdr, size, path)) {
+        munmap(map, size);
+        return false;
+    }
+
+    char *base = map;
+    void *ptr[SEC_COUNT];
+    for (int i = 0; i < SEC_COUNT; i++) {
+        ptr[i] = hdr->sections[i].count ? base + hdr->sections[i].offset : NULL;
+    }
+    scene->camera = hdr->camera;
+    scene->width = hdr->width;
+    scene->height = hdr->height;
+    scene->max_depth = hdr->max_depth;
+    scene->samples = hdr->samples;
+    memcpy(scene->background, hdr->background, sizeof(scene->background));
+    memcpy(scene->ambient, hdr->ambient, sizeof(scene->ambient));
+    scene->exposure = hdr->exposure;
+    scene->tonemap = (v3_tonemap)hdr->tonemap;
+    scene->materials = ptr[SEC_MATERIALS];
+    scene->material_count = hdr->sections[SEC_MATERIALS].count;
+    scene->spheres = ptr[SEC_SPHERES];
+    scene->sphere_count = hdr->sections[SEC_SPHERES].count;
+    scene->planes = ptr[SEC_PLANES];
+    scene->plane_count = hdr->sections[SEC_PLANES].count;
+    scene->tris = ptr[SEC_TRIS];
+    scene->tri_materials = ptr[SEC_TRI_MATERIALS];
+    scene->tri_count = hdr->sections[SEC_TRIS].count;
+    scene->lights = ptr[SEC_LIGHTS];
+    scene->light_count = hdr->sections[SEC_LIGHTS].count;
+    scene->bvh.nodes = ptr[SEC_BVH_NODES];
+    scene->bvh.node_count = hdr->sections[SEC_BVH_NODES].count;
+    scene->bvh.prims = ptr[SEC_BVH_PRIMS];
+    scene->bvh.prim_count = hdr->sections[SEC_BVH_PRIMS].count;
+    scene->meshes = ptr[SEC_MESHES];
+    scene->mesh_count = hdr->sections[SEC_MESHES].count;
+    scene->mesh_tris = ptr[SEC_MESH_TRIS];
+    scene->mesh_tri_materials = ptr[SEC_MESH_TRI_MATERIALS];
+    scene->mesh_tri_count = hdr->sections[SEC_MESH_TRIS].count;
+    scene->mesh_nodes = ptr[SEC_MESH_NODES];
+    scene->mesh_node_count = hdr->sections[SEC_MESH_NODES].count;
+    scene->mesh_prims = ptr[SEC_MESH_PRIMS];
+    scene->instances = ptr[SEC_INSTANCES];
+    scene->instance_count = hdr->sections[SEC_INSTANCES].count;
+    scene->mapping = map;
+    scene->mapping_size = size;
+
+    if (scene->width <= 0 || scene->height <= 0 || scene->samples <= 0 || scene->max_depth < 0 ||
+        (hdr->tonemap != V3_TONEMAP_CLAMP && hdr->tonemap != V3_TONEMAP_FILMIC)) {
+        bin_error(path, "invalid image settings");
+        v3_scene_free(scene);
+        return false;
+    }
+    if (!check_indices(scene, path)) {
+        v3_scene_free(scene);
+        return false;
+    }
+    return true;
+}
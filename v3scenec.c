@@ -0,0 +1,25 @@
+#include "v3scene.h"
+
+#include <stdio.h>
+
+// Scene converter. Usage: v3scenec scene.txt scene.v3s
+// Parses a text scene, builds its BVH and writes the binary form that
+// v3_scene_load maps without parsing.
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s scene.txt scene.v3s\n", argv[0]);
+        return 2;
+    }
+    v3_scene scene;
+    if (!v3_scene_load(&scene, argv[1])) return 1;
+    bool ok = v3_scene_save_binary(&scene, argv[2]);
+    if (ok) {
+        printf("%s: %zu materials, %zu spheres, %zu planes, %zu triangles, %zu lights, %zu meshes, "
+               "%zu instances, %zu BVH nodes\n",
+               argv[2], scene.material_count, scene.sphere_count, scene.plane_count, scene.tri_count,
+               scene.light_count, scene.mesh_count, scene.instance_count, scene.bvh.node_count);
+    }
+    v3_scene_free(&scene);
+    return ok ? 0 : 1;
+}
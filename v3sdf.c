@@ -0,0 +1,469 @@
+#include "v3sdf.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+// central-difference step of the gradient normals
+#define V3_SDF_NORMAL_STEP 1e-3f
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+// One primitive and one point, scalar. The SSE forms below run the same
+// operations in the same order, so both builds march identically.
+static float sd_sphere(const float *c, const float *size, float x, float y, float z) {
+    float dx = x - c[0], dy = y - c[1], dz = z - c[2];
+    return sqrtf(dx * dx + dy * dy + dz * dz) - size[0];
+}
+
+static float sd_box(const float *c, const float *half, float x, float y, float z) {
+    float qx = fabsf(x - c[0]) - half[0], qy = fabsf(y - c[1]) - half[1], qz = fabsf(z - c[2]) - half[2];
+    float ox = fmaxf(qx, 0.0f), oy = fmaxf(qy, 0.0f), oz = fmaxf(qz, 0.0f);
+    float outside = sqrtf(ox * ox + oy * oy + oz * oz);
+    return outside + fminf(fmaxf(qx, fmaxf(qy, qz)), 0.0f);
+}
+
+static float sd_torus(const float *c, const float *size, float x, float y, float z) {
+    float dx = x - c[0], dy = y - c[1], dz = z - c[2];
+    float ring = sqrtf(dx * dx + dz * dz) - size[0];
+    return sqrtf(ring * ring + dy * dy) - size[1];
+}
+
+// polynomial smooth minimum; hk = 0.5 / k, or 0 for the plain minimum
+static float smin(float a, float b, float k, float hk) {
+    if (hk == 0.0f) return fminf(a, b);
+    float h = fminf(fmaxf(0.5f + (b - a) * hk, 0.0f), 1.0f);
+    return b + (a - b) * h - k * h * (1.0f - h);
+}
+
+static float prim_dist(const v3_sdf_prim *p, float x, float y, float z) {
+    switch (p->kind) {
+    case V3_SDF_SPHERE: return sd_sphere(p->center, p->size, x, y, z);
+    case V3_SDF_BOX: return sd_box(p->center, p->size, x, y, z);
+    default: return sd_torus(p->center, p->size, x, y, z);
+    }
+}
+
+static float blend_hk(float k) {
+    return k > 0.0f ? 0.5f / k : 0.0f;
+}
+
+static float eval1(const v3_sdf *sdf, float x, float y, float z) {
+    if (sdf->count == 0) return INFINITY;
+    float d = prim_dist(&sdf->prims[0], x, y, z);
+    for (size_t i = 1; i < sdf->count; i++) {
+        const v3_sdf_prim *p = &sdf->prims[i];
+        d = smin(d, prim_dist(p, x, y, z), p->blend, blend_hk(p->blend));
+    }
+    return d;
+}
+
+// tetrahedron offsets: the gradient is sum(k * f(p + step * k)) / 4 step
+static const float k_tetra[4][3] = {{1, -1, -1}, {-1, -1, 1}, {-1, 1, -1}, {1, 1, 1}};
+
+static void normal1(const v3_sdf *sdf, float x, float y, float z, float *n) {
+    n[0] = n[1] = n[2] = 0.0f;
+    for (int i = 0; i < 4; i++) {
+        const float *k = k_tetra[i];
+        float f = eval1(sdf, x + V3_SDF_NORMAL_STEP * k[0], y + V3_SDF_NORMAL_STEP * k[1],
+                        z + V3_SDF_NORMAL_STEP * k[2]);
+        n[0] += k[0] * f;
+        n[1] += k[1] * f;
+        n[2] += k[2] * f;
+    }
+    float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    float inv = len > 0.0f ? 1.0f / len : 0.0f;
+    n[0] *= inv;
+    n[1] *= inv;
+    n[2] *= inv;
+}
+
+#ifdef __SSE__
+static inline __m128 abs4(__m128 v) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+static inline __m128 sd_sphere4(const float *c, const float *size, __m128 x, __m128 y, __m128 z) {
+    __m128 dx = _mm_sub_ps(x, _mm_set1_ps(c[0])), dy = _mm_sub_ps(y, _mm_set1_ps(c[1]));
+    __m128 dz = _mm_sub_ps(z, _mm_set1_ps(c[2]));
+    __m128 sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    return _mm_sub_ps(_mm_sqrt_ps(sq), _mm_set1_ps(size[0]));
+}
+
+static inline __m128 sd_box4(const float *c, const float *half, __m128 x, __m128 y, __m128 z) {
+    const __m128 zero = _mm_setzero_ps();
+    __m128 qx = _mm_sub_ps(abs4(_mm_sub_ps(x, _mm_set1_ps(c[0]))), _mm_set1_ps(half[0]));
+    __m128 qy = _mm_sub_ps(abs4(_mm_sub_ps(y, _mm_set1_ps(c[1]))), _mm_set1_ps(half[1]));
+    __m128 qz = _mm_sub_ps(abs4(_mm_sub_ps(z, _mm_set1_ps(c[2]))), _mm_set1_ps(half[2]));
+    __m128 ox = _mm_max_ps(qx, zero), oy = _mm_max_ps(qy, zero), oz = _mm_max_ps(qz, zero);
+    __m128 sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz));
+    __m128 inside = _mm_min_ps(_mm_max_ps(qx, _mm_max_ps(qy, qz)), zero);
+    return _mm_add_ps(_mm_sqrt_ps(sq), inside);
+}
+
+static inline __m128 sd_torus4(const float *c, const float *size, __m128 x, __m128 y, __m128 z) {
+    __m128 dx = _mm_sub_ps(x, _mm_set1_ps(c[0])), dy = _mm_sub_ps(y, _mm_set1_ps(c[1]));
+    __m128 dz = _mm_sub_ps(z, _mm_set1_ps(c[2]));
+    __m128 ring = _mm_sub_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz))), _mm_set1_ps(size[0]));
+    __m128 sq = _mm_add_ps(_mm_mul_ps(ring, ring), _mm_mul_ps(dy, dy));
+    return _mm_sub_ps(_mm_sqrt_ps(sq), _mm_set1_ps(size[1]));
+}
+
+static inline __m128 smin4(__m128 a, __m128 b, float k, float hk) {
+    if (hk == 0.0f) return _mm_min_ps(a, b);
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 h = _mm_add_ps(_mm_set1_ps(0.5f), _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(hk)));
+    h = _mm_min_ps(_mm_max_ps(h, _mm_setzero_ps()), one);
+    __m128 mix = _mm_add_ps(b, _mm_mul_ps(_mm_sub_ps(a, b), h));
+    return _mm_sub_ps(mix, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(k), h), _mm_sub_ps(one, h)));
+}
+
+static inline __m128 prim_dist4(const v3_sdf_prim *p, __m128 x, __m128 y, __m128 z) {
+    switch (p->kind) {
+    case V3_SDF_SPHERE: return sd_sphere4(p->center, p->size, x, y, z);
+    case V3_SDF_BOX: return sd_box4(p->center, p->size, x, y, z);
+    default: return sd_torus4(p->center, p->size, x, y, z);
+    }
+}
+
+static inline __m128 eval4(const v3_sdf *sdf, __m128 x, __m128 y, __m128 z) {
+    if (sdf->count == 0) return _mm_set1_ps(INFINITY);
+    __m128 d = prim_dist4(&sdf->prims[0], x, y, z);
+    for (size_t i = 1; i < sdf->count; i++) {
+        const v3_sdf_prim *p = &sdf->prims[i];
+        d = smin4(d, prim_dist4(p, x, y, z), p->blend, blend_hk(p->blend));
+    }
+    return d;
+}
+
+static inline void normal4(const v3_sdf *sdf, __m128 x, __m128 y, __m128 z, __m128 *n) {
+    n[0] = n[1] = n[2] = _mm_setzero_ps();
+    for (int i = 0; i < 4; i++) {
+        const float *k = k_tetra[i];
+        __m128 f = eval4(sdf, _mm_add_ps(x, _mm_set1_ps(V3_SDF_NORMAL_STEP * k[0])),
+                         _mm_add_ps(y, _mm_set1_ps(V3_SDF_NORMAL_STEP * k[1])),
+                         _mm_add_ps(z, _mm_set1_ps(V3_SDF_NORMAL_STEP * k[2])));
+        for (int a = 0; a < 3; a++) n[a] = _mm_add_ps(n[a], _mm_mul_ps(_mm_set1_ps(k[a]), f));
+    }
+    __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(n[0], n[0]), _mm_mul_ps(n[1], n[1])),
+                                        _mm_mul_ps(n[2], n[2])));
+    // 1 / len where len > 0, else 0 (the division's NaN/inf is masked off)
+    __m128 inv = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), len), _mm_cmpgt_ps(len, _mm_setzero_ps()));
+    for (int a = 0; a < 3; a++) n[a] = _mm_mul_ps(n[a], inv);
+}
+#endif
+
+// ---------- field ----------
+bool v3_sdf_init(v3_sdf *sdf) {
+    if (sdf == NULL) {
+        v3_error("v3_sdf_init received NULL pointer");
+        return false;
+    }
+    memset(sdf, 0, sizeof(*sdf));
+    sdf->max_steps = 128;
+    sdf->eps = 1e-4f;
+    return true;
+}
+
+void v3_sdf_free(v3_sdf *sdf) {
+    if (sdf == NULL) return;
+    free(sdf->prims);
+    memset(sdf, 0, sizeof(*sdf));
+}
+
+static bool add_prim(v3_sdf *sdf, uint32_t kind, float *center, const float *size, float blend) {
+    if (sdf->count == sdf->cap) {
+        size_t cap = sdf->cap ? 2 * sdf->cap : 8;
+        v3_sdf_prim *p = realloc(sdf->prims, cap * sizeof(v3_sdf_prim));
+        if (p == NULL) {
+            v3_error("v3_sdf_add out of memory");
+            return false;
+        }
+        sdf->prims = p;
+        sdf->cap = cap;
+    }
+    v3_sdf_prim *p = &sdf->prims[sdf->count++];
+    p->kind = kind;
+    memcpy(p->center, center, sizeof(p->center));
+    memcpy(p->size, size, sizeof(p->size));
+    p->blend = blend;
+    return true;
+}
+
+bool v3_sdf_add_sphere(v3_sdf *sdf, float *center, float radius, float blend) {
+    if (sdf == NULL || center == NULL) {
+        v3_error("v3_sdf_add_sphere received NULL pointer");
+        return false;
+    }
+    if (!(radius > 0.0f) || !(blend >= 0.0f)) {
+        v3_error("v3_sdf_add_sphere needs radius > 0 and blend >= 0");
+        return false;
+    }
+    float size[3] = {radius, 0.0f, 0.0f};
+    return add_prim(sdf, V3_SDF_SPHERE, center, size, blend);
+}
+
+bool v3_sdf_add_box(v3_sdf *sdf, float *center, float *half, float blend) {
+    if (sdf == NULL || center == NULL || half == NULL) {
+        v3_error("v3_sdf_add_box received NULL pointer");
+        return false;
+    }
+    if (!(half[0] > 0.0f && half[1] > 0.0f && half[2] > 0.0f) || !(blend >= 0.0f)) {
+        v3_error("v3_sdf_add_box needs half extents > 0 and blend >= 0");
+        return false;
+    }
+    return add_prim(sdf, V3_SDF_BOX, center, half, blend);
+}
+
+bool v3_sdf_add_torus(v3_sdf *sdf, float *center, float major, float minor, float blend) {
+    if (sdf == NULL || center == NULL) {
+        v3_error("v3_sdf_add_torus received NULL pointer");
+        return false;
+    }
+    if (!(minor > 0.0f && major >= minor) || !(blend >= 0.0f)) {
+        v3_error("v3_sdf_add_torus needs major >= minor > 0 and blend >= 0");
+        return false;
+    }
+    float size[3] = {major, minor, 0.0f};
+    return add_prim(sdf, V3_SDF_TORUS, center, size, blend);
+}
+
+// ---------- batched distance functions ----------
+void v3_sdf_sphere_soa(float *dst, v3_soa3 p, float *center, float radius, size_t count) {
+    if (dst == NULL || p.x == NULL || p.y == NULL || p.z == NULL || center == NULL) {
+        v3_error("v3_sdf_sphere_soa received NULL pointer");
+        return;
+    }
+    float size[3] = {radius, 0.0f, 0.0f};
+    size_t i = 0;
+#ifdef __SSE__
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(p.x + i), y = _mm_loadu_ps(p.y + i), z = _mm_loadu_ps(p.z + i);
+        _mm_storeu_ps(dst + i, sd_sphere4(center, size, x, y, z));
+    }
+#endif
+    for (; i < count; i++) dst[i] = sd_sphere(center, size, p.x[i], p.y[i], p.z[i]);
+}
+
+void v3_sdf_box_soa(float *dst, v3_soa3 p, float *center, float *half, size_t count) {
+    if (dst == NULL || p.x == NULL || p.y == NULL || p.z == NULL || center == NULL || half == NULL) {
+        v3_error("v3_sdf_box_soa received NULL pointer");
+        return;
+    }
+    size_t i = 0;
+#ifdef __SSE__
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(p.x + i), y = _mm_loadu_ps(p.y + i), z = _mm_loadu_ps(p.z + i);
+        _mm_storeu_ps(dst + i, sd_box4(center, half, x, y, z));
+    }
+#endif
+    for (; i < count; i++) dst[i] = sd_box(center, half, p.x[i], p.y[i], p.z[i]);
+}
+
+void v3_sdf_torus_soa(float *dst, v3_soa3 p, float *center, float major, float minor, size_t count) {
+    if (dst == NULL || p.x == NULL || p.y == NULL || p.z == NULL || center == NULL) {
+        v3_error("v3_sdf_torus_soa received NULL pointer");
+        return;
+    }
+    float size[3] = {major, minor, 0.0f};
+    size_t i = 0;
+#ifdef __SSE__
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(p.x + i), y = _mm_loadu_ps(p.y + i), z = _mm_loadu_ps(p.z + i);
+        _mm_storeu_ps(dst + i, sd_torus4(center, size, x, y, z));
+    }
+#endif
+    for (; i < count; i++) dst[i] = sd_torus(center, size, p.x[i], p.y[i], p.z[i]);
+}
+
+void v3_sdf_smooth_union_soa(float *dst, float *a, float *b, float k, size_t count) {
+    if (dst == NULL || a == NULL || b == NULL) {
+        v3_error("v3_sdf_smooth_union_soa received NULL pointer");
+        return;
+    }
+    float hk = blend_hk(k);
+    size_t i = 0;
+#ifdef __SSE__
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(dst + i, smin4(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i), k, hk));
+    }
+#endif
+    for (; i < count; i++) dst[i] = smin(a[i], b[i], k, hk);
+}
+
+void v3_sdf_eval_soa(v3_sdf *sdf, float *dst, v3_soa3 p, size_t count) {
+    if (sdf == NULL || dst == NULL || p.x == NULL || p.y == NULL || p.z == NULL) {
+        v3_error("v3_sdf_eval_soa received NULL pointer");
+        return;
+    }
+    size_t i = 0;
+#ifdef __SSE__
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(p.x + i), y = _mm_loadu_ps(p.y + i), z = _mm_loadu_ps(p.z + i);
+        _mm_storeu_ps(dst + i, eval4(sdf, x, y, z));
+    }
+#endif
+    for (; i < count; i++) dst[i] = eval1(sdf, p.x[i], p.y[i], p.z[i]);
+}
+
+void v3_sdf_normal_soa(v3_sdf *sdf, v3_soa3 n, v3_soa3 p, size_t count) {
+    if (sdf == NULL || n.x == NULL || n.y == NULL || n.z == NULL || p.x == NULL || p.y == NULL || p.z == NULL) {
+        v3_error("v3_sdf_normal_soa received NULL pointer");
+        return;
+    }
+    size_t i = 0;
+#ifdef __SSE__
+    for (; i + 4 <= count; i += 4) {
+        __m128 g[3];
+        normal4(sdf, _mm_loadu_ps(p.x + i), _mm_loadu_ps(p.y + i), _mm_loadu_ps(p.z + i), g);
+        _mm_storeu_ps(n.x + i, g[0]);
+        _mm_storeu_ps(n.y + i, g[1]);
+        _mm_storeu_ps(n.z + i, g[2]);
+    }
+#endif
+    for (; i < count; i++) {
+        float g[3];
+        normal1(sdf, p.x[i], p.y[i], p.z[i], g);
+        n.x[i] = g[0];
+        n.y[i] = g[1];
+        n.z[i] = g[2];
+    }
+}
+
+// ---------- sphere tracing ----------
+typedef struct {
+    const v3_sdf *sdf;
+    const v3_ray_soa *rays;
+    const float *t_max;
+    size_t count;
+    float *t;
+    v3_soa3 normal;
+    uint8_t *hit;
+    _Atomic size_t hits;
+} march_ctx;
+
+#ifdef __SSE__
+// Rays [first, first + n), n <= 4, in the lanes of one register set. Lanes
+// past n get t_max = -1 and never step.
+static size_t march4(const march_ctx *c, size_t first, size_t n) {
+    const v3_ray_soa *r = c->rays;
+    _Alignas(16) float lane[7][4];
+    for (size_t l = 0; l < 4; l++) {
+        bool real = l < n;
+        size_t i = first + l;
+        lane[0][l] = real ? r->ox[i] : 0.0f;
+        lane[1][l] = real ? r->oy[i] : 0.0f;
+        lane[2][l] = real ? r->oz[i] : 0.0f;
+        lane[3][l] = real ? r->dx[i] : 0.0f;
+        lane[4][l] = real ? r->dy[i] : 0.0f;
+        lane[5][l] = real ? r->dz[i] : 0.0f;
+        lane[6][l] = real ? c->t_max[i] : -1.0f;
+    }
+    const __m128 ox = _mm_load_ps(lane[0]), oy = _mm_load_ps(lane[1]), oz = _mm_load_ps(lane[2]);
+    const __m128 dx = _mm_load_ps(lane[3]), dy = _mm_load_ps(lane[4]), dz = _mm_load_ps(lane[5]);
+    const __m128 tm = _mm_load_ps(lane[6]), eps = _mm_set1_ps(c->sdf->eps), one = _mm_set1_ps(1.0f);
+    __m128 t = _mm_setzero_ps();
+    __m128 active = _mm_cmplt_ps(t, tm), hit = _mm_setzero_ps();
+    for (int step = 0; step < c->sdf->max_steps && _mm_movemask_ps(active) != 0; step++) {
+        __m128 px = _mm_add_ps(ox, _mm_mul_ps(t, dx));
+        __m128 py = _mm_add_ps(oy, _mm_mul_ps(t, dy));
+        __m128 pz = _mm_add_ps(oz, _mm_mul_ps(t, dz));
+        __m128 d = eval4(c->sdf, px, py, pz);
+        __m128 close = _mm_and_ps(active, _mm_cmplt_ps(d, _mm_mul_ps(eps, _mm_max_ps(t, one))));
+        hit = _mm_or_ps(hit, close);
+        active = _mm_andnot_ps(close, active);
+        t = _mm_add_ps(t, _mm_and_ps(d, active));
+        active = _mm_and_ps(active, _mm_cmplt_ps(t, tm));
+    }
+    t = _mm_or_ps(_mm_and_ps(hit, t), _mm_andnot_ps(hit, tm));
+    int mask = _mm_movemask_ps(hit);
+    _Alignas(16) float out[4][4];
+    _mm_store_ps(out[0], t);
+    if (c->normal.x != NULL) {
+        __m128 g[3];
+        if (mask != 0) {
+            normal4(c->sdf, _mm_add_ps(ox, _mm_mul_ps(t, dx)), _mm_add_ps(oy, _mm_mul_ps(t, dy)),
+                    _mm_add_ps(oz, _mm_mul_ps(t, dz)), g);
+        }
+        for (int a = 0; a < 3; a++) _mm_store_ps(out[1 + a], mask ? _mm_and_ps(g[a], hit) : _mm_setzero_ps());
+    }
+    for (size_t l = 0; l < n; l++) {
+        size_t i = first + l;
+        c->t[i] = out[0][l];
+        c->hit[i] = (uint8_t)(mask >> l & 1);
+        if (c->normal.x != NULL) {
+            c->normal.x[i] = out[1][l];
+            c->normal.y[i] = out[2][l];
+            c->normal.z[i] = out[3][l];
+        }
+    }
+    return (size_t)__builtin_popcount((unsigned)mask & ((1u << n) - 1));
+}
+#else
+static size_t march1(const march_ctx *c, size_t i) {
+    const v3_ray_soa *r = c->rays;
+    float o[3] = {r->ox[i], r->oy[i], r->oz[i]}, d[3] = {r->dx[i], r->dy[i], r->dz[i]};
+    float tm = c->t_max[i], t = 0.0f;
+    bool active = t < tm, hit = false;
+    for (int step = 0; step < c->sdf->max_steps && active; step++) {
+        float dist = eval1(c->sdf, o[0] + t * d[0], o[1] + t * d[1], o[2] + t * d[2]);
+        if (dist < c->sdf->eps * fmaxf(t, 1.0f)) {
+            hit = true;
+            break;
+        }
+        t = t + dist;
+        active = t < tm;
+    }
+    c->t[i] = hit ? t : tm;
+    c->hit[i] = hit;
+    if (c->normal.x != NULL) {
+        float g[3] = {0.0f, 0.0f, 0.0f};
+        if (hit) normal1(c->sdf, o[0] + t * d[0], o[1] + t * d[1], o[2] + t * d[2], g);
+        c->normal.x[i] = g[0];
+        c->normal.y[i] = g[1];
+        c->normal.z[i] = g[2];
+    }
+    return hit;
+}
+#endif
+
+static void march_chunks(void *arg, size_t begin, size_t end) {
+    march_ctx *c = arg;
+    size_t hits = 0;
+    for (size_t chunk = begin; chunk < end; chunk++) {
+        size_t first = chunk * V3_SDF_CHUNK;
+        size_t last = c->count - first < V3_SDF_CHUNK ? c->count : first + V3_SDF_CHUNK;
+#ifdef __SSE__
+        for (size_t i = first; i < last; i += 4) hits += march4(c, i, last - i < 4 ? last - i : 4);
+#else
+        for (size_t i = first; i < last; i++) hits += march1(c, i);
+#endif
+    }
+    atomic_fetch_add(&c->hits, hits);
+}
+
+size_t v3_sdf_march(v3_sdf *sdf, v3_pool *pool, const v3_ray_soa *rays, const float *t_max, size_t count,
+                    float *t, v3_soa3 normal, uint8_t *hit) {
+    if (sdf == NULL || rays == NULL || t_max == NULL || t == NULL || hit == NULL) {
+        v3_error("v3_sdf_march received NULL pointer");
+        return 0;
+    }
+    if (normal.x != NULL && (normal.y == NULL || normal.z == NULL)) {
+        v3_error("v3_sdf_march received a partial normal array");
+        return 0;
+    }
+    march_ctx c = {.sdf = sdf, .rays = rays, .t_max = t_max, .count = count, .t = t, .normal = normal, .hit = hit};
+    atomic_init(&c.hits, 0);
+    size_t chunks = (count + V3_SDF_CHUNK - 1) / V3_SDF_CHUNK;
+    v3_pool_parallel_for(pool ? pool : v3_pool_default(), chunks, 1, march_chunks, &c);
+    return atomic_load(&c.hits);
+}
@@ -0,0 +1,556 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "v3serve.h"
+#include "v3trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+#define V3_SERVE_MAGIC 0x51533356u   // "V3SQ"
+#define V3_SERVE_VERSION 1u
+#define V3_SERVE_MAX_SLOTS 1024u
+#define V3_SERVE_MAX_SLOT_RAYS (1u << 20)
+#define V3_SERVE_GRAIN 64
+
+// Handshake, client to server, with the ring's file descriptor attached.
+typedef struct {
+    uint32_t magic, version;
+    uint32_t slots, slot_rays;
+} serve_hello;
+
+// Handshake reply: status 0 accepts the ring.
+typedef struct {
+    uint32_t magic;
+    int32_t status;
+} serve_welcome;
+
+// Doorbell in both directions: (slot, ray count) from the client,
+// (slot, hit count) back from the server.
+typedef struct {
+    uint32_t slot, count;
+} serve_msg;
+
+static size_t round64(size_t n) {
+    return (n + 63) & ~(size_t)63;
+}
+
+// Slot i holds its rays at i * slot_bytes and its hits right after them.
+static size_t hits_offset(uint32_t slot_rays) {
+    return round64((size_t)slot_rays * sizeof(v3_query_ray));
+}
+
+static size_t slot_bytes(uint32_t slot_rays) {
+    return hits_offset(slot_rays) + round64((size_t)slot_rays * sizeof(v3_query_hit));
+}
+
+static bool write_full(int fd, const void *buf, size_t n) {
+    const char *p = buf;
+    while (n > 0) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+static bool read_full(int fd, void *buf, size_t n) {
+    char *p = buf;
+    while (n > 0) {
+        ssize_t r = recv(fd, p, n, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+static bool socket_address(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        v3_error("v3serve socket path too long");
+        return false;
+    }
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+// ---------- server ----------
+typedef struct serve_conn {
+    struct v3_server *server;
+    int fd;
+    pthread_t thread;
+    atomic_bool done;
+    struct serve_conn *next;
+} serve_conn;
+
+struct v3_server {
+    v3_scene *scene;
+    v3_pool *pool;
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    int listen_fd;
+    pthread_t accept_thread;
+    atomic_bool stopping;
+
+    pthread_mutex_t lock;   // conns
+    serve_conn *conns;
+
+    _Atomic uint64_t clients, batches, rays;
+};
+
+typedef struct {
+    v3_scene *scene;
+    v3_query_ray *rays;
+    v3_query_hit *hits;
+    _Atomic uint32_t hit_count;
+} trace_job;
+
+static void trace_range(void *arg, size_t begin, size_t end) {
+    trace_job *job = arg;
+    uint32_t found = 0;
+    for (size_t i = begin; i < end; i++) {
+        v3_query_ray *r = &job->rays[i];
+        v3_query_hit *out = &job->hits[i];
+        v3_hit h;
+        if (v3_trace_intersect(job->scene, r->orig, r->dir, r->t_max, &h)) {
+            out->t = h.t;
+            memcpy(out->n, h.n, sizeof(out->n));
+            out->material = h.material;
+            out->flags = V3_QUERY_HIT | (h.inside ? V3_QUERY_INSIDE : 0u);
+            found++;
+        } else {
+            out->t = r->t_max;
+            out->n[0] = out->n[1] = out->n[2] = 0.0f;
+            out->material = 0;
+            out->flags = 0;
+        }
+    }
+    atomic_fetch_add_explicit(&job->hit_count, found, memory_order_relaxed);
+}
+
+// Receive the hello and the ring descriptor; returns the mapped ring or NULL.
+static char *accept_ring(int fd, serve_hello *hello, size_t *size) {
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = {hello, sizeof(*hello)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t r;
+    do {
+        r = recvmsg(fd, &msg, 0);
+    } while (r < 0 && errno == EINTR);
+    if (r <= 0) return NULL;
+
+    int ring_fd = -1;
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    if (cm != NULL && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS &&
+        cm->cmsg_len == CMSG_LEN(sizeof(int))) {
+        memcpy(&ring_fd, CMSG_DATA(cm), sizeof(int));
+    }
+    // the rest of a short hello, should the stream have split it
+    if (ring_fd < 0 || !read_full(fd, (char *)hello + r, sizeof(*hello) - (size_t)r)) {
+        if (ring_fd >= 0) close(ring_fd);
+        v3_error("v3_server client sent no ring");
+        return NULL;
+    }
+
+    char *ring = NULL;
+    struct stat st;
+    if (hello->magic != V3_SERVE_MAGIC || hello->version != V3_SERVE_VERSION) {
+        v3_error("v3_server client speaks another protocol");
+    } else if (hello->slots == 0 || hello->slots > V3_SERVE_MAX_SLOTS || hello->slot_rays == 0 ||
+               hello->slot_rays > V3_SERVE_MAX_SLOT_RAYS) {
+        v3_error("v3_server client ring has an invalid size");
+    } else if (fstat(ring_fd, &st) != 0 ||
+               (size_t)st.st_size < (*size = hello->slots * slot_bytes(hello->slot_rays))) {
+        v3_error("v3_server client ring is smaller than announced");
+    } else {
+        ring = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+        if (ring == MAP_FAILED) {
+            v3_error("v3_server cannot map client ring");
+            ring = NULL;
+        }
+    }
+    close(ring_fd);
+    return ring;
+}
+
+static void *serve_client(void *arg) {
+    serve_conn *conn = arg;
+    v3_server *s = conn->server;
+    serve_hello hello;
+    size_t size = 0;
+    char *ring = accept_ring(conn->fd, &hello, &size);
+    serve_welcome welcome = {V3_SERVE_MAGIC, ring ? 0 : -1};
+    if (write_full(conn->fd, &welcome, sizeof(welcome)) && ring != NULL) {
+        size_t stride = slot_bytes(hello.slot_rays), hits = hits_offset(hello.slot_rays);
+        serve_msg m;
+        while (read_full(conn->fd, &m, sizeof(m))) {
+            if (m.slot >= hello.slots || m.count > hello.slot_rays) {
+                v3_error("v3_server client submitted an invalid batch");
+                break;
+            }
+            char *slot = ring + (size_t)m.slot * stride;
+            trace_job job = {s->scene, (v3_query_ray *)slot, (v3_query_hit *)(slot + hits), 0};
+            v3_pool_parallel_for(s->pool, m.count, V3_SERVE_GRAIN, trace_range, &job);
+            serve_msg reply = {m.slot, atomic_load(&job.hit_count)};
+            atomic_fetch_add_explicit(&s->batches, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&s->rays, m.count, memory_order_relaxed);
+            if (!write_full(conn->fd, &reply, sizeof(reply))) break;
+        }
+    }
+    if (ring != NULL) munmap(ring, size);
+    atomic_store(&conn->done, true);
+    return NULL;
+}
+
+// join and free connections whose client has left; lock held
+static void reap_conns(v3_server *s) {
+    serve_conn **link = &s->conns;
+    while (*link != NULL) {
+        serve_conn *c = *link;
+        if (atomic_load(&c->done)) {
+            pthread_join(c->thread, NULL);
+            close(c->fd);
+            *link = c->next;
+            free(c);
+        } else {
+            link = &c->next;
+        }
+    }
+}
+
+static void *accept_loop(void *arg) {
+    v3_server *s = arg;
+    for (;;) {
+        int fd = accept(s->listen_fd, NULL, NULL);
+        if (atomic_load(&s->stopping)) {
+            if (fd >= 0) close(fd);
+            break;
+        }
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            v3_error("v3_server accept failed");
+            break;
+        }
+        serve_conn *conn = malloc(sizeof(*conn));
+        if (conn == NULL) {
+            v3_error("v3_server out of memory");
+            close(fd);
+            continue;
+        }
+        conn->server = s;
+        conn->fd = fd;
+        atomic_init(&conn->done, false);
+        pthread_mutex_lock(&s->lock);
+        reap_conns(s);
+        // counted before the client thread can answer, so a client that has
+        // its welcome already shows up in v3_server_stats
+        atomic_fetch_add_explicit(&s->clients, 1, memory_order_relaxed);
+        if (pthread_create(&conn->thread, NULL, serve_client, conn) != 0) {
+            atomic_fetch_sub_explicit(&s->clients, 1, memory_order_relaxed);
+            pthread_mutex_unlock(&s->lock);
+            v3_error("v3_server cannot start client thread");
+            close(fd);
+            free(conn);
+            continue;
+        }
+        conn->next = s->conns;
+        s->conns = conn;
+        pthread_mutex_unlock(&s->lock);
+    }
+    return NULL;
+}
+
+v3_server *v3_server_start(v3_scene *scene, const char *path, v3_pool *pool) {
+    if (scene == NULL || path == NULL) {
+        v3_error("v3_server_start received NULL pointer");
+        return NULL;
+    }
+    struct sockaddr_un addr;
+    if (!socket_address(&addr, path)) return NULL;
+    v3_server *s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        v3_error("v3_server_start out of memory");
+        return NULL;
+    }
+    s->scene = scene;
+    s->pool = pool ? pool : v3_pool_default();
+    strcpy(s->path, addr.sun_path);
+    atomic_init(&s->stopping, false);
+    atomic_init(&s->clients, 0);
+    atomic_init(&s->batches, 0);
+    atomic_init(&s->rays, 0);
+
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+    s->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s->listen_fd < 0 || bind(s->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        v3_error("v3_server_start cannot bind socket");
+        if (s->listen_fd >= 0) close(s->listen_fd);
+        free(s);
+        return NULL;
+    }
+    if (chmod(path, 0600) != 0 || listen(s->listen_fd, 64) != 0) {
+        v3_error("v3_server_start cannot listen on socket");
+        close(s->listen_fd);
+        unlink(path);
+        free(s);
+        return NULL;
+    }
+    pthread_mutex_init(&s->lock, NULL);
+    if (pthread_create(&s->accept_thread, NULL, accept_loop, s) != 0) {
+        v3_error("v3_server_start cannot start accept thread");
+        pthread_mutex_destroy(&s->lock);
+        close(s->listen_fd);
+        unlink(path);
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+void v3_server_stop(v3_server *s) {
+    if (s == NULL) return;
+    atomic_store(&s->stopping, true);
+    // shutdown wakes the blocked accept and every blocked client read
+    shutdown(s->listen_fd, SHUT_RDWR);
+    pthread_join(s->accept_thread, NULL);
+    close(s->listen_fd);
+    unlink(s->path);
+
+    pthread_mutex_lock(&s->lock);
+    for (serve_conn *c = s->conns; c != NULL; c = c->next) shutdown(c->fd, SHUT_RDWR);
+    while (s->conns != NULL) {
+        serve_conn *c = s->conns;
+        pthread_join(c->thread, NULL);
+        close(c->fd);
+        s->conns = c->next;
+        free(c);
+    }
+    pthread_mutex_unlock(&s->lock);
+    pthread_mutex_destroy(&s->lock);
+    free(s);
+}
+
+void v3_server_get_stats(v3_server *s, v3_server_stats *stats) {
+    if (s == NULL || stats == NULL) {
+        v3_error("v3_server_get_stats received NULL pointer");
+        return;
+    }
+    stats->clients = atomic_load(&s->clients);
+    stats->batches = atomic_load(&s->batches);
+    stats->rays = atomic_load(&s->rays);
+}
+
+// ---------- client ----------
+struct v3_client {
+    int fd;
+    char *ring;
+    size_t ring_size;
+    unsigned slots, slot_rays;
+    unsigned in_flight;
+};
+
+// Create an unlinked shared-memory object of size bytes; returns its fd.
+static int create_ring(size_t size) {
+    static _Atomic unsigned counter;
+    char name[64];
+    for (int attempt = 0; attempt < 16; attempt++) {
+        snprintf(name, sizeof(name), "/v3serve-%ld-%u", (long)getpid(), atomic_fetch_add(&counter, 1));
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) {
+            if (errno == EEXIST) continue;
+            return -1;
+        }
+        shm_unlink(name);
+        if (ftruncate(fd, (off_t)size) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    return -1;
+}
+
+static bool send_hello(int fd, const serve_hello *hello, int ring_fd) {
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov = {(void *)hello, sizeof(*hello)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cm), &ring_fd, sizeof(int));
+    ssize_t w;
+    do {
+        w = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (w < 0 && errno == EINTR);
+    // the descriptor went with the first byte; the rest is plain data
+    return w > 0 && write_full(fd, (const char *)hello + w, sizeof(*hello) - (size_t)w);
+}
+
+v3_client *v3_client_connect(const char *path, unsigned slots, unsigned slot_rays) {
+    if (path == NULL) {
+        v3_error("v3_client_connect received NULL pointer");
+        return NULL;
+    }
+    if (slots == 0 || slots > V3_SERVE_MAX_SLOTS || slot_rays == 0 || slot_rays > V3_SERVE_MAX_SLOT_RAYS) {
+        v3_error("v3_client_connect ring size out of range");
+        return NULL;
+    }
+    struct sockaddr_un addr;
+    if (!socket_address(&addr, path)) return NULL;
+    v3_client *c = calloc(1, sizeof(*c));
+    if (c == NULL) {
+        v3_error("v3_client_connect out of memory");
+        return NULL;
+    }
+    c->slots = slots;
+    c->slot_rays = slot_rays;
+    c->ring_size = slots * slot_bytes(slot_rays);
+    c->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (c->fd < 0 || connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        v3_error("v3_client_connect cannot reach server");
+        if (c->fd >= 0) close(c->fd);
+        free(c);
+        return NULL;
+    }
+
+    int ring_fd = create_ring(c->ring_size);
+    if (ring_fd >= 0) {
+        c->ring = mmap(NULL, c->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+        if (c->ring == MAP_FAILED) c->ring = NULL;
+    }
+    serve_hello hello = {V3_SERVE_MAGIC, V3_SERVE_VERSION, slots, slot_rays};
+    serve_welcome welcome;
+    bool ok = c->ring != NULL && send_hello(c->fd, &hello, ring_fd) &&
+              read_full(c->fd, &welcome, sizeof(welcome)) && welcome.magic == V3_SERVE_MAGIC &&
+              welcome.status == 0;
+    if (ring_fd >= 0) close(ring_fd);
+    if (!ok) {
+        v3_error(c->ring ? "v3_client_connect refused by server" : "v3_client_connect cannot create ring");
+        v3_client_close(c);
+        return NULL;
+    }
+    return c;
+}
+
+void v3_client_close(v3_client *c) {
+    if (c == NULL) return;
+    close(c->fd);
+    if (c->ring != NULL) munmap(c->ring, c->ring_size);
+    free(c);
+}
+
+unsigned v3_client_slots(const v3_client *c) {
+    return c ? c->slots : 0;
+}
+
+unsigned v3_client_slot_rays(const v3_client *c) {
+    return c ? c->slot_rays : 0;
+}
+
+v3_query_ray *v3_client_rays(v3_client *c, unsigned slot) {
+    if (c == NULL || slot >= c->slots) {
+        v3_error("v3_client_rays received an invalid slot");
+        return NULL;
+    }
+    return (v3_query_ray *)(c->ring + slot * slot_bytes(c->slot_rays));
+}
+
+v3_query_hit *v3_client_hits(v3_client *c, unsigned slot) {
+    if (c == NULL || slot >= c->slots) {
+        v3_error("v3_client_hits received an invalid slot");
+        return NULL;
+    }
+    return (v3_query_hit *)(c->ring + slot * slot_bytes(c->slot_rays) + hits_offset(c->slot_rays));
+}
+
+bool v3_client_submit(v3_client *c, unsigned slot, unsigned count) {
+    if (c == NULL || slot >= c->slots || count > c->slot_rays) {
+        v3_error("v3_client_submit received an invalid batch");
+        return false;
+    }
+    serve_msg m = {slot, count};
+    if (!write_full(c->fd, &m, sizeof(m))) {
+        v3_error("v3_client_submit lost the server");
+        return false;
+    }
+    c->in_flight++;
+    return true;
+}
+
+int v3_client_wait(v3_client *c, unsigned *hits) {
+    if (c == NULL || c->in_flight == 0) return -1;
+    serve_msg reply;
+    if (!read_full(c->fd, &reply, sizeof(reply))) {
+        v3_error("v3_client_wait lost the server");
+        return -1;
+    }
+    c->in_flight--;
+    if (hits) *hits = reply.count;
+    return (int)reply.slot;
+}
+
+long v3_client_cast(v3_client *c, const v3_query_ray *rays, size_t count, v3_query_hit *hits) {
+    if (c == NULL || (count > 0 && (rays == NULL || hits == NULL))) {
+        v3_error("v3_client_cast received NULL pointer");
+        return -1;
+    }
+    if (c->in_flight != 0) {
+        v3_error("v3_client_cast called with batches in flight");
+        return -1;
+    }
+    // batch b goes through slot b % slots; batches complete in order
+    size_t batches = (count + c->slot_rays - 1) / c->slot_rays;
+    size_t submitted = 0, completed = 0;
+    long found = 0;
+    while (completed < batches) {
+        while (submitted < batches && submitted - completed < c->slots) {
+            size_t first = submitted * c->slot_rays;
+            unsigned n = (unsigned)(count - first < c->slot_rays ? count - first : c->slot_rays);
+            unsigned slot = (unsigned)(submitted % c->slots);
+            memcpy(v3_client_rays(c, slot), rays + first, n * sizeof(v3_query_ray));
+            if (!v3_client_submit(c, slot, n)) return -1;
+            submitted++;
+        }
+        unsigned h;
+        int slot = v3_client_wait(c, &h);
+        if (slot < 0) return -1;
+        size_t first = completed * c->slot_rays;
+        size_t n = count - first < c->slot_rays ? count - first : c->slot_rays;
+        memcpy(hits + first, v3_client_hits(c, (unsigned)slot), n * sizeof(v3_query_hit));
+        found += h;
+        completed++;
+    }
+    return found;
+}
@@ -0,0 +1,106 @@
+#ifndef V3SERVE_H
+#define V3SERVE_H
+
+#include "v3pool.h"
+#include "v3scene.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Ray-cast query service: one process holds a scene and its BVH and answers
+// closest-hit queries from other local processes, which then need neither
+// their own copy nor the load time.
+//
+// Each client owns a shared-memory ring of `slots` batch slots, each with
+// room for slot_rays rays and their hits. The ring is created by the client
+// and handed to the server over a Unix stream socket when connecting. After
+// that the socket carries only 8-byte doorbells: the client writes rays into
+// a slot in place and submits (slot, count); the server traces the batch on
+// its pool, writes the hits into the same slot and replies. Ray payloads
+// never pass through the socket. Batches of one client complete in
+// submission order, so up to `slots` batches can be in flight.
+//
+//   v3_client *c = v3_client_connect("/tmp/v3.sock", 4, 4096);
+//   v3_query_ray *rays = v3_client_rays(c, 0);   // fill rays[0 .. n)
+//   v3_client_submit(c, 0, n);
+//   v3_client_wait(c, NULL);                     // hits in v3_client_hits(c, 0)
+//
+// Clients are trusted: the socket is created 0600 and a client that
+// shrinks or unmaps its ring while connected can crash the server.
+
+typedef struct {
+    float orig[3];
+    float dir[3];
+    float t_max;       // INFINITY for an unbounded ray
+} v3_query_ray;
+
+#define V3_QUERY_HIT 1u      // v3_query_hit.flags: something was hit
+#define V3_QUERY_INSIDE 2u   // the ray hit the surface from behind
+
+// As v3_hit, without the hit point (orig + t * dir).
+typedef struct {
+    float t;
+    float n[3];
+    uint32_t material;
+    uint32_t flags;
+} v3_query_hit;
+
+// ---------- server ----------
+typedef struct v3_server v3_server;
+
+typedef struct {
+    uint64_t clients;    // connections accepted
+    uint64_t batches;
+    uint64_t rays;
+} v3_server_stats;
+
+// Listen on the Unix socket path, replacing a stale socket file there, and
+// answer queries against scene on pool (the default pool if NULL) until
+// v3_server_stop. Every connection gets a thread; batches are split across
+// the pool. The scene must not change or be freed while the server runs.
+v3_server *v3_server_start(v3_scene *scene, const char *path, v3_pool *pool);
+
+// Disconnect every client, remove the socket file and free the server.
+void v3_server_stop(v3_server *s);
+
+void v3_server_get_stats(v3_server *s, v3_server_stats *stats);
+
+// ---------- client ----------
+typedef struct v3_client v3_client;
+
+// Connect with a ring of slots (1 .. 1024) slots of slot_rays
+// (1 .. 1 << 20) rays. Returns NULL if the server is unreachable or
+// refuses the ring.
+v3_client *v3_client_connect(const char *path, unsigned slots, unsigned slot_rays);
+void v3_client_close(v3_client *c);
+
+unsigned v3_client_slots(const v3_client *c);
+unsigned v3_client_slot_rays(const v3_client *c);
+
+// The slot's ray and hit arrays in the shared ring. A slot must not be
+// touched between its submit and the wait that returns it.
+v3_query_ray *v3_client_rays(v3_client *c, unsigned slot);
+v3_query_hit *v3_client_hits(v3_client *c, unsigned slot);
+
+// Queue the first count rays of slot for tracing.
+bool v3_client_submit(v3_client *c, unsigned slot, unsigned count);
+
+// Wait for the oldest submitted batch. Returns its slot and sets *hits (if
+// not NULL) to the number of rays that hit, or returns -1 if nothing is in
+// flight or the connection failed.
+int v3_client_wait(v3_client *c, unsigned *hits);
+
+// Trace count rays through the ring, keeping every slot in flight, and
+// copy the results to hits. Returns the number of hits, or -1 on failure.
+long v3_client_cast(v3_client *c, const v3_query_ray *rays, size_t count, v3_query_hit *hits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
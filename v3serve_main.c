@@ -0,0 +1,67 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "v3pool.h"
+#include "v3scene.h"
+#include "v3serve.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Ray-cast query daemon. Usage: v3serve scene socket [threads]
+// Loads the scene (text or binary) once and answers v3_client queries on the
+// Unix socket until SIGINT or SIGTERM. threads = 0 (the default) uses one
+// worker per online CPU.
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "usage: %s scene socket [threads]\n", argv[0]);
+        return 2;
+    }
+    unsigned threads = argc > 3 ? (unsigned)strtoul(argv[3], NULL, 10) : 0;
+
+    // block the stop signals before any thread exists so that only sigwait sees them
+    sigset_t stop;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, NULL);
+
+    double t0 = now_sec();
+    v3_scene scene;
+    if (!v3_scene_load(&scene, argv[1])) return 1;
+    double t1 = now_sec();
+
+    v3_pool *pool = v3_pool_create(threads);
+    v3_server *server = pool ? v3_server_start(&scene, argv[2], pool) : NULL;
+    if (server == NULL) {
+        v3_pool_destroy(pool);
+        v3_scene_free(&scene);
+        return 1;
+    }
+    printf("scene   %zu spheres, %zu triangles, %zu planes, %zu BVH nodes  %.3f ms\n", scene.sphere_count,
+           scene.tri_count, scene.plane_count, scene.bvh.node_count, (t1 - t0) * 1e3);
+    printf("serving %s on %u threads\n", argv[2], v3_pool_size(pool));
+    fflush(stdout);
+
+    int sig;
+    sigwait(&stop, &sig);
+    double t2 = now_sec();
+
+    v3_server_stats stats;
+    v3_server_get_stats(server, &stats);
+    v3_server_stop(server);
+    printf("served  %llu clients, %llu batches, %llu rays  %.2f Mrays/s average\n",
+           (unsigned long long)stats.clients, (unsigned long long)stats.batches,
+           (unsigned long long)stats.rays, (double)stats.rays / (t2 - t1) * 1e-6);
+    v3_pool_destroy(pool);
+    v3_scene_free(&scene);
+    return 0;
+}
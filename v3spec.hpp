@@ -0,0 +1,208 @@
+#ifndef V3SPEC_HPP
+#define V3SPEC_HPP
+
+// Optional C++20 layer of batched kernels specialized for parameters that are
+// the same for every element: a constant scale, a fixed reflection plane, a
+// fixed comparison tolerance. Passing them as template arguments lets the
+// compiler fold them into the loop, and special values become cheaper loops:
+//
+//   v3::spec::scale<-1.0f>(dst, a);                    // sign flip, no multiply
+//   v3::spec::reflect<v3::spec::normal{0, 1, 0}>(dst, v);  // negates y only
+//   v3::spec::equals<1e-5f>(mask, a, b);
+//
+// The overloads taking the parameter at run time check it once and dispatch
+// to the same instantiations, so callers with a fixed but runtime value (a
+// mirror plane read from a scene) get the special cases too; otherwise the
+// parameter is hoisted out of the loop as a uniform.
+//
+// Results are bit-identical to v3_scale_n and v3_equals. Reflection about an
+// axis plane whose normal component is a power of two in [2^-60, 2^60] (e.g.
+// {0, 1, 0} or {0, 2, 0}) is a sign flip, which matches v3_reflect_n for
+// finite vectors well inside the float range; where v3_reflect_n overflows
+// or meets inf/NaN it yields NaN, while the flip just negates. Any other
+// normal, {0, 3, 0} included, computes 2 / dot(n, n) once, which can differ
+// from v3_reflect_n's per-element division in the last bit.
+// Spans hold packed vectors; mismatched lengths throw std::invalid_argument.
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+
+namespace v3::spec {
+
+// a plane normal usable as a template argument; need not be normalized
+struct normal {
+    float x, y, z;
+};
+
+namespace detail {
+
+inline std::size_t vec_count(std::span<const float> v) {
+    if (v.size() % 3 != 0) throw std::invalid_argument("v3 span size is not a multiple of 3");
+    return v.size() / 3;
+}
+
+inline void require_same(std::size_t a, std::size_t b) {
+    if (a != b) throw std::invalid_argument("v3 spans have mismatched lengths");
+}
+
+// |c| = 2^e with |e| <= 60: c * c, v * c and the division by c * c are then
+// exact for ordinary v, so the reflection formula rounds to a sign flip
+constexpr bool flip_exact(float c) {
+    if (c < 0.0f) c = -c;
+    if (!(c >= 0x1p-60f && c <= 0x1p60f)) return false;
+    while (c >= 2.0f) c *= 0.5f;
+    while (c < 1.0f) c *= 2.0f;
+    return c == 1.0f;
+}
+
+// index of the only nonzero component when reflecting about it is an exact
+// sign flip, or -1
+constexpr int axis_of(normal n) {
+    int nonzero = (n.x != 0.0f) + (n.y != 0.0f) + (n.z != 0.0f);
+    if (nonzero != 1) return -1;
+    int axis = n.x != 0.0f ? 0 : n.y != 0.0f ? 1 : 2;
+    return flip_exact(axis == 0 ? n.x : axis == 1 ? n.y : n.z) ? axis : -1;
+}
+
+template <float S>
+void scale_loop(float *d, const float *a, std::size_t nfloats) {
+    if constexpr (S == 1.0f) {
+        if (d != a) std::memmove(d, a, nfloats * sizeof(float));
+    } else if constexpr (S == -1.0f) {
+        for (std::size_t i = 0; i < nfloats; i++) d[i] = -a[i];
+    } else {
+        for (std::size_t i = 0; i < nfloats; i++) d[i] = a[i] * S;
+    }
+}
+
+inline void scale_uniform(float *d, const float *a, float s, std::size_t nfloats) {
+    for (std::size_t i = 0; i < nfloats; i++) d[i] = a[i] * s;
+}
+
+// Reflection about the plane through the origin with normal c e_Axis, c a
+// power of two (see flip_exact): v - 2 dot(v,n)/dot(n,n) n negates one
+// component.
+template <int Axis>
+void flip_loop(float *d, const float *v, std::size_t count) {
+    if (d == v) {
+        for (std::size_t i = 0; i < count; i++) d[3 * i + Axis] = -d[3 * i + Axis];
+        return;
+    }
+    for (std::size_t i = 0; i < count; i++) {
+        d[3 * i + 0] = Axis == 0 ? -v[3 * i + 0] : v[3 * i + 0];
+        d[3 * i + 1] = Axis == 1 ? -v[3 * i + 1] : v[3 * i + 1];
+        d[3 * i + 2] = Axis == 2 ? -v[3 * i + 2] : v[3 * i + 2];
+    }
+}
+
+// general plane with the normal and 2 / dot(n,n) hoisted out of the loop
+inline void reflect_uniform(float *d, const float *v, float nx, float ny, float nz, std::size_t count) {
+    float k2 = 2.0f / (nx * nx + ny * ny + nz * nz);
+    for (std::size_t i = 0; i < count; i++) {
+        float vx = v[3 * i], vy = v[3 * i + 1], vz = v[3 * i + 2];
+        float k = (vx * nx + vy * ny + vz * nz) * k2;
+        d[3 * i + 0] = vx - k * nx;
+        d[3 * i + 1] = vy - k * ny;
+        d[3 * i + 2] = vz - k * nz;
+    }
+}
+
+// mask[i] = all components within tol (tol >= 0); returns the number equal.
+// Plain == for tol = 0 measured slower than this form (setcc per compare).
+inline std::size_t equals_loop(unsigned char *mask, const float *a, const float *b, float tol,
+                               std::size_t count) {
+    std::size_t equal = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        const float *pa = a + 3 * i, *pb = b + 3 * i;
+        bool eq = (std::fabs(pa[0] - pb[0]) <= tol) & (std::fabs(pa[1] - pb[1]) <= tol) &
+                  (std::fabs(pa[2] - pb[2]) <= tol);
+        mask[i] = eq;
+        equal += eq;
+    }
+    return equal;
+}
+
+} // namespace detail
+
+// ---------- scale ----------
+// dst = a * S. S = 1 copies and S = -1 negates.
+template <float S>
+void scale(std::span<float> dst, std::span<const float> a) {
+    detail::require_same(detail::vec_count(a), detail::vec_count(dst));
+    detail::scale_loop<S>(dst.data(), a.data(), a.size());
+}
+
+inline void scale(std::span<float> dst, std::span<const float> a, float s) {
+    detail::require_same(detail::vec_count(a), detail::vec_count(dst));
+    if (s == 1.0f) {
+        detail::scale_loop<1.0f>(dst.data(), a.data(), a.size());
+    } else if (s == -1.0f) {
+        detail::scale_loop<-1.0f>(dst.data(), a.data(), a.size());
+    } else {
+        detail::scale_uniform(dst.data(), a.data(), s, a.size());
+    }
+}
+
+// ---------- reflect ----------
+// Reflect each v about the plane with normal N.
+template <normal N>
+void reflect(std::span<float> dst, std::span<const float> v) {
+    static_assert(N.x * N.x + N.y * N.y + N.z * N.z != 0.0f, "reflection normal must be nonzero");
+    std::size_t n = detail::vec_count(v);
+    detail::require_same(n, detail::vec_count(dst));
+    constexpr int axis = detail::axis_of(N);
+    if constexpr (axis >= 0) {
+        detail::flip_loop<axis>(dst.data(), v.data(), n);
+    } else {
+        detail::reflect_uniform(dst.data(), v.data(), N.x, N.y, N.z, n);
+    }
+}
+
+// Runtime plane, e.g. a mirror from a scene. A zero or non-finite dot(n,n)
+// throws std::invalid_argument, where v3_reflect_n would copy v per element.
+inline void reflect(std::span<float> dst, std::span<const float> v, const float n[3]) {
+    std::size_t count = detail::vec_count(v);
+    detail::require_same(count, detail::vec_count(dst));
+    float nn = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+    if (nn == 0.0f || !std::isfinite(nn)) throw std::invalid_argument("v3 reflection normal is zero-length");
+    switch (detail::axis_of(normal{n[0], n[1], n[2]})) {
+    case 0:
+        detail::flip_loop<0>(dst.data(), v.data(), count);
+        break;
+    case 1:
+        detail::flip_loop<1>(dst.data(), v.data(), count);
+        break;
+    case 2:
+        detail::flip_loop<2>(dst.data(), v.data(), count);
+        break;
+    default:
+        detail::reflect_uniform(dst.data(), v.data(), n[0], n[1], n[2], count);
+        break;
+    }
+}
+
+// ---------- equals ----------
+// mask[i] = v3_equals(a[i], b[i], Tol); returns how many were equal.
+template <float Tol>
+std::size_t equals(std::span<unsigned char> mask, std::span<const float> a, std::span<const float> b) {
+    std::size_t n = detail::vec_count(a);
+    detail::require_same(n, detail::vec_count(b));
+    detail::require_same(n, mask.size());
+    constexpr float tol = Tol < 0.0f ? -Tol : Tol;
+    return detail::equals_loop(mask.data(), a.data(), b.data(), tol, n);
+}
+
+inline std::size_t equals(std::span<unsigned char> mask, std::span<const float> a, std::span<const float> b,
+                          float tol) {
+    std::size_t n = detail::vec_count(a);
+    detail::require_same(n, detail::vec_count(b));
+    detail::require_same(n, mask.size());
+    return detail::equals_loop(mask.data(), a.data(), b.data(), tol < 0.0f ? -tol : tol, n);
+}
+
+} // namespace v3::spec
+
+#endif
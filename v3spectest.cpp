@@ -0,0 +1,182 @@
+#include "v3spec.hpp"
+#include "v3batch.h"
+#include "v3math.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+static int g_failures = 0;
+
+static void expect_true(const char *testname, bool cond) {
+    if (cond) {
+        std::printf("PASS: %s\n", testname);
+    } else {
+        std::printf("FAIL: %s\n", testname);
+        g_failures++;
+    }
+}
+
+static bool same_bits(const std::vector<float> &a, const std::vector<float> &b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+// deterministic pseudo-random floats in [-1, 1)
+static std::vector<float> random_vectors(std::size_t count, unsigned seed) {
+    std::vector<float> v(3 * count);
+    unsigned state = seed * 2654435761u + 1u;
+    for (float &x : v) {
+        state = state * 1664525u + 1013904223u;
+        x = (float)(state >> 8) / (float)(1u << 23) - 1.0f;
+    }
+    return v;
+}
+
+// ---- Tests ----
+
+static void test_scale() {
+    const std::size_t n = 1001;
+    std::vector<float> a = random_vectors(n, 1), out(3 * n), exp(3 * n);
+
+    v3::spec::scale<0.25f>(out, a);
+    v3_scale_n(exp.data(), a.data(), 0.25f, n);
+    expect_true("scale<0.25> matches v3_scale_n", same_bits(out, exp));
+
+    v3::spec::scale<-1.0f>(out, a);
+    v3_scale_n(exp.data(), a.data(), -1.0f, n);
+    expect_true("scale<-1> matches v3_scale_n", same_bits(out, exp));
+
+    v3::spec::scale(out, a, 1.0f);
+    expect_true("scale by 1 copies", same_bits(out, a));
+
+    v3::spec::scale(out, a, 3.0f);
+    v3_scale_n(exp.data(), a.data(), 3.0f, n);
+    expect_true("scale by runtime uniform matches v3_scale_n", same_bits(out, exp));
+
+    std::vector<float> in_place = a;
+    v3::spec::scale<-1.0f>(in_place, in_place);
+    v3_scale_n(exp.data(), a.data(), -1.0f, n);
+    expect_true("scale<-1> in place", same_bits(in_place, exp));
+}
+
+static void test_reflect() {
+    const std::size_t n = 777;
+    std::vector<float> v = random_vectors(n, 2), out(3 * n), exp(3 * n), normals(3 * n);
+
+    // axis planes with a power-of-two normal become sign flips and match
+    // v3_reflect_n exactly
+    for (std::size_t i = 0; i < n; i++) {
+        normals[3 * i] = 0.0f;
+        normals[3 * i + 1] = 2.0f;
+        normals[3 * i + 2] = 0.0f;
+    }
+    v3_reflect_n(exp.data(), v.data(), normals.data(), n);
+    v3::spec::reflect<v3::spec::normal{0.0f, 2.0f, 0.0f}>(out, v);
+    expect_true("reflect<{0,2,0}> matches v3_reflect_n", same_bits(out, exp));
+
+    const float ny[3] = {0.0f, -1.0f, 0.0f};
+    v3::spec::reflect(out, v, ny);
+    expect_true("runtime axis plane matches v3_reflect_n", same_bits(out, exp));
+
+    std::vector<float> in_place = v;
+    v3::spec::reflect<v3::spec::normal{0.0f, 1.0f, 0.0f}>(in_place, in_place);
+    expect_true("reflect<{0,1,0}> in place", same_bits(in_place, exp));
+
+    // an axis normal of length 3 does not round to a flip: it takes the
+    // general loop, which agrees with v3_reflect_n to rounding
+    for (std::size_t i = 0; i < n; i++) normals[3 * i + 1] = 3.0f;
+    v3_reflect_n(exp.data(), v.data(), normals.data(), n);
+    v3::spec::reflect<v3::spec::normal{0.0f, 3.0f, 0.0f}>(out, v);
+    bool close3 = true;
+    for (std::size_t i = 0; i < n; i++) close3 = close3 && v3_equals(&out[3 * i], &exp[3 * i], 1e-6f);
+    expect_true("reflect<{0,3,0}> close to v3_reflect_n", close3);
+    std::vector<float> runtime3(3 * n);
+    const float n3[3] = {0.0f, 3.0f, 0.0f};
+    v3::spec::reflect(runtime3, v, n3);
+    expect_true("runtime {0,3,0} matches template", same_bits(runtime3, out));
+    std::vector<float> flipped = v;
+    for (std::size_t i = 0; i < n; i++) flipped[3 * i + 1] = -flipped[3 * i + 1];
+    expect_true("v3_reflect_n about {0,3,0} is not a plain flip", !same_bits(exp, flipped));
+    static_assert(v3::spec::detail::axis_of({0.0f, 0.5f, 0.0f}) == 1 &&
+                  v3::spec::detail::axis_of({0.0f, 3.0f, 0.0f}) == -1 &&
+                  v3::spec::detail::axis_of({0x1p70f, 0.0f, 0.0f}) == -1);
+
+    // a general plane agrees with v3_reflect_n to rounding
+    const float tilted[3] = {1.0f, 2.0f, -0.5f};
+    for (std::size_t i = 0; i < n; i++) std::memcpy(&normals[3 * i], tilted, sizeof(tilted));
+    v3_reflect_n(exp.data(), v.data(), normals.data(), n);
+    v3::spec::reflect<v3::spec::normal{1.0f, 2.0f, -0.5f}>(out, v);
+    bool close = true;
+    for (std::size_t i = 0; i < n; i++) close = close && v3_equals(&out[3 * i], &exp[3 * i], 1e-6f);
+    expect_true("reflect<{1,2,-0.5}> close to v3_reflect_n", close);
+    std::vector<float> runtime(3 * n);
+    v3::spec::reflect(runtime, v, tilted);
+    expect_true("runtime general plane matches template", same_bits(runtime, out));
+
+    const float zero[3] = {0.0f, 0.0f, 0.0f};
+    bool threw = false;
+    try {
+        v3::spec::reflect(out, v, zero);
+    } catch (const std::invalid_argument &) {
+        threw = true;
+    }
+    expect_true("zero runtime normal throws", threw);
+}
+
+static void test_equals() {
+    const std::size_t n = 500;
+    std::vector<float> a = random_vectors(n, 3), b = a;
+    for (std::size_t i = 0; i < n; i += 7) b[3 * i + i % 3] += 1e-3f;
+    for (std::size_t i = 3; i < n; i += 11) b[3 * i + 2] += 1e-6f;
+    std::vector<unsigned char> mask(n), mask_rt(n);
+
+    std::size_t eq = v3::spec::equals<1e-5f>(mask, a, b);
+    bool ok = true;
+    std::size_t expected = 0;
+    for (std::size_t i = 0; i < n; i++) {
+        bool e = v3_equals(&a[3 * i], &b[3 * i], 1e-5f);
+        expected += e;
+        ok = ok && mask[i] == e;
+    }
+    expect_true("equals<1e-5> matches v3_equals", ok && eq == expected);
+    expect_true("runtime tolerance matches template",
+                v3::spec::equals(mask_rt, a, b, -1e-5f) == eq && mask_rt == mask);
+
+    eq = v3::spec::equals<0.0f>(mask, a, b);
+    ok = true;
+    expected = 0;
+    for (std::size_t i = 0; i < n; i++) {
+        bool e = v3_equals(&a[3 * i], &b[3 * i], 0.0f);
+        expected += e;
+        ok = ok && mask[i] == e;
+    }
+    expect_true("equals<0> matches v3_equals", ok && eq == expected);
+
+    std::vector<float> odd(4);
+    bool threw = false;
+    try {
+        v3::spec::equals<0.0f>(mask, a, odd);
+    } catch (const std::invalid_argument &) {
+        threw = true;
+    }
+    expect_true("equals rejects a partial vector", threw);
+}
+
+int main() {
+    std::printf("=== v3spectest: Specialized Kernel Tests ===\n\n");
+
+    test_scale();
+    test_reflect();
+    test_equals();
+
+    std::printf("\n=== Summary ===\n");
+    if (g_failures == 0) {
+        std::printf("ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        std::printf("FAILURES: %d\n", g_failures);
+        return 1;
+    }
+}
@@ -222,6 +222,96 @@ static void test_v3_reflect(void) {
     expect_v3("v3_reflect overlap dst==v", v2, exp2, 1e-5f);
 }
 
+static void test_v3_refract_and_fresnel(void) {
+    float n[3] = {0, 1, 0};
+    float dst[3], refl[3];
+
+    // normal incidence passes straight through
+    float down[3] = {0, -1, 0};
+    bool ok = v3_reflect_refract(refl, dst, down, n, 1.0f / 1.5f);
+    float exp_r[3] = {0, 1, 0};
+    expect_v3("v3_reflect_refract normal incidence reflect", refl, exp_r, EPS);
+    expect_v3("v3_reflect_refract normal incidence refract", dst, down, EPS);
+    expect_float("v3_reflect_refract normal incidence ok", ok, 1.0f, 0.0f);
+
+    // 45 degrees into glass: sin_t = sin_i / 1.5
+    float s = sqrtf(0.5f);
+    float d[3] = {s, -s, 0};
+    ok = v3_refract(dst, d, n, 1.0f / 1.5f);
+    float st = s / 1.5f;
+    float exp_t[3] = {st, -sqrtf(1.0f - st * st), 0};
+    expect_v3("v3_refract 45 degrees into glass", dst, exp_t, EPS);
+    expect_float("v3_refract unit length", v3_length(dst), 1.0f, EPS);
+
+    // the same ray from inside is totally internally reflected
+    float keep[3] = {7, 7, 7};
+    ok = v3_refract(keep, d, n, 1.5f);
+    float exp_keep[3] = {7, 7, 7};
+    expect_float("v3_refract total internal reflection", ok, 0.0f, 0.0f);
+    expect_v3("v3_refract leaves dst on total internal reflection", keep, exp_keep, 0.0f);
+
+    // overlap: refl == d
+    float d2[3] = {s, -s, 0};
+    v3_reflect_refract(d2, dst, d2, n, 1.0f / 1.5f);
+    float exp_m[3] = {s, s, 0};
+    expect_v3("v3_reflect_refract overlap refl==d", d2, exp_m, EPS);
+    expect_v3("v3_reflect_refract overlap refract", dst, exp_t, EPS);
+
+    // air to glass: 4% at normal incidence, all of it at grazing angles
+    expect_float("v3_fresnel_exact normal incidence", v3_fresnel_exact(1.0f, 1.0f / 1.5f), 0.04f, EPS);
+    expect_float("v3_fresnel_schlick normal incidence", v3_fresnel_schlick(1.0f, 1.0f / 1.5f), 0.04f, EPS);
+    expect_float("v3_fresnel_exact grazing", v3_fresnel_exact(0.0f, 1.0f / 1.5f), 1.0f, EPS);
+    expect_float("v3_fresnel_schlick grazing", v3_fresnel_schlick(0.0f, 1.0f / 1.5f), 1.0f, EPS);
+    expect_float("v3_fresnel_exact 45 degrees", v3_fresnel_exact(s, 1.0f / 1.5f), 0.0502f, 1e-3f);
+    expect_float("v3_fresnel_schlick close to exact", v3_fresnel_schlick(s, 1.0f / 1.5f),
+                 v3_fresnel_exact(s, 1.0f / 1.5f), 0.02f);
+    expect_float("v3_fresnel_exact total internal reflection", v3_fresnel_exact(s, 1.5f), 1.0f, 0.0f);
+    expect_float("v3_fresnel_schlick total internal reflection", v3_fresnel_schlick(s, 1.5f), 1.0f, 0.0f);
+
+    // reciprocity: leaving glass along the refracted ray reflects the same share
+    float cos_t = -exp_t[1];
+    expect_float("v3_fresnel_exact reciprocal", v3_fresnel_exact(cos_t, 1.5f),
+                 v3_fresnel_exact(s, 1.0f / 1.5f), 1e-5f);
+    expect_float("v3_fresnel_schlick reciprocal", v3_fresnel_schlick(cos_t, 1.5f),
+                 v3_fresnel_schlick(s, 1.0f / 1.5f), 1e-5f);
+}
+
+static void test_v3_transform_and_invert(void) {
+    // rotate 90 degrees about z, scale x by 2, translate by (1, 2, 3)
+    float m[12] = {0, -1, 0, 1,
+                   2,  0, 0, 2,
+                   0,  0, 1, 3};
+    float p[3] = {1, 1, 1}, dst[3];
+    v3_transform_point(dst, m, p);
+    float exp_p[3] = {0, 4, 4};
+    expect_v3("v3_transform_point", dst, exp_p, EPS);
+    v3_transform_vector(dst, m, p);
+    float exp_v[3] = {-1, 2, 1};
+    expect_v3("v3_transform_vector ignores translation", dst, exp_v, EPS);
+
+    // the inverse takes the point back, also with dst == m
+    float inv[12], back[3], q[3] = {0, 4, 4};
+    bool ok = v3_affine_invert(inv, m);
+    expect_float("v3_affine_invert ok", ok, 1.0f, 0.0f);
+    v3_transform_point(back, inv, q);
+    expect_v3("v3_affine_invert round trip", back, p, EPS);
+    float m2[12];
+    memcpy(m2, m, sizeof(m2));
+    v3_affine_invert(m2, m2);
+    for (int i = 0; i < 12; i++) expect_float("v3_affine_invert in place", m2[i], inv[i], EPS);
+
+    // overlap: dst == p
+    float pp[3] = {1, 1, 1};
+    v3_transform_point(pp, m, pp);
+    expect_v3("v3_transform_point overlap dst==p", pp, exp_p, EPS);
+
+    float singular[12] = {1, 0, 0, 0,  0, 0, 0, 0,  0, 0, 1, 0};
+    float keep[12] = {7};
+    ok = v3_affine_invert(keep, singular);
+    expect_float("v3_affine_invert singular", ok, 0.0f, 0.0f);
+    expect_float("v3_affine_invert leaves dst when singular", keep[0], 7.0f, 0.0f);
+}
+
 int main(void) {
     printf("=== v3test: 3D Math Library Unit Tests ===\n\n");
 
@@ -235,6 +325,8 @@ int main(void) {
     test_v3_normalize();
     test_v3_angle_quick_and_angle();
     test_v3_reflect();
+    test_v3_refract_and_fresnel();
+    test_v3_transform_and_invert();
 
     printf("\n=== Summary ===\n");
     if (g_failures == 0) {
@@ -0,0 +1,533 @@
+#include "v3trace.h"
+#include "v3batch.h"
+#include "v3math.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// offset of secondary ray origins from the surface, and the smallest
+// accepted distance for spheres and planes
+#define V3_TRACE_EPS 1e-4f
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+// dst = a + s*b
+static void madd3(float *dst, const float *a, float s, const float *b) {
+    dst[0] = a[0] + s * b[0];
+    dst[1] = a[1] + s * b[1];
+    dst[2] = a[2] + s * b[2];
+}
+
+static bool sphere_hit(const v3_sphere *sp, const float *orig, const float *dir, float t_max, float *t) {
+    float oc[3] = {orig[0] - sp->center[0], orig[1] - sp->center[1], orig[2] - sp->center[2]};
+    float a = dir[0]*dir[0] + dir[1]*dir[1] + dir[2]*dir[2];
+    float b = oc[0]*dir[0] + oc[1]*dir[1] + oc[2]*dir[2];
+    float c = oc[0]*oc[0] + oc[1]*oc[1] + oc[2]*oc[2] - sp->radius * sp->radius;
+    float disc = b*b - a*c;
+    if (disc < 0.0f || a == 0.0f) return false;
+    float root = sqrtf(disc);
+    float tt = (-b - root) / a;
+    if (tt <= V3_TRACE_EPS) tt = (-b + root) / a;  // origin inside the sphere
+    if (!(tt > V3_TRACE_EPS && tt < t_max)) return false;
+    *t = tt;
+    return true;
+}
+
+static bool plane_hit(const v3_plane *pl, const float *orig, const float *dir, float t_max, float *t) {
+    float denom = pl->normal[0]*dir[0] + pl->normal[1]*dir[1] + pl->normal[2]*dir[2];
+    if (denom == 0.0f) return false;
+    float d[3] = {pl->point[0] - orig[0], pl->point[1] - orig[1], pl->point[2] - orig[2]};
+    float tt = (d[0]*pl->normal[0] + d[1]*pl->normal[1] + d[2]*pl->normal[2]) / denom;
+    if (!(tt > V3_TRACE_EPS && tt < t_max)) return false;
+    *t = tt;
+    return true;
+}
+
+// ---------- instances ----------
+// The bottom-level BVH of a mesh, viewed in place in the scene's mesh arrays.
+static v3_bvh mesh_bvh(v3_scene *s, const v3_mesh *m) {
+    v3_bvh b = {s->mesh_nodes + m->node_first, m->node_count, s->mesh_prims + m->prim_first, m->tri_count};
+    return b;
+}
+
+// Triangle tests of one mesh; wt[ray] is the object-space setup of each ray.
+typedef struct {
+    v3_tri_wt *tris;
+    v3_ray_wt *wt;
+    uint32_t tri;
+} mesh_ctx;
+
+static bool mesh_hit(void *arg, uint32_t prim, float *t_max) {
+    mesh_ctx *c = arg;
+    float h[3];
+    if (!v3_ray_tri_intersect_watertight(&c->tris[prim], c->wt, *t_max, h)) return false;
+    *t_max = h[0];
+    c->tri = prim;
+    return true;
+}
+
+static bool mesh_any(void *arg, uint32_t ray, uint32_t prim, float t_max) {
+    mesh_ctx *c = arg;
+    float h[3];
+    return v3_ray_tri_intersect_watertight(&c->tris[prim], &c->wt[ray], t_max, h);
+}
+
+// The ray in object space. The direction is transformed but not normalized,
+// so hit distances t are the same in both spaces.
+static void to_object(v3_instance *inst, const float *orig, const float *dir, float *o, float *d) {
+    v3_transform_point(o, inst->to_object, (float *)orig);
+    v3_transform_vector(d, inst->to_object, (float *)dir);
+}
+
+// Closest hit on an instance: lowers *t_max and sets *tri to the mesh triangle.
+static bool instance_hit(v3_scene *s, v3_instance *inst, const float *orig, const float *dir, float *t_max,
+                         uint32_t *tri) {
+    const v3_mesh *m = &s->meshes[inst->mesh];
+    float o[3], d[3];
+    to_object(inst, orig, dir, o, d);
+    v3_ray_wt wt;
+    v3_ray_wt_precompute(&wt, o, d);
+    mesh_ctx mc = {.tris = s->mesh_tris + m->tri_first, .wt = &wt};
+    v3_bvh b = mesh_bvh(s, m);
+    if (!v3_bvh_intersect(&b, o, d, t_max, mesh_hit, &mc)) return false;
+    *tri = mc.tri;
+    return true;
+}
+
+static bool instance_occluded(v3_scene *s, v3_instance *inst, const float *orig, const float *dir, float t_max) {
+    const v3_mesh *m = &s->meshes[inst->mesh];
+    float o[3], d[3];
+    to_object(inst, orig, dir, o, d);
+    v3_ray_wt wt;
+    v3_ray_wt_precompute(&wt, o, d);
+    mesh_ctx mc = {.tris = s->mesh_tris + m->tri_first, .wt = &wt};
+    v3_bvh b = mesh_bvh(s, m);
+    return v3_bvh_occluded(&b, o, d, t_max, mesh_any, &mc);
+}
+
+// ---------- closest hit ----------
+typedef struct {
+    v3_scene *scene;
+    const float *orig;
+    const float *dir;
+    v3_ray_wt ray;     // watertight setup shared by every triangle test
+    uint32_t prim;
+    uint32_t tri;      // mesh triangle when prim is an instance
+} hit_ctx;
+
+static bool hit_prim(void *arg, uint32_t prim, float *t_max) {
+    hit_ctx *c = arg;
+    v3_scene *s = c->scene;
+    float t;
+    if (prim < s->sphere_count) {
+        if (!sphere_hit(&s->spheres[prim], c->orig, c->dir, *t_max, &t)) return false;
+    } else if (prim < s->sphere_count + s->tri_count) {
+        float h[3];
+        if (!v3_ray_tri_intersect_watertight(&s->tris[prim - s->sphere_count], &c->ray, *t_max, h)) {
+            return false;
+        }
+        t = h[0];
+    } else {
+        v3_instance *inst = &s->instances[prim - s->sphere_count - s->tri_count];
+        if (!instance_hit(s, inst, c->orig, c->dir, t_max, &c->tri)) return false;
+        t = *t_max;
+    }
+    *t_max = t;
+    c->prim = prim;
+    return true;
+}
+
+bool v3_trace_intersect(v3_scene *scene, float *orig, float *dir, float t_max, v3_hit *hit) {
+    if (scene == NULL || orig == NULL || dir == NULL || hit == NULL) {
+        v3_error("v3_trace_intersect received NULL pointer");
+        return false;
+    }
+    hit_ctx c = {.scene = scene, .orig = orig, .dir = dir};
+    v3_ray_wt_precompute(&c.ray, orig, dir);
+    float t = t_max;
+    bool found = v3_bvh_intersect(&scene->bvh, orig, dir, &t, hit_prim, &c);
+
+    int plane = -1;
+    for (size_t i = 0; i < scene->plane_count; i++) {
+        if (plane_hit(&scene->planes[i], orig, dir, t, &t)) plane = (int)i;
+    }
+    if (!found && plane < 0) return false;
+
+    hit->t = t;
+    madd3(hit->p, orig, t, dir);
+    if (plane >= 0) {
+        v3_plane *pl = &scene->planes[plane];
+        memcpy(hit->n, pl->normal, sizeof(hit->n));
+        hit->material = pl->material;
+    } else if (c.prim < scene->sphere_count) {
+        v3_sphere *sp = &scene->spheres[c.prim];
+        v3_from_points(hit->n, sp->center, hit->p);
+        v3_scale(hit->n, 1.0f / sp->radius);
+        hit->material = sp->material;
+    } else if (c.prim < scene->sphere_count + scene->tri_count) {
+        size_t i = c.prim - scene->sphere_count;
+        v3_normalize(hit->n, scene->tris[i].n);
+        hit->material = scene->tri_materials[i];
+    } else {
+        v3_instance *inst = &scene->instances[c.prim - scene->sphere_count - scene->tri_count];
+        size_t i = scene->meshes[inst->mesh].tri_first + c.tri;
+        // normals go to world space by the transpose of to_object; a
+        // mirroring transform also reverses the winding, so the sign of its
+        // determinant keeps n as the flattened triangle's would be
+        const float *m = inst->to_object, *n = scene->mesh_tris[i].n;
+        float det = m[0] * (m[5] * m[10] - m[6] * m[9]) - m[1] * (m[4] * m[10] - m[6] * m[8]) +
+                    m[2] * (m[4] * m[9] - m[5] * m[8]);
+        float nw[3];
+        for (int k = 0; k < 3; k++) nw[k] = m[k] * n[0] + m[4 + k] * n[1] + m[8 + k] * n[2];
+        v3_normalize(hit->n, nw);
+        if (det < 0.0f) v3_scale(hit->n, -1.0f);
+        hit->material = scene->mesh_tri_materials[i];
+    }
+    hit->inside = v3_dot_product(hit->n, dir) > 0.0f;
+    if (hit->inside) v3_scale(hit->n, -1.0f);
+    return true;
+}
+
+// ---------- occlusion (shadow rays) ----------
+// Any-hit context. Triangle tests need the watertight setup of each ray;
+// for packets and streams it is computed once per ray up front, and only
+// when the scene has triangles.
+//
+// A packet meets an instance once per traversal, so the first ray to reach
+// it moves the whole packet into object space with the batched transforms,
+// traces it through the mesh BVH as a packet and caches the answers for the
+// rays that follow.
+typedef struct {
+    v3_scene *scene;
+    const v3_ray_soa *rays;   // NULL for a single ray
+    const float *orig;
+    const float *dir;
+    v3_ray_wt *wt;            // one per ray, or NULL without triangles
+    const float *t_packet;    // packet limits; NULL outside v3_trace_occluded_packet
+    size_t packet_count;
+    uint32_t cached;          // instance of inst_hit, UINT32_MAX for none
+    uint8_t inst_hit[V3_BVH_PACKET];
+} any_ctx;
+
+static void packet_instance(any_ctx *c, v3_instance *inst) {
+    v3_scene *s = c->scene;
+    const v3_mesh *m = &s->meshes[inst->mesh];
+    const v3_ray_soa *r = c->rays;
+    size_t n = c->packet_count;
+    float obj[6][V3_BVH_PACKET];
+    v3_ray_wt wt[V3_BVH_PACKET];
+    v3_ray_soa o = {obj[0], obj[1], obj[2], obj[3], obj[4], obj[5]};
+    v3_transform_points_soa((v3_soa3){o.ox, o.oy, o.oz}, inst->to_object, (v3_soa3){r->ox, r->oy, r->oz}, n);
+    v3_transform_vectors_soa((v3_soa3){o.dx, o.dy, o.dz}, inst->to_object, (v3_soa3){r->dx, r->dy, r->dz}, n);
+    for (size_t i = 0; i < n; i++) {
+        float orig[3] = {o.ox[i], o.oy[i], o.oz[i]};
+        float dir[3] = {o.dx[i], o.dy[i], o.dz[i]};
+        if (c->t_packet[i] >= 0.0f) v3_ray_wt_precompute(&wt[i], orig, dir);
+    }
+    mesh_ctx mc = {.tris = s->mesh_tris + m->tri_first, .wt = wt};
+    v3_bvh b = mesh_bvh(s, m);
+    v3_bvh_occluded_packet(&b, &o, c->t_packet, n, c->inst_hit, mesh_any, &mc);
+}
+
+static bool any_prim(void *arg, uint32_t ray, uint32_t prim, float t_max) {
+    any_ctx *c = arg;
+    v3_scene *s = c->scene;
+    float t;
+    const v3_ray_soa *r = c->rays;
+    if (prim < s->sphere_count) {
+        if (r == NULL) return sphere_hit(&s->spheres[prim], c->orig, c->dir, t_max, &t);
+        float orig[3] = {r->ox[ray], r->oy[ray], r->oz[ray]};
+        float dir[3] = {r->dx[ray], r->dy[ray], r->dz[ray]};
+        return sphere_hit(&s->spheres[prim], orig, dir, t_max, &t);
+    }
+    if (prim < s->sphere_count + s->tri_count) {
+        float h[3];
+        return v3_ray_tri_intersect_watertight(&s->tris[prim - s->sphere_count], &c->wt[ray], t_max, h);
+    }
+    uint32_t i = prim - (uint32_t)(s->sphere_count + s->tri_count);
+    if (r == NULL) return instance_occluded(s, &s->instances[i], c->orig, c->dir, t_max);
+    if (c->t_packet != NULL) {
+        if (c->cached != i) {
+            packet_instance(c, &s->instances[i]);
+            c->cached = i;
+        }
+        return c->inst_hit[ray];
+    }
+    float orig[3] = {r->ox[ray], r->oy[ray], r->oz[ray]};
+    float dir[3] = {r->dx[ray], r->dy[ray], r->dz[ray]};
+    return instance_occluded(s, &s->instances[i], orig, dir, t_max);
+}
+
+static bool planes_block(v3_scene *scene, const float *orig, const float *dir, float t_max) {
+    float t;
+    for (size_t i = 0; i < scene->plane_count; i++) {
+        if (plane_hit(&scene->planes[i], orig, dir, t_max, &t)) return true;
+    }
+    return false;
+}
+
+bool v3_trace_occluded(v3_scene *scene, float *orig, float *dir, float t_max) {
+    if (scene == NULL || orig == NULL || dir == NULL) {
+        v3_error("v3_trace_occluded received NULL pointer");
+        return false;
+    }
+    // planes are unbounded and cheap, so they go first
+    if (planes_block(scene, orig, dir, t_max)) return true;
+    v3_ray_wt wt;
+    any_ctx c = {.scene = scene, .orig = orig, .dir = dir, .wt = &wt};
+    if (scene->tri_count > 0) v3_ray_wt_precompute(&wt, orig, dir);
+    return v3_bvh_occluded(&scene->bvh, orig, dir, t_max, any_prim, &c);
+}
+
+// Planes first: rays they block get t_max = -1 so the BVH pass skips them.
+// Returns the number of plane-blocked rays.
+static size_t prepare_rays(v3_scene *scene, const v3_ray_soa *rays, const float *t_max, size_t count,
+                           uint8_t *occluded, float *t_bvh, v3_ray_wt *wt) {
+    size_t blocked = 0;
+    for (size_t i = 0; i < count; i++) {
+        float orig[3] = {rays->ox[i], rays->oy[i], rays->oz[i]};
+        float dir[3] = {rays->dx[i], rays->dy[i], rays->dz[i]};
+        occluded[i] = planes_block(scene, orig, dir, t_max[i]);
+        blocked += occluded[i];
+        t_bvh[i] = occluded[i] ? -1.0f : t_max[i];
+        if (wt != NULL) v3_ray_wt_precompute(&wt[i], orig, dir);
+    }
+    return blocked;
+}
+
+size_t v3_trace_occluded_packet(v3_scene *scene, const v3_ray_soa *rays, const float *t_max, size_t count,
+                                uint8_t *occluded) {
+    if (scene == NULL || rays == NULL || t_max == NULL || occluded == NULL) {
+        v3_error("v3_trace_occluded_packet received NULL pointer");
+        return 0;
+    }
+    if (count > V3_BVH_PACKET) {
+        v3_error("v3_trace_occluded_packet takes at most V3_BVH_PACKET rays");
+        return 0;
+    }
+    float t_bvh[V3_BVH_PACKET];
+    uint8_t by_plane[V3_BVH_PACKET];
+    v3_ray_wt wt[V3_BVH_PACKET];
+    any_ctx c = {.scene = scene, .rays = rays, .wt = scene->tri_count > 0 ? wt : NULL,
+                 .t_packet = t_bvh, .packet_count = count, .cached = UINT32_MAX};
+    size_t blocked = prepare_rays(scene, rays, t_max, count, by_plane, t_bvh, c.wt);
+    blocked += v3_bvh_occluded_packet(&scene->bvh, rays, t_bvh, count, occluded, any_prim, &c);
+    for (size_t i = 0; i < count; i++) occluded[i] |= by_plane[i];
+    return blocked;
+}
+
+typedef struct {
+    v3_scene *scene;
+    const v3_ray_soa *rays;
+    const float *t_max;
+    size_t count;
+    uint8_t *occluded;
+    _Atomic size_t blocked;
+    _Atomic bool failed;
+} stream_ctx;
+
+static void occlude_chunks(void *arg, size_t begin, size_t end) {
+    stream_ctx *sc = arg;
+    v3_scene *s = sc->scene;
+    float *t_bvh = malloc(V3_BVH_STREAM * sizeof(float));
+    uint8_t *by_plane = malloc(V3_BVH_STREAM);
+    v3_ray_wt *wt = s->tri_count > 0 ? malloc(V3_BVH_STREAM * sizeof(v3_ray_wt)) : NULL;
+    if (t_bvh == NULL || by_plane == NULL || (s->tri_count > 0 && wt == NULL)) {
+        atomic_store(&sc->failed, true);
+        free(t_bvh);
+        free(by_plane);
+        free(wt);
+        return;
+    }
+    size_t blocked = 0;
+    for (size_t chunk = begin; chunk < end; chunk++) {
+        size_t first = chunk * V3_BVH_STREAM;
+        size_t n = sc->count - first < V3_BVH_STREAM ? sc->count - first : V3_BVH_STREAM;
+        const v3_ray_soa *r = sc->rays;
+        v3_ray_soa sub = {r->ox + first, r->oy + first, r->oz + first, r->dx + first, r->dy + first, r->dz + first};
+        any_ctx c = {.scene = s, .rays = &sub, .wt = wt};
+        uint8_t *occ = sc->occluded + first;
+        blocked += prepare_rays(s, &sub, sc->t_max + first, n, by_plane, t_bvh, wt);
+        blocked += v3_bvh_occluded_stream(&s->bvh, &sub, t_bvh, n, occ, any_prim, &c);
+        for (size_t i = 0; i < n; i++) occ[i] |= by_plane[i];
+    }
+    atomic_fetch_add(&sc->blocked, blocked);
+    free(t_bvh);
+    free(by_plane);
+    free(wt);
+}
+
+size_t v3_trace_occluded_n(v3_scene *scene, v3_pool *pool, const v3_ray_soa *rays, const float *t_max,
+                           size_t count, uint8_t *occluded) {
+    if (scene == NULL || rays == NULL || t_max == NULL || occluded == NULL) {
+        v3_error("v3_trace_occluded_n received NULL pointer");
+        return 0;
+    }
+    stream_ctx sc = {.scene = scene, .rays = rays, .t_max = t_max, .count = count, .occluded = occluded};
+    atomic_init(&sc.blocked, 0);
+    atomic_init(&sc.failed, false);
+    size_t chunks = (count + V3_BVH_STREAM - 1) / V3_BVH_STREAM;
+    v3_pool_parallel_for(pool ? pool : v3_pool_default(), chunks, 1, occlude_chunks, &sc);
+    if (atomic_load(&sc.failed)) v3_error("v3_trace_occluded_n out of memory");
+    return atomic_load(&sc.blocked);
+}
+
+// ---------- shading ----------
+void v3_trace_ray(v3_scene *scene, float *orig, float *dir, int depth, float *color, uint64_t *rays) {
+    if (scene == NULL || orig == NULL || dir == NULL || color == NULL) {
+        v3_error("v3_trace_ray received NULL pointer");
+        return;
+    }
+    if (rays) (*rays)++;
+    v3_hit h;
+    if (!v3_trace_intersect(scene, orig, dir, INFINITY, &h)) {
+        memcpy(color, scene->background, 3 * sizeof(float));
+        return;
+    }
+    v3_material *m = &scene->materials[h.material];
+
+    // offset origins on either side of the surface
+    float above[3], below[3];
+    madd3(above, h.p, V3_TRACE_EPS, h.n);
+    madd3(below, h.p, -V3_TRACE_EPS, h.n);
+
+    float diffuse[3] = {scene->ambient[0], scene->ambient[1], scene->ambient[2]};
+    float specular[3] = {0.0f, 0.0f, 0.0f};
+    float view[3] = {-dir[0], -dir[1], -dir[2]};
+    for (size_t i = 0; i < scene->light_count; i++) {
+        v3_light *light = &scene->lights[i];
+        float l[3];
+        v3_from_points(l, above, light->pos);
+        float dist = v3_length(l);
+        if (dist == 0.0f) continue;
+        v3_scale(l, 1.0f / dist);
+        float ndl = v3_dot_product(h.n, l);
+        if (ndl <= 0.0f) continue;
+
+        if (rays) (*rays)++;
+        if (v3_trace_occluded(scene, above, l, dist)) continue;
+
+        // Phong: r is the light direction mirrored about the normal
+        float r[3], to_light[3] = {-l[0], -l[1], -l[2]};
+        v3_reflect(r, to_light, h.n);
+        float rv = v3_dot_product(r, view);
+        float spec = rv > 0.0f ? powf(rv, m->shininess) : 0.0f;
+        for (int k = 0; k < 3; k++) {
+            diffuse[k] += ndl * light->color[k];
+            specular[k] += spec * light->color[k];
+        }
+    }
+
+    float local = 1.0f - m->reflect - m->transmit;
+    for (int k = 0; k < 3; k++) {
+        color[k] = local * m->diffuse[k] * diffuse[k] + m->specular[k] * specular[k];
+    }
+    if (depth >= scene->max_depth) return;
+
+    // glass gets both directions from one dot product
+    float mirror[3], t_dir[3];
+    bool refracts = false;
+    if (m->transmit > 0.0f) {
+        float eta = h.inside ? m->ior : 1.0f / m->ior;
+        refracts = v3_reflect_refract(mirror, t_dir, dir, h.n, eta);
+    } else if (m->reflect > 0.0f) {
+        v3_reflect(mirror, dir, h.n);
+    }
+    if (m->reflect > 0.0f) {
+        float c[3];
+        v3_trace_ray(scene, above, mirror, depth + 1, c, rays);
+        madd3(color, color, m->reflect, c);
+    }
+    if (m->transmit > 0.0f) {
+        float c[3];
+        if (refracts) {
+            v3_normalize(t_dir, t_dir);
+            v3_trace_ray(scene, below, t_dir, depth + 1, c, rays);
+        } else {
+            // total internal reflection sends the transmitted share back
+            v3_trace_ray(scene, above, mirror, depth + 1, c, rays);
+        }
+        madd3(color, color, m->transmit, c);
+    }
+}
+
+// ---------- rendering ----------
+typedef struct {
+    v3_scene *scene;
+    float *rgb;
+    int tiles_x;
+    v3_raygen rg;
+    v3_hist_group *tile_ns;
+    _Atomic uint64_t rays;
+} render_ctx;
+
+static void render_tiles(void *arg, size_t begin, size_t end) {
+    render_ctx *rc = arg;
+    v3_scene *s = rc->scene;
+    enum { N = V3_TRACE_TILE * V3_TRACE_TILE };
+    float buf[6][N];
+    v3_ray_soa rays = {buf[0], buf[1], buf[2], buf[3], buf[4], buf[5]};
+    float inv_samples = 1.0f / (float)s->samples;
+    uint64_t count = 0;
+    v3_hist *times = rc->tile_ns ? v3_hist_group_local(rc->tile_ns) : NULL;
+    for (size_t tile = begin; tile < end; tile++) {
+        uint64_t t0 = times ? v3_hist_now_ns() : 0;
+        int x0 = (int)(tile % (size_t)rc->tiles_x) * V3_TRACE_TILE;
+        int y0 = (int)(tile / (size_t)rc->tiles_x) * V3_TRACE_TILE;
+        int w = x0 + V3_TRACE_TILE < s->width ? V3_TRACE_TILE : s->width - x0;
+        int h = y0 + V3_TRACE_TILE < s->height ? V3_TRACE_TILE : s->height - y0;
+        float acc[N][3];
+        memset(acc, 0, sizeof(acc));
+        for (int sample = 0; sample < s->samples; sample++) {
+            v3_raygen_tile(&rc->rg, x0, y0, w, h, (uint32_t)sample, &rays);
+            for (int i = 0; i < w * h; i++) {
+                float orig[3] = {rays.ox[i], rays.oy[i], rays.oz[i]};
+                float dir[3] = {rays.dx[i], rays.dy[i], rays.dz[i]};
+                float c[3];
+                v3_trace_ray(s, orig, dir, 0, c, &count);
+                v3_add(acc[i], acc[i], c);
+            }
+        }
+        for (int i = 0; i < w * h; i++) {
+            float *px = rc->rgb + 3 * ((size_t)(y0 + i / w) * s->width + (size_t)(x0 + i % w));
+            for (int k = 0; k < 3; k++) px[k] = acc[i][k] * inv_samples;
+        }
+        if (times) v3_hist_record(times, v3_hist_now_ns() - t0);
+    }
+    atomic_fetch_add(&rc->rays, count);
+}
+
+bool v3_trace_render(v3_scene *scene, v3_pool *pool, float *rgb, v3_trace_stats *stats) {
+    return v3_trace_render_timed(scene, pool, rgb, stats, NULL);
+}
+
+bool v3_trace_render_timed(v3_scene *scene, v3_pool *pool, float *rgb, v3_trace_stats *stats,
+                           v3_hist_group *tile_ns) {
+    if (scene == NULL || rgb == NULL) {
+        v3_error("v3_trace_render received NULL pointer");
+        return false;
+    }
+    if (pool == NULL) pool = v3_pool_default();
+    if (tile_ns != NULL && tile_ns->pool != pool) {
+        v3_error("v3_trace_render_timed histograms belong to another pool");
+        return false;
+    }
+
+    render_ctx rc = {.scene = scene, .rgb = rgb, .tile_ns = tile_ns};
+    if (!v3_raygen_init(&rc.rg, &scene->camera, scene->width, scene->height)) return false;
+    rc.rg.jitter = scene->samples > 1;
+
+    rc.tiles_x = (scene->width + V3_TRACE_TILE - 1) / V3_TRACE_TILE;
+    int tiles_y = (scene->height + V3_TRACE_TILE - 1) / V3_TRACE_TILE;
+    atomic_init(&rc.rays, 0);
+    v3_pool_parallel_for(pool, (size_t)rc.tiles_x * tiles_y, 1, render_tiles, &rc);
+
+    if (stats) stats->rays = atomic_load(&rc.rays);
+    return true;
+}
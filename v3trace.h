@@ -0,0 +1,71 @@
+#ifndef V3TRACE_H
+#define V3TRACE_H
+
+#include "v3hist.h"
+#include "v3pool.h"
+#include "v3scene.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Whitted-style ray tracer over a v3_scene: pinhole or thin-lens camera
+// (v3camera.h) with scene->samples jittered rays per pixel, BVH closest-hit
+// queries, Phong shading with any-hit shadow rays, and recursive reflection and
+// refraction up to scene->max_depth bounces.
+
+// Renders are split into square tiles; each tile is one parallel_for item.
+#define V3_TRACE_TILE 16
+
+typedef struct {
+    float t;
+    float p[3];        // hit point
+    float n[3];        // unit geometric normal, facing against the ray
+    bool inside;       // the ray hit the surface from behind
+    uint32_t material;
+} v3_hit;
+
+typedef struct {
+    uint64_t rays;     // primary, secondary and shadow rays
+} v3_trace_stats;
+
+// Closest hit of orig + t*dir for t in (0, t_max) against every primitive.
+bool v3_trace_intersect(v3_scene *scene, float *orig, float *dir, float t_max, v3_hit *hit);
+
+// Shadow-ray queries: is anything on orig + t*dir for t in (0, t_max)?
+// Any-hit traversal stops at the first blocker and computes no hit point,
+// normal or material. v3_trace_ray uses the single-ray form for its lights.
+bool v3_trace_occluded(v3_scene *scene, float *orig, float *dir, float t_max);
+
+// Packet form for up to V3_BVH_PACKET coherent rays, and stream form for any
+// number of rays, split into V3_BVH_STREAM-ray chunks on pool (the default
+// pool if NULL). occluded[i] is set to 0 or 1 for ray i with limit t_max[i];
+// both return the number of blocked rays.
+size_t v3_trace_occluded_packet(v3_scene *scene, const v3_ray_soa *rays, const float *t_max, size_t count,
+                                uint8_t *occluded);
+size_t v3_trace_occluded_n(v3_scene *scene, v3_pool *pool, const v3_ray_soa *rays, const float *t_max,
+                           size_t count, uint8_t *occluded);
+
+// Radiance along a ray, recursing for reflect/transmit while depth <= max_depth.
+// rays, if not NULL, is incremented for every ray cast.
+void v3_trace_ray(v3_scene *scene, float *orig, float *dir, int depth, float *color, uint64_t *rays);
+
+// Render scene->width x scene->height pixels into rgb (3 floats per pixel,
+// row-major from the top-left) on pool, or on the default pool if NULL.
+// stats may be NULL.
+bool v3_trace_render(v3_scene *scene, v3_pool *pool, float *rgb, v3_trace_stats *stats);
+
+// v3_trace_render that also records the time of every tile in nanoseconds
+// into tile_ns (a group for the same pool; may be NULL).
+bool v3_trace_render_timed(v3_scene *scene, v3_pool *pool, float *rgb, v3_trace_stats *stats,
+                           v3_hist_group *tile_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,81 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "v3image.h"
+#include "v3pool.h"
+#include "v3scene.h"
+#include "v3trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Reference renderer. Usage: v3trace scene out.ppm|out.pfm [threads]
+// A .pfm output keeps linear float radiance; anything else is written as
+// 8-bit sRGB PPM after the scene's exposure and tonemap.
+// threads = 0 (the default) uses one worker per online CPU.
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static bool write_image(const char *path, v3_scene *scene, v3_pool *pool, float *rgb) {
+    size_t len = strlen(path);
+    if (len >= 4 && strcmp(path + len - 4, ".pfm") == 0) {
+        return v3_image_write_pfm(path, rgb, scene->width, scene->height);
+    }
+    size_t pixels = (size_t)scene->width * scene->height;
+    uint8_t *rgb8 = malloc(3 * pixels);
+    if (rgb8 == NULL) {
+        fprintf(stderr, "Error: v3trace allocation failed\n");
+        return false;
+    }
+    v3_image_to_srgb8(rgb8, rgb, pixels, scene->exposure, scene->tonemap, pool);
+    bool ok = v3_image_write_ppm(path, rgb8, scene->width, scene->height);
+    free(rgb8);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "usage: %s scene out.ppm|out.pfm [threads]\n", argv[0]);
+        return 2;
+    }
+    unsigned threads = argc > 3 ? (unsigned)strtoul(argv[3], NULL, 10) : 0;
+
+    double t0 = now_sec();
+    v3_scene scene;
+    if (!v3_scene_load(&scene, argv[1])) return 1;
+    double t1 = now_sec();
+
+    v3_pool *pool = v3_pool_create(threads);
+    float *rgb = malloc((size_t)scene.width * scene.height * 3 * sizeof(float));
+    if (pool == NULL || rgb == NULL) {
+        fprintf(stderr, "Error: v3trace allocation failed\n");
+        free(rgb);
+        v3_pool_destroy(pool);
+        v3_scene_free(&scene);
+        return 1;
+    }
+
+    v3_trace_stats stats;
+    bool ok = v3_trace_render(&scene, pool, rgb, &stats);
+    double t2 = now_sec();
+    if (ok) ok = write_image(argv[2], &scene, pool, rgb);
+    double t3 = now_sec();
+
+    if (ok) {
+        printf("scene   %zu spheres, %zu triangles, %zu planes, %zu lights, %zu BVH nodes  %.3f ms\n",
+               scene.sphere_count, scene.tri_count, scene.plane_count, scene.light_count,
+               scene.bvh.node_count, (t1 - t0) * 1e3);
+        printf("render  %dx%d on %u threads  %.3f ms  %.2f Mrays/s\n", scene.width, scene.height,
+               v3_pool_size(pool), (t2 - t1) * 1e3, (double)stats.rays / (t2 - t1) * 1e-6);
+        printf("output  %s  %.3f ms\n", argv[2], (t3 - t2) * 1e3);
+    }
+    free(rgb);
+    v3_pool_destroy(pool);
+    v3_scene_free(&scene);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,1929 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "v3math.h"
+#include "v3tri.h"
+#include "v3bvh.h"
+#include "v3camera.h"
+#include "v3image.h"
+#include "v3scene.h"
+#include "v3trace.h"
+#include "v3progressive.h"
+#include "v3dirty.h"
+#include "v3rcu.h"
+#include "v3serve.h"
+#include "v3sdf.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int g_failures = 0;
+
+static void expect_true(const char *testname, bool cond) {
+    if (cond) {
+        printf("PASS: %s\n", testname);
+    } else {
+        printf("FAIL: %s\n", testname);
+        g_failures++;
+    }
+}
+
+static void expect_float(const char *testname, float actual, float expected, float tol) {
+    if (fabsf(actual - expected) <= tol) {
+        printf("PASS: %s\n", testname);
+    } else {
+        printf("FAIL: %s\n  expected=%.8f actual=%.8f tol=%.6g\n",
+               testname, expected, actual, tol);
+        g_failures++;
+    }
+}
+
+// ---- Tests ----
+
+static void test_tri_precompute(void) {
+    float v0[3] = {1, 1, 0}, v1[3] = {3, 1, 0}, v2[3] = {1, 4, 0};
+    v3_tri tri;
+    v3_tri_precompute(&tri, v0, v1, v2);
+    float e1[3] = {2, 0, 0}, e2[3] = {0, 3, 0}, n[3] = {0, 0, 6};
+    expect_true("v3_tri_precompute edges", v3_equals(tri.e1, e1, 0.0f) && v3_equals(tri.e2, e2, 0.0f));
+    expect_true("v3_tri_precompute normal", v3_equals(tri.n, n, 0.0f));
+
+    // indexed mesh form
+    float verts[9] = {1, 1, 0, 3, 1, 0, 1, 4, 0};
+    uint32_t idx[3] = {0, 1, 2};
+    v3_tri_wt wt;
+    v3_tri_wt_precompute_n(&wt, verts, idx, 1);
+    expect_true("v3_tri_wt_precompute_n keeps vertices and normal",
+                v3_equals(wt.v1, v1, 0.0f) && v3_equals(wt.n, n, 0.0f));
+}
+
+static void test_ray_tri_hits_and_misses(void) {
+    float v0[3] = {0, 0, 0}, v1[3] = {1, 0, 0}, v2[3] = {0, 1, 0};
+    v3_tri tri;
+    v3_tri_wt wt;
+    v3_tri_precompute(&tri, v0, v1, v2);
+    v3_tri_wt_precompute(&wt, v0, v1, v2);
+
+    struct {
+        const char *name;
+        float orig[3], dir[3], t_max;
+        bool hit;
+        float t, u, v;
+    } cases[] = {
+        {"hit from above", {0.25f, 0.5f, 2}, {0, 0, -1}, INFINITY, true, 2.0f, 0.25f, 0.5f},
+        {"hit from below (no culling)", {0.25f, 0.25f, -1}, {0, 0, 2}, INFINITY, true, 0.5f, 0.25f, 0.25f},
+        {"miss outside", {0.8f, 0.8f, 1}, {0, 0, -1}, INFINITY, false, 0, 0, 0},
+        {"miss behind origin", {0.25f, 0.25f, -1}, {0, 0, -1}, INFINITY, false, 0, 0, 0},
+        {"miss parallel", {0.25f, 0.25f, 1}, {1, 0, 0}, INFINITY, false, 0, 0, 0},
+        {"miss beyond t_max", {0.25f, 0.25f, 2}, {0, 0, -1}, 1.5f, false, 0, 0, 0},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        float hit[3], hit_wt[3];
+        bool h = v3_ray_tri_intersect(&tri, cases[i].orig, cases[i].dir, cases[i].t_max, hit);
+        v3_ray_wt ray;
+        v3_ray_wt_precompute(&ray, cases[i].orig, cases[i].dir);
+        bool hw = v3_ray_tri_intersect_watertight(&wt, &ray, cases[i].t_max, hit_wt);
+
+        char name[128];
+        snprintf(name, sizeof(name), "v3_ray_tri_intersect %s", cases[i].name);
+        bool ok = h == cases[i].hit;
+        if (ok && h) {
+            ok = fabsf(hit[0] - cases[i].t) < 1e-5f && fabsf(hit[1] - cases[i].u) < 1e-5f &&
+                 fabsf(hit[2] - cases[i].v) < 1e-5f;
+        }
+        expect_true(name, ok);
+
+        snprintf(name, sizeof(name), "v3_ray_tri_intersect_watertight %s", cases[i].name);
+        ok = hw == cases[i].hit;
+        if (ok && hw) {
+            ok = fabsf(hit_wt[0] - cases[i].t) < 1e-5f && fabsf(hit_wt[1] - cases[i].u) < 1e-5f &&
+                 fabsf(hit_wt[2] - cases[i].v) < 1e-5f;
+        }
+        expect_true(name, ok);
+    }
+}
+
+// Rays aimed exactly at the shared diagonal of a quad split into two
+// triangles must hit at least one of them.
+static void test_watertight_shared_edge(void) {
+    float p0[3] = {0.1f, 0.37f, 2.3f}, p1[3] = {5.3f, 0.61f, 1.7f};
+    float p2[3] = {5.9f, 4.13f, 0.9f}, p3[3] = {0.7f, 3.3f, 2.1f};
+    v3_tri_wt a, b;
+    v3_tri_wt_precompute(&a, p0, p1, p2);
+    v3_tri_wt_precompute(&b, p0, p2, p3);
+
+    int misses = 0;
+    int rays = 0;
+    for (int i = 1; i < 2000; i++) {
+        float s = (float)i / 2000.0f;
+        float target[3];
+        for (int k = 0; k < 3; k++) target[k] = p0[k] + s * (p2[k] - p0[k]);
+        float orig[3] = {target[0] + 0.31f, target[1] - 0.17f, target[2] + 3.0f};
+        float dir[3];
+        v3_from_points(dir, orig, target);
+
+        v3_ray_wt ray;
+        v3_ray_wt_precompute(&ray, orig, dir);
+        float hit[3];
+        bool h = v3_ray_tri_intersect_watertight(&a, &ray, INFINITY, hit) ||
+                 v3_ray_tri_intersect_watertight(&b, &ray, INFINITY, hit);
+        misses += !h;
+        rays++;
+    }
+    char name[96];
+    snprintf(name, sizeof(name), "watertight: no cracks along shared edge (%d rays)", rays);
+    expect_true(name, misses == 0);
+
+    // hit distance agrees with the plane distance
+    float orig[3] = {3.0f, 2.0f, 10.0f}, dir[3] = {0, 0, -1};
+    v3_ray_wt ray;
+    v3_ray_wt_precompute(&ray, orig, dir);
+    float hit[3] = {0, 0, 0};
+    v3_tri_wt *which = v3_ray_tri_intersect_watertight(&a, &ray, INFINITY, hit) ? &a : &b;
+    v3_ray_tri_intersect_watertight(which, &ray, INFINITY, hit);
+    float d = (which->v0[0] - orig[0]) * which->n[0] + (which->v0[1] - orig[1]) * which->n[1] +
+              (which->v0[2] - orig[2]) * which->n[2];
+    expect_float("watertight t matches plane distance", hit[0], d / (-which->n[2]), 1e-4f);
+}
+
+static void fill_random(float *v, size_t nfloats, unsigned seed) {
+    unsigned state = seed * 2654435761u + 1u;
+    for (size_t i = 0; i < nfloats; i++) {
+        state = state * 1664525u + 1013904223u;
+        v[i] = (float)(state >> 8) / (float)(1u << 23) - 1.0f;
+    }
+}
+
+typedef struct {
+    float *centers;   // 4 floats per sphere: x y z r
+    float *orig, *dir;
+    uint32_t prim;
+} sphere_set;
+
+static bool sphere_t(const float *s, const float *orig, const float *dir, float t_max, float *t) {
+    float oc[3] = {orig[0] - s[0], orig[1] - s[1], orig[2] - s[2]};
+    float b = oc[0]*dir[0] + oc[1]*dir[1] + oc[2]*dir[2];
+    float c = oc[0]*oc[0] + oc[1]*oc[1] + oc[2]*oc[2] - s[3]*s[3];
+    float disc = b*b - c;
+    if (disc < 0.0f) return false;
+    float tt = -b - sqrtf(disc);
+    if (!(tt > 0.0f && tt < t_max)) return false;
+    *t = tt;
+    return true;
+}
+
+static bool sphere_set_hit(void *ctx, uint32_t prim, float *t_max) {
+    sphere_set *ss = ctx;
+    float t;
+    if (!sphere_t(ss->centers + 4 * (size_t)prim, ss->orig, ss->dir, *t_max, &t)) return false;
+    *t_max = t;
+    ss->prim = prim;
+    return true;
+}
+
+// rays whose BVH closest hit differs from a linear scan over n spheres
+static int bvh_mismatches(v3_bvh *bvh, float *spheres, uint32_t n, int rays, unsigned seed, int *hits) {
+    float *rnd = malloc(6 * (size_t)rays * sizeof(float));
+    fill_random(rnd, 6 * (size_t)rays, seed);
+    int mismatches = 0;
+    *hits = 0;
+    for (int r = 0; r < rays; r++) {
+        float orig[3] = {rnd[6*r] * 12.0f, rnd[6*r+1] * 12.0f, rnd[6*r+2] * 12.0f};
+        float dir[3] = {rnd[6*r+3], rnd[6*r+4], rnd[6*r+5]};
+        if (v3_length(dir) == 0.0f) continue;
+        v3_normalize(dir, dir);
+
+        float t_brute = INFINITY, t;
+        uint32_t p_brute = UINT32_MAX;
+        for (uint32_t i = 0; i < n; i++) {
+            if (sphere_t(spheres + 4 * i, orig, dir, t_brute, &t)) {
+                t_brute = t;
+                p_brute = i;
+            }
+        }
+        sphere_set ss = {spheres, orig, dir, UINT32_MAX};
+        float t_bvh = INFINITY;
+        bool h = v3_bvh_intersect(bvh, orig, dir, &t_bvh, sphere_set_hit, &ss);
+        *hits += h;
+        if (h != (p_brute != UINT32_MAX) || (h && (ss.prim != p_brute || t_bvh != t_brute))) mismatches++;
+    }
+    free(rnd);
+    return mismatches;
+}
+
+// BVH closest hit must match a linear scan over every primitive
+static void test_bvh_matches_brute_force(void) {
+    enum { N = 500, RAYS = 2000 };
+    float *spheres = malloc(N * 4 * sizeof(float));
+    v3_aabb *boxes = malloc(N * sizeof(v3_aabb));
+    fill_random(spheres, N * 4, 7);
+    for (size_t i = 0; i < N; i++) {
+        float *s = spheres + 4 * i;
+        for (int k = 0; k < 3; k++) s[k] *= 10.0f;
+        s[3] = 0.05f + 0.2f * fabsf(s[3]);
+        for (int k = 0; k < 3; k++) {
+            boxes[i].min[k] = s[k] - s[3];
+            boxes[i].max[k] = s[k] + s[3];
+        }
+    }
+    v3_bvh bvh;
+    expect_true("v3_bvh_build succeeds", v3_bvh_build(&bvh, boxes, N));
+    expect_true("v3_bvh_build node count within 2n-1", bvh.node_count >= 1 && bvh.node_count <= 2 * N - 1);
+
+    bool seen_all = true;
+    bool *seen = calloc(N, sizeof(bool));
+    for (size_t i = 0; i < bvh.prim_count; i++) seen[bvh.prims[i]] = true;
+    for (size_t i = 0; i < N; i++) seen_all &= seen[i];
+    expect_true("v3_bvh_build keeps every primitive once", seen_all && bvh.prim_count == N);
+    free(seen);
+
+    int hits = 0;
+    int mismatches = bvh_mismatches(&bvh, spheres, N, RAYS, 11, &hits);
+    char name[96];
+    snprintf(name, sizeof(name), "v3_bvh_intersect matches brute force (%d rays, %d hits)", RAYS, hits);
+    expect_true(name, mismatches == 0 && hits > 0);
+
+    v3_bvh_free(&bvh);
+    v3_bvh empty;
+    float o[3] = {0, 0, 0}, d[3] = {0, 0, 1}, tm = INFINITY;
+    expect_true("v3_bvh empty build", v3_bvh_build(&empty, NULL, 0) && empty.node_count == 0);
+    expect_true("v3_bvh empty never hits", !v3_bvh_intersect(&empty, o, d, &tm, sphere_set_hit, NULL));
+    free(boxes);
+    free(spheres);
+}
+
+static void sphere_boxes(v3_aabb *boxes, const float *spheres, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        const float *s = spheres + 4 * i;
+        for (int k = 0; k < 3; k++) {
+            boxes[i].min[k] = s[k] - s[3];
+            boxes[i].max[k] = s[k] + s[3];
+        }
+    }
+}
+
+// every node's box is exactly the union of its children or primitives
+static bool bvh_tight(v3_bvh *bvh, v3_aabb *boxes, uint32_t node) {
+    v3_bvh_node *n = &bvh->nodes[node];
+    v3_aabb box;
+    v3_aabb_empty(&box);
+    bool ok = true;
+    if (n->count > 0) {
+        for (uint32_t i = 0; i < n->count; i++) v3_aabb_grow_box(&box, &boxes[bvh->prims[n->first + i]]);
+    } else {
+        for (uint32_t c = n->first; c < n->first + 2; c++) {
+            v3_bvh_node *ch = &bvh->nodes[c];
+            v3_aabb cb;
+            memcpy(cb.min, ch->bmin, sizeof(cb.min));
+            memcpy(cb.max, ch->bmax, sizeof(cb.max));
+            v3_aabb_grow_box(&box, &cb);
+            ok &= c < bvh->node_count && c > node && bvh_tight(bvh, boxes, c);
+        }
+    }
+    return ok && memcmp(box.min, n->bmin, sizeof(box.min)) == 0 && memcmp(box.max, n->bmax, sizeof(box.max)) == 0;
+}
+
+static bool sphere_set_any(void *ctx, uint32_t ray, uint32_t prim, float t_max) {
+    (void)ray;
+    sphere_set *ss = ctx;
+    float t;
+    return sphere_t(ss->centers + 4 * (size_t)prim, ss->orig, ss->dir, t_max, &t);
+}
+
+// the wide tree must find exactly what the binary tree finds
+static int wbvh_mismatches(v3_bvh *bvh, v3_wbvh *w, float *spheres, int rays, unsigned seed, int *hits) {
+    float *rnd = malloc(7 * (size_t)rays * sizeof(float));
+    fill_random(rnd, 7 * (size_t)rays, seed);
+    int mismatches = 0;
+    *hits = 0;
+    for (int r = 0; r < rays; r++) {
+        float *q = rnd + 7 * r;
+        float orig[3] = {q[0] * 12.0f, q[1] * 12.0f, q[2] * 12.0f}, dir[3] = {q[3], q[4], q[5]};
+        // every fourth ray runs along an axis, so slabs see 0 * inf
+        if (r % 4 == 0) dir[0] = dir[1] = 0.0f;
+        if (v3_length(dir) == 0.0f) continue;
+        v3_normalize(dir, dir);
+        sphere_set a = {spheres, orig, dir, UINT32_MAX}, b = a;
+        float ta = INFINITY, tb = INFINITY;
+        bool ha = v3_bvh_intersect(bvh, orig, dir, &ta, sphere_set_hit, &a);
+        bool hb = v3_wbvh_intersect(w, orig, dir, &tb, sphere_set_hit, &b);
+        *hits += hb;
+        if (ha != hb || (ha && (a.prim != b.prim || ta != tb))) mismatches++;
+        float t_max = 4.0f + 8.0f * (q[6] + 1.0f);
+        if (v3_bvh_occluded(bvh, orig, dir, t_max, sphere_set_any, &a) !=
+            v3_wbvh_occluded(w, orig, dir, t_max, sphere_set_any, &b)) {
+            mismatches++;
+        }
+    }
+    free(rnd);
+    return mismatches;
+}
+
+static bool mark_prim(void *ctx, uint32_t prim, float *t_max) {
+    (void)t_max;
+    ((bool *)ctx)[prim] = true;
+    return false;
+}
+
+static bool mark_any(void *ctx, uint32_t ray, uint32_t prim, float t_max) {
+    (void)ray;
+    return mark_prim(ctx, prim, &t_max);
+}
+
+static void test_wbvh_matches_bvh(void) {
+    enum { N = 2000, RAYS = 3000 };
+    float *spheres = malloc(N * 4 * sizeof(float));
+    v3_aabb *boxes = malloc(N * sizeof(v3_aabb));
+    fill_random(spheres, N * 4, 17);
+    for (size_t i = 0; i < N; i++) {
+        float *s = spheres + 4 * i;
+        // a dense cluster next to sparse spheres, so quantization steps vary
+        float spread = i % 2 ? 10.0f : 0.5f;
+        for (int k = 0; k < 3; k++) s[k] *= spread;
+        s[3] = (0.02f + 0.08f * fabsf(s[3])) * spread;
+    }
+    sphere_boxes(boxes, spheres, N);
+    v3_bvh bvh;
+    v3_wbvh w;
+    bool ok = v3_bvh_build(&bvh, boxes, N) && v3_wbvh_convert(&w, &bvh);
+    expect_true("v3_wbvh_convert succeeds", ok);
+    if (!ok) return;
+
+    bool seen_all = w.prim_count == N;
+    bool *seen = calloc(N, sizeof(bool));
+    for (size_t i = 0; i < w.prim_count; i++) seen[w.prims[i]] = true;
+    for (size_t i = 0; i < N; i++) seen_all &= seen[i];
+    free(seen);
+    expect_true("v3_wbvh_convert keeps every primitive once", seen_all);
+    expect_true("v3_wbvh nodes are 80 bytes and the tree smaller",
+                sizeof(v3_wbvh_node) == 80 &&
+                w.node_count * sizeof(v3_wbvh_node) < bvh.node_count * sizeof(v3_bvh_node) / 2);
+
+    int hits = 0;
+    int mismatches = wbvh_mismatches(&bvh, &w, spheres, RAYS, 19, &hits);
+    char name[96];
+    snprintf(name, sizeof(name), "v3_wbvh matches the binary BVH (%d rays, %d hits)", RAYS, hits);
+    expect_true(name, mismatches == 0 && hits > RAYS / 10);
+    v3_wbvh_free(&w);
+    v3_bvh_free(&bvh);
+
+    // a single leaf as root, and an empty tree
+    ok = v3_bvh_build(&bvh, boxes, 1) && v3_wbvh_convert(&w, &bvh);
+    expect_true("v3_wbvh of one primitive", ok && w.node_count == 1 && w.prim_count == 1 &&
+                                            wbvh_mismatches(&bvh, &w, spheres, 200, 23, &hits) == 0);
+    v3_wbvh_free(&w);
+    v3_bvh_free(&bvh);
+    float o[3] = {0, 0, 0}, d[3] = {0, 0, 1}, tm = INFINITY;
+    ok = v3_bvh_build(&bvh, NULL, 0) && v3_wbvh_convert(&w, &bvh);
+    expect_true("v3_wbvh empty tree never hits", ok && w.node_count == 0 &&
+                                                 !v3_wbvh_intersect(&w, o, d, &tm, sphere_set_hit, NULL));
+
+    // coincident boxes leave one leaf per set: 200 need a wide node of two
+    // leaves, 1500 a second level
+    for (size_t i = 0; i < N; i++) boxes[i] = (v3_aabb){{-1, -1, -1}, {1, 1, 1}};
+    bool *reached = calloc(N, sizeof(bool));
+    size_t sets[2] = {200, 1500};
+    for (int k = 0; k < 2; k++) {
+        size_t n = sets[k];
+        ok = v3_bvh_build(&bvh, boxes, n) && v3_wbvh_convert(&w, &bvh);
+        expect_true("v3_bvh_build keeps coincident boxes in one leaf",
+                    ok && bvh.node_count == 1 && bvh.nodes[0].count == n);
+        if (!ok) continue;
+        float from[3] = {0, 0, -5}, up[3] = {0, 0, 1}, far = INFINITY;
+        memset(reached, 0, N * sizeof(bool));
+        v3_wbvh_intersect(&w, from, up, &far, mark_prim, reached);
+        bool all = w.prim_count == n && w.node_count == (k ? 9u : 1u);
+        for (size_t i = 0; i < n; i++) all &= reached[i];
+        memset(reached, 0, N * sizeof(bool));
+        v3_wbvh_occluded(&w, from, up, INFINITY, mark_any, reached);
+        for (size_t i = 0; i < n; i++) all &= reached[i];
+        expect_true("v3_wbvh_convert splits oversized leaves and reaches every primitive", all);
+        v3_wbvh_free(&w);
+        v3_bvh_free(&bvh);
+    }
+    free(reached);
+    free(boxes);
+    free(spheres);
+}
+
+static int bvh_depth(const v3_bvh *bvh, uint32_t node) {
+    const v3_bvh_node *n = &bvh->nodes[node];
+    if (n->count > 0) return 0;
+    int a = bvh_depth(bvh, n->first), b = bvh_depth(bvh, n->first + 1);
+    return 1 + (a > b ? a : b);
+}
+
+static void test_bvh_depth_limit(void) {
+    // boxes at x = 2^i: binned splits peel a few boxes off at a time, so
+    // the tree is far deeper than a balanced one
+    enum { N = 100, CHAIN = V3_BVH_MAX_DEPTH + 8 };
+    v3_aabb boxes[N];
+    for (int i = 0; i < N; i++) {
+        float c = ldexpf(1.0f, i);
+        boxes[i] = (v3_aabb){{0.75f * c, -0.25f, -0.25f}, {1.25f * c, 0.25f, 0.25f}};
+    }
+    v3_bvh bvh;
+    v3_wbvh w;
+    bool ok = v3_bvh_build(&bvh, boxes, N) && v3_wbvh_convert(&w, &bvh);
+    int depth = ok ? bvh_depth(&bvh, 0) : 0;
+    expect_true("v3_bvh_build of a skewed set stays within V3_BVH_MAX_DEPTH",
+                ok && depth > 20 && depth <= V3_BVH_MAX_DEPTH);
+    if (!ok) return;
+
+    // a ray down onto each box must find it through every traversal
+    int found[4] = {0, 0, 0, 0};
+    for (int i = 0; i < N; i++) {
+        float o[3] = {ldexpf(1.0f, i), 0.0f, -1.0f}, d[3] = {0.0f, 0.0f, 1.0f}, t = INFINITY;
+        bool seen[4][N];
+        memset(seen, 0, sizeof(seen));
+        v3_bvh_intersect(&bvh, o, d, &t, mark_prim, seen[0]);
+        v3_bvh_occluded(&bvh, o, d, INFINITY, mark_any, seen[1]);
+        t = INFINITY;
+        v3_wbvh_intersect(&w, o, d, &t, mark_prim, seen[2]);
+        v3_wbvh_occluded(&w, o, d, INFINITY, mark_any, seen[3]);
+        for (int k = 0; k < 4; k++) found[k] += seen[k][i];
+    }
+    expect_true("skewed BVH traversals reach every primitive",
+                found[0] == N && found[1] == N && found[2] == N && found[3] == N);
+    v3_wbvh_free(&w);
+    v3_bvh_free(&bvh);
+
+    // a hand-made chain deeper than the limit: the wide tree folds seven
+    // levels into one, so it stays well within the wide stack
+    v3_bvh_node nodes[2 * CHAIN + 1];
+    uint32_t prims[CHAIN + 1];
+    // node 2i has the leaf 2i+1 and the next link 2i+2 as children; the
+    // last link is a leaf itself
+    for (uint32_t i = 0; i <= CHAIN; i++) {
+        prims[i] = i;
+        nodes[2 * i] = (v3_bvh_node){{-1, -1, -1}, i < CHAIN ? 2 * i + 1 : i, {1, 1, 1}, i < CHAIN ? 0 : 1};
+        if (i < CHAIN) nodes[2 * i + 1] = (v3_bvh_node){{-1, -1, -1}, i, {1, 1, 1}, 1};
+    }
+    bvh = (v3_bvh){nodes, 2 * CHAIN + 1, prims, CHAIN + 1};
+    float o[3] = {0.0f, 0.0f, -5.0f}, d[3] = {0.0f, 0.0f, 1.0f}, t = INFINITY;
+    bool seen[CHAIN + 1] = {false};
+    ok = v3_wbvh_convert(&w, &bvh);
+    if (ok) v3_wbvh_intersect(&w, o, d, &t, mark_prim, seen);
+    for (int i = 0; i <= CHAIN; i++) ok &= seen[i];
+    expect_true("v3_wbvh of a chain deeper than V3_BVH_MAX_DEPTH reaches every primitive", ok);
+    if (ok) v3_wbvh_free(&w);
+}
+
+static void test_bvh_refit(void) {
+    enum { N = 8192, MOVED = 200, RAYS = 1000 };
+    float *spheres = malloc(N * 4 * sizeof(float));
+    v3_aabb *boxes = malloc(N * sizeof(v3_aabb));
+    fill_random(spheres, N * 4, 17);
+    for (size_t i = 0; i < N; i++) {
+        float *s = spheres + 4 * i;
+        for (int k = 0; k < 3; k++) s[k] *= 10.0f;
+        s[3] = 0.02f + 0.05f * fabsf(s[3]);
+    }
+    sphere_boxes(boxes, spheres, N);
+    v3_bvh full, inc;
+    v3_bvh_refitter r;
+    bool ok = v3_bvh_build(&full, boxes, N) && v3_bvh_build(&inc, boxes, N) && v3_bvh_refitter_init(&r, &inc);
+    expect_true("v3_bvh_refitter_init succeeds", ok);
+    if (!ok) return;
+    expect_true("v3_bvh_refitter costs match v3_bvh_sah_cost",
+                fabsf(r.built[0] - v3_bvh_sah_cost(&inc)) < 1e-3f * v3_bvh_sah_cost(&inc));
+
+    // move every 41st sphere a little
+    uint32_t changed[MOVED];
+    for (uint32_t i = 0; i < MOVED; i++) {
+        changed[i] = (i * 41) % N;
+        float *s = spheres + 4 * (size_t)changed[i];
+        s[0] += 0.3f;
+        s[1] -= 0.2f;
+    }
+    sphere_boxes(boxes, spheres, N);
+    v3_pool *pool = v3_pool_create(3);
+    v3_bvh_refit(&full, NULL, boxes, pool);
+    expect_true("v3_bvh_refit leaves tight bounds", bvh_tight(&full, boxes, 0));
+    expect_true("v3_bvh_refit_prims succeeds", v3_bvh_refit_prims(&inc, &r, boxes, changed, MOVED));
+    expect_true("v3_bvh_refit_prims matches full refit",
+                memcmp(full.nodes, inc.nodes, full.node_count * sizeof(v3_bvh_node)) == 0);
+    uint32_t bad = N;
+    expect_true("v3_bvh_refit_prims rejects bad index", !v3_bvh_refit_prims(&inc, &r, boxes, &bad, 1));
+    int hits = 0;
+    int mism = bvh_mismatches(&inc, spheres, N, RAYS, 19, &hits);
+    expect_true("v3_bvh_refit_prims tree matches brute force", mism == 0 && hits > 0);
+    expect_true("v3_bvh_rebuild_degraded leaves a mildly moved tree alone",
+                v3_bvh_rebuild_degraded(&inc, &r, boxes, 1.5f) == 0);
+
+    // shuffle the spheres of one corner among themselves: the corner's
+    // bounds stay put while its subtree's structure becomes useless
+    uint32_t *cluster = malloc(N * sizeof(uint32_t));
+    uint32_t cn = 0;
+    for (uint32_t i = 0; i < N; i++) {
+        float *s = spheres + 4 * (size_t)i;
+        if (s[0] > 5.0f && s[1] > 5.0f && s[2] > 5.0f) cluster[cn++] = i;
+    }
+    float *moved = malloc(cn * 3 * sizeof(float));
+    for (uint32_t i = 0; i < cn; i++) memcpy(moved + 3 * i, spheres + 4 * (size_t)cluster[(i + cn / 2) % cn], 3 * sizeof(float));
+    for (uint32_t i = 0; i < cn; i++) memcpy(spheres + 4 * (size_t)cluster[i], moved + 3 * i, 3 * sizeof(float));
+    free(moved);
+    sphere_boxes(boxes, spheres, N);
+    v3_bvh_refit_prims(&inc, &r, boxes, cluster, cn);
+    float stretched = v3_bvh_sah_cost(&inc);
+    size_t rebuilt = v3_bvh_rebuild_degraded(&inc, &r, boxes, 1.5f);
+    float repaired = v3_bvh_sah_cost(&inc);
+    v3_bvh fresh;
+    v3_bvh_build(&fresh, boxes, N);
+    char name[128];
+    snprintf(name, sizeof(name), "v3_bvh_rebuild_degraded restores SAH (%u shuffled, %zu rebuilt, %.1f -> %.1f, fresh %.1f)",
+             cn, rebuilt, stretched, repaired, v3_bvh_sah_cost(&fresh));
+    expect_true(name, cn > 0 && rebuilt > 0 && repaired < stretched && repaired < 1.01f * v3_bvh_sah_cost(&fresh));
+    expect_true("v3_bvh_rebuild_degraded leaves tight bounds", bvh_tight(&inc, boxes, 0));
+    bool *seen = calloc(N, sizeof(bool));
+    bool seen_all = true;
+    for (size_t i = 0; i < N; i++) seen[inc.prims[i]] = true;
+    for (size_t i = 0; i < N; i++) seen_all &= seen[i];
+    expect_true("v3_bvh_rebuild_degraded keeps every primitive once", seen_all);
+    mism = bvh_mismatches(&inc, spheres, N, RAYS, 29, &hits);
+    expect_true("v3_bvh_rebuild_degraded tree matches brute force", mism == 0 && hits > 0);
+
+    // the refitter stays valid after the rebuild
+    for (uint32_t i = 0; i < MOVED; i++) spheres[4 * (size_t)changed[i] + 2] += 0.1f;
+    sphere_boxes(boxes, spheres, N);
+    v3_bvh_refit_prims(&inc, &r, boxes, changed, MOVED);
+    expect_true("v3_bvh_refit_prims after rebuild leaves tight bounds", bvh_tight(&inc, boxes, 0));
+
+    free(seen);
+    free(cluster);
+    v3_pool_destroy(pool);
+    v3_bvh_refitter_free(&r);
+    v3_bvh_free(&fresh);
+    v3_bvh_free(&full);
+    v3_bvh_free(&inc);
+    free(boxes);
+    free(spheres);
+}
+
+static void test_dirty_tracking(void) {
+    // bitset: runs are whole blocks, clipped to the array and to from
+    v3_dirty *d = v3_dirty_create(1000, 64);
+    expect_true("v3_dirty_create", d != NULL && v3_dirty_block_size(d) == 64);
+    if (d == NULL) return;
+    size_t end;
+    expect_true("v3_dirty starts clean", v3_dirty_next(d, 0, &end) == 1000 && v3_dirty_blocks(d) == 0);
+    v3_dirty_mark(d, 70, 5);       // block 1
+    v3_dirty_mark(d, 130, 100);    // blocks 2 and 3
+    uint32_t idx[2] = {999, 640};  // blocks 15 and 10
+    v3_dirty_mark_indices(d, idx, 2);
+    size_t b0 = v3_dirty_next(d, 0, &end), e0 = end;
+    size_t b1 = v3_dirty_next(d, e0, &end), e1 = end;
+    size_t b2 = v3_dirty_next(d, e1, &end), e2 = end;
+    size_t b3 = v3_dirty_next(d, e2, &end);
+    expect_true("v3_dirty_next coalesces adjacent blocks",
+                b0 == 64 && e0 == 256 && b1 == 640 && e1 == 704 && b2 == 960 && e2 == 1000 && b3 == 1000);
+    expect_true("v3_dirty_next starts inside a run", v3_dirty_next(d, 100, &end) == 100 && end == 256);
+    expect_true("v3_dirty_blocks", v3_dirty_blocks(d) == 5);
+    v3_dirty_clear(d);
+    v3_dirty_mark_all(d);
+    expect_true("v3_dirty_mark_all", v3_dirty_next(d, 0, &end) == 0 && end == 1000 && v3_dirty_blocks(d) == 16);
+    v3_dirty_destroy(d);
+
+    // a grid mesh whose vertices move in one patch
+    enum { G = 64, V = G * G, T = 2 * (G - 1) * (G - 1) };
+    float *verts = malloc(3 * V * sizeof(float));
+    float *prev = malloc(3 * V * sizeof(float));
+    float *nrm = malloc(3 * V * sizeof(float));
+    float *ref = malloc(3 * V * sizeof(float));
+    uint32_t *tris = malloc(3 * T * sizeof(uint32_t));
+    for (uint32_t y = 0; y < G; y++) {
+        for (uint32_t x = 0; x < G; x++) {
+            float *p = verts + 3 * (size_t)(y * G + x);
+            p[0] = (float)x;
+            p[1] = (float)y;
+            p[2] = 0.3f * sinf(0.2f * (float)x) * cosf(0.3f * (float)y);
+        }
+    }
+    size_t t = 0;
+    for (uint32_t y = 0; y + 1 < G; y++) {
+        for (uint32_t x = 0; x + 1 < G; x++) {
+            uint32_t v = y * G + x;
+            uint32_t quad[6] = {v, v + 1, v + G, v + 1, v + G + 1, v + G};
+            memcpy(tris + 3 * t, quad, sizeof(quad));
+            t += 2;
+        }
+    }
+    d = v3_dirty_create(V, 32);
+    v3_normals nm;
+    v3_bounds bounds;
+    bool ok = d != NULL && v3_normals_init(&nm, tris, T, V) && v3_bounds_init(&bounds, d, verts);
+    expect_true("v3_normals_init and v3_bounds_init", ok);
+    if (!ok) return;
+    v3_normals_compute(&nm, verts, nrm);
+    float up = nrm[3 * (G * G / 2 + G / 2) + 2];
+    expect_true("v3_normals_compute points up on a wavy grid", up > 0.5f && up <= 1.0f);
+
+    memcpy(prev, verts, 3 * V * sizeof(float));
+    for (uint32_t y = 20; y < 24; y++) {
+        for (uint32_t x = 10; x < 30; x++) verts[3 * (size_t)(y * G + x) + 2] += 2.0f;
+    }
+    expect_true("v3_dirty_mark_changed finds the moved rows", v3_dirty_mark_changed(d, verts, prev, 0.0f) == 4);
+    size_t written = v3_normals_update(&nm, d, verts, nrm);
+    v3_normals ref_nm;
+    v3_normals_init(&ref_nm, tris, T, V);
+    v3_normals_compute(&ref_nm, verts, ref);
+    expect_true("v3_normals_update matches a full recompute",
+                memcmp(nrm, ref, 3 * V * sizeof(float)) == 0 && written > 0 && written < V / 4);
+    // an update straight after init has no face cache and recomputes all
+    v3_normals fresh;
+    v3_normals_init(&fresh, tris, T, V);
+    written = v3_normals_update(&fresh, d, verts, prev);
+    expect_true("v3_normals_update before any compute recomputes everything",
+                written == V && memcmp(prev, ref, 3 * V * sizeof(float)) == 0);
+    v3_normals_free(&fresh);
+    v3_bounds_update(&bounds, d, verts);
+    v3_aabb box;
+    v3_aabb_empty(&box);
+    for (size_t i = 0; i < V; i++) v3_aabb_grow_point(&box, verts + 3 * i);
+    expect_true("v3_bounds_update matches the points", memcmp(&box, &bounds.total, sizeof(box)) == 0);
+    v3_dirty_clear(d);
+    expect_true("v3_normals_update with nothing dirty", v3_normals_update(&nm, d, verts, nrm) == 0);
+
+    // BVH over spheres, a contiguous range of which moves
+    v3_dirty_destroy(d);
+    enum { N = 4096 };
+    float *spheres = malloc(N * 4 * sizeof(float));
+    v3_aabb *boxes = malloc(N * sizeof(v3_aabb));
+    fill_random(spheres, N * 4, 41);
+    for (size_t i = 0; i < N; i++) spheres[4 * i + 3] = 0.01f + 0.02f * fabsf(spheres[4 * i + 3]);
+    sphere_boxes(boxes, spheres, N);
+    v3_bvh full, inc;
+    v3_bvh_refitter r;
+    d = v3_dirty_create(N, 0);
+    ok = d && v3_bvh_build(&full, boxes, N) && v3_bvh_build(&inc, boxes, N) && v3_bvh_refitter_init(&r, &inc);
+    expect_true("v3_bvh_refit_dirty setup", ok);
+    if (ok) {
+        for (size_t i = 1000; i < 1100; i++) spheres[4 * i] += 0.05f;
+        sphere_boxes(boxes, spheres, N);
+        v3_dirty_mark(d, 1000, 100);
+        v3_bvh_refit(&full, NULL, boxes, NULL);
+        expect_true("v3_bvh_refit_dirty matches full refit",
+                    v3_bvh_refit_dirty(&inc, &r, boxes, d) &&
+                    memcmp(full.nodes, inc.nodes, full.node_count * sizeof(v3_bvh_node)) == 0);
+        v3_bvh_refitter_free(&r);
+        v3_bvh_free(&full);
+        v3_bvh_free(&inc);
+    }
+
+    v3_dirty_destroy(d);
+    v3_normals_free(&nm);
+    v3_normals_free(&ref_nm);
+    v3_bounds_free(&bounds);
+    free(verts);
+    free(prev);
+    free(nrm);
+    free(ref);
+    free(tris);
+    free(spheres);
+    free(boxes);
+}
+
+static void test_raygen_pinhole(void) {
+    v3_camera cam = {.pos = {1, 2, 3}, .look = {1, 2, -1}, .up = {0, 1, 0}, .fov = 60};
+    enum { W = 7, H = 5 };
+    v3_raygen rg;
+    expect_true("v3_raygen_init pinhole", v3_raygen_init(&rg, &cam, W, H) && !rg.thin_lens);
+
+    v3_ray_soa rays;
+    v3_ray_soa_alloc(&rays, W * H);
+    v3_raygen_tile(&rg, 0, 0, W, H, 0, &rays);
+
+    // reference: the per-pixel v3_scale/v3_add/v3_normalize construction
+    float forward[3] = {0, 0, -1}, right[3] = {1, 0, 0}, up[3] = {0, 1, 0};
+    float half_h = tanf(30.0f * 3.14159265f / 180.0f), half_w = half_h * W / H;
+    float worst = 0.0f;
+    bool origins = true;
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            float r[3] = {right[0], right[1], right[2]}, u[3] = {up[0], up[1], up[2]}, d[3];
+            v3_scale(r, (2.0f * (x + 0.5f) / W - 1.0f) * half_w);
+            v3_scale(u, (1.0f - 2.0f * (y + 0.5f) / H) * half_h);
+            v3_add(d, forward, r);
+            v3_add(d, d, u);
+            v3_normalize(d, d);
+            size_t i = (size_t)y * W + x;
+            float got[3] = {rays.dx[i], rays.dy[i], rays.dz[i]};
+            for (int k = 0; k < 3; k++) worst = fmaxf(worst, fabsf(got[k] - d[k]));
+            origins &= rays.ox[i] == 1.0f && rays.oy[i] == 2.0f && rays.oz[i] == 3.0f;
+        }
+    }
+    expect_float("v3_raygen_tile pinhole matches per-pixel directions", worst, 0.0f, 1e-6f);
+    expect_true("v3_raygen_tile pinhole origins", origins);
+    size_t c = (H / 2) * W + W / 2;
+    expect_true("v3_raygen_tile centre ray is forward",
+                fabsf(rays.dx[c]) < 1e-6f && fabsf(rays.dy[c]) < 1e-6f && fabsf(rays.dz[c] + 1.0f) < 1e-6f);
+
+    // a sub-tile equals the same pixels of the full frame
+    v3_ray_soa sub;
+    v3_ray_soa_alloc(&sub, 6);
+    v3_raygen_tile(&rg, 2, 1, 3, 2, 0, &sub);
+    bool same = true;
+    for (int i = 0; i < 6; i++) {
+        size_t j = (size_t)(1 + i / 3) * W + (size_t)(2 + i % 3);
+        same &= sub.dx[i] == rays.dx[j] && sub.dy[i] == rays.dy[j] && sub.dz[i] == rays.dz[j];
+    }
+    expect_true("v3_raygen_tile sub-tile matches full frame", same);
+    v3_ray_soa_free(&sub);
+    v3_ray_soa_free(&rays);
+}
+
+static void test_raygen_jitter_and_lens(void) {
+    v3_camera cam = {.pos = {0, 0, 0}, .look = {0, 0, -4}, .up = {0, 1, 0}, .fov = 50};
+    enum { W = 9, H = 6, N = W * H };
+    v3_raygen rg;
+    v3_raygen_init(&rg, &cam, W, H);
+    rg.jitter = true;
+    v3_ray_soa a, b;
+    v3_ray_soa_alloc(&a, N);
+    v3_ray_soa_alloc(&b, N);
+
+    v3_raygen_tile(&rg, 0, 0, W, H, 3, &a);
+    v3_raygen_tile(&rg, 0, 0, W, H, 3, &b);
+    expect_true("v3_raygen_tile jitter reproducible", memcmp(a.dx, b.dx, N * sizeof(float)) == 0);
+    v3_raygen_tile(&rg, 0, 0, W, H, 4, &b);
+    expect_true("v3_raygen_tile jitter varies by sample", memcmp(a.dx, b.dx, N * sizeof(float)) != 0);
+
+    // every jittered ray stays inside its own pixel on the image plane
+    bool inside = true;
+    for (int i = 0; i < N; i++) {
+        float d[3] = {a.dx[i], a.dy[i], a.dz[i]};
+        v3_scale(d, 1.0f / -d[2]);  // image plane at distance 1
+        float px = (d[0] - rg.corner[0]) / rg.step_x[0];
+        float py = (d[1] - rg.corner[1]) / rg.step_y[1];
+        inside &= px >= (float)(i % W) - 1e-4f && px <= (float)(i % W + 1) + 1e-4f;
+        inside &= py >= (float)(i / W) - 1e-4f && py <= (float)(i / W + 1) + 1e-4f;
+    }
+    expect_true("v3_raygen_tile jitter stays inside pixel", inside);
+
+    // thin lens: origins spread over the aperture, rays meet on the focus plane
+    cam.aperture = 0.25f;
+    cam.focus = 3.0f;
+    v3_raygen lens, pin;
+    expect_true("v3_raygen_init thin lens", v3_raygen_init(&lens, &cam, W, H) && lens.thin_lens);
+    cam.aperture = 0.0f;
+    v3_raygen_init(&pin, &cam, W, H);
+    v3_raygen_tile(&lens, 0, 0, W, H, 1, &a);
+    v3_raygen_tile(&pin, 0, 0, W, H, 0, &b);
+    bool in_aperture = true, moved = false;
+    float worst = 0.0f;
+    for (int i = 0; i < N; i++) {
+        float r = sqrtf(a.ox[i] * a.ox[i] + a.oy[i] * a.oy[i]);
+        in_aperture &= r <= 0.25f + 1e-6f && a.oz[i] == 0.0f;
+        moved |= r > 0.0f;
+        float tl = (-3.0f - a.oz[i]) / a.dz[i], tp = -3.0f / b.dz[i];
+        worst = fmaxf(worst, fabsf(a.ox[i] + tl * a.dx[i] - tp * b.dx[i]));
+        worst = fmaxf(worst, fabsf(a.oy[i] + tl * a.dy[i] - tp * b.dy[i]));
+    }
+    expect_true("v3_raygen_tile thin lens origins on the aperture", in_aperture && moved);
+    expect_float("v3_raygen_tile thin lens rays converge on focus plane", worst, 0.0f, 1e-5f);
+
+    // pixel 4 of a 5-wide row comes from the scalar tail; of a 4-wide row
+    // starting at 1, from the SIMD path. Both must give the same ray.
+    lens.jitter = true;
+    v3_raygen_tile(&lens, 0, 2, 5, 1, 9, &a);
+    v3_raygen_tile(&lens, 1, 2, 4, 1, 9, &b);
+    expect_true("v3_raygen_tile SIMD and scalar paths agree",
+                a.ox[4] == b.ox[3] && a.oy[4] == b.oy[3] && a.dx[4] == b.dx[3] &&
+                a.dy[4] == b.dy[3] && a.dz[4] == b.dz[3]);
+
+    v3_ray_soa_free(&a);
+    v3_ray_soa_free(&b);
+}
+
+static int srgb_exact(float x) {
+    double v = x <= 0.0f ? 0.0 : x >= 1.0f ? 1.0 : x;
+    v = v <= 0.0031308 ? 12.92 * v : 1.055 * pow(v, 1.0 / 2.4) - 0.055;
+    return (int)(v * 255.0 + 0.5);
+}
+
+static void test_image_srgb(void) {
+    enum { N = 30000 };  // pixels, 3 * N values spread over [0, 1]
+    float *lin = malloc(3 * N * sizeof(float));
+    uint8_t *out = malloc(3 * N);
+    for (int i = 0; i < 3 * N; i++) lin[i] = (float)i / (float)(3 * N - 1);
+    v3_image_srgb8_n(out, lin, N);
+    int worst = 0, off = 0;
+    for (int i = 0; i < 3 * N; i++) {
+        int d = abs((int)out[i] - srgb_exact(lin[i]));
+        worst = d > worst ? d : worst;
+        off += d != 0;
+    }
+    char name[96];
+    snprintf(name, sizeof(name), "v3_image_srgb8_n within one code of exact (%d of %d differ)", off, 3 * N);
+    expect_true(name, worst <= 1 && off < 3 * N / 100);
+
+    float edge[6] = {0.0f, 1.0f, -3.0f, 7.0f, NAN, 0.0031308f};
+    uint8_t e8[6];
+    v3_image_srgb8_n(e8, edge, 2);
+    expect_true("v3_image_srgb8_n clamps and maps NaN to 0",
+                e8[0] == 0 && e8[1] == 255 && e8[2] == 0 && e8[3] == 255 && e8[4] == 0 && e8[5] == 10);
+
+    // the scalar tail agrees with the SIMD body
+    bool same = true;
+    for (int i = 0; i < 50; i++) {
+        uint8_t one[3];
+        v3_image_srgb8_n(one, lin + 3 * (i * 97), 1);
+        same &= memcmp(one, out + 3 * (i * 97), 3) == 0;
+    }
+    expect_true("v3_image_srgb8_n SIMD and scalar paths agree", same);
+    free(lin);
+    free(out);
+}
+
+static void test_image_tonemap(void) {
+    float v[6] = {0.3f, 0.7f, -1.0f, 0.0f, 2.0f, 100.0f};
+    float d[6];
+    v3_image_tonemap_n(d, v, 2, 2.0f, V3_TONEMAP_CLAMP);
+    float want[6] = {0.6f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f};
+    bool ok = true;
+    for (int i = 0; i < 6; i++) ok &= fabsf(d[i] - want[i]) < 1e-6f;
+    expect_true("v3_image_tonemap_n clamp with exposure", ok);
+
+    float ramp[12];
+    for (int i = 0; i < 12; i++) ramp[i] = (float)i * 0.5f;
+    v3_image_tonemap_n(ramp, ramp, 4, 1.0f, V3_TONEMAP_FILMIC);  // in place
+    bool mono = fabsf(ramp[0]) < 1e-6f && ramp[11] <= 1.0f && ramp[11] > 0.95f;
+    for (int i = 1; i < 12; i++) mono &= ramp[i] > ramp[i - 1] || ramp[i] == 1.0f;
+    expect_true("v3_image_tonemap_n filmic is monotonic in [0, 1]", mono);
+}
+
+static void test_image_parallel_matches_serial(void) {
+    enum { N = 200003 };
+    float *rgb = malloc(3 * (size_t)N * sizeof(float));
+    float *tm = malloc(3 * (size_t)N * sizeof(float));
+    uint8_t *a = malloc(3 * (size_t)N), *b = malloc(3 * (size_t)N);
+    fill_random(rgb, 3 * (size_t)N, 5);
+    for (size_t i = 0; i < 3 * (size_t)N; i++) rgb[i] = fabsf(rgb[i]) * 3.0f;
+
+    v3_pool *pool = v3_pool_create(3);
+    v3_image_to_srgb8(a, rgb, N, 0.8f, V3_TONEMAP_FILMIC, pool);
+    v3_image_tonemap_n(tm, rgb, N, 0.8f, V3_TONEMAP_FILMIC);
+    v3_image_srgb8_n(b, tm, N);
+    expect_true("v3_image_to_srgb8 pooled equals tonemap + srgb8", memcmp(a, b, 3 * (size_t)N) == 0);
+    v3_pool_destroy(pool);
+    free(rgb);
+    free(tm);
+    free(a);
+    free(b);
+}
+
+static void test_image_writers(void) {
+    char path[] = "/tmp/v3imageXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        expect_true("image writer temp file", false);
+        return;
+    }
+    close(fd);
+    uint8_t px[2 * 2 * 3] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    char buf[64];
+    expect_true("v3_image_write_ppm succeeds", v3_image_write_ppm(path, px, 2, 2));
+    FILE *f = fopen(path, "rb");
+    size_t n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    expect_true("v3_image_write_ppm header and data",
+                n == 11 + 12 && memcmp(buf, "P6\n2 2\n255\n", 11) == 0 && memcmp(buf + 11, px, 12) == 0);
+
+    float rows[2 * 1 * 3] = {1, 2, 3, 4, 5, 6};  // width 1, height 2
+    expect_true("v3_image_write_pfm succeeds", v3_image_write_pfm(path, rows, 1, 2));
+    f = fopen(path, "rb");
+    n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    float back[6];
+    memcpy(back, buf + 12, sizeof(back));
+    expect_true("v3_image_write_pfm header and bottom-up rows",
+                n == 12 + 24 && memcmp(buf, "PF\n1 2\n-1.0\n", 12) == 0 &&
+                back[0] == 4 && back[2] == 6 && back[3] == 1 && back[5] == 3);
+    unlink(path);
+}
+
+static const char *k_scene =
+    "# test scene\n"
+    "image 32 24\n"
+    "depth 3\n"
+    "samples 2\n"
+    "exposure 1.5\n"
+    "tonemap filmic\n"
+    "background 0.1 0.2 0.3\n"
+    "camera pos 0 0 5 look 0 0 0 up 0 1 0 fov 40\n"
+    "material red diffuse 1 0 0\n"
+    "material glass transmit 0.9 ior 1.5 reflect 0.1\n"
+    "light pos 0 5 5 color 1 1 1\n"
+    "sphere center 0 0 0 radius 1 material red\n"
+    "sphere center 3 0 0 radius 0.5 material glass   # trailing comment\n"
+    "plane point 0 -1 0 normal 0 2 0 material red\n"
+    "triangle -1 -1 -3 1 -1 -3 0 1 -3 material glass\n";
+
+static void scene_destroy(void *scene) {
+    v3_scene_free(scene);
+    free(scene);
+}
+
+static bool parse_string(v3_scene *scene, const char *text) {
+    FILE *f = tmpfile();
+    if (f == NULL) return false;
+    fputs(text, f);
+    rewind(f);
+    bool ok = v3_scene_parse(scene, f, "test");
+    fclose(f);
+    return ok;
+}
+
+static void test_scene_parse(void) {
+    v3_scene scene;
+    bool ok = parse_string(&scene, k_scene);
+    expect_true("v3_scene_parse accepts scene", ok);
+    if (!ok) return;
+    expect_true("v3_scene_parse image/depth", scene.width == 32 && scene.height == 24 && scene.max_depth == 3 &&
+                                               scene.samples == 2);
+    expect_true("v3_scene_parse exposure/tonemap", scene.exposure == 1.5f && scene.tonemap == V3_TONEMAP_FILMIC);
+    expect_true("v3_scene_parse counts",
+                scene.material_count == 2 && scene.sphere_count == 2 && scene.plane_count == 1 &&
+                scene.tri_count == 1 && scene.light_count == 1);
+    expect_true("v3_scene_parse material refs",
+                scene.spheres[0].material == 0 && scene.spheres[1].material == 1 && scene.tri_materials[0] == 1);
+    expect_float("v3_scene_parse material ior", scene.materials[1].ior, 1.5f, 0.0f);
+    float up[3] = {0, 1, 0};
+    expect_true("v3_scene_parse normalizes plane normal", v3_equals(scene.planes[0].normal, up, 1e-6f));
+    expect_true("v3_scene_parse builds BVH", scene.bvh.prim_count == 3);
+    v3_scene_free(&scene);
+
+    const char *bad[] = {
+        "sphere center 0 0 0 radius 1 material nope\n",
+        "material m\nsphere center 0 0 radius 1 material m\n",
+        "image 10\n",
+        "frobnicate 1 2 3\n",
+        "material m reflect 0.8 transmit 0.8\n",
+    };
+    bool all_rejected = true;
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        all_rejected &= !parse_string(&scene, bad[i]);
+    }
+    expect_true("v3_scene_parse rejects malformed scenes", all_rejected);
+}
+
+static void test_scene_binary_roundtrip(void) {
+    v3_scene text, bin;
+    if (!parse_string(&text, k_scene)) {
+        expect_true("binary scene source parses", false);
+        return;
+    }
+    char path[] = "/tmp/v3tracetestXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        expect_true("binary scene temp file", false);
+        v3_scene_free(&text);
+        return;
+    }
+    close(fd);
+
+    expect_true("v3_scene_save_binary succeeds", v3_scene_save_binary(&text, path));
+    bool ok = v3_scene_load(&bin, path);
+    expect_true("v3_scene_load detects and maps binary scene", ok && bin.mapping != NULL);
+    if (ok) {
+        expect_true("binary scene arrays are 64-byte aligned",
+                    ((uintptr_t)bin.spheres % 64) == 0 && ((uintptr_t)bin.tris % 64) == 0 &&
+                    ((uintptr_t)bin.bvh.nodes % 64) == 0);
+        expect_true("binary scene matches text scene",
+                    bin.width == text.width && bin.samples == text.samples &&
+                    bin.sphere_count == text.sphere_count && bin.tri_count == text.tri_count &&
+                    bin.bvh.node_count == text.bvh.node_count &&
+                    memcmp(bin.spheres, text.spheres, text.sphere_count * sizeof(v3_sphere)) == 0 &&
+                    memcmp(bin.tris, text.tris, text.tri_count * sizeof(v3_tri_wt)) == 0 &&
+                    memcmp(bin.materials, text.materials, text.material_count * sizeof(v3_material)) == 0 &&
+                    memcmp(bin.bvh.nodes, text.bvh.nodes, text.bvh.node_count * sizeof(v3_bvh_node)) == 0);
+
+        size_t n = (size_t)text.width * text.height * 3;
+        float *a = malloc(n * sizeof(float)), *b = malloc(n * sizeof(float));
+        v3_trace_render(&text, NULL, a, NULL);
+        v3_trace_render(&bin, NULL, b, NULL);
+        expect_true("binary scene renders identically", memcmp(a, b, n * sizeof(float)) == 0);
+        free(a);
+        free(b);
+
+        // rebuilding the BVH of a mapped scene replaces it with a heap copy
+        expect_true("v3_scene_build_bvh on mapped scene", v3_scene_build_bvh(&bin));
+        v3_scene_free(&bin);
+    }
+
+    // corrupt the last BVH prim index: the loader must refuse the file
+    FILE *f = fopen(path, "r+b");
+    fseek(f, 0, SEEK_END);
+    long end = ftell(f);
+    long last = -1;
+    uint32_t bad = 0xffffu;
+    // without meshes or instances the prims are the last non-empty section;
+    // find the last non-padding word
+    for (long off = end - 4; off >= 0; off -= 4) {
+        uint32_t w;
+        fseek(f, off, SEEK_SET);
+        if (fread(&w, 4, 1, f) == 1 && w != 0) {
+            last = off;
+            break;
+        }
+    }
+    if (last >= 0) {
+        fseek(f, last, SEEK_SET);
+        fwrite(&bad, 4, 1, f);
+    }
+    fclose(f);
+    expect_true("v3_scene_load_binary rejects corrupt BVH", last >= 0 && !v3_scene_load_binary(&bin, path));
+
+    // and a truncated file
+    f = fopen(path, "r+b");
+    ok = f != NULL && ftruncate(fileno(f), end / 2) == 0;
+    if (f) fclose(f);
+    expect_true("v3_scene_load_binary rejects truncated file", ok && !v3_scene_load_binary(&bin, path));
+
+    unlink(path);
+    v3_scene_free(&text);
+}
+
+static void test_render_small(void) {
+    v3_scene scene;
+    if (!parse_string(&scene, k_scene)) {
+        expect_true("v3_trace_render scene", false);
+        return;
+    }
+    float *rgb = malloc((size_t)scene.width * scene.height * 3 * sizeof(float));
+    v3_pool *pool = v3_pool_create(2);
+    v3_trace_stats stats;
+    expect_true("v3_trace_render succeeds", v3_trace_render(&scene, pool, rgb, &stats));
+
+    // centre pixel sees the red sphere, the top-left corner sees the sky
+    float *c = rgb + 3 * ((size_t)(scene.height / 2) * scene.width + scene.width / 2);
+    expect_true("v3_trace_render centre is lit red", c[0] > 0.3f && c[1] < 0.05f && c[2] < 0.05f);
+    expect_true("v3_trace_render corner is background", v3_equals(rgb, scene.background, 0.0f));
+    expect_true("v3_trace_render counts rays", stats.rays >= (uint64_t)scene.width * scene.height);
+
+    // pool size must not change the image
+    float *rgb1 = malloc((size_t)scene.width * scene.height * 3 * sizeof(float));
+    v3_pool *single = v3_pool_create(1);
+    v3_trace_render(&scene, single, rgb1, NULL);
+    expect_true("v3_trace_render deterministic across pools",
+                memcmp(rgb, rgb1, (size_t)scene.width * scene.height * 3 * sizeof(float)) == 0);
+
+    // a ray into the glass sphere refracts and exits the far side
+    float orig[3] = {3, 0, 5}, dir[3] = {0, 0, -1};
+    v3_hit h;
+    expect_true("v3_trace_intersect front of glass sphere",
+                v3_trace_intersect(&scene, orig, dir, INFINITY, &h) && !h.inside && fabsf(h.t - 4.5f) < 1e-4f);
+    float inner[3] = {3, 0, 0};
+    expect_true("v3_trace_intersect from inside flips normal",
+                v3_trace_intersect(&scene, inner, dir, INFINITY, &h) && h.inside && h.n[2] > 0.99f);
+
+    // per-tile times: one value per tile, the image unchanged
+    v3_hist_group tiles;
+    v3_hist all;
+    size_t tile_count = (size_t)((scene.width + V3_TRACE_TILE - 1) / V3_TRACE_TILE) *
+                        ((scene.height + V3_TRACE_TILE - 1) / V3_TRACE_TILE);
+    if (v3_hist_group_init(&tiles, pool) && v3_hist_init(&all)) {
+        bool ok = v3_trace_render_timed(&scene, pool, rgb1, NULL, &tiles);
+        v3_hist_group_merge(&all, &tiles);
+        expect_true("v3_trace_render_timed records every tile",
+                    ok && all.total == tile_count && all.min > 0 &&
+                    memcmp(rgb, rgb1, (size_t)scene.width * scene.height * 3 * sizeof(float)) == 0);
+        expect_true("v3_trace_render_timed rejects another pool's histograms",
+                    !v3_trace_render_timed(&scene, single, rgb1, NULL, &tiles));
+        v3_hist_free(&all);
+        v3_hist_group_free(&tiles);
+    }
+
+    v3_pool_destroy(single);
+    v3_pool_destroy(pool);
+    free(rgb1);
+    free(rgb);
+    v3_scene_free(&scene);
+}
+
+// RCU versions are never freed while a test runs: destroy only marks them,
+// so a reader that could see a destroyed version is detected, not UB
+typedef struct {
+    atomic_int alive;
+    int id;
+    int payload[64];
+} rcu_version;
+
+static atomic_int g_rcu_destroyed;
+
+static void rcu_version_destroy(void *p) {
+    atomic_store(&((rcu_version *)p)->alive, 0);
+    atomic_fetch_add(&g_rcu_destroyed, 1);
+}
+
+typedef struct {
+    v3_rcu *rcu;
+    atomic_bool *stop;
+    int reads, torn;
+} rcu_reader_ctx;
+
+static void *rcu_reader(void *arg) {
+    rcu_reader_ctx *c = arg;
+    int me = v3_rcu_register(c->rcu);
+    while (!atomic_load(c->stop)) {
+        rcu_version *v = v3_rcu_read_lock(c->rcu, me);
+        bool whole = atomic_load(&v->alive) == 1;
+        for (int i = 0; i < 64; i++) whole &= v->payload[i] == v->id;
+        whole &= atomic_load(&v->alive) == 1;
+        v3_rcu_read_unlock(c->rcu, me);
+        c->torn += !whole;
+        c->reads++;
+    }
+    v3_rcu_unregister(c->rcu, me);
+    return NULL;
+}
+
+static void test_rcu_snapshots(void) {
+    enum { VERSIONS = 300, READERS = 3 };
+    rcu_version *versions = calloc(VERSIONS, sizeof(rcu_version));
+    for (int i = 0; i < VERSIONS; i++) {
+        atomic_init(&versions[i].alive, 1);
+        versions[i].id = i;
+        for (int k = 0; k < 64; k++) versions[i].payload[k] = i;
+    }
+    atomic_store(&g_rcu_destroyed, 0);
+    v3_rcu *rcu = v3_rcu_create(&versions[0], rcu_version_destroy, 4);
+
+    // a reader inside its critical section holds back reclamation
+    int me = v3_rcu_register(rcu);
+    rcu_version *held = v3_rcu_read_lock(rcu, me);
+    v3_rcu_publish(rcu, &versions[1]);
+    v3_rcu_publish(rcu, &versions[2]);
+    expect_true("v3_rcu keeps versions an active reader may hold",
+                held == &versions[0] && atomic_load(&held->alive) == 1 && v3_rcu_pending(rcu) == 2);
+    v3_rcu_read_unlock(rcu, me);
+    expect_true("v3_rcu_reclaim after the reader leaves", v3_rcu_reclaim(rcu) == 2 && v3_rcu_pending(rcu) == 0);
+    // a critical section entered after a publish does not block its reclaim
+    held = v3_rcu_read_lock(rcu, me);
+    v3_rcu_publish(rcu, &versions[3]);
+    expect_true("v3_rcu new reader sees the latest version", held == &versions[2]);
+    v3_rcu_read_unlock(rcu, me);
+    held = v3_rcu_read_lock(rcu, me);
+    v3_rcu_publish(rcu, &versions[4]);
+    expect_true("v3_rcu frees versions older than every reader",
+                held == &versions[3] && atomic_load(&versions[2].alive) == 0 && v3_rcu_pending(rcu) == 1);
+    v3_rcu_read_unlock(rcu, me);
+    v3_rcu_unregister(rcu, me);
+
+    int slots[4];
+    for (int i = 0; i < 4; i++) slots[i] = v3_rcu_register(rcu);
+    expect_true("v3_rcu_register runs out of slots", slots[3] >= 0 && v3_rcu_register(rcu) == -1);
+    for (int i = 0; i < 4; i++) v3_rcu_unregister(rcu, slots[i]);
+
+    // concurrent readers never see a torn or destroyed version
+    atomic_bool stop;
+    atomic_init(&stop, false);
+    pthread_t threads[READERS];
+    rcu_reader_ctx ctx[READERS];
+    for (int i = 0; i < READERS; i++) {
+        ctx[i] = (rcu_reader_ctx){rcu, &stop, 0, 0};
+        pthread_create(&threads[i], NULL, rcu_reader, &ctx[i]);
+    }
+    for (int i = 5; i < VERSIONS; i++) {
+        v3_rcu_publish(rcu, &versions[i]);
+        if (i % 16 == 0) sched_yield();
+    }
+    atomic_store(&stop, true);
+    int reads = 0, torn = 0;
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(threads[i], NULL);
+        reads += ctx[i].reads;
+        torn += ctx[i].torn;
+    }
+    v3_rcu_reclaim(rcu);
+    char name[96];
+    snprintf(name, sizeof(name), "v3_rcu concurrent readers see whole versions (%d reads)", reads);
+    expect_true(name, reads > 0 && torn == 0);
+    expect_true("v3_rcu reclaims every replaced version",
+                v3_rcu_pending(rcu) == 0 && atomic_load(&g_rcu_destroyed) == VERSIONS - 1);
+    v3_rcu_destroy(rcu);
+    expect_true("v3_rcu_destroy destroys the current version", atomic_load(&g_rcu_destroyed) == VERSIONS);
+    free(versions);
+
+    // scene snapshots: an edited copy is published, the original untouched
+    v3_scene *base = malloc(sizeof(v3_scene)), *next = malloc(sizeof(v3_scene));
+    if (!parse_string(base, k_scene)) {
+        expect_true("v3_scene_copy scene", false);
+        free(base);
+        free(next);
+        return;
+    }
+    expect_true("v3_scene_copy", v3_scene_copy(next, base) && next->spheres != base->spheres &&
+                memcmp(next->bvh.nodes, base->bvh.nodes, base->bvh.node_count * sizeof(v3_bvh_node)) == 0);
+    next->spheres[0].center[2] -= 2.0f;
+    v3_scene_build_bvh(next);
+    float orig[3] = {0, 0, 5}, dir[3] = {0, 0, -1};
+    v3_hit before, after;
+    bool hit_before = v3_trace_intersect(base, orig, dir, INFINITY, &before);
+    rcu = v3_rcu_create(base, scene_destroy, 0);
+    int reader = v3_rcu_register(rcu);
+    v3_scene *snap = v3_rcu_read_lock(rcu, reader);
+    v3_rcu_publish(rcu, next);
+    bool same = v3_trace_intersect(snap, orig, dir, INFINITY, &after) && after.t == before.t;
+    v3_rcu_read_unlock(rcu, reader);
+    snap = v3_rcu_read_lock(rcu, reader);
+    bool moved = v3_trace_intersect(snap, orig, dir, INFINITY, &after) && after.t > before.t + 1.0f;
+    v3_rcu_read_unlock(rcu, reader);
+    expect_true("v3_rcu scene snapshot stays intact across a publish", hit_before && same);
+    expect_true("v3_rcu readers see the published scene", snap == next && moved);
+    v3_rcu_unregister(rcu, reader);
+    v3_rcu_destroy(rcu);
+}
+
+static void test_query_server(void) {
+    v3_scene scene;
+    if (!parse_string(&scene, k_scene)) {
+        expect_true("v3_server scene", false);
+        return;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/v3tracetest-%ld.sock", (long)getpid());
+    v3_pool *pool = v3_pool_create(2);
+    v3_server *server = v3_server_start(&scene, path, pool);
+    expect_true("v3_server_start", server != NULL);
+    if (server == NULL) {
+        v3_pool_destroy(pool);
+        v3_scene_free(&scene);
+        return;
+    }
+
+    // 100 rays through a 3 x 16 ray ring: batches wrap around the slots
+    enum { N = 100 };
+    v3_query_ray rays[N];
+    v3_query_hit hits[N];
+    float rnd[3 * N];
+    fill_random(rnd, 3 * N, 68);
+    for (int i = 0; i < N; i++) {
+        float o[3] = {0, 1, 5}, d[3] = {rnd[3 * i], rnd[3 * i + 1], rnd[3 * i + 2] - 1.0f};
+        memcpy(rays[i].orig, o, sizeof(o));
+        memcpy(rays[i].dir, d, sizeof(d));
+        rays[i].t_max = i % 10 == 0 ? 2.0f : INFINITY;
+    }
+    v3_client *c = v3_client_connect(path, 3, 16);
+    expect_true("v3_client_connect", c != NULL && v3_client_slots(c) == 3 && v3_client_slot_rays(c) == 16);
+    long found = v3_client_cast(c, rays, N, hits);
+    int expected = 0;
+    bool same = true;
+    for (int i = 0; i < N; i++) {
+        v3_hit h;
+        bool hit = v3_trace_intersect(&scene, rays[i].orig, rays[i].dir, rays[i].t_max, &h);
+        expected += hit;
+        if (hit) {
+            uint32_t flags = V3_QUERY_HIT | (h.inside ? V3_QUERY_INSIDE : 0u);
+            same &= hits[i].flags == flags && hits[i].t == h.t && hits[i].material == h.material &&
+                    memcmp(hits[i].n, h.n, sizeof(h.n)) == 0;
+        } else {
+            same &= hits[i].flags == 0;
+        }
+    }
+    expect_true("v3_client_cast matches v3_trace_intersect", found == expected && expected > 0 && same);
+
+    // two clients with batches in flight at once; each completes in order
+    v3_client *c2 = v3_client_connect(path, 2, 8);
+    memcpy(v3_client_rays(c2, 1), rays, 8 * sizeof(v3_query_ray));
+    memcpy(v3_client_rays(c, 2), rays + 8, 4 * sizeof(v3_query_ray));
+    memcpy(v3_client_rays(c, 0), rays, 8 * sizeof(v3_query_ray));
+    bool submitted = v3_client_submit(c2, 1, 8) && v3_client_submit(c, 2, 4) && v3_client_submit(c, 0, 8);
+    unsigned h1, h2, h3;
+    int s1 = v3_client_wait(c, &h1), s2 = v3_client_wait(c, &h2), s3 = v3_client_wait(c2, &h3);
+    expect_true("v3_client batches complete in submission order",
+                submitted && s1 == 2 && s2 == 0 && s3 == 1 && h2 == h3 &&
+                memcmp(v3_client_hits(c, 2), hits + 8, 4 * sizeof(v3_query_hit)) == 0 &&
+                memcmp(v3_client_hits(c2, 1), hits, 8 * sizeof(v3_query_hit)) == 0);
+    expect_true("v3_client rejects invalid batches",
+                !v3_client_submit(c, 3, 1) && !v3_client_submit(c, 0, 17) && v3_client_wait(c, NULL) == -1);
+
+    v3_server_stats stats;
+    v3_server_get_stats(server, &stats);
+    expect_true("v3_server_get_stats", stats.clients == 2 && stats.batches == 10 && stats.rays == N + 20);
+    v3_client_close(c2);
+    v3_server_stop(server);
+    // the server is gone: a connected client fails instead of hanging
+    expect_true("v3_client fails once the server stops", v3_client_cast(c, rays, 1, hits) == -1);
+    v3_client_close(c);
+    expect_true("v3_server_stop removes the socket", access(path, F_OK) != 0);
+    expect_true("v3_client_connect without server", v3_client_connect(path, 1, 1) == NULL);
+    v3_pool_destroy(pool);
+    v3_scene_free(&scene);
+}
+
+// random spheres and triangles above a floor plane, for shadow-ray queries
+static bool occlusion_scene(v3_scene *scene) {
+    enum { SPHERES = 300, TRIS = 100 };
+    size_t cap = 128 * (SPHERES + TRIS) + 256;
+    char *text = malloc(cap);
+    float rnd[9 * TRIS + 4 * SPHERES];
+    if (text == NULL) return false;
+    fill_random(rnd, sizeof(rnd) / sizeof(rnd[0]), 72);
+    int len = snprintf(text, cap, "material m diffuse 1 1 1\nplane point 0 -10 0 normal 0 1 0 material m\n");
+    for (int i = 0; i < SPHERES; i++) {
+        const float *r = rnd + 4 * i;
+        len += snprintf(text + len, cap - len, "sphere center %g %g %g radius %g material m\n", 8 * r[0],
+                        8 * r[1], 8 * r[2], 0.3 + 0.25 * r[3]);
+    }
+    for (int i = 0; i < TRIS; i++) {
+        const float *r = rnd + 4 * SPHERES + 9 * i;
+        len += snprintf(text + len, cap - len, "triangle %g %g %g %g %g %g %g %g %g material m\n", 8 * r[0],
+                        8 * r[1], 8 * r[2], 8 * r[0] + r[3], 8 * r[1] + r[4], 8 * r[2] + r[5],
+                        8 * r[0] + r[6], 8 * r[1] + r[7], 8 * r[2] + r[8]);
+    }
+    bool ok = parse_string(scene, text);
+    free(text);
+    return ok;
+}
+
+static void test_occlusion_queries(void) {
+    v3_scene scene;
+    if (!occlusion_scene(&scene)) {
+        expect_true("occlusion scene", false);
+        return;
+    }
+    enum { N = 2500 };   // three stream chunks, the last one partial
+    v3_ray_soa rays;
+    float *t_max = malloc(N * sizeof(float)), *rnd = malloc(6 * N * sizeof(float));
+    uint8_t *ref = malloc(N), *packet = malloc(N), *stream = malloc(N);
+    if (!v3_ray_soa_alloc(&rays, N) || t_max == NULL || rnd == NULL || ref == NULL || packet == NULL || stream == NULL) {
+        expect_true("occlusion allocation", false);
+        return;
+    }
+    fill_random(rnd, 6 * N, 73);
+    size_t expected = 0;
+    bool single_ok = true;
+    for (int i = 0; i < N; i++) {
+        float *r = rnd + 6 * i;
+        float o[3] = {10 * r[0], 10 * r[1], 10 * r[2]}, d[3] = {r[3], r[4], r[5]};
+        v3_normalize(d, d);
+        rays.ox[i] = o[0]; rays.oy[i] = o[1]; rays.oz[i] = o[2];
+        rays.dx[i] = d[0]; rays.dy[i] = d[1]; rays.dz[i] = d[2];
+        t_max[i] = i % 3 == 0 ? INFINITY : 1.0f + 6.0f * (r[0] + 1.0f);
+        v3_hit h;
+        ref[i] = v3_trace_intersect(&scene, o, d, t_max[i], &h);
+        expected += ref[i];
+        single_ok &= v3_trace_occluded(&scene, o, d, t_max[i]) == ref[i];
+    }
+    expect_true("v3_trace_occluded matches v3_trace_intersect", single_ok && expected > N / 10 && expected < N);
+
+    // packets of every size up to V3_BVH_PACKET, including partial SSE groups
+    size_t found = 0;
+    for (size_t first = 0, n = 1; first < N; first += n, n = n % V3_BVH_PACKET + 1) {
+        if (n > N - first) n = N - first;
+        v3_ray_soa sub = {rays.ox + first, rays.oy + first, rays.oz + first,
+                          rays.dx + first, rays.dy + first, rays.dz + first};
+        found += v3_trace_occluded_packet(&scene, &sub, t_max + first, n, packet + first);
+    }
+    expect_true("v3_trace_occluded_packet matches", found == expected && memcmp(packet, ref, N) == 0);
+
+    v3_pool *pool = v3_pool_create(2);
+    found = v3_trace_occluded_n(&scene, pool, &rays, t_max, N, stream);
+    expect_true("v3_trace_occluded_n matches", found == expected && memcmp(stream, ref, N) == 0);
+    v3_pool_destroy(pool);
+
+    v3_ray_soa_free(&rays);
+    free(t_max);
+    free(rnd);
+    free(ref);
+    free(packet);
+    free(stream);
+    v3_scene_free(&scene);
+}
+
+// a two-material triangle soup instanced with rotations, non-uniform and
+// mirroring scales, and the same triangles flattened into world space
+static bool instance_scenes(v3_scene *inst, v3_scene *flat) {
+    enum { TRIS = 40, COPIES = 12 };
+    size_t cap = 160 * (TRIS + COPIES * TRIS) + 512;
+    char *text = malloc(cap), *ftext = malloc(cap);
+    float rnd[9 * TRIS];
+    if (text == NULL || ftext == NULL) {
+        free(text);
+        free(ftext);
+        return false;
+    }
+    fill_random(rnd, 9 * TRIS, 81);
+    const char *head = "material a diffuse 1 0 0\nmaterial b diffuse 0 1 0\n"
+                       "sphere center 0 -3 0 radius 1 material a\nplane point 0 -12 0 normal 0 1 0 material b\n";
+    int len = snprintf(text, cap, "%smesh soup\n", head);
+    for (int i = 0; i < TRIS; i++) {
+        const float *r = rnd + 9 * i;
+        len += snprintf(text + len, cap - len, "triangle %g %g %g %g %g %g %g %g %g material %s\n", r[0],
+                        r[1], r[2], r[0] + 0.5 * r[3], r[1] + 0.5 * r[4], r[2] + 0.5 * r[5], r[0] + 0.5 * r[6],
+                        r[1] + 0.5 * r[7], r[2] + 0.5 * r[8], i % 2 ? "b" : "a");
+    }
+    len += snprintf(text + len, cap - len, "end\n");
+    for (int c = 0; c < COPIES; c++) {
+        len += snprintf(text + len, cap - len,
+                        "instance soup scale %g %g %g rotate %d 1 %d %d translate %d %d %d\n",
+                        c % 3 == 2 ? -1.0 : 1.0 + 0.25 * (c % 4), 1.0 + 0.5 * (c % 2), 0.75, c % 2, c % 3,
+                        30 * c, 4 * (c % 4) - 6, c % 2 ? 2 : -2, 4 * (c / 4) - 4);
+    }
+    bool ok = parse_string(inst, text);
+    if (ok) {
+        // flatten with the parsed transforms so both scenes hold the same triangles
+        len = snprintf(ftext, cap, "%s", head);
+        for (size_t c = 0; c < inst->instance_count; c++) {
+            for (int i = 0; i < TRIS; i++) {
+                v3_tri_wt *t = &inst->mesh_tris[i];
+                float v[3][3];
+                v3_transform_point(v[0], inst->instances[c].to_world, t->v0);
+                v3_transform_point(v[1], inst->instances[c].to_world, t->v1);
+                v3_transform_point(v[2], inst->instances[c].to_world, t->v2);
+                len += snprintf(ftext + len, cap - len, "triangle %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g "
+                                "material %s\n", v[0][0], v[0][1], v[0][2], v[1][0], v[1][1], v[1][2],
+                                v[2][0], v[2][1], v[2][2], i % 2 ? "b" : "a");
+            }
+        }
+        ok = parse_string(flat, ftext);
+        if (!ok) v3_scene_free(inst);
+    }
+    free(text);
+    free(ftext);
+    return ok;
+}
+
+static void test_instances(void) {
+    v3_scene scene, flat, copy;
+    if (!instance_scenes(&scene, &flat)) {
+        expect_true("instance scenes parse", false);
+        return;
+    }
+    expect_true("instances share one mesh",
+                scene.mesh_count == 1 && scene.instance_count == 12 && scene.mesh_tri_count == 40 &&
+                scene.tri_count == 0 && flat.tri_count == 480 && scene.bvh.prim_count == 13);
+
+    enum { N = 2000 };
+    v3_ray_soa rays;
+    float *t_max = malloc(N * sizeof(float)), *rnd = malloc(6 * N * sizeof(float));
+    uint8_t *ref = malloc(N), *packet = malloc(N), *stream = malloc(N);
+    if (!v3_ray_soa_alloc(&rays, N) || t_max == NULL || rnd == NULL || ref == NULL || packet == NULL ||
+        stream == NULL) {
+        expect_true("instance allocation", false);
+        return;
+    }
+    fill_random(rnd, 6 * N, 82);
+    size_t hits = 0, expected = 0;
+    int mismatches = 0;
+    bool single_ok = true;
+    for (int i = 0; i < N; i++) {
+        float *r = rnd + 6 * i;
+        float o[3] = {12 * r[0], 12 * r[1], 12 * r[2]}, d[3] = {r[3], r[4], r[5]};
+        v3_normalize(d, d);
+        rays.ox[i] = o[0]; rays.oy[i] = o[1]; rays.oz[i] = o[2];
+        rays.dx[i] = d[0]; rays.dy[i] = d[1]; rays.dz[i] = d[2];
+        t_max[i] = i % 3 == 0 ? INFINITY : 2.0f + 8.0f * (r[0] + 1.0f);
+        v3_hit a, b;
+        bool ha = v3_trace_intersect(&scene, o, d, t_max[i], &a);
+        bool hb = v3_trace_intersect(&flat, o, d, t_max[i], &b);
+        // edge hits may go either way after the transform round trip
+        if (ha != hb || (ha && (fabsf(a.t - b.t) > 1e-3f * b.t || a.material != b.material ||
+                                a.inside != b.inside || v3_dot_product(a.n, b.n) < 0.9999f))) {
+            mismatches++;
+        }
+        hits += ha;
+        ref[i] = ha;
+        expected += ha;
+        single_ok &= v3_trace_occluded(&scene, o, d, t_max[i]) == ha;
+    }
+    expect_true("instanced scene matches flattened triangles", mismatches <= 2 && hits > N / 10 && hits < N);
+    expect_true("v3_trace_occluded on instances matches v3_trace_intersect", single_ok);
+
+    size_t found = 0;
+    for (size_t first = 0, n = 1; first < N; first += n, n = n % V3_BVH_PACKET + 1) {
+        if (n > N - first) n = N - first;
+        v3_ray_soa sub = {rays.ox + first, rays.oy + first, rays.oz + first,
+                          rays.dx + first, rays.dy + first, rays.dz + first};
+        found += v3_trace_occluded_packet(&scene, &sub, t_max + first, n, packet + first);
+    }
+    expect_true("v3_trace_occluded_packet on instances matches", found == expected && memcmp(packet, ref, N) == 0);
+    v3_pool *pool = v3_pool_create(2);
+    found = v3_trace_occluded_n(&scene, pool, &rays, t_max, N, stream);
+    expect_true("v3_trace_occluded_n on instances matches", found == expected && memcmp(stream, ref, N) == 0);
+    v3_pool_destroy(pool);
+
+    // binary round trip and deep copy keep meshes and instances
+    char path[] = "/tmp/v3tracetestXXXXXX";
+    int fd = mkstemp(path);
+    v3_scene bin;
+    bool saved = fd >= 0 && v3_scene_save_binary(&scene, path);
+    if (fd >= 0) close(fd);
+    bool loaded = saved && v3_scene_load(&bin, path);
+    bool copied = v3_scene_copy(&copy, &scene);
+    expect_true("instanced scene saves, loads and copies", loaded && copied);
+    if (loaded && copied) {
+        bool same = bin.instance_count == scene.instance_count && bin.mesh_node_count == scene.mesh_node_count;
+        for (int i = 0; i < N; i += 7) {
+            float o[3] = {rays.ox[i], rays.oy[i], rays.oz[i]}, d[3] = {rays.dx[i], rays.dy[i], rays.dz[i]};
+            v3_hit a, b, c;
+            bool ha = v3_trace_intersect(&scene, o, d, t_max[i], &a);
+            same &= v3_trace_intersect(&bin, o, d, t_max[i], &b) == ha;
+            same &= v3_trace_intersect(&copy, o, d, t_max[i], &c) == ha;
+            if (ha) same &= a.t == b.t && a.t == c.t && a.material == b.material && a.material == c.material;
+        }
+        expect_true("binary and copied instanced scenes trace identically", same);
+        expect_true("v3_scene_add_instance refuses mapped scenes",
+                    !v3_scene_add_instance(&bin, 0, scene.instances[0].to_world));
+    }
+    if (loaded) v3_scene_free(&bin);
+    if (copied) v3_scene_free(&copy);
+    if (fd >= 0) unlink(path);
+
+    // instances added through the API take part after a rebuild: aim at
+    // the centroid of the first mesh triangle, moved up by 40
+    float m[12] = {1, 0, 0, 0,  0, 1, 0, 40,  0, 0, 1, 0}, singular[12] = {0};
+    v3_tri_wt *t0 = &scene.mesh_tris[0];
+    float o[3], d[3] = {0, 0, -1};
+    for (int k = 0; k < 3; k++) o[k] = (t0->v0[k] + t0->v1[k] + t0->v2[k]) / 3.0f;
+    o[1] += 40.0f;
+    o[2] += 10.0f;
+    v3_hit h;
+    bool before = v3_trace_intersect(&scene, o, d, INFINITY, &h);
+    bool ok = v3_scene_add_instance(&scene, 0, m) && v3_scene_build_bvh(&scene);
+    bool after = v3_trace_intersect(&scene, o, d, INFINITY, &h);
+    expect_true("v3_scene_add_instance extends the scene",
+                ok && !before && after && scene.instance_count == 13 && scene.bvh.prim_count == 14);
+    expect_true("v3_scene_add_instance rejects singular transforms and unknown meshes",
+                !v3_scene_add_instance(&scene, 0, singular) && !v3_scene_add_instance(&scene, 1, m));
+
+    // a copy holds exact arrays; adding to it grows them by doubling and a
+    // rejected mesh leaves the counts alone
+    v3_scene grown;
+    if (v3_scene_copy(&grown, &scene)) {
+        float verts[9];
+        memcpy(verts, t0->v0, sizeof(t0->v0));
+        memcpy(verts + 3, t0->v1, sizeof(t0->v1));
+        memcpy(verts + 6, t0->v2, sizeof(t0->v2));
+        size_t tris = grown.mesh_tri_count, nodes = grown.mesh_node_count, insts = grown.instance_count;
+        uint32_t bad = (uint32_t)grown.material_count, mat = 0;
+        bool rejected = !v3_scene_add_mesh(&grown, "bad", verts, &bad, 1) && grown.mesh_count == 1 &&
+                        grown.mesh_tri_count == tris && grown.mesh_node_count == nodes;
+        bool added = true;
+        for (int i = 0; i < 40 && added; i++) added = v3_scene_add_mesh(&grown, "tri", verts, &mat, 1);
+        for (int i = 0; i < 200 && added; i++) added = v3_scene_add_instance(&grown, (uint32_t)(1 + i % 40), m);
+        bool kept = added && memcmp(grown.instances, scene.instances, insts * sizeof(v3_instance)) == 0 &&
+                    grown.meshes[40].tri_first == tris + 39 && grown.instances[insts + 199].mesh == 1 + 199 % 40;
+        bool doubled = grown.mesh_cap >= 41 && grown.mesh_cap <= 2 * 41 && grown.instance_cap >= insts + 200 &&
+                       grown.instance_cap <= 2 * (insts + 200);
+        expect_true("v3_scene_add_mesh rejection leaves the scene unchanged", rejected);
+        expect_true("v3_scene_add_mesh/add_instance grow copied arrays by doubling",
+                    kept && doubled && grown.mesh_count == 41 && grown.instance_count == insts + 200 &&
+                    v3_scene_build_bvh(&grown) && v3_trace_intersect(&grown, o, d, INFINITY, &h));
+        v3_scene_free(&grown);
+    }
+
+    v3_ray_soa_free(&rays);
+    free(t_max);
+    free(rnd);
+    free(ref);
+    free(packet);
+    free(stream);
+    v3_scene_free(&scene);
+    v3_scene_free(&flat);
+
+    const char *bad[] = {
+        "end\n",
+        "material m\nmesh a\ntriangle 0 0 0 1 0 0 0 1 0 material m\n",
+        "material m\nmesh a\nend\n",
+        "material m\nmesh a\nsphere center 0 0 0 radius 1 material m\nend\n",
+        "material m\nmesh a\ntriangle 0 0 0 1 0 0 0 1 0 material m\nend\nmesh a\n",
+        "instance nope\n",
+        "material m\nmesh a\ntriangle 0 0 0 1 0 0 0 1 0 material m\nend\ninstance a scale 0 1 1\n",
+        "material m\nmesh a\ntriangle 0 0 0 1 0 0 0 1 0 material m\nend\ninstance a rotate 0 0 0 90\n",
+        "material m\nmesh a\ntriangle 0 0 0 1 0 0 0 1 0 material m\nend\ninstance a spin 1\n",
+    };
+    bool all_rejected = true;
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) all_rejected &= !parse_string(&scene, bad[i]);
+    expect_true("v3_scene_parse rejects malformed meshes and instances", all_rejected);
+}
+
+static float ref_box(const float *c, const float *h, float x, float y, float z) {
+    float q[3] = {fabsf(x - c[0]) - h[0], fabsf(y - c[1]) - h[1], fabsf(z - c[2]) - h[2]};
+    float o[3] = {fmaxf(q[0], 0.0f), fmaxf(q[1], 0.0f), fmaxf(q[2], 0.0f)};
+    return v3_length(o) + fminf(fmaxf(q[0], fmaxf(q[1], q[2])), 0.0f);
+}
+
+static void test_sdf_primitives(void) {
+    enum { N = 13 };   // not a multiple of the SIMD width
+    float px[N], py[N], pz[N], d[N], e[N], u[N];
+    fill_random(px, N, 61);
+    fill_random(py, N, 62);
+    fill_random(pz, N, 63);
+    for (int i = 0; i < N; i++) {
+        px[i] *= 3.0f;
+        py[i] *= 3.0f;
+        pz[i] *= 3.0f;
+    }
+    v3_soa3 p = {px, py, pz};
+    float c[3] = {0.5f, -0.25f, 0.1f}, half[3] = {1.0f, 0.5f, 0.75f};
+    float worst_sphere = 0, worst_box = 0, worst_stoporus = 0;
+    v3_sdf_sphere_soa(d, p, c, 1.25f, N);
+    v3_sdf_box_soa(e, p, c, half, N);
+    for (int i = 0; i < N; i++) {
+        float q[3] = {px[i] - c[0], py[i] - c[1], pz[i] - c[2]};
+        worst_sphere = fmaxf(worst_sphere, fabsf(d[i] - (v3_length(q) - 1.25f)));
+        worst_box = fmaxf(worst_box, fabsf(e[i] - ref_box(c, half, px[i], py[i], pz[i])));
+    }
+    v3_sdf_torus_soa(u, p, c, 2.0f, 0.5f, N);
+    for (int i = 0; i < N; i++) {
+        float q[3] = {px[i] - c[0], py[i] - c[1], pz[i] - c[2]};
+        float ring = sqrtf(q[0] * q[0] + q[2] * q[2]) - 2.0f;
+        worst_stoporus = fmaxf(worst_stoporus, fabsf(u[i] - (sqrtf(ring * ring + q[1] * q[1]) - 0.5f)));
+    }
+    expect_true("v3_sdf_sphere_soa matches the scalar distance", worst_sphere < 1e-5f);
+    expect_true("v3_sdf_box_soa matches the scalar distance", worst_box < 1e-5f);
+    expect_true("v3_sdf_torus_soa matches the scalar distance", worst_stoporus < 1e-5f);
+
+    // smooth union: never above the minimum, equal to it once the
+    // distances differ by at least k, and the plain minimum for k = 0
+    float k = 0.5f, m[N];
+    bool below = true, equal_far = true, plain = true;
+    v3_sdf_smooth_union_soa(m, d, e, 0.0f, N);
+    for (int i = 0; i < N; i++) plain &= m[i] == fminf(d[i], e[i]);
+    v3_sdf_smooth_union_soa(m, d, e, k, N);
+    for (int i = 0; i < N; i++) {
+        float lo = fminf(d[i], e[i]);
+        below &= m[i] <= lo + 1e-6f && m[i] >= lo - k / 4.0f - 1e-6f;
+        if (fabsf(d[i] - e[i]) >= k) equal_far &= fabsf(m[i] - lo) < 1e-6f;
+    }
+    expect_true("v3_sdf_smooth_union_soa with k = 0 is the minimum", plain);
+    expect_true("v3_sdf_smooth_union_soa stays within k/4 below the minimum", below);
+    expect_true("v3_sdf_smooth_union_soa is the minimum far from the seam", equal_far);
+
+    // the whole field is the same chain of unions
+    v3_sdf sdf;
+    v3_sdf_init(&sdf);
+    bool ok = v3_sdf_add_sphere(&sdf, c, 1.25f, 0.0f) && v3_sdf_add_box(&sdf, c, half, k) &&
+              v3_sdf_add_torus(&sdf, c, 2.0f, 0.5f, 0.0f);
+    expect_true("v3_sdf_add_* accept valid primitives", ok && sdf.count == 3);
+    v3_sdf_smooth_union_soa(m, d, e, k, N);
+    for (int i = 0; i < N; i++) m[i] = fminf(m[i], u[i]);
+    v3_sdf_eval_soa(&sdf, e, p, N);
+    bool same = true;
+    for (int i = 0; i < N; i++) same &= fabsf(e[i] - m[i]) < 1e-5f;
+    expect_true("v3_sdf_eval_soa matches the composed SoA calls", same);
+    expect_true("v3_sdf_add_* reject bad sizes",
+                !v3_sdf_add_sphere(&sdf, c, 0.0f, 0.0f) && !v3_sdf_add_torus(&sdf, c, 0.5f, 1.0f, 0.0f) &&
+                !v3_sdf_add_sphere(&sdf, c, 1.0f, -1.0f) && sdf.count == 3);
+    m[0] = 7.0f;
+    v3_sdf_sphere_soa(m, (v3_soa3){px, NULL, pz}, c, 1.0f, N);
+    v3_sdf_box_soa(m, p, c, NULL, N);
+    v3_sdf_torus_soa(NULL, p, c, 2.0f, 0.5f, N);
+    v3_sdf_smooth_union_soa(m, d, NULL, k, N);
+    expect_true("v3_sdf_*_soa reject NULL pointers", m[0] == 7.0f);
+    v3_sdf_free(&sdf);
+}
+
+static void test_sdf_march(void) {
+    enum { N = 37, MANY = 2500 };
+    v3_sdf sdf;
+    v3_sdf_init(&sdf);
+    float origin[3] = {0, 0, 0};
+    v3_sdf_add_sphere(&sdf, origin, 1.0f, 0.0f);
+
+    // a fan of rays from z = -5; the outer ones miss the unit sphere
+    v3_ray_soa rays;
+    v3_ray_soa_alloc(&rays, MANY);
+    float t[MANY], t_max[MANY], nx[MANY], ny[MANY], nz[MANY];
+    uint8_t hit[MANY];
+    for (int i = 0; i < N; i++) {
+        float d[3] = {(float)(i - N / 2) * 0.015f, 0.1f, 1.0f};
+        v3_normalize(d, d);
+        rays.ox[i] = 0.0f;
+        rays.oy[i] = 0.0f;
+        rays.oz[i] = -5.0f;
+        rays.dx[i] = d[0];
+        rays.dy[i] = d[1];
+        rays.dz[i] = d[2];
+        t_max[i] = 100.0f;
+    }
+    v3_soa3 n = {nx, ny, nz};
+    size_t hits = v3_sdf_march(&sdf, NULL, &rays, t_max, N, t, n, hit);
+    int expected = 0, wrong = 0;
+    float worst_stop = 0, worst_n = 0;
+    for (int i = 0; i < N; i++) {
+        // |o + t d|^2 = 1 with o = (0, 0, -5): t^2 - 10 dz t + 24 = 0
+        float b = 5.0f * rays.dz[i], disc = b * b - 24.0f;
+        bool want = disc >= 0.0f;
+        expected += want;
+        if (want != (hit[i] != 0)) {
+            wrong++;
+            continue;
+        }
+        if (!want) {
+            wrong += t[i] != t_max[i] || nx[i] != 0.0f || ny[i] != 0.0f || nz[i] != 0.0f;
+            continue;
+        }
+        float ta = b - sqrtf(disc);
+        float p[3] = {ta * rays.dx[i], ta * rays.dy[i], ta * rays.dz[i] - 5.0f};
+        // grazing rays stop short along the ray, but never past the
+        // surface and always within the tolerance of it
+        float q[3] = {t[i] * rays.dx[i], t[i] * rays.dy[i], t[i] * rays.dz[i] - 5.0f};
+        float residual = (v3_length(q) - 1.0f) / (sdf.eps * t[i]);
+        worst_stop = fmaxf(worst_stop, t[i] > ta + 1e-5f ? INFINITY : residual);
+        worst_n = fmaxf(worst_n, fmaxf(fabsf(nx[i] - p[0]), fmaxf(fabsf(ny[i] - p[1]), fabsf(nz[i] - p[2]))));
+    }
+    char name[96];
+    snprintf(name, sizeof(name), "v3_sdf_march hits the unit sphere (%zu of %d rays)", hits, N);
+    expect_true(name, wrong == 0 && hits == (size_t)expected && expected > 0 && expected < N);
+    expect_true("v3_sdf_march stops within eps of the sphere, never past it", worst_stop <= 1.0f);
+    expect_true("v3_sdf_march normals match the analytic sphere", worst_n < 1e-2f);
+
+    // t_max short of the surface, and a ray starting inside
+    t_max[0] = 3.0f;
+    rays.dx[0] = rays.dy[0] = 0.0f;
+    rays.dz[0] = 1.0f;
+    rays.oz[1] = 0.0f;
+    hits = v3_sdf_march(&sdf, NULL, &rays, t_max, 2, t, n, hit);
+    expect_true("v3_sdf_march respects t_max", !hit[0] && t[0] == 3.0f);
+    expect_true("v3_sdf_march hits at t = 0 from inside", hit[1] && t[1] == 0.0f && hits == 1);
+
+    // box face and torus top: axis-aligned normals
+    v3_sdf_free(&sdf);
+    v3_sdf_init(&sdf);
+    float half[3] = {1, 1, 1}, torus_c[3] = {10, 0, 0};
+    v3_sdf_add_box(&sdf, origin, half, 0.0f);
+    v3_sdf_add_torus(&sdf, torus_c, 2.0f, 0.5f, 0.0f);
+    float o2[2][3] = {{0.3f, 0.2f, -5.0f}, {12.0f, 5.0f, 0.0f}}, d2[2][3] = {{0, 0, 1}, {0, -1, 0}};
+    for (int i = 0; i < 2; i++) {
+        rays.ox[i] = o2[i][0];
+        rays.oy[i] = o2[i][1];
+        rays.oz[i] = o2[i][2];
+        rays.dx[i] = d2[i][0];
+        rays.dy[i] = d2[i][1];
+        rays.dz[i] = d2[i][2];
+        t_max[i] = 100.0f;
+    }
+    v3_sdf_march(&sdf, NULL, &rays, t_max, 2, t, n, hit);
+    expect_true("v3_sdf_march box face normal",
+                hit[0] && fabsf(t[0] - 4.0f) < 1e-3f && fabsf(nz[0] + 1.0f) < 1e-3f && fabsf(nx[0]) < 1e-3f);
+    expect_true("v3_sdf_march torus top normal",
+                hit[1] && fabsf(t[1] - 4.5f) < 1e-3f && fabsf(ny[1] - 1.0f) < 1e-3f && fabsf(nx[1]) < 1e-3f);
+
+    // the normals pass on its own agrees with the march
+    float px[2], py[2], pz[2], mx[2], my[2], mz[2];
+    for (int i = 0; i < 2; i++) {
+        px[i] = rays.ox[i] + t[i] * rays.dx[i];
+        py[i] = rays.oy[i] + t[i] * rays.dy[i];
+        pz[i] = rays.oz[i] + t[i] * rays.dz[i];
+    }
+    v3_sdf_normal_soa(&sdf, (v3_soa3){mx, my, mz}, (v3_soa3){px, py, pz}, 2);
+    expect_true("v3_sdf_normal_soa matches the march normals",
+                fabsf(mx[0] - nx[0]) < 1e-6f && fabsf(mz[0] - nz[0]) < 1e-6f && fabsf(my[1] - ny[1]) < 1e-6f);
+
+    // several chunks on a pool agree with the serial march
+    float *rnd = malloc(MANY * 3 * sizeof(float));
+    fill_random(rnd, MANY * 3, 67);
+    for (int i = 0; i < MANY; i++) {
+        float d[3] = {rnd[3 * i], rnd[3 * i + 1], rnd[3 * i + 2]};
+        v3_normalize(d, d);
+        rays.ox[i] = 0.0f;
+        rays.oy[i] = 3.0f;
+        rays.oz[i] = -6.0f;
+        rays.dx[i] = d[0];
+        rays.dy[i] = d[1];
+        rays.dz[i] = d[2];
+        t_max[i] = 50.0f;
+    }
+    free(rnd);
+    float t2[MANY], n2x[MANY], n2y[MANY], n2z[MANY];
+    uint8_t hit2[MANY];
+    v3_pool *pool = v3_pool_create(3);
+    hits = v3_sdf_march(&sdf, pool, &rays, t_max, MANY, t, n, hit);
+    size_t hits2 = v3_sdf_march(&sdf, NULL, &rays, t_max, MANY, t2, (v3_soa3){n2x, n2y, n2z}, hit2);
+    expect_true("v3_sdf_march on a pool matches the default pool",
+                hits == hits2 && hits > 0 && memcmp(t, t2, sizeof(t)) == 0 && memcmp(hit, hit2, sizeof(hit)) == 0 &&
+                memcmp(nx, n2x, sizeof(nx)) == 0);
+    hits2 = v3_sdf_march(&sdf, pool, &rays, t_max, MANY, t2, (v3_soa3){NULL, NULL, NULL}, hit2);
+    expect_true("v3_sdf_march without normals", hits2 == hits && memcmp(t, t2, sizeof(t)) == 0);
+    v3_pool_destroy(pool);
+    v3_ray_soa_free(&rays);
+    v3_sdf_free(&sdf);
+}
+
+static void test_progressive(void) {
+    v3_scene scene;
+    if (!parse_string(&scene, k_scene)) {
+        expect_true("v3_progressive scene", false);
+        return;
+    }
+    size_t pixels = (size_t)scene.width * scene.height;
+    float *rgb = malloc(pixels * 3 * sizeof(float));
+    float *ref = malloc(pixels * 3 * sizeof(float));
+    v3_pool *pool = v3_pool_create(3);
+    v3_progressive p;
+    expect_true("v3_progressive_init succeeds", v3_progressive_init(&p, &scene));
+    p.max_samples = 64;
+
+    bool full = true;
+    for (int i = 0; i < p.min_samples; i++) full &= v3_progressive_pass(&p, pool) == pixels;
+    expect_true("v3_progressive_pass samples every pixel until min_samples", full);
+
+    int passes = p.min_samples;
+    size_t last = pixels;
+    while (passes < 1000 && (last = v3_progressive_pass(&p, pool)) > 0) passes++;
+    expect_true("v3_progressive_pass converges", last == 0);
+
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (size_t i = 0; i < pixels; i++) {
+        lo = p.count[i] < lo ? p.count[i] : lo;
+        hi = p.count[i] > hi ? p.count[i] : hi;
+    }
+    expect_true("v3_progressive flat background stops at min_samples", p.count[0] == (uint32_t)p.min_samples);
+    expect_true("v3_progressive adapts sample counts", lo == (uint32_t)p.min_samples && hi > lo * 2 &&
+                                                           hi <= (uint32_t)p.max_samples);
+
+    // the converged image is close to a uniform 64 spp render
+    v3_progressive_resolve(&p, rgb);
+    scene.samples = 64;
+    v3_trace_render(&scene, pool, ref, NULL);
+    double err = 0.0;
+    for (size_t i = 0; i < pixels * 3; i++) err += (rgb[i] - ref[i]) * (rgb[i] - ref[i]);
+    err = sqrt(err / (double)(pixels * 3));
+    char name[96];
+    snprintf(name, sizeof(name), "v3_progressive matches reference (rms %.4f)", err);
+    expect_true(name, err < 0.02);
+
+    // pool size must not change the result
+    float *rgb1 = malloc(pixels * 3 * sizeof(float));
+    v3_pool *single = v3_pool_create(1);
+    expect_true("v3_progressive_reset succeeds", v3_progressive_reset(&p));
+    expect_true("v3_progressive_reset clears samples", p.count[5] == 0 && p.rays == 0);
+    while (v3_progressive_pass(&p, single) > 0) {
+    }
+    v3_progressive_resolve(&p, rgb1);
+    expect_true("v3_progressive deterministic across pools", memcmp(rgb, rgb1, pixels * 3 * sizeof(float)) == 0);
+
+    // a new size within the same tile grid still invalidates the buffers
+    int width = scene.width;
+    scene.width = width % V3_TRACE_TILE == 0 ? width - 1 : p.tiles_x * V3_TRACE_TILE;
+    expect_true("v3_progressive resize keeps the tile grid",
+                (scene.width + V3_TRACE_TILE - 1) / V3_TRACE_TILE == p.tiles_x);
+    expect_true("v3_progressive_reset rejects a resized scene", !v3_progressive_reset(&p));
+    p.tile_count = 1;
+    expect_true("v3_progressive_pass rejects a resized scene", v3_progressive_pass(&p, pool) == 0);
+    scene.width = width;
+    p.max_samples = p.min_samples - 1;
+    expect_true("v3_progressive_reset rejects max_samples < min_samples", !v3_progressive_reset(&p));
+    p.max_samples = 64;
+    int min_samples = p.min_samples;
+    p.min_samples = 1;
+    bool one = !v3_progressive_reset(&p) && v3_progressive_pass(&p, pool) == 0;
+    p.min_samples = -3;
+    expect_true("v3_progressive rejects min_samples < 2",
+                one && !v3_progressive_reset(&p) && v3_progressive_pass(&p, pool) == 0);
+    p.min_samples = min_samples;
+    expect_true("v3_progressive_reset after restoring the settings", v3_progressive_reset(&p));
+
+    v3_pool_destroy(single);
+    v3_pool_destroy(pool);
+    v3_progressive_free(&p);
+    free(rgb1);
+    free(ref);
+    free(rgb);
+    v3_scene_free(&scene);
+}
+
+int main(void) {
+    printf("=== v3tracetest: Ray Tracing Kernel Tests ===\n\n");
+
+    test_tri_precompute();
+    test_ray_tri_hits_and_misses();
+    test_watertight_shared_edge();
+    test_bvh_matches_brute_force();
+    test_bvh_refit();
+    test_wbvh_matches_bvh();
+    test_bvh_depth_limit();
+    test_dirty_tracking();
+    test_raygen_pinhole();
+    test_raygen_jitter_and_lens();
+    test_image_srgb();
+    test_image_tonemap();
+    test_image_parallel_matches_serial();
+    test_image_writers();
+    test_scene_parse();
+    test_render_small();
+    test_rcu_snapshots();
+    test_query_server();
+    test_occlusion_queries();
+    test_instances();
+    test_sdf_primitives();
+    test_sdf_march();
+    test_progressive();
+    test_scene_binary_roundtrip();
+
+    printf("\n=== Summary ===\n");
+    if (g_failures == 0) {
+        printf("ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("FAILURES: %d\n", g_failures);
+        return 1;
+    }
+}
@@ -0,0 +1,173 @@
+#include "v3tri.h"
+#include "v3math.h"
+
+#include <math.h>
+#include <stdio.h>
+
+// ---------- internal helpers ----------
+static void v3_error(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+}
+
+static float dot3(const float *a, const float *b) {
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+// ---------- precomputation ----------
+void v3_tri_precompute(v3_tri *dst, float *v0, float *v1, float *v2) {
+    if (dst == NULL || v0 == NULL || v1 == NULL || v2 == NULL) {
+        v3_error("v3_tri_precompute received NULL pointer");
+        return;
+    }
+    float a[3] = {v0[0], v0[1], v0[2]};
+    v3_from_points(dst->e1, a, v1);
+    v3_from_points(dst->e2, a, v2);
+    v3_cross_product(dst->n, dst->e1, dst->e2);
+    dst->v0[0] = a[0]; dst->v0[1] = a[1]; dst->v0[2] = a[2];
+}
+
+void v3_tri_wt_precompute(v3_tri_wt *dst, float *v0, float *v1, float *v2) {
+    if (dst == NULL || v0 == NULL || v1 == NULL || v2 == NULL) {
+        v3_error("v3_tri_wt_precompute received NULL pointer");
+        return;
+    }
+    float e1[3], e2[3];
+    v3_from_points(e1, v0, v1);
+    v3_from_points(e2, v0, v2);
+    v3_cross_product(dst->n, e1, e2);
+    for (int k = 0; k < 3; k++) {
+        dst->v0[k] = v0[k];
+        dst->v1[k] = v1[k];
+        dst->v2[k] = v2[k];
+    }
+}
+
+void v3_tri_precompute_n(v3_tri *dst, float *verts, uint32_t *indices, size_t count) {
+    if (dst == NULL || verts == NULL || indices == NULL) {
+        v3_error("v3_tri_precompute_n received NULL pointer");
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint32_t *t = indices + 3 * i;
+        v3_tri_precompute(&dst[i], verts + 3 * (size_t)t[0],
+                          verts + 3 * (size_t)t[1], verts + 3 * (size_t)t[2]);
+    }
+}
+
+void v3_tri_wt_precompute_n(v3_tri_wt *dst, float *verts, uint32_t *indices, size_t count) {
+    if (dst == NULL || verts == NULL || indices == NULL) {
+        v3_error("v3_tri_wt_precompute_n received NULL pointer");
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint32_t *t = indices + 3 * i;
+        v3_tri_wt_precompute(&dst[i], verts + 3 * (size_t)t[0],
+                             verts + 3 * (size_t)t[1], verts + 3 * (size_t)t[2]);
+    }
+}
+
+// ---------- fast test ----------
+// Moller-Trumbore rewritten around n = e1 x e2:
+//   det = -dot(dir, n), t = dot(orig - v0, n) / det,
+//   u = -dot(e2, r) / det, v = dot(e1, r) / det with r = dir x (orig - v0).
+// One cross product instead of two, and t is checked before u and v.
+bool v3_ray_tri_intersect(v3_tri *tri, float *orig, float *dir, float t_max, float *hit) {
+    if (tri == NULL || orig == NULL || dir == NULL || hit == NULL) {
+        v3_error("v3_ray_tri_intersect received NULL pointer");
+        return false;
+    }
+    float det = -dot3(dir, tri->n);
+    if (det == 0.0f || !isfinite(det)) return false;  // parallel or degenerate
+    float inv = 1.0f / det;
+
+    float s[3] = {orig[0] - tri->v0[0], orig[1] - tri->v0[1], orig[2] - tri->v0[2]};
+    float t = dot3(s, tri->n) * inv;
+    if (!(t > 0.0f && t < t_max)) return false;
+
+    float r[3] = {
+        dir[1]*s[2] - dir[2]*s[1],
+        dir[2]*s[0] - dir[0]*s[2],
+        dir[0]*s[1] - dir[1]*s[0],
+    };
+    float u = -dot3(tri->e2, r) * inv;
+    if (u < 0.0f || u > 1.0f) return false;
+    float v = dot3(tri->e1, r) * inv;
+    if (v < 0.0f || u + v > 1.0f) return false;
+
+    hit[0] = t;
+    hit[1] = u;
+    hit[2] = v;
+    return true;
+}
+
+// ---------- watertight test ----------
+void v3_ray_wt_precompute(v3_ray_wt *ray, float *orig, float *dir) {
+    if (ray == NULL || orig == NULL || dir == NULL) {
+        v3_error("v3_ray_wt_precompute received NULL pointer");
+        return;
+    }
+    // kz is the dominant axis of dir; keep (kx, ky, kz) right-handed
+    float ax = fabsf(dir[0]), ay = fabsf(dir[1]), az = fabsf(dir[2]);
+    int kz = ax > ay ? (ax > az ? 0 : 2) : (ay > az ? 1 : 2);
+    int kx = (kz + 1) % 3;
+    int ky = (kx + 1) % 3;
+    if (dir[kz] < 0.0f) {
+        int tmp = kx;
+        kx = ky;
+        ky = tmp;
+    }
+    ray->org[0] = orig[0]; ray->org[1] = orig[1]; ray->org[2] = orig[2];
+    ray->kx = kx;
+    ray->ky = ky;
+    ray->kz = kz;
+    ray->sx = dir[kx] / dir[kz];
+    ray->sy = dir[ky] / dir[kz];
+    ray->sz = 1.0f / dir[kz];
+}
+
+bool v3_ray_tri_intersect_watertight(v3_tri_wt *tri, v3_ray_wt *ray, float t_max, float *hit) {
+    if (tri == NULL || ray == NULL || hit == NULL) {
+        v3_error("v3_ray_tri_intersect_watertight received NULL pointer");
+        return false;
+    }
+    int kx = ray->kx, ky = ray->ky, kz = ray->kz;
+    if (!isfinite(ray->sz)) return false;  // zero direction
+
+    // vertices relative to the origin, sheared so the ray runs along +z
+    float A[3] = {tri->v0[0] - ray->org[0], tri->v0[1] - ray->org[1], tri->v0[2] - ray->org[2]};
+    float B[3] = {tri->v1[0] - ray->org[0], tri->v1[1] - ray->org[1], tri->v1[2] - ray->org[2]};
+    float C[3] = {tri->v2[0] - ray->org[0], tri->v2[1] - ray->org[1], tri->v2[2] - ray->org[2]};
+    float Ax = A[kx] - ray->sx * A[kz], Ay = A[ky] - ray->sy * A[kz];
+    float Bx = B[kx] - ray->sx * B[kz], By = B[ky] - ray->sy * B[kz];
+    float Cx = C[kx] - ray->sx * C[kz], Cy = C[ky] - ray->sy * C[kz];
+
+    // scaled barycentrics (2D edge functions)
+    float U = Cx*By - Cy*Bx;
+    float V = Ax*Cy - Ay*Cx;
+    float W = Bx*Ay - By*Ax;
+
+    // an exact zero may be a rounding artifact on a shared edge: redo in double
+    if (U == 0.0f || V == 0.0f || W == 0.0f) {
+        U = (float)((double)Cx*By - (double)Cy*Bx);
+        V = (float)((double)Ax*Cy - (double)Ay*Cx);
+        W = (float)((double)Bx*Ay - (double)By*Ax);
+    }
+
+    if ((U < 0.0f || V < 0.0f || W < 0.0f) && (U > 0.0f || V > 0.0f || W > 0.0f)) return false;
+    float det = U + V + W;
+    if (det == 0.0f) return false;
+
+    float Az = ray->sz * A[kz], Bz = ray->sz * B[kz], Cz = ray->sz * C[kz];
+    float T = U*Az + V*Bz + W*Cz;
+
+    // compare t against (0, t_max) without dividing: flip T by det's sign
+    float sign = det < 0.0f ? -1.0f : 1.0f;
+    float Ts = T * sign, dets = det * sign;
+    if (!(Ts > 0.0f && Ts < t_max * dets)) return false;
+
+    float inv = 1.0f / det;
+    hit[0] = T * inv;
+    hit[1] = V * inv;  // weight of v1
+    hit[2] = W * inv;  // weight of v2
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef V3TRI_H
+#define V3TRI_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Ray-triangle intersection on precomputed per-triangle records.
+// A hit is reported as hit[3] = {t, u, v} with the point at
+// orig + t*dir = (1-u-v)*v0 + u*v1 + v*v2, and only for 0 < t < t_max.
+
+// Fast test (Moller-Trumbore using the stored normal): 48 bytes per triangle.
+typedef struct {
+    float v0[3];
+    float e1[3];   // v1 - v0
+    float e2[3];   // v2 - v0
+    float n[3];    // e1 x e2, not normalized
+} v3_tri;
+
+// Watertight test (Woop, Benthin, Wald 2013). Shared edges only stay
+// crack-free if both triangles see bit-identical vertices, so this record
+// keeps the vertices themselves rather than edge vectors.
+typedef struct {
+    float v0[3];
+    float v1[3];
+    float v2[3];
+    float n[3];    // (v1 - v0) x (v2 - v0), not normalized
+} v3_tri_wt;
+
+// Per-ray part of the watertight test: shear/permutation that maps the ray
+// onto +z. Compute once per ray and reuse for every triangle it is tested against.
+typedef struct {
+    float org[3];
+    int kx, ky, kz;
+    float sx, sy, sz;
+} v3_ray_wt;
+
+void v3_tri_precompute(v3_tri *dst, float *v0, float *v1, float *v2);
+void v3_tri_wt_precompute(v3_tri_wt *dst, float *v0, float *v1, float *v2);
+
+// build count records from an indexed mesh (3 vertex indices per triangle)
+void v3_tri_precompute_n(v3_tri *dst, float *verts, uint32_t *indices, size_t count);
+void v3_tri_wt_precompute_n(v3_tri_wt *dst, float *verts, uint32_t *indices, size_t count);
+
+bool v3_ray_tri_intersect(v3_tri *tri, float *orig, float *dir, float t_max, float *hit);
+
+void v3_ray_wt_precompute(v3_ray_wt *ray, float *orig, float *dir);
+bool v3_ray_tri_intersect_watertight(v3_tri_wt *tri, v3_ray_wt *ray, float t_max, float *hit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif